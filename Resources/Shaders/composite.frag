@@ -6,7 +6,17 @@ layout(location = 0) in vec2 in_uv;
 layout(location = 0) out vec4 out_color;
 
 layout(set = 0, binding = 0) uniform sampler2D base;
+// at the volumetric light's resolution
 layout(set = 0, binding = 1) uniform sampler2D volumetric_light;
+layout(set = 0, binding = 2) uniform sampler2D march_depth;
+layout(set = 0, binding = 3) uniform sampler2D depth_prepass;
+
+layout(push_constant) uniform PushConstants {
+	float near;
+	float far;
+	// full resolution pixels per volumetric light pixel
+	uint scale;
+};
 
 const vec3 VOLUMETRIC_LIGHT_COLOR = vec3(1, 1, 0.9);
 
@@ -14,11 +24,54 @@ vec3 blend_soft_light(vec3 base, vec3 blend) {
 	return mix(sqrt(base) * (2.0 * blend - 1.0) + 2.0 * base * (1.0 - blend), 2.0 * base * blend + base * base * (1.0 - 2.0 * blend), step(base, vec3(0.5)));
 }
 
+float linearize(float depth) {
+	// non-linear depth (GLM_FORCE_DEPTH_ZERO_TO_ONE) to view distance
+	return near * far / (far - depth * (far - near));
+}
+
+// joint bilateral, like ssao_upsample.frag: the bilinear weights of the four closest volumetric light texels, scaled down by how far the
+// depth they were marched to is from this pixel's
+float upsample_volumetric_light(ivec2 texel) {
+	ivec2 size = textureSize(volumetric_light, 0);
+	float view_distance = linearize(texelFetch(depth_prepass, texel, 0).r);
+
+	// volumetric light texel p was marched for the full resolution texel p * scale + scale / 2
+	vec2 pos = (vec2(texel) - float(scale / 2)) / float(scale);
+	ivec2 base_texel = ivec2(floor(pos));
+	vec2 f = pos - vec2(base_texel);
+
+	const ivec2 offsets[4] = ivec2[4](ivec2(0, 0), ivec2(1, 0), ivec2(0, 1), ivec2(1, 1));
+	vec4 bilinear = vec4((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y), (1.0 - f.x) * f.y, f.x * f.y);
+
+	float result = 0.0;
+	float total_weight = 0.0;
+	float closest_light = 0.0;
+	float closest_delta = 1e30;
+
+	for (int i = 0; i < 4; ++i) {
+		ivec2 tap = clamp(base_texel + offsets[i], ivec2(0), size - 1);
+		float light = texelFetch(volumetric_light, tap, 0).r;
+		float delta = abs(linearize(texelFetch(march_depth, tap, 0).r) - view_distance) / view_distance;
+
+		float weight = bilinear[i] / (delta + 1e-3);
+		result += light * weight;
+		total_weight += weight;
+
+		if (delta < closest_delta) {
+			closest_delta = delta;
+			closest_light = light;
+		}
+	}
+
+	return closest_delta > 0.1 ? closest_light : result / total_weight;
+}
+
 void main() {
 	vec3 color = texture(base, in_uv).rgb;
 
 	// composite volumetric light
-	float volumetric_light = texture(volumetric_light, in_uv).r;
+	ivec2 texel = min(ivec2(in_uv * vec2(textureSize(depth_prepass, 0))), textureSize(depth_prepass, 0) - 1);
+	float volumetric_light = upsample_volumetric_light(texel);
 
 	// color = mix(color, vec3(volumetric_light) * VOLUMETRIC_LIGHT_COLOR, volumetric_light * 0.002);
 	color += vec3(volumetric_light) * VOLUMETRIC_LIGHT_COLOR * 0.2;
@@ -0,0 +1,38 @@
+#version 450
+#pragma shader_stage(fragment)
+
+// like composite.frag, with the fog from FroxelFogPass instead of the raymarched volumetric light
+
+layout(location = 0) in vec2 in_uv;
+
+layout(location = 0) out vec4 out_color;
+
+layout(set = 0, binding = 0) uniform sampler2D base;
+layout(set = 0, binding = 1) uniform sampler3D froxels;
+layout(set = 0, binding = 2) uniform sampler2D depth_prepass;
+
+layout(push_constant) uniform PushConstants {
+	float near;
+	// of the froxel grid
+	float far;
+	float camera_far;
+};
+
+#include "froxel.glsl"
+
+void main() {
+	vec3 color = texture(base, in_uv).rgb;
+
+	// non-linear depth (GLM_FORCE_DEPTH_ZERO_TO_ONE) to view distance
+	float depth = texture(depth_prepass, in_uv).r;
+	float view_distance = near * camera_far / (camera_far - depth * (camera_far - near));
+
+	// every froxel holds the fog up to its far side, so step back half a slice
+	float slices = float(textureSize(froxels, 0).z);
+	vec4 fog = texture(froxels, vec3(in_uv, slice_coord(view_distance, near, far) - 0.5 / slices));
+
+	// both linear HDR; PostProcessPass tonemaps the sum
+	color = color * fog.a + fog.rgb;
+
+	out_color = vec4(color, 1);
+}
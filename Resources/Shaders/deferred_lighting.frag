@@ -0,0 +1,61 @@
+#version 450
+#pragma shader_stage(fragment)
+
+layout(location = 0) out vec4 out_color;
+
+layout(set = 0, binding = 0) uniform Camera {
+	mat4 inv_view_proj;
+	mat4 view;
+	vec3 cam_pos;
+	// see AtmosphericSkyCubemap::skybox_model_matrix
+	float sky_half_extent;
+};
+
+#include "pbr_lighting.glsl"
+
+layout(set = 1, binding = 0) uniform sampler2D depth_prepass;
+layout(set = 1, binding = 1) uniform sampler2D g_normal;
+layout(set = 1, binding = 2) uniform sampler2D g_albedo;
+layout(set = 1, binding = 3) uniform sampler2D g_material;
+
+layout(push_constant) uniform PushConstants {
+	vec2 screen_size;
+};
+
+#include "normal_encoding.glsl"
+
+void main() {
+	// same pixel as every g-buffer target, no matter which way the fullscreen triangle's uvs go
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	vec2 screen_uv = gl_FragCoord.xy / screen_size;
+
+	float depth = texelFetch(depth_prepass, texel, 0).r;
+	vec4 world_pos = inv_view_proj * vec4(screen_uv * 2.0 - 1.0, depth, 1.0);
+	world_pos /= world_pos.w;
+
+	// the sky is a camera centered cube that's already been drawn under this pass (same test as depth_reduce.comp)
+	vec3 offset = abs(world_pos.xyz - cam_pos);
+	if (depth >= 1.0 || max(offset.x, max(offset.y, offset.z)) >= sky_half_extent * 0.999) {
+		discard;
+	}
+
+	vec4 albedo_ao = texelFetch(g_albedo, texel, 0);
+	vec2 material = texelFetch(g_material, texel, 0).rg;
+
+	Surface s;
+	s.pos = world_pos.xyz;
+	s.N = decode_normal(texelFetch(g_normal, texel, 0).rg);
+	// the forward path offsets along the interpolated vertex normal, which isn't stored
+	s.shadow_normal = s.N;
+	s.view_z = (view * vec4(s.pos, 1.0)).z;
+
+	s.albedo = albedo_ao.rgb;
+	s.metallic = material.r;
+	s.roughness = material.g;
+	s.ao = albedo_ao.a;
+	s.frag_coord = gl_FragCoord.xy;
+
+	float ssao = texture(g_ssao, screen_uv).r;
+
+	out_color = vec4(shade(s, cam_pos, ssao), 1.0);
+}
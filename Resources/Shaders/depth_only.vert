@@ -1,9 +1,6 @@
 #version 450
 #pragma shader_stage(vertex)
 
-// keep this in sync with CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT
-#define SHADOW_MAP_CASCADE_COUNT 4
-
 layout(location = 0) in vec3 in_pos;
 layout(location = 1) in vec3 in_normal;
 
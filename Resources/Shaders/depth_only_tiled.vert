@@ -0,0 +1,34 @@
+#version 450
+#pragma shader_stage(vertex)
+
+layout(location = 0) in vec3 in_pos;
+layout(location = 1) in vec3 in_normal;
+
+layout(set = 0, binding = 0) uniform Uniforms {
+	mat4[SHADOW_MAP_CASCADE_COUNT] light_space_mats;
+	// xy = scale, zw = offset from a cascade's clip space to its tile in atlas clip space
+	vec4[SHADOW_MAP_CASCADE_COUNT] tile_transforms;
+};
+
+layout(set = 1, binding = 0) uniform Model {
+	mat4 model;
+};
+
+out gl_PerVertex {
+	vec4 gl_Position;
+	float gl_ClipDistance[4];
+};
+
+void main() {
+	// one instance per cascade; the first instance of each draw is the first cascade it goes into
+	vec4 pos = light_space_mats[gl_InstanceIndex] * model * vec4(in_pos, 1.0);
+
+	// the rasterizer only clips against the whole atlas, so clip against the edges of the tile here
+	gl_ClipDistance[0] = pos.w + pos.x;
+	gl_ClipDistance[1] = pos.w - pos.x;
+	gl_ClipDistance[2] = pos.w + pos.y;
+	gl_ClipDistance[3] = pos.w - pos.y;
+
+	vec4 tile = tile_transforms[gl_InstanceIndex];
+	gl_Position = vec4(pos.xy * tile.xy + tile.zw * pos.w, pos.zw);
+}
@@ -0,0 +1,11 @@
+// the froxel grid shared by froxel_inject.comp, froxel_integrate.comp and composite_froxel.frag (see FroxelFogPass)
+
+// view distance of the boundary between slices z - 1 and z; the slices are exponential like LightClusters', so close ones are thin
+float slice_distance(float z, float slice_count, float near, float far) {
+	return near * pow(far / near, z / slice_count);
+}
+
+// inverse of slice_distance, normalized to [0, 1]
+float slice_coord(float view_distance, float near, float far) {
+	return log(max(view_distance, near) / near) / log(far / near);
+}
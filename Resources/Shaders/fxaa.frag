@@ -0,0 +1,137 @@
+#version 450
+#pragma shader_stage(fragment)
+
+// fast approximate anti-aliasing (Lottes 2009, the quality variant): finds the direction of the edge through each pixel from the contrast of
+// its neighbours, walks along it to both ends, and blends towards the other side of the edge by how close the pixel is to its end
+
+layout(location = 0) out vec4 out_color;
+
+// bilinear, clamped to the edge
+layout(set = 0, binding = 0) uniform sampler2D image;
+
+// the minimum contrast, relative to the brightest neighbour, that counts as an edge
+const float EDGE_THRESHOLD = 0.125;
+// and in absolute terms, so dark areas aren't processed for nothing
+const float EDGE_THRESHOLD_MIN = 0.0312;
+// how much of the sub-pixel aliasing (single pixel features) is blurred away
+const float SUBPIXEL_QUALITY = 0.75;
+
+// the walk along the edge speeds up the further it gets
+const int SEARCH_STEPS = 12;
+const float SEARCH_STEP_SIZES[SEARCH_STEPS] = float[SEARCH_STEPS](1.0, 1.0, 1.0, 1.0, 1.0, 1.5, 2.0, 2.0, 2.0, 2.0, 4.0, 8.0);
+
+// perceptual, roughly: the image is sampled as linear
+float luma(vec3 color) {
+	return sqrt(dot(color, vec3(0.299, 0.587, 0.114)));
+}
+
+float luma_at(vec2 uv) {
+	return luma(texture(image, uv).rgb);
+}
+
+void main() {
+	vec2 inv_size = 1.0 / vec2(textureSize(image, 0));
+	vec2 uv = gl_FragCoord.xy * inv_size;
+
+	vec3 center_color = texture(image, uv).rgb;
+	float center = luma(center_color);
+	float up = luma(textureOffset(image, uv, ivec2(0, -1)).rgb);
+	float down = luma(textureOffset(image, uv, ivec2(0, 1)).rgb);
+	float left = luma(textureOffset(image, uv, ivec2(-1, 0)).rgb);
+	float right = luma(textureOffset(image, uv, ivec2(1, 0)).rgb);
+
+	float luma_min = min(center, min(min(up, down), min(left, right)));
+	float luma_max = max(center, max(max(up, down), max(left, right)));
+	float range = luma_max - luma_min;
+
+	if (range < max(EDGE_THRESHOLD_MIN, luma_max * EDGE_THRESHOLD)) {
+		out_color = vec4(center_color, 1.0);
+		return;
+	}
+
+	float up_left = luma(textureOffset(image, uv, ivec2(-1, -1)).rgb);
+	float up_right = luma(textureOffset(image, uv, ivec2(1, -1)).rgb);
+	float down_left = luma(textureOffset(image, uv, ivec2(-1, 1)).rgb);
+	float down_right = luma(textureOffset(image, uv, ivec2(1, 1)).rgb);
+
+	float edge_horizontal = abs(-2.0 * left + up_left + down_left) + 2.0 * abs(-2.0 * center + up + down) + abs(-2.0 * right + up_right + down_right);
+	float edge_vertical = abs(-2.0 * up + up_left + up_right) + 2.0 * abs(-2.0 * center + left + right) + abs(-2.0 * down + down_left + down_right);
+	bool horizontal = edge_horizontal >= edge_vertical;
+
+	// which side of the pixel the edge is on: the one with the steeper gradient
+	float luma1 = horizontal ? up : left;
+	float luma2 = horizontal ? down : right;
+	float gradient1 = luma1 - center;
+	float gradient2 = luma2 - center;
+	bool steepest1 = abs(gradient1) >= abs(gradient2);
+	float gradient_scaled = 0.25 * max(abs(gradient1), abs(gradient2));
+
+	float step_length = horizontal ? inv_size.y : inv_size.x;
+	float local_average;
+	if (steepest1) {
+		step_length = -step_length;
+		local_average = 0.5 * (luma1 + center);
+	} else {
+		local_average = 0.5 * (luma2 + center);
+	}
+
+	// walk along the edge, half a pixel towards it, until the luma no longer matches the edge's on either end
+	vec2 edge_uv = uv;
+	if (horizontal) {
+		edge_uv.y += step_length * 0.5;
+	} else {
+		edge_uv.x += step_length * 0.5;
+	}
+
+	vec2 offset = horizontal ? vec2(inv_size.x, 0.0) : vec2(0.0, inv_size.y);
+	vec2 uv1 = edge_uv - offset;
+	vec2 uv2 = edge_uv + offset;
+	float end1 = 0.0;
+	float end2 = 0.0;
+	bool reached1 = false;
+	bool reached2 = false;
+
+	for (int i = 0; i < SEARCH_STEPS && !(reached1 && reached2); ++i) {
+		if (!reached1) {
+			end1 = luma_at(uv1) - local_average;
+			reached1 = abs(end1) >= gradient_scaled;
+		}
+		if (!reached2) {
+			end2 = luma_at(uv2) - local_average;
+			reached2 = abs(end2) >= gradient_scaled;
+		}
+
+		if (!reached1) {
+			uv1 -= offset * SEARCH_STEP_SIZES[i];
+		}
+		if (!reached2) {
+			uv2 += offset * SEARCH_STEP_SIZES[i];
+		}
+	}
+
+	float distance1 = horizontal ? uv.x - uv1.x : uv.y - uv1.y;
+	float distance2 = horizontal ? uv2.x - uv.x : uv2.y - uv.y;
+	bool closer_to1 = distance1 < distance2;
+	float edge_length = distance1 + distance2;
+
+	// only blend if the closer end goes the same way as the center, otherwise this pixel is on the far side of the edge's tip
+	float pixel_offset = 0.5 - min(distance1, distance2) / edge_length;
+	bool center_smaller = center < local_average;
+	bool correct_variation = ((closer_to1 ? end1 : end2) < 0.0) != center_smaller;
+	float final_offset = correct_variation ? pixel_offset : 0.0;
+
+	// sub-pixel aliasing: how much the pixel stands out from its whole 3x3 neighbourhood
+	float neighbourhood_average = (2.0 * (up + down + left + right) + up_left + up_right + down_left + down_right) / 12.0;
+	float subpixel = clamp(abs(neighbourhood_average - center) / range, 0.0, 1.0);
+	subpixel = (-2.0 * subpixel + 3.0) * subpixel * subpixel;
+	final_offset = max(final_offset, subpixel * subpixel * SUBPIXEL_QUALITY);
+
+	vec2 final_uv = uv;
+	if (horizontal) {
+		final_uv.y += final_offset * step_length;
+	} else {
+		final_uv.x += final_offset * step_length;
+	}
+
+	out_color = vec4(texture(image, final_uv).rgb, 1.0);
+}
@@ -5,9 +5,8 @@ layout(location = 0) in vec3 in_pos;
 layout(location = 1) in vec3 in_normal;
 layout(location = 2) in vec2 in_tex_coords;
 
-// MRT
-layout(location = 0) out vec4 out_pos;
-layout(location = 1) out vec4 out_normal;
+// position is reconstructed from depth_prepass where it's needed
+layout(location = 0) out vec2 out_normal;
 
 layout(set = 1, binding = 1) uniform sampler2D normal_map;
 
@@ -27,7 +26,8 @@ vec3 get_normal_from_map() {
 	return normalize(TBN * tangent_normal);
 }
 
+#include "normal_encoding.glsl"
+
 void main() {
-	out_pos = vec4(in_pos, 1.0);
-	out_normal = vec4(get_normal_from_map(), 1.0);
+	out_normal = encode_normal(get_normal_from_map());
 }
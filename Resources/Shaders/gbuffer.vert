@@ -8,6 +8,8 @@ layout(location = 2) in vec2 in_tex_coords;
 layout(location = 0) out vec3 out_pos;
 layout(location = 1) out vec3 out_normal;
 layout(location = 2) out vec2 out_tex_coords;
+// only used by gbuffer_deferred.frag
+layout(location = 3) out vec3 out_world_pos;
 
 layout(set = 0, binding = 0) uniform Uniforms {
 	mat4 proj;
@@ -22,9 +24,14 @@ out gl_PerVertex {
 	vec4 gl_Position;
 };
 
+// the PBR pass tests against this depth with an equal compare (see pbr.vert)
+invariant gl_Position;
+
 void main() {
-	vec4 view_pos = view * model * vec4(in_pos, 1);
+	vec4 world_pos = model * vec4(in_pos, 1.0);
+	vec4 view_pos = view * world_pos;
 	out_pos = view_pos.xyz;
+	out_world_pos = world_pos.xyz / world_pos.w;
 
 	out_tex_coords = in_tex_coords;
 
@@ -0,0 +1,48 @@
+#version 450
+#pragma shader_stage(fragment)
+
+layout(location = 0) in vec3 in_pos;
+layout(location = 1) in vec3 in_normal;
+layout(location = 2) in vec2 in_tex_coords;
+layout(location = 3) in vec3 in_world_pos;
+
+// everything deferred_lighting.frag needs besides depth
+layout(location = 0) out vec2 out_normal;
+// linear albedo (the target is sRGB), ao
+layout(location = 1) out vec4 out_albedo;
+// metallic, roughness
+layout(location = 2) out vec2 out_material;
+
+layout(set = 1, binding = 1) uniform sampler2D normal_map;
+layout(set = 1, binding = 2) uniform sampler2D albedo_map;
+layout(set = 1, binding = 3) uniform sampler2D metallic_map;
+layout(set = 1, binding = 4) uniform sampler2D roughness_map;
+layout(set = 1, binding = 5) uniform sampler2D ao_map;
+
+#include "normal_encoding.glsl"
+
+// same as pbr.frag, so both paths shade the same normal
+vec3 get_normal_from_map(vec2 uv) {
+	vec3 tangent_normal = texture(normal_map, uv).xyz * 2.0 - 1.0;
+
+	vec3 Q1 = dFdx(in_world_pos);
+	vec3 Q2 = dFdy(in_world_pos);
+	vec2 st1 = dFdx(uv);
+	vec2 st2 = dFdy(uv);
+
+	vec3 N = normalize(in_normal);
+	vec3 T = normalize(Q1 * st2.t - Q2 * st1.t);
+	vec3 B = -normalize(cross(N, T));
+	mat3 TBN = mat3(T, B, N);
+
+	return normalize(TBN * tangent_normal);
+}
+
+void main() {
+	// pbr.vert tiles the material twice
+	vec2 uv = in_tex_coords * 2;
+
+	out_normal = encode_normal(get_normal_from_map(uv));
+	out_albedo = vec4(pow(texture(albedo_map, uv).rgb, vec3(2.2)), texture(ao_map, uv).r);
+	out_material = vec2(texture(metallic_map, uv).r, texture(roughness_map, uv).r);
+}
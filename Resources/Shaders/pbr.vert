@@ -23,6 +23,9 @@ out gl_PerVertex {
 	vec4 gl_Position;
 };
 
+// has to come out bit-identical to gbuffer.vert, since this pass only shades where its depth is equal to depth_prepass
+invariant gl_Position;
+
 void main() {
 	out_uv = in_uv * 2;
 	vec4 locPos = model * vec4(in_pos, 1.0);
@@ -30,5 +33,6 @@ void main() {
 	out_normal = normalize(transpose(inverse(mat3(model))) * in_normal);
 	out_mv_pos = (view * vec4(out_pos, 1.0)).xyz;
 
-	gl_Position = projection * view * vec4(out_pos, 1.0);
+	// same operations, in the same order, as gbuffer.vert
+	gl_Position = projection * (view * locPos);
 }
\ No newline at end of file
@@ -0,0 +1,277 @@
+// shading shared by the forward (pbr.frag) and deferred (deferred_lighting.frag) paths; both bind these to set 0
+
+// IBL
+layout(set = 0, binding = 1) uniform samplerCube irradiance_map;
+layout(set = 0, binding = 2) uniform samplerCube prefilter_map;
+layout(set = 0, binding = 3) uniform sampler2D brdf_lut;
+layout(set = 0, binding = 4) uniform sampler2D shadow_map;
+
+// cool FX
+layout(set = 0, binding = 5) uniform sampler2D g_ssao;
+
+layout(set = 0, binding = 6) uniform Cascades {
+	// i can get away with vec4 because float[SHADOW_MAP_CASCADE_COUNT] -> float[4] -> vec4 and thus i don't have to deal with alignment
+	vec4 cascade_splits;
+	mat4 cascade_view_proj_mats[SHADOW_MAP_CASCADE_COUNT];
+	// xy = offset, zw = scale of each cascade's tile in the shadow atlas
+	vec4 cascade_atlas_rects[SHADOW_MAP_CASCADE_COUNT];
+	vec3 light_direction;
+};
+
+// point and spot lights, assigned to clusters on the CPU (see LightClusters and ClusteredLightPass)
+layout(set = 0, binding = 7) uniform LightGrid {
+	// xy = clusters per pixel, z = slice scale, w = slice bias: slice = floor(log2(view distance) * z + w)
+	vec4 grid_scale;
+	uvec4 grid_size;
+};
+
+struct Light {
+	vec4 position_radius;
+	// premultiplied by the intensity
+	vec4 color;
+	vec4 direction;
+	// x = scale, y = offset of the cone falloff; (0, 1) for point lights
+	vec4 spot;
+};
+
+layout(std430, set = 0, binding = 8) readonly buffer Lights {
+	Light lights[];
+};
+
+// per cluster: x = offset into light_indices, y = count
+layout(std430, set = 0, binding = 9) readonly buffer LightRanges {
+	uvec2 light_ranges[];
+};
+
+layout(std430, set = 0, binding = 10) readonly buffer LightIndices {
+	uint light_indices[];
+};
+
+// the sun :O
+const vec3 lightColors[1] = vec3[1](vec3(100, 100, 100));
+
+const mat4 biasMat = mat4(0.5, 0.0, 0.0, 0.0, 0.0, 0.5, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.5, 0.5, 0.0, 1.0);
+
+struct Surface {
+	// world space
+	vec3 pos;
+	vec3 N;
+	// the shadow lookup is pushed out along this, against acne
+	vec3 shadow_normal;
+	// view space z, picks the cascade
+	float view_z;
+
+	vec3 albedo;
+	float metallic;
+	float roughness;
+	float ao;
+
+	// picks the light cluster
+	vec2 frag_coord;
+};
+
+// the rest of this is a slightly modified version of LearnOpenGL's PBR shader
+
+const float PI = 3.14159265359;
+
+float distribution_ggx(vec3 N, vec3 H, float roughness) {
+	float a = roughness * roughness;
+	float a2 = a * a;
+	float NdotH = max(dot(N, H), 0.0);
+	float NdotH2 = NdotH * NdotH;
+
+	float nom = a2;
+	float denom = (NdotH2 * (a2 - 1.0) + 1.0);
+	denom = PI * denom * denom;
+
+	return nom / denom;
+}
+
+float geometry_schlick_ggx(float NdotV, float roughness) {
+	float r = (roughness + 1.0);
+	float k = (r * r) / 8.0;
+
+	float nom = NdotV;
+	float denom = NdotV * (1.0 - k) + k;
+
+	return nom / denom;
+}
+
+float geometry_smith(vec3 N, vec3 V, vec3 L, float roughness) {
+	float NdotV = max(dot(N, V), 0.0);
+	float NdotL = max(dot(N, L), 0.0);
+	float ggx2 = geometry_schlick_ggx(NdotV, roughness);
+	float ggx1 = geometry_schlick_ggx(NdotL, roughness);
+
+	return ggx1 * ggx2;
+}
+
+vec3 fresnel_schlick(float cosTheta, vec3 F0) {
+	return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+vec3 fresnel_schlick_roughness(float cosTheta, vec3 F0, float roughness) {
+	return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+// keeps the lookup (and its filter footprint) inside the cascade's tile, so it never picks up a neighbouring tile
+vec2 atlas_uv(vec2 uv, uint cascadeIndex) {
+	vec4 rect = cascade_atlas_rects[cascadeIndex];
+	vec2 half_texel = 0.5 / vec2(textureSize(shadow_map, 0));
+	return rect.xy + clamp(uv * rect.zw, half_texel, rect.zw - half_texel);
+}
+
+float texture_proj(vec4 shadowCoord, vec2 offset, uint cascadeIndex, vec3 N) {
+	float shadow = 1.0;
+	float bias = 0.005 * tan(acos(clamp(dot(N, normalize(-light_direction)), 0, 1)));
+
+	if (shadowCoord.z > -1.0 && shadowCoord.z < 1.0) {
+		float dist = texture(shadow_map, atlas_uv(shadowCoord.st + offset, cascadeIndex)).r;
+		if (shadowCoord.w > 0 && dist < shadowCoord.z - bias) {
+			shadow = 0; // ambient light
+		}
+	}
+
+	return shadow;
+}
+
+// shadows :)
+float shadow_calculation(Surface s) {
+	uint cascadeIndex = 0;
+	for (uint i = 0; i < SHADOW_MAP_CASCADE_COUNT - 1; ++i) {
+		if (s.view_z < cascade_splits[i]) {
+			cascadeIndex = i + 1;
+		}
+	}
+
+	vec4 sc = (biasMat * cascade_view_proj_mats[cascadeIndex]) * vec4(s.pos + s.shadow_normal * 0.1, 1.0);
+	sc = sc / sc.w;
+
+	// the cascade's own resolution, not the atlas'
+	vec2 texDim = vec2(textureSize(shadow_map, 0)) * cascade_atlas_rects[cascadeIndex].zw;
+	float scale = 0.75;
+	float dx = scale * 1.0 / float(texDim.x);
+	float dy = scale * 1.0 / float(texDim.y);
+
+	float shadowFactor = 0.0;
+	int count = 0;
+	int range = 8;
+
+	for (int x = -range; x <= range; x++) {
+		for (int y = -range; y <= range; y++) {
+			shadowFactor += texture_proj(sc, vec2(dx * x, dy * y), cascadeIndex, s.N);
+			count++;
+		}
+	}
+
+	return shadowFactor / count;
+}
+
+// outgoing radiance towards V from light arriving along L
+vec3 direct_light(Surface s, vec3 V, vec3 L, vec3 F0, vec3 radiance) {
+	vec3 N = s.N;
+	vec3 H = normalize(V + L);
+
+	// Cook-Torrance BRDF
+	float NDF = distribution_ggx(N, H, s.roughness);
+	float G = geometry_smith(N, V, L, s.roughness);
+	vec3 F = fresnel_schlick(max(dot(H, V), 0.0), F0);
+
+	vec3 nominator = NDF * G * F;
+	float denominator = 4 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.001; // 0.001 to prevent divide by zero.
+	vec3 specular = nominator / denominator;
+
+	// kS is equal to Fresnel
+	vec3 kS = F;
+	// for energy conservation, the diffuse and specular light can't
+	// be above 1.0 (unless the surface emits light); to preserve this
+	// relationship the diffuse component (kD) should equal 1.0 - kS.
+	vec3 kD = vec3(1.0) - kS;
+	// multiply kD by the inverse metalness such that only non-metals
+	// have diffuse lighting, or a linear blend if partly metal (pure metals
+	// have no diffuse light).
+	kD *= 1.0 - s.metallic;
+
+	// scale light by NdotL
+	float NdotL = max(dot(N, L), 0.0);
+
+	return (kD * s.albedo / PI + specular) * radiance * NdotL; // note that we already multiplied the BRDF by the Fresnel (kS) so we won't multiply by kS again
+}
+
+// only the lights of the surface's cluster
+vec3 local_lights(Surface s, vec3 V, vec3 F0) {
+	uvec3 cluster;
+	cluster.xy = min(uvec2(s.frag_coord * grid_scale.xy), grid_size.xy - 1);
+	cluster.z = uint(clamp(floor(log2(max(-s.view_z, 1e-4)) * grid_scale.z + grid_scale.w), 0.0, float(grid_size.z - 1)));
+	uvec2 range = light_ranges[(cluster.z * grid_size.y + cluster.y) * grid_size.x + cluster.x];
+
+	vec3 Lo = vec3(0.0);
+	for (uint i = range.x; i < range.x + range.y; ++i) {
+		Light light = lights[light_indices[i]];
+
+		vec3 to_light = light.position_radius.xyz - s.pos;
+		float distance_sq = dot(to_light, to_light);
+		vec3 L = to_light * inversesqrt(max(distance_sq, 1e-8));
+
+		// inverse square, windowed to reach zero at the radius
+		float radius = light.position_radius.w;
+		float window = clamp(1.0 - pow(distance_sq / (radius * radius), 2.0), 0.0, 1.0);
+		float attenuation = window * window / (distance_sq + 1.0);
+
+		float cone = clamp(dot(light.direction.xyz, -L) * light.spot.x + light.spot.y, 0.0, 1.0);
+		attenuation *= cone * cone;
+
+		if (attenuation > 0.0) {
+			Lo += direct_light(s, V, L, F0, light.color.rgb * attenuation);
+		}
+	}
+	return Lo;
+}
+
+// linear HDR; PostProcessPass tonemaps
+vec3 shade(Surface s, vec3 cam_pos, float ssao) {
+	vec3 N = s.N;
+	vec3 V = normalize(cam_pos - s.pos);
+	vec3 R = reflect(-V, N);
+
+	float shadow = shadow_calculation(s);
+	shadow = clamp(shadow, 0, 1);
+
+	vec3 F0 = vec3(0.04);
+	F0 = mix(F0, s.albedo, s.metallic);
+
+	// reflectance equation
+	vec3 Lo = vec3(0.0);
+
+	// for a single directional light:
+	Lo += direct_light(s, V, normalize(-light_direction), F0, lightColors[0]); // no attenuation for directional lights
+
+	// ambient lighting (we now use IBL as the ambient term)
+	vec3 F = fresnel_schlick_roughness(max(dot(N, V), 0.0), F0, s.roughness);
+
+	vec3 kS = F;
+	vec3 kD = 1.0 - kS;
+	kD *= 1.0 - s.metallic;
+
+	vec3 irradiance = texture(irradiance_map, N).rgb;
+	vec3 diffuse = irradiance * s.albedo;
+
+	// sample both the pre-filter map and the BRDF lut and combine them together as per the Split-Sum approximation to get the IBL specular part.
+	const float MAX_REFLECTION_LOD = 4.0;
+	vec3 prefilteredColor = textureLod(prefilter_map, R, s.roughness * MAX_REFLECTION_LOD).rgb;
+	vec2 brdf = texture(brdf_lut, vec2(max(dot(N, V), 0.0), s.roughness)).rg;
+	vec3 specular = prefilteredColor * (F * brdf.x + brdf.y);
+
+	vec3 ambient = (kD * diffuse + specular) * s.ao;
+
+	vec3 color = ambient * ssao + Lo * shadow;
+
+	shadow = clamp(shadow, 0.2, 1);
+
+	color.rgb *= shadow;
+
+	// the sun's shadow doesn't apply to them
+	color += local_lights(s, V, F0) * s.ao;
+
+	return color;
+}
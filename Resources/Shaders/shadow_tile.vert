@@ -0,0 +1,24 @@
+#version 450
+#pragma shader_stage(vertex)
+
+// instance i covers the atlas tile target_rects[i], optionally copying the static atlas texels source_offsets[i] away from it into it
+layout(push_constant) uniform Tiles {
+	// xy = min, zw = max, in atlas clip space
+	vec4 target_rects[SHADOW_MAP_CASCADE_COUNT];
+	ivec2 source_offsets[SHADOW_MAP_CASCADE_COUNT];
+};
+
+layout(location = 0) flat out ivec2 out_source_offset;
+
+out gl_PerVertex {
+	vec4 gl_Position;
+};
+
+const vec2 corners[6] = vec2[6](vec2(0, 0), vec2(1, 0), vec2(0, 1), vec2(0, 1), vec2(1, 0), vec2(1, 1));
+
+void main() {
+	// two triangles covering the tile, at the far plane
+	vec4 rect = target_rects[gl_InstanceIndex];
+	gl_Position = vec4(mix(rect.xy, rect.zw, corners[gl_VertexIndex]), 1.0, 1.0);
+	out_source_offset = source_offsets[gl_InstanceIndex];
+}
@@ -0,0 +1,12 @@
+#version 450
+#pragma shader_stage(fragment)
+
+// cached static casters of every cached cascade
+layout(set = 0, binding = 0) uniform sampler2D static_shadow_atlas;
+
+layout(location = 0) flat in ivec2 in_source_offset;
+
+void main() {
+	// the static tile has the same size as the cascade's, so this is a straight copy
+	gl_FragDepth = texelFetch(static_shadow_atlas, ivec2(gl_FragCoord.xy) + in_source_offset, 0).r;
+}
@@ -1,7 +1,7 @@
 #version 450
 #pragma shader_stage(fragment)
 
-layout(location = 0) in vec2 in_uv;
+layout(location = 0) in vec3 in_pos;
 
 layout(location = 0) out vec4 out_color;
 
@@ -96,8 +96,9 @@ vec3 atmosphere(vec3 r, vec3 r0, vec3 sun_pos, float sun_intensity, float planet
 void main() {
 	vec3 sun_pos = normalize(-light_direction);
 
+	// rendered through cubemap.vert, so in_pos is the world-space view direction of this cubemap texel
 	vec3 color = atmosphere(
-		normalize(vec3(in_uv * 2 - vec2(1), -1)), vec3(0, 6372e3, 0), sun_pos, 22.0, 6371e3, 6471e3, vec3(5.5e-6, 13.0e-6, 22.4e-6), 21e-6, 8e3, 1.2e3, 0.758);
+		normalize(in_pos), vec3(0, 6372e3, 0), sun_pos, 22.0, 6371e3, 6471e3, vec3(5.5e-6, 13.0e-6, 22.4e-6), 21e-6, 8e3, 1.2e3, 0.758);
 
 	color = 1 - exp(-1 * color);
 
@@ -16,13 +16,17 @@ layout(set = 0, binding = 1) uniform Model {
 	mat4 model;
 };
 
+// maps the cube's local position to the cubemap sampling direction
+layout(set = 0, binding = 3) uniform SampleTransform {
+	mat4 sample_transform;
+};
+
 out gl_PerVertex {
 	vec4 gl_Position;
 };
 
 void main() {
-	out_uv = in_pos;
-	out_uv.y *= -1;
+	out_uv = (sample_transform * vec4(in_pos, 0)).xyz;
 
 	gl_Position = projection * view * model * vec4(in_pos, 1);
 }
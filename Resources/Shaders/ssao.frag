@@ -3,16 +3,16 @@
 
 #define KERNEL_SIZE 64
 
-layout(location = 0) in vec2 in_uv;
+// r = ambient occlusion, g = view distance of the texel it was computed for (for the bilateral blur and upsample)
+layout(location = 0) out vec2 out_ao;
 
-layout(location = 0) out float out_ao;
-
-layout(set = 0, binding = 0) uniform sampler2D g_position;
+layout(set = 0, binding = 0) uniform sampler2D depth_prepass;
 layout(set = 0, binding = 1) uniform sampler2D g_normal;
 layout(set = 0, binding = 2) uniform sampler2D random_normal;
 layout(set = 0, binding = 3) uniform Uniforms {
 	vec4 samples[KERNEL_SIZE];
 	mat4 projection;
+	mat4 inv_projection;
 };
 
 const float radius = 0.5;
@@ -20,23 +20,43 @@ const float bias = 0.025;
 
 layout(push_constant) uniform PushConsts {
 	vec2 screen_size;
+	// moves the noise around every frame when accumulating
+	vec2 noise_offset;
+	// full resolution pixels per ssao pixel (1, 2 or 4)
+	uint scale;
+	// this frame uses samples[i * KERNEL_SIZE / sample_count + sample_offset] (all of them, unless it's accumulated over frames)
+	uint sample_count;
+	uint sample_offset;
 }
 push_consts;
 
+#include "normal_encoding.glsl"
+
+// view space position of whatever was drawn at uv
+vec3 view_pos(vec2 uv) {
+	vec4 pos = inv_projection * vec4(uv * 2.0 - 1.0, texture(depth_prepass, uv).r, 1.0);
+	return pos.xyz / pos.w;
+}
+
 void main() {
-	vec2 noise_scale = vec2(push_consts.screen_size.x / 4, push_consts.screen_size.y / 4);
+	// every ssao pixel is computed for one full resolution texel (and its depth), so the upsample knows exactly where it sits
+	ivec2 texel = min(ivec2(gl_FragCoord.xy) * int(push_consts.scale) + int(push_consts.scale / 2), ivec2(push_consts.screen_size) - 1);
+	vec2 uv = (vec2(texel) + 0.5) / push_consts.screen_size;
 
-	vec3 frag_pos = texture(g_position, in_uv).xyz;
-	vec3 normal = normalize(texture(g_normal, in_uv).rgb);
-	vec3 random_vec = normalize(texture(random_normal, in_uv * noise_scale).xyz);
+	vec4 pos = inv_projection * vec4(uv * 2.0 - 1.0, texelFetch(depth_prepass, texel, 0).r, 1.0);
+	vec3 frag_pos = pos.xyz / pos.w;
+	vec3 normal = decode_normal(texelFetch(g_normal, texel, 0).rg);
+	// the noise tiles over 4x4 ssao pixels, which is what the blur evens out
+	vec3 random_vec = normalize(texture(random_normal, gl_FragCoord.xy / 4.0 + push_consts.noise_offset).xyz);
 
 	vec3 tangent = normalize(random_vec - normal * dot(random_vec, normal));
 	vec3 bitangent = cross(normal, tangent);
 	mat3 TBN = mat3(tangent, bitangent, normal);
 
 	float occlusion = 0;
-	for (int i = 0; i < KERNEL_SIZE; ++i) {
-		vec3 sample_pos = TBN * samples[i].xyz;
+	uint stride = KERNEL_SIZE / push_consts.sample_count;
+	for (uint i = 0; i < push_consts.sample_count; ++i) {
+		vec3 sample_pos = TBN * samples[i * stride + push_consts.sample_offset].xyz;
 		sample_pos = frag_pos + sample_pos * radius;
 
 		vec4 offset = vec4(sample_pos, 1);
@@ -44,13 +64,13 @@ void main() {
 		offset.xyz /= offset.w;
 		offset.xyz = offset.xyz * 0.5 + 0.5;
 
-		float sample_depth = texture(g_position, offset.xy).z;
+		float sample_depth = view_pos(offset.xy).z;
 
 		float range_check = smoothstep(0, 1, radius / abs(frag_pos.z - sample_depth));
 		occlusion += float(sample_depth >= sample_pos.z + bias) * range_check;
 	}
 
-	occlusion = 1 - (occlusion / KERNEL_SIZE);
+	occlusion = 1 - (occlusion / float(push_consts.sample_count));
 
-	out_ao = occlusion * occlusion;
+	out_ao = vec2(occlusion * occlusion, -frag_pos.z);
 }
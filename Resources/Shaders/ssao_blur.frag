@@ -1,22 +1,39 @@
 #version 450
 #pragma shader_stage(fragment)
 
-layout(location = 0) in vec2 in_uv;
-
-layout(location = 0) out float out_ao;
+layout(location = 0) out vec2 out_ao;
 
+// r = ambient occlusion, g = view distance (see ssao.frag)
 layout(set = 0, binding = 0) uniform sampler2D ssao;
 
+// one axis of a separable gaussian, (1, 0) then (0, 1)
+layout(push_constant) uniform PushConsts {
+	ivec2 direction;
+};
+
+const int RADIUS = 4;
+const float SIGMA = 2.5;
+// taps further than this fraction of the center's view distance away from it get no weight, so occlusion doesn't bleed across depth edges
+const float DEPTH_TOLERANCE = 0.05;
+
 void main() {
-	vec2 texel_size = 1.0 / vec2(textureSize(ssao, 0));
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	ivec2 size = textureSize(ssao, 0);
+	vec2 center = texelFetch(ssao, texel, 0).rg;
+
 	float result = 0.0;
+	float total_weight = 0.0;
+
+	for (int i = -RADIUS; i <= RADIUS; ++i) {
+		vec2 tap = texelFetch(ssao, clamp(texel + direction * i, ivec2(0), size - 1), 0).rg;
+
+		float spatial = exp(-float(i * i) / (2.0 * SIGMA * SIGMA));
+		float range = max(0.0, 1.0 - abs(tap.g - center.g) / (center.g * DEPTH_TOLERANCE));
 
-	for (int x = -2; x < 2; ++x) {
-		for (int y = -2; y < 2; ++y) {
-			vec2 offset = vec2(float(x), float(y)) * texel_size;
-			result += texture(ssao, in_uv + offset).r;
-		}
+		result += tap.r * spatial * range;
+		total_weight += spatial * range;
 	}
 
-	out_ao = result / (4.0 * 4.0);
-}
\ No newline at end of file
+	// the center tap always has full weight
+	out_ao = vec2(result / total_weight, center.g);
+}
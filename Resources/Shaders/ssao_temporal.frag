@@ -0,0 +1,61 @@
+#version 450
+#pragma shader_stage(fragment)
+
+// r = ambient occlusion, g = view distance (see ssao.frag)
+layout(location = 0) out vec2 out_ao;
+
+layout(set = 0, binding = 0) uniform sampler2D ssao;
+// last frame's output of this pass
+layout(set = 0, binding = 1) uniform sampler2D history;
+
+layout(set = 0, binding = 2) uniform Params {
+	mat4 inv_view;
+	mat4 prev_view_proj;
+	vec2 tan_half_fov;
+	vec2 screen_size;
+	// see ssao.frag
+	uint scale;
+	// false on the first frame (or after a resize), when history holds nothing useful
+	uint history_valid;
+};
+
+#include "temporal.glsl"
+
+// history texels further than this fraction from the expected view distance belong to another surface (disocclusion)
+const float DEPTH_TOLERANCE = 0.05;
+
+void main() {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 size = textureSize(ssao, 0);
+	vec2 current = texelFetch(ssao, pixel, 0).rg;
+
+	// the neighbourhood's range of occlusion; the history is clamped into it, which keeps stale values from ghosting
+	float lo = current.r;
+	float hi = current.r;
+	for (int y = -1; y <= 1; ++y) {
+		for (int x = -1; x <= 1; ++x) {
+			float ao = texelFetch(ssao, clamp(pixel + ivec2(x, y), ivec2(0), size - 1), 0).r;
+			lo = min(lo, ao);
+			hi = max(hi, ao);
+		}
+	}
+
+	// the full resolution texel this ssao pixel was computed for, back in world space
+	ivec2 texel = min(pixel * int(scale) + int(scale / 2), ivec2(screen_size) - 1);
+	vec2 ndc = (vec2(texel) + 0.5) / screen_size * 2.0 - 1.0;
+	vec3 world_pos = (inv_view * vec4(ndc * tan_half_fov * current.g, -current.g, 1.0)).xyz;
+
+	vec3 prev = reproject(world_pos, prev_view_proj);
+	// nearest history pixel; filtering would mix surfaces at depth edges
+	ivec2 history_pixel = ivec2(floor((prev.xy * screen_size - 0.5 - float(scale / 2)) / float(scale) + 0.5));
+
+	float result = current.r;
+	if (history_valid != 0 && on_screen(prev.xy)) {
+		vec2 previous = texelFetch(history, clamp(history_pixel, ivec2(0), size - 1), 0).rg;
+		if (abs(previous.g - prev.z) < prev.z * DEPTH_TOLERANCE) {
+			result = mix(clamp(previous.r, lo, hi), current.r, TEMPORAL_BLEND);
+		}
+	}
+
+	out_ao = vec2(result, current.g);
+}
@@ -0,0 +1,55 @@
+#version 450
+#pragma shader_stage(fragment)
+
+layout(location = 0) out vec2 out_ao;
+
+layout(set = 0, binding = 0) uniform sampler2D depth_prepass;
+// reduced resolution, r = ambient occlusion, g = view distance (see ssao.frag)
+layout(set = 0, binding = 1) uniform sampler2D ssao;
+
+layout(push_constant) uniform PushConsts {
+	float near;
+	float far;
+	// full resolution pixels per ssao pixel (2 or 4)
+	uint scale;
+};
+
+// joint bilateral: the bilinear weights of the four closest ssao texels, scaled down by how far their depth is from this pixel's
+void main() {
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	ivec2 size = textureSize(ssao, 0);
+
+	// non-linear depth (GLM_FORCE_DEPTH_ZERO_TO_ONE) to view distance
+	float depth = texelFetch(depth_prepass, texel, 0).r;
+	float view_distance = near * far / (far - depth * (far - near));
+
+	// ssao texel p was computed for the full resolution texel p * scale + scale / 2
+	vec2 pos = (vec2(texel) - float(scale / 2)) / float(scale);
+	ivec2 base = ivec2(floor(pos));
+	vec2 f = pos - vec2(base);
+
+	const ivec2 offsets[4] = ivec2[4](ivec2(0, 0), ivec2(1, 0), ivec2(0, 1), ivec2(1, 1));
+	vec4 bilinear = vec4((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y), (1.0 - f.x) * f.y, f.x * f.y);
+
+	float result = 0.0;
+	float total_weight = 0.0;
+	float closest_ao = 1.0;
+	float closest_delta = 1e30;
+
+	for (int i = 0; i < 4; ++i) {
+		vec2 tap = texelFetch(ssao, clamp(base + offsets[i], ivec2(0), size - 1), 0).rg;
+		float delta = abs(tap.g - view_distance) / view_distance;
+
+		float weight = bilinear[i] / (delta + 1e-3);
+		result += tap.r * weight;
+		total_weight += weight;
+
+		if (delta < closest_delta) {
+			closest_delta = delta;
+			closest_ao = tap.r;
+		}
+	}
+
+	// none of them is on the same surface (thin features); the closest in depth is the best guess
+	out_ao = vec2(closest_delta > 0.1 ? closest_ao : result / total_weight, view_distance);
+}
@@ -0,0 +1,86 @@
+#version 450
+#pragma shader_stage(fragment)
+
+// temporal anti-aliasing: every frame is rendered with a different sub-pixel jitter (see AntiAliasingPass::jitter) and blended into the
+// reprojected result of the previous ones, so over a few frames every pixel integrates its whole footprint
+
+layout(location = 0) out vec4 out_color;
+
+layout(set = 0, binding = 0) uniform sampler2D current;
+// last frame's output of this pass
+layout(set = 0, binding = 1) uniform sampler2D history;
+layout(set = 0, binding = 2) uniform sampler2D depth_prepass;
+
+layout(set = 0, binding = 3) uniform Params {
+	// this frame's, with the jitter
+	mat4 inv_view_proj;
+	// last frame's, without it
+	mat4 prev_view_proj;
+	// this frame's, in NDC
+	vec2 jitter;
+	// false on the first frame (or after a resize), when history holds nothing useful
+	uint history_valid;
+};
+
+#include "temporal.glsl"
+
+// how many standard deviations around the neighbourhood's mean the history is clamped to
+const float VARIANCE_CLIP_GAMMA = 1.0;
+
+vec3 rgb_to_ycocg(vec3 c) {
+	return vec3(0.25 * c.r + 0.5 * c.g + 0.25 * c.b, 0.5 * c.r - 0.5 * c.b, -0.25 * c.r + 0.5 * c.g - 0.25 * c.b);
+}
+
+vec3 ycocg_to_rgb(vec3 c) {
+	return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+void main() {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 size = textureSize(current, 0);
+	vec3 color = texelFetch(current, pixel, 0).rgb;
+
+	// the neighbourhood's mean and deviation in YCoCg (variance clipping, Salvi 2016), and its closest depth: reprojecting with that one
+	// keeps the edges of foreground objects, the ones that need anti-aliasing most, from picking up the background's motion
+	vec3 m1 = vec3(0.0);
+	vec3 m2 = vec3(0.0);
+	float closest_depth = 1.0;
+	ivec2 closest = pixel;
+	for (int y = -1; y <= 1; ++y) {
+		for (int x = -1; x <= 1; ++x) {
+			ivec2 p = clamp(pixel + ivec2(x, y), ivec2(0), size - 1);
+			vec3 c = rgb_to_ycocg(texelFetch(current, p, 0).rgb);
+			m1 += c;
+			m2 += c * c;
+
+			float depth = texelFetch(depth_prepass, p, 0).r;
+			if (depth < closest_depth) {
+				closest_depth = depth;
+				closest = p;
+			}
+		}
+	}
+	m1 /= 9.0;
+	m2 /= 9.0;
+	vec3 sigma = sqrt(max(m2 - m1 * m1, vec3(0.0)));
+	vec3 lo = m1 - VARIANCE_CLIP_GAMMA * sigma;
+	vec3 hi = m1 + VARIANCE_CLIP_GAMMA * sigma;
+
+	// the history is kept without the jitter: this frame's samples are offset from it by jitter, which averages out over frames
+	vec2 uv = (vec2(closest) + 0.5) / vec2(size);
+	vec4 world_pos = inv_view_proj * vec4(uv * 2.0 - 1.0, closest_depth, 1.0);
+	vec3 prev = reproject(world_pos.xyz / world_pos.w, prev_view_proj);
+	vec2 history_uv = gl_FragCoord.xy / vec2(size) + prev.xy - (uv - jitter * 0.5);
+
+	vec3 result = color;
+	if (history_valid != 0 && on_screen(history_uv)) {
+		vec3 history_color = clamp(rgb_to_ycocg(texture(history, history_uv).rgb), lo, hi);
+		// the colors are HDR, so the blend is weighted by inverse luma (Karis 2014); otherwise a single very bright sample would dominate for
+		// many frames, which flickers as the jitter moves it in and out of a pixel
+		float history_weight = (1.0 - TEMPORAL_BLEND) / (1.0 + history_color.x);
+		float current_weight = TEMPORAL_BLEND / (1.0 + rgb_to_ycocg(color).x);
+		result = (ycocg_to_rgb(history_color) * history_weight + color * current_weight) / (history_weight + current_weight);
+	}
+
+	out_color = vec4(result, 1.0);
+}
@@ -0,0 +1,14 @@
+// temporal accumulation helpers, for passes that keep a TemporalHistory
+
+// weight of the current frame; the rest comes from the (neighbourhood clamped) history
+const float TEMPORAL_BLEND = 0.1;
+
+// where world_pos was on screen last frame, as a uv in gl_FragCoord / size terms (xy), and its view distance then (z)
+vec3 reproject(vec3 world_pos, mat4 prev_view_proj) {
+	vec4 clip = prev_view_proj * vec4(world_pos, 1.0);
+	return vec3(clip.xy / clip.w * 0.5 + 0.5, clip.w);
+}
+
+bool on_screen(vec2 uv) {
+	return all(greaterThanEqual(uv, vec2(0.0))) && all(lessThanEqual(uv, vec2(1.0)));
+}
@@ -0,0 +1,51 @@
+#version 450
+#pragma shader_stage(fragment)
+
+// the last step of PostProcessPass: exposure, bloom, tonemapping and gamma correction
+
+layout(location = 0) out vec4 out_color;
+
+// the same size as the output; both of these are addressed with gl_FragCoord, since the composite already flipped them the right way up
+layout(set = 0, binding = 0) uniform sampler2D hdr;
+// half the size of the output, bilinear
+layout(set = 0, binding = 1) uniform sampler2D bloom;
+// 1 x 1
+layout(set = 0, binding = 2) uniform sampler2D exposure;
+
+layout(push_constant) uniform PushConstants {
+	float bloom_strength;
+	float bloom_scale;
+};
+
+// thanks vinc
+
+vec3 uncharted2_tonemap_partial(vec3 x) {
+	float A = 0.15f;
+	float B = 0.50f;
+	float C = 0.10f;
+	float D = 0.20f;
+	float E = 0.02f;
+	float F = 0.30f;
+	return ((x * (A * x + C * B) + D * E) / (x * (A * x + B) + D * F)) - E / F;
+}
+
+vec3 uncharted2_filmic(vec3 v, float exposure) {
+	vec3 curr = uncharted2_tonemap_partial(v * exposure);
+
+	vec3 W = vec3(11.2f);
+	vec3 white_scale = vec3(1.0f) / uncharted2_tonemap_partial(W);
+	return curr * white_scale;
+}
+
+void main() {
+	vec3 color = texelFetch(hdr, ivec2(gl_FragCoord.xy), 0).rgb;
+	vec3 bloom_color = texture(bloom, gl_FragCoord.xy / vec2(textureSize(hdr, 0))).rgb * bloom_scale;
+	color = mix(color, bloom_color, bloom_strength);
+
+	// HDR tonemapping
+	color = uncharted2_filmic(color, texelFetch(exposure, ivec2(0), 0).r);
+	// gamma correct
+	color = pow(color, vec3(1.0 / 2.2));
+
+	out_color = vec4(color, 1);
+}
@@ -1,7 +1,6 @@
 #version 450
 #pragma shader_stage(fragment)
 
-#define SHADOW_MAP_CASCADE_COUNT 4
 #define PI 3.14159265358979323
 
 layout(location = 0) in vec3 in_ray_dir;
@@ -14,20 +13,32 @@ layout(set = 0, binding = 0) uniform Camera {
 	vec2 clip_range;
 };
 
-layout(set = 0, binding = 1) uniform sampler2D g_position;
-layout(set = 0, binding = 2) uniform sampler2DArray shadow_map;
+layout(set = 0, binding = 2) uniform sampler2D shadow_map;
+// one texel per pixel of this pass (see volumetric_march_depth.frag)
 layout(set = 0, binding = 3) uniform sampler2D depth;
 
 layout(set = 0, binding = 4) uniform Uniforms {
 	vec4 cascade_splits;
 	mat4 cascade_view_proj_mats[SHADOW_MAP_CASCADE_COUNT];
+	// xy = offset, zw = scale of each cascade's tile in the shadow atlas
+	vec4 cascade_atlas_rects[SHADOW_MAP_CASCADE_COUNT];
 	mat4 inv_view;
 	vec3 light_direction;
 	float _pad;
 	vec3 cam_pos;
 };
 
-const int num_steps = 10;
+layout(push_constant) uniform PushConstants {
+	// full resolution
+	vec2 screen_size;
+	// full resolution pixels per pixel of this pass
+	uint scale;
+	// fewer when accumulated over frames
+	int num_steps;
+	// added to the dither, so accumulated frames don't all sample the same points
+	float dither_offset;
+};
+
 const float scattering = 0.9;
 
 const float light_intensity = 1000;
@@ -44,7 +55,9 @@ float texture_proj(vec4 shadowCoord, vec2 offset, uint cascadeIndex) {
 	float bias = 0;
 
 	if (shadowCoord.z > -1.0 && shadowCoord.z < 1.0) {
-		float dist = texture(shadow_map, vec3(shadowCoord.st + offset, cascadeIndex)).r;
+		vec4 rect = cascade_atlas_rects[cascadeIndex];
+		vec2 half_texel = 0.5 / vec2(textureSize(shadow_map, 0));
+		float dist = texture(shadow_map, rect.xy + clamp((shadowCoord.st + offset) * rect.zw, half_texel, rect.zw - half_texel)).r;
 		if (shadowCoord.w > 0 && dist < shadowCoord.z - bias) {
 			shadow = 0; // ambient light
 		}
@@ -72,29 +85,12 @@ float shadow_calculation(vec3 mv_pos, vec3 pos) {
 const float dither_pattern[4][4] = {
 	{0.0f, 0.5f, 0.125f, 0.625f}, {0.75f, 0.22f, 0.875f, 0.375f}, {0.1875f, 0.6875f, 0.0625f, 0.5625}, {0.9375f, 0.4375f, 0.8125f, 0.3125}};
 
-vec3 uncharted2_tonemap_partial(vec3 x) {
-	float A = 0.15f;
-	float B = 0.50f;
-	float C = 0.10f;
-	float D = 0.20f;
-	float E = 0.02f;
-	float F = 0.30f;
-	return ((x * (A * x + C * B) + D * E) / (x * (A * x + B) + D * F)) - E / F;
-}
-
-vec3 uncharted2_filmic(vec3 v) {
-	float exposure_bias = 2.0f;
-	vec3 curr = uncharted2_tonemap_partial(v * exposure_bias);
-
-	vec3 W = vec3(11.2f);
-	vec3 white_scale = vec3(1.0f) / uncharted2_tonemap_partial(W);
-	return curr * white_scale;
-}
-
 void main() {
-	vec3 mv_pos = texture(g_position, in_uv).xyz / texture(g_position, in_uv).w;
-
-	vec4 world_pos_inv = inv_view * vec4(mv_pos, 1);
+	// the surface behind this pixel, reconstructed from its depth (in gl_FragCoord terms, so the output lines up with depth_prepass); the
+	// dither below is keyed to this pass' own pixels, so it stays a 4x4 pattern at any scale
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	vec2 uv = gl_FragCoord.xy * float(scale) / screen_size;
+	vec4 world_pos_inv = inv_view_proj * vec4(uv * 2.0 - 1.0, texelFetch(depth, pixel, 0).r, 1.0);
 
 	vec3 world_pos = world_pos_inv.xyz / world_pos_inv.w;
 	vec3 start_pos = cam_pos;
@@ -105,7 +101,7 @@ void main() {
 	float step_length = ray_length / num_steps;
 	vec3 step = ray_dir * step_length;
 
-	const float dither_value = dither_pattern[int(in_uv.x * 800) % 4][int(in_uv.y * 600) % 4];
+	const float dither_value = fract(dither_pattern[pixel.x % 4][pixel.y % 4] + dither_offset);
 	start_pos += step * dither_value;
 
 	vec3 current_pos = start_pos;
@@ -126,11 +122,6 @@ void main() {
 	}
 
 	out_fog /= num_steps;
-
-	// HDR tonemapping
-	out_fog.rgb = uncharted2_filmic(out_fog.rgb);
-	// gamma correct
-	out_fog.rgb = pow(out_fog.rgb, vec3(1.0 / 2.2));
 }
 
 // simpler version
@@ -0,0 +1,52 @@
+#version 450
+#pragma shader_stage(fragment)
+
+layout(location = 0) out vec4 out_volumetric_light;
+
+layout(set = 0, binding = 0) uniform sampler2D volumetric_light;
+// last frame's output of this pass
+layout(set = 0, binding = 1) uniform sampler2D history;
+// what volumetric_light was marched to (see volumetric_march_depth.frag)
+layout(set = 0, binding = 2) uniform sampler2D depth;
+
+layout(set = 0, binding = 3) uniform Params {
+	mat4 inv_view_proj;
+	mat4 prev_view_proj;
+	// full resolution
+	vec2 screen_size;
+	// full resolution pixels per volumetric_light pixel
+	uint scale;
+	// false on the first frame (or after a resize), when history holds nothing useful
+	uint history_valid;
+};
+
+#include "temporal.glsl"
+
+void main() {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 size = textureSize(volumetric_light, 0);
+	vec4 current = texelFetch(volumetric_light, pixel, 0);
+
+	// the neighbourhood's range; the history is clamped into it, which keeps stale values from ghosting
+	vec4 lo = current;
+	vec4 hi = current;
+	for (int y = -1; y <= 1; ++y) {
+		for (int x = -1; x <= 1; ++x) {
+			vec4 neighbour = texelFetch(volumetric_light, clamp(pixel + ivec2(x, y), ivec2(0), size - 1), 0);
+			lo = min(lo, neighbour);
+			hi = max(hi, neighbour);
+		}
+	}
+
+	// the fog is reprojected with the surface it was marched towards; it varies slowly enough that depth edges don't need special care
+	vec2 uv = gl_FragCoord.xy * float(scale) / screen_size;
+	vec4 world_pos = inv_view_proj * vec4(uv * 2.0 - 1.0, texelFetch(depth, pixel, 0).r, 1.0);
+	vec3 prev = reproject(world_pos.xyz / world_pos.w, prev_view_proj);
+
+	vec4 result = current;
+	if (history_valid != 0 && on_screen(prev.xy)) {
+		result = mix(clamp(texture(history, prev.xy), lo, hi), current, TEMPORAL_BLEND);
+	}
+
+	out_volumetric_light = result;
+}
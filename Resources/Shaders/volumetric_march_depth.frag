@@ -0,0 +1,31 @@
+#version 450
+#pragma shader_stage(fragment)
+
+// the depth each volumetric_light pixel marches to: the closest or the furthest of its scale x scale block of depth_prepass, alternating in a
+// checkerboard, so that along a depth edge the upsample in composite.frag finds texels that marched to either side of it
+
+layout(location = 0) out float out_depth;
+
+layout(set = 0, binding = 0) uniform sampler2D depth_prepass;
+
+layout(push_constant) uniform PushConstants {
+	// full resolution pixels per volumetric_light pixel
+	uint scale;
+};
+
+void main() {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 size = textureSize(depth_prepass, 0);
+
+	float closest = 1.0;
+	float furthest = 0.0;
+	for (int y = 0; y < int(scale); ++y) {
+		for (int x = 0; x < int(scale); ++x) {
+			float depth = texelFetch(depth_prepass, min(pixel * int(scale) + ivec2(x, y), size - 1), 0).r;
+			closest = min(closest, depth);
+			furthest = max(furthest, depth);
+		}
+	}
+
+	out_depth = ((pixel.x + pixel.y) & 1) != 0 ? furthest : closest;
+}
@@ -0,0 +1,146 @@
+#include "CameraPath.hpp"
+
+#include <glm/trigonometric.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <utility>
+
+// orbit(): one lap around the origin, at this distance, bobbing between the two heights
+static constexpr f32 ORBIT_RADIUS = 4.f;
+static constexpr f32 ORBIT_LOW = 0.25f;
+static constexpr f32 ORBIT_HIGH = 1.5f;
+static constexpr f32 ORBIT_DURATION = 16.f;
+static constexpr u32 ORBIT_KEYFRAMES = 8;
+
+template<typename T>
+static T catmull_rom(const T& p0, const T& p1, const T& p2, const T& p3, f32 t) {
+	const f32 t2 = t * t;
+	const f32 t3 = t2 * t;
+	return 0.5f * ((2.f * p1) + (p2 - p0) * t + (2.f * p0 - 5.f * p1 + 4.f * p2 - p3) * t2 + (3.f * p1 - p0 - 3.f * p2 + p3) * t3);
+}
+
+CameraPath::CameraPath(std::vector<Keyframe> keyframes) : m_keyframes{std::move(keyframes)} {
+}
+
+CameraPath CameraPath::orbit() {
+	std::vector<Keyframe> keyframes;
+
+	// the last one closes the loop
+	for (u32 i = 0; i <= ORBIT_KEYFRAMES; ++i) {
+		const f32 angle = 360.f * i / ORBIT_KEYFRAMES;
+		const f32 height = i % 2 == 0 ? ORBIT_LOW : ORBIT_HIGH;
+		const glm::vec3 position{ORBIT_RADIUS * std::cos(glm::radians(angle)), height, ORBIT_RADIUS * std::sin(glm::radians(angle))};
+
+		// looking at the origin (see Renderer::mouse_event for how yaw and pitch turn into a direction)
+		keyframes.push_back(Keyframe{
+			.time = ORBIT_DURATION * i / ORBIT_KEYFRAMES,
+			.position = position,
+			.yaw = angle + 180.f,
+			.pitch = -glm::degrees(std::atan2(height, ORBIT_RADIUS)),
+		});
+	}
+
+	return CameraPath{std::move(keyframes)};
+}
+
+std::optional<CameraPath> CameraPath::load(const std::string& path) {
+	std::ifstream file{path};
+	if (!file) {
+		spdlog::error("can't open camera path {}", path);
+		return {};
+	}
+
+	CameraPath result;
+	std::string line;
+	u32 line_number = 0;
+
+	while (std::getline(file, line)) {
+		++line_number;
+		line = line.substr(0, line.find('#'));
+		if (line.find_first_not_of(" \t\r") == std::string::npos) {
+			continue;
+		}
+
+		Keyframe keyframe;
+		if (std::sscanf(line.c_str(), "%f %f %f %f %f %f", &keyframe.time, &keyframe.position.x, &keyframe.position.y, &keyframe.position.z,
+				&keyframe.yaw, &keyframe.pitch) != 6) {
+			spdlog::error("{}:{}: expected \"time x y z yaw pitch\"", path, line_number);
+			return {};
+		}
+		if (!result.empty() && keyframe.time < result.m_keyframes.back().time) {
+			spdlog::error("{}:{}: keyframes have to be sorted by time", path, line_number);
+			return {};
+		}
+
+		result.m_keyframes.push_back(keyframe);
+	}
+
+	if (result.empty()) {
+		spdlog::error("camera path {} has no keyframes", path);
+		return {};
+	}
+
+	return result;
+}
+
+bool CameraPath::save(const std::string& path) const {
+	std::ofstream file{path};
+	if (!file) {
+		return false;
+	}
+
+	file << "# time x y z yaw pitch\n";
+	for (const auto& keyframe : m_keyframes) {
+		file << keyframe.time << " " << keyframe.position.x << " " << keyframe.position.y << " " << keyframe.position.z << " " << keyframe.yaw
+			 << " " << keyframe.pitch << "\n";
+	}
+	return static_cast<bool>(file);
+}
+
+void CameraPath::add(const Keyframe& keyframe) {
+	m_keyframes.push_back(keyframe);
+}
+
+CameraPath::Keyframe CameraPath::sample(f32 time) const {
+	if (m_keyframes.empty()) {
+		return Keyframe{};
+	}
+	if (time <= m_keyframes.front().time) {
+		return m_keyframes.front();
+	}
+	if (time >= m_keyframes.back().time) {
+		return m_keyframes.back();
+	}
+
+	// the segment [i, i + 1] that contains time
+	const auto next = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), time, [](f32 t, const Keyframe& k) { return t < k.time; });
+	const size_t i = static_cast<size_t>(next - m_keyframes.begin()) - 1;
+	const size_t last = m_keyframes.size() - 1;
+
+	const Keyframe& k0 = m_keyframes[i == 0 ? 0 : i - 1];
+	const Keyframe& k1 = m_keyframes[i];
+	const Keyframe& k2 = m_keyframes[i + 1];
+	const Keyframe& k3 = m_keyframes[std::min(i + 2, last)];
+
+	const f32 span = k2.time - k1.time;
+	const f32 t = span > 0.f ? (time - k1.time) / span : 0.f;
+
+	return Keyframe{
+		.time = time,
+		.position = catmull_rom(k0.position, k1.position, k2.position, k3.position, t),
+		.yaw = catmull_rom(k0.yaw, k1.yaw, k2.yaw, k3.yaw, t),
+		// the renderer's limits (see Renderer::mouse_event); the spline can overshoot them
+		.pitch = std::clamp(catmull_rom(k0.pitch, k1.pitch, k2.pitch, k3.pitch, t), -89.f, 89.f),
+	};
+}
+
+f32 CameraPath::duration() const {
+	return m_keyframes.empty() ? 0.f : m_keyframes.back().time - m_keyframes.front().time;
+}
+
+bool CameraPath::empty() const {
+	return m_keyframes.empty();
+}
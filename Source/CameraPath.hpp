@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Types.hpp"
+
+#include <glm/vec3.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+/*
+	A camera path to play back at a fixed timestep, so every run of the renderer sees the same frames: keyframes with a time, a position and
+	the renderer's yaw/pitch (degrees), sampled with a uniform Catmull-Rom spline through all four. The end keyframes are repeated as the
+	missing neighbours, so the path passes through every keyframe and stops at both ends.
+
+	Paths are recorded from the app (vukpbr --record) or written by hand; the file has one keyframe per line, "time x y z yaw pitch", and
+	everything after a # is ignored.
+*/
+
+class CameraPath {
+  public:
+	struct Keyframe {
+		// seconds
+		f32 time;
+		glm::vec3 position;
+		f32 yaw;
+		f32 pitch;
+	};
+
+	CameraPath() = default;
+	// sorted by time
+	explicit CameraPath(std::vector<Keyframe> keyframes);
+
+	// a closed loop around the pillars, for when no path is given
+	static CameraPath orbit();
+	// empty if the file can't be read or a line doesn't parse
+	static std::optional<CameraPath> load(const std::string& path);
+	bool save(const std::string& path) const;
+
+	// no earlier than the last keyframe
+	void add(const Keyframe& keyframe);
+
+	// clamped to the first and last keyframe
+	Keyframe sample(f32 time) const;
+
+	// of the whole path, from the first keyframe
+	f32 duration() const;
+	bool empty() const;
+
+  private:
+	std::vector<Keyframe> m_keyframes;
+};
@@ -0,0 +1,211 @@
+#include "CascadeFit.hpp"
+
+#include "Frustum.hpp"
+#include "CpuTrace.hpp"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace cascade_fit {
+
+// shrinks the light space window to the visible receivers that overlap the cascade's bounding sphere
+static void fit_receivers(std::span<const Box> receivers, const Frustum& camera_frustum, const glm::mat4& light_view, glm::vec3 center, f32 radius,
+	f32 resolution, glm::vec2& min_xy, glm::vec2& max_xy) {
+	glm::vec2 receivers_min{std::numeric_limits<f32>::max()};
+	glm::vec2 receivers_max{std::numeric_limits<f32>::lowest()};
+
+	for (const auto& box : receivers) {
+		const glm::vec3 closest = glm::clamp(center, box.min, box.max);
+		if (glm::length(closest - center) > radius || !camera_frustum.is_box_visible(box.min, box.max)) {
+			continue;
+		}
+
+		for (u8 c = 0; c < 8; ++c) {
+			const glm::vec3 corner{(c & 1) ? box.max.x : box.min.x, (c & 2) ? box.max.y : box.min.y, (c & 4) ? box.max.z : box.min.z};
+			const glm::vec2 p = light_view * glm::vec4(corner, 1.0f);
+			receivers_min = glm::min(receivers_min, p);
+			receivers_max = glm::max(receivers_max, p);
+		}
+	}
+
+	if (receivers_min.x > receivers_max.x) {
+		return;
+	}
+
+	// keep the window on the sphere's texel grid, so it only changes size in whole texels
+	const f32 texel_size = 2.0f * radius / resolution;
+	const glm::vec2 fitted_min = glm::floor(glm::max(receivers_min, min_xy) / texel_size) * texel_size;
+	const glm::vec2 fitted_max = glm::ceil(glm::min(receivers_max, max_xy) / texel_size) * texel_size;
+
+	if (fitted_min.x < fitted_max.x && fitted_min.y < fitted_max.y) {
+		// the ortho window has to stay square or texels stop being square
+		const f32 extent = std::max(fitted_max.x - fitted_min.x, fitted_max.y - fitted_min.y);
+		const glm::vec2 mid = (fitted_min + fitted_max) * 0.5f;
+		min_xy = mid - extent * 0.5f;
+		max_xy = mid + extent * 0.5f;
+	}
+}
+
+// https://github.com/SaschaWillems/Vulkan/blob/master/examples/shadowmappingcascade/shadowmappingcascade.cpp
+std::array<Cascade, CASCADE_COUNT> fit(const View& view, const Settings& settings) {
+	TRACE_ZONE("cascade_fit::fit");
+
+	std::array<Cascade, CASCADE_COUNT> cascades{};
+
+	f32 cascade_splits[CASCADE_COUNT];
+
+	f32 near_clip = view.cam_proj.near;
+	f32 far_clip = view.cam_proj.far;
+	f32 clip_range = far_clip - near_clip;
+
+	f32 min_z = near_clip;
+	f32 max_z = near_clip + clip_range;
+
+	// SDSM: only split the depth range that's actually visible. The bounds are a few frames old, so they're padded, and snapped to quarter
+	// octaves so the splits (and any cached cascades with them) don't move every time the bounds jitter a little
+	if (settings.sample_distribution && view.depth_bounds) {
+		max_z = std::exp2(std::ceil(std::log2(view.depth_bounds->y * 1.1f) * 4.0f) / 4.0f);
+		max_z = std::clamp(max_z, near_clip * 2.0f, far_clip);
+		min_z = std::exp2(std::floor(std::log2(view.depth_bounds->x * 0.9f) * 4.0f) / 4.0f);
+		min_z = std::clamp(min_z, near_clip, max_z * 0.5f);
+	}
+
+	f32 range = max_z - min_z;
+	f32 ratio = max_z / min_z;
+
+	// Calculate split depths based on view camera frustum
+	// Based on method presented in https://developer.nvidia.com/gpugems/GPUGems3/gpugems3_ch10.html
+	for (u8 i = 0; i < CASCADE_COUNT; i++) {
+		f32 p = (i + 1) / static_cast<f32>(CASCADE_COUNT);
+		f32 log = min_z * std::pow(ratio, p);
+		f32 uniform = min_z + range * p;
+		f32 d = settings.split_lambda * (log - uniform) + uniform;
+		cascade_splits[i] = (d - near_clip) / clip_range;
+	}
+
+	const bool scene_valid = view.scene_min.x <= view.scene_max.x;
+	const Frustum camera_frustum{view.cam_proj.unjittered_matrix() * view.cam_view};
+
+	// Calculate orthographic projection matrix for each cascade
+	f32 last_split_dist = 0.0;
+	for (u8 i = 0; i < CASCADE_COUNT; i++) {
+		f32 split_dist = cascade_splits[i];
+		const f32 resolution = static_cast<f32>(settings.resolutions[i]);
+		const bool cached = i >= settings.first_cached;
+
+		// the near plane is at z = 0 (GLM_FORCE_DEPTH_ZERO_TO_ONE)
+		glm::vec3 frustum_corners[8] = {
+			glm::vec3(-1.0f, 1.0f, 0.0f),
+			glm::vec3(1.0f, 1.0f, 0.0f),
+			glm::vec3(1.0f, -1.0f, 0.0f),
+			glm::vec3(-1.0f, -1.0f, 0.0f),
+			glm::vec3(-1.0f, 1.0f, 1.0f),
+			glm::vec3(1.0f, 1.0f, 1.0f),
+			glm::vec3(1.0f, -1.0f, 1.0f),
+			glm::vec3(-1.0f, -1.0f, 1.0f),
+		};
+
+		// Project frustum corners into world space
+		glm::mat4 inv_cam = glm::inverse(view.cam_proj.unjittered_matrix() * view.cam_view);
+		for (u8 i = 0; i < 8; i++) {
+			glm::vec4 inv_corner = inv_cam * glm::vec4(frustum_corners[i], 1.0f);
+			frustum_corners[i] = inv_corner / inv_corner.w;
+		}
+
+		for (u8 i = 0; i < 4; i++) {
+			glm::vec3 dist = frustum_corners[i + 4] - frustum_corners[i];
+			frustum_corners[i + 4] = frustum_corners[i] + (dist * split_dist);
+			frustum_corners[i] = frustum_corners[i] + (dist * last_split_dist);
+		}
+
+		// Get frustum center
+		glm::vec3 frustum_center = glm::vec3(0.0f);
+		for (u8 i = 0; i < 8; i++) {
+			frustum_center += frustum_corners[i];
+		}
+		frustum_center /= 8.0f;
+
+		f32 radius = 0.0f;
+		for (u8 i = 0; i < 8; i++) {
+			f32 distance = glm::length(frustum_corners[i] - frustum_center);
+			radius = glm::max(radius, distance);
+		}
+		// cached cascades are reused while the camera moves, so leave them some room to do so
+		if (cached) {
+			radius /= 1.f - 2.f * settings.cached_move_threshold / resolution;
+		}
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+
+		// lookAt degenerates when the light points straight down
+		const glm::vec3 light_dir = glm::normalize(view.light_direction);
+		const glm::vec3 up = std::abs(light_dir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		glm::mat4 light_view_matrix = glm::lookAt(frustum_center - light_dir * radius, frustum_center, up);
+
+		// light space xy window; by default the bounding sphere, which doesn't change size as the camera rotates
+		glm::vec2 min_xy{-radius};
+		glm::vec2 max_xy{radius};
+
+		// cached cascades need the whole (padded) sphere to stay valid while the camera moves
+		if (settings.fit_to_receivers && !cached) {
+			fit_receivers(view.receivers, camera_frustum, light_view_matrix, frustum_center, radius, resolution, min_xy, max_xy);
+		}
+
+		// the sphere spans [0, 2r] along the light. Pull the near plane back to the scene's furthest point towards the light so every caster
+		// is inside the depth range, and the far plane in to where the scene ends so the depth precision isn't wasted on empty space
+		f32 near_dist = 0.0f;
+		f32 far_dist = 2.0f * radius;
+		if (scene_valid) {
+			f32 scene_near = std::numeric_limits<f32>::max();
+			f32 scene_far = std::numeric_limits<f32>::lowest();
+			for (u8 c = 0; c < 8; ++c) {
+				const glm::vec3 corner{(c & 1) ? view.scene_max.x : view.scene_min.x, (c & 2) ? view.scene_max.y : view.scene_min.y,
+					(c & 4) ? view.scene_max.z : view.scene_min.z};
+				// lookAt looks down -z
+				const f32 dist = -(light_view_matrix * glm::vec4(corner, 1.0f)).z;
+				scene_near = std::min(scene_near, dist);
+				scene_far = std::max(scene_far, dist);
+			}
+			near_dist = std::min(near_dist, scene_near);
+			far_dist = std::max(std::min(far_dist, scene_far), near_dist + 0.01f);
+		}
+
+		glm::mat4 light_ortho_matrix = glm::ortho(min_xy.x, max_xy.x, min_xy.y, max_xy.y, near_dist, far_dist);
+
+		// snap the projection to whole texels, so the shadow edges don't crawl when the camera moves
+		const glm::mat4 shadow_matrix = light_ortho_matrix * light_view_matrix;
+		const glm::vec2 shadow_origin = glm::vec2(shadow_matrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)) * (resolution / 2.0f);
+		const glm::vec2 snap_offset = (glm::round(shadow_origin) - shadow_origin) * (2.0f / resolution);
+		light_ortho_matrix[3][0] += snap_offset.x;
+		light_ortho_matrix[3][1] += snap_offset.y;
+
+		// Store split distance and matrix in cascade
+		cascades[i].split_depth = (view.cam_proj.near + split_dist * clip_range) * -1.0f;
+		cascades[i].view_proj_mat = light_ortho_matrix * light_view_matrix;
+		cascades[i].center = frustum_center;
+		cascades[i].radius = radius;
+		std::copy(std::begin(frustum_corners), std::end(frustum_corners), cascades[i].slice_corners.begin());
+
+		// how much of the map the frustum slice actually covers
+		glm::vec2 slice_min{std::numeric_limits<f32>::max()};
+		glm::vec2 slice_max{std::numeric_limits<f32>::lowest()};
+		for (u8 c = 0; c < 8; ++c) {
+			const glm::vec2 p = light_view_matrix * glm::vec4(frustum_corners[c], 1.0f);
+			slice_min = glm::min(slice_min, p);
+			slice_max = glm::max(slice_max, p);
+		}
+		const glm::vec2 covered = glm::max(glm::min(slice_max, max_xy) - glm::max(slice_min, min_xy), glm::vec2(0.0f));
+
+		cascades[i].texel_density = resolution / (max_xy.x - min_xy.x);
+		cascades[i].utilization = (covered.x * covered.y) / ((max_xy.x - min_xy.x) * (max_xy.y - min_xy.y));
+
+		last_split_dist = cascade_splits[i];
+	}
+
+	return cascades;
+}
+
+} // namespace cascade_fit
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Types.hpp"
+#include "Perspective.hpp"
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include <array>
+#include <optional>
+#include <span>
+
+/*
+	Fits the shadow cascades to a camera, a light direction and the scene's bounds. Nothing here touches the GPU, so CascadedShadowRenderPass
+	and cascade_density_check (which compares texel densities between fitting settings) run the same code.
+
+	The camera's depth range is split with the practical split scheme (a blend of logarithmic and uniform splits), optionally within only the
+	visible depth range (sample distribution). Each cascade is fitted to the bounding sphere of its slice (so its size doesn't change when
+	the camera rotates) and snapped to whole texels (so it doesn't shimmer when the camera moves). Its depth range is taken from the scene
+	bounds rather than the sphere, so casters between the sphere and the light don't rely on depth clamping and no precision is spent past
+	the end of the scene. Optionally, the window is shrunk to the visible receivers inside the sphere.
+
+	Cached cascades are reused while the camera moves, so they're fitted with a margin of cached_move_threshold texels and never shrunk to
+	the receivers.
+*/
+
+namespace cascade_fit {
+
+inline constexpr u8 CASCADE_COUNT = 4;
+
+struct Cascade {
+	f32 split_depth;
+	glm::mat4 view_proj_mat;
+	// bounding sphere of the view frustum slice the cascade was fitted to
+	glm::vec3 center;
+	f32 radius;
+	// shadow map texels per world unit
+	f32 texel_density;
+	// fraction of the map covered by the frustum slice's light space bounds
+	f32 utilization;
+	// xy = offset, zw = scale of the cascade's tile in atlas uv space; not set by fit()
+	glm::vec4 atlas_rect;
+	// world space corners of this frame's view frustum slice, i.e. the receivers that sample the cascade
+	std::array<glm::vec3, 8> slice_corners;
+};
+
+// world space AABB
+struct Box {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+struct Settings {
+	// 0 is uniform, 1 logarithmic
+	f32 split_lambda;
+	// split RenderInfo::depth_bounds instead of the whole clip range
+	bool sample_distribution;
+	// shrink the window to the receivers
+	bool fit_to_receivers;
+	// texels along each side of every cascade's map
+	std::array<u32, CASCADE_COUNT> resolutions;
+	// cascades [first_cached, CASCADE_COUNT) are cached
+	u8 first_cached;
+	// in texels of the cascade
+	f32 cached_move_threshold;
+};
+
+struct View {
+	Perspective cam_proj;
+	glm::mat4 cam_view;
+	glm::vec3 light_direction;
+	// min > max if the scene is empty
+	glm::vec3 scene_min;
+	glm::vec3 scene_max;
+	// closest/furthest visible view distance, if known
+	std::optional<glm::vec2> depth_bounds;
+	// only used with Settings::fit_to_receivers
+	std::span<const Box> receivers;
+};
+
+std::array<Cascade, CASCADE_COUNT> fit(const View& view, const Settings& settings);
+
+} // namespace cascade_fit
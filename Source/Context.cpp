@@ -4,21 +4,28 @@
 #include <GLFW/glfw3.h>
 #include <vuk/Context.hpp>
 
-std::optional<Context> Context::create() {
-	if (!glfwInit()) {
-		spdlog::error("failed to init glfw");
-		return {};
-	}
-
+std::optional<Context> Context::create(std::optional<vuk::Extent2D> headless_extent) {
 	Context ctxt;
+	ctxt.headless = headless_extent.has_value();
+	ctxt.window = nullptr;
+	ctxt.surface = VK_NULL_HANDLE;
+	ctxt.vuk_swapchain = nullptr;
 
-	// don't let GLFW create an OpenGL context
-	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+	if (!ctxt.headless) {
+		if (!glfwInit()) {
+			spdlog::error("failed to init glfw");
+			return {};
+		}
 
-	ctxt.window = glfwCreateWindow(800, 600, "Vuk PBR", nullptr, nullptr);
+		// don't let GLFW create an OpenGL context
+		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+
+		ctxt.window = glfwCreateWindow(800, 600, "Vuk PBR", nullptr, nullptr);
+	}
 
 	vkb::InstanceBuilder builder;
-	builder.request_validation_layers()
+	builder.set_headless(ctxt.headless)
+		.request_validation_layers()
 		.use_default_debug_messenger()
 		.set_debug_callback([](VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType,
 							   const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData) -> VkBool32 {
@@ -40,10 +47,12 @@ std::optional<Context> Context::create() {
 	phys_dev_features.samplerAnisotropy = VK_TRUE;
 	phys_dev_features.depthClamp = VK_TRUE;
 
-	glfwCreateWindowSurface(ctxt.instance, ctxt.window, nullptr, &ctxt.surface);
-
 	vkb::PhysicalDeviceSelector selector{ctxt.vkb_instance};
-	selector.set_surface(ctxt.surface).set_minimum_version(1, 2);
+	if (!ctxt.headless) {
+		glfwCreateWindowSurface(ctxt.instance, ctxt.window, nullptr, &ctxt.surface);
+		selector.set_surface(ctxt.surface);
+	}
+	selector.set_minimum_version(1, 2);
 	selector.set_required_features(phys_dev_features);
 
 	auto phys_ret = selector.select();
@@ -55,19 +64,33 @@ std::optional<Context> Context::create() {
 	ctxt.vkb_physical_device = phys_ret.value();
 	ctxt.physical_device = ctxt.vkb_physical_device.physical_device;
 
+	VkPhysicalDeviceVulkan12Features supported_vk12_feats{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+	VkPhysicalDeviceFeatures2 supported_feats{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &supported_vk12_feats};
+	vkGetPhysicalDeviceFeatures2(ctxt.physical_device, &supported_feats);
+
+	// only used for profiling; optional
+	ctxt.pipeline_statistics = supported_feats.features.pipelineStatisticsQuery && supported_vk12_feats.hostQueryReset;
+	ctxt.vkb_physical_device.features.pipelineStatisticsQuery = ctxt.pipeline_statistics;
+	ctxt.timestamps = ctxt.vkb_physical_device.properties.limits.timestampComputeAndGraphics && supported_vk12_feats.hostQueryReset;
+	// only used to draw the shadow cascades instanced; optional
+	ctxt.clip_distance = supported_feats.features.shaderClipDistance;
+	ctxt.vkb_physical_device.features.shaderClipDistance = ctxt.clip_distance;
+
 	vkb::DeviceBuilder device_builder{ctxt.vkb_physical_device};
 
-	VkPhysicalDeviceDescriptorIndexingFeatures descriptor_indexing_features{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES};
-	descriptor_indexing_features.descriptorBindingPartiallyBound = true;
-	descriptor_indexing_features.descriptorBindingUpdateUnusedWhilePending = true;
-	descriptor_indexing_features.shaderSampledImageArrayNonUniformIndexing = true;
-	descriptor_indexing_features.runtimeDescriptorArray = true;
-	descriptor_indexing_features.descriptorBindingVariableDescriptorCount = true;
+	// the descriptor indexing features are part of the 1.2 struct (the two can't be chained together)
+	VkPhysicalDeviceVulkan12Features vk12_feats{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+	vk12_feats.descriptorBindingPartiallyBound = true;
+	vk12_feats.descriptorBindingUpdateUnusedWhilePending = true;
+	vk12_feats.shaderSampledImageArrayNonUniformIndexing = true;
+	vk12_feats.runtimeDescriptorArray = true;
+	vk12_feats.descriptorBindingVariableDescriptorCount = true;
+	vk12_feats.hostQueryReset = ctxt.pipeline_statistics || ctxt.timestamps;
 
 	VkPhysicalDeviceVulkan11Features feats{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES};
 	feats.shaderDrawParameters = true;
 
-	auto dev_ret = device_builder.add_pNext(&descriptor_indexing_features).add_pNext(&feats).build();
+	auto dev_ret = device_builder.add_pNext(&vk12_feats).add_pNext(&feats).build();
 	if (!dev_ret.has_value()) {
 		spdlog::error("failed to build device");
 		return {};
@@ -77,6 +100,15 @@ std::optional<Context> Context::create() {
 	ctxt.graphics_queue = ctxt.vkb_device.get_queue(vkb::QueueType::graphics).value();
 	ctxt.device = ctxt.vkb_device.device;
 
+	ctxt.vuk_context = std::make_unique<vuk::Context>(ctxt.instance, ctxt.device, ctxt.physical_device, ctxt.graphics_queue);
+
+	if (ctxt.headless) {
+		// what the swapchain would most likely be, so the output is the same
+		ctxt.output_extent = *headless_extent;
+		ctxt.output_format = vuk::Format::eR8G8B8A8Srgb;
+		return ctxt;
+	}
+
 	vkb::SwapchainBuilder swb(ctxt.vkb_device);
 	swb.set_desired_format(vuk::SurfaceFormatKHR{vuk::Format::eR8G8B8A8Srgb, vuk::ColorSpaceKHR::eSrgbNonlinear});
 	swb.add_fallback_format(vuk::SurfaceFormatKHR{vuk::Format::eB8G8R8A8Srgb, vuk::ColorSpaceKHR::eSrgbNonlinear});
@@ -101,9 +133,9 @@ std::optional<Context> Context::create() {
 	sw.surface = ctxt.vkb_device.surface;
 	sw.swapchain = vk_swapchain->swapchain;
 
-	ctxt.vuk_context = std::make_unique<vuk::Context>(ctxt.instance, ctxt.device, ctxt.physical_device, ctxt.graphics_queue);
-
 	ctxt.vuk_swapchain = ctxt.vuk_context->add_swapchain(sw);
+	ctxt.output_extent = sw.extent;
+	ctxt.output_format = sw.format;
 
 	return ctxt;
 }
@@ -121,10 +153,14 @@ void Context::cleanup(std::optional<Context>& ctxt) {
 
 	ctxt.reset();
 
-	vkDestroySurfaceKHR(vkb_instance.instance, surface, nullptr);
+	if (surface != VK_NULL_HANDLE) {
+		vkDestroySurfaceKHR(vkb_instance.instance, surface, nullptr);
+	}
 	vkb::destroy_device(vkb_device);
 	vkb::destroy_instance(vkb_instance);
 
-	glfwDestroyWindow(window);
-	glfwTerminate();
+	if (window) {
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
 }
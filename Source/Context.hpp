@@ -9,9 +9,13 @@
 #include <memory>
 
 struct Context {
-	static std::optional<Context> create();
+	// with a headless_extent there is no window, surface or swapchain (so it also works on devices that can't present, like lavapipe), and
+	// the Renderer renders into an offscreen target of that size instead
+	static std::optional<Context> create(std::optional<vuk::Extent2D> headless_extent = {});
 	static void cleanup(std::optional<Context>& ctxt);
 
+	bool headless;
+	// null in headless mode
 	struct GLFWwindow* window;
 
 	vkb::Instance vkb_instance;
@@ -24,9 +28,21 @@ struct Context {
 	VkDevice device;
 	VkQueue graphics_queue;
 
+	// only valid outside of headless mode
 	VkSurfaceKHR surface;
 	vkb::Swapchain vkb_swapchain;
 	vuk::Swapchain* vuk_swapchain;
 
+	// of the final image: the swapchain's, or the offscreen target's in headless mode
+	vuk::Extent2D output_extent;
+	vuk::Format output_format;
+
 	std::unique_ptr<vuk::Context> vuk_context;
+
+	// pipelineStatisticsQuery/hostQueryReset are available and enabled (see PipelineStatisticsQuery)
+	bool pipeline_statistics;
+	// timestamps can be written on the graphics queue, and hostQueryReset is enabled (see GpuTimer)
+	bool timestamps;
+	// shaderClipDistance is available and enabled; CascadedShadowRenderPass draws its cascades one at a time without it
+	bool clip_distance;
 };
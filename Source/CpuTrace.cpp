@@ -0,0 +1,86 @@
+#include "CpuTrace.hpp"
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+
+namespace cpu_trace {
+
+#ifdef VUKPBR_CPU_TRACE
+
+struct Event {
+	const char* name;
+	u64 begin_ns;
+	u64 end_ns;
+	u32 thread;
+};
+
+// zones go in the order they end; s_next counts every zone ever recorded
+static std::array<Event, RING_SIZE> s_ring;
+static std::atomic<u64> s_next{0};
+
+// threads show up as 0, 1, ... in the order they first record a zone
+static u32 thread_index() {
+	static std::atomic<u32> next{0};
+	thread_local const u32 index = next.fetch_add(1, std::memory_order_relaxed);
+	return index;
+}
+
+#endif
+
+u64 now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void record(const char* name, u64 begin_ns, u64 end_ns) {
+#ifdef VUKPBR_CPU_TRACE
+	const u64 slot = s_next.fetch_add(1, std::memory_order_relaxed) % RING_SIZE;
+	s_ring[slot] = Event{.name = name, .begin_ns = begin_ns, .end_ns = end_ns, .thread = thread_index()};
+#endif
+}
+
+bool write_chrome_json(const std::string& path) {
+#ifdef VUKPBR_CPU_TRACE
+	const u64 end = s_next.load(std::memory_order_acquire);
+	const u64 begin = end > RING_SIZE ? end - RING_SIZE : 0;
+
+	std::ofstream file{path};
+	if (!file) {
+		spdlog::error("cpu trace: failed to write {}", path);
+		return false;
+	}
+
+	// timestamps are in microseconds, from the start of the oldest zone
+	u64 origin_ns = std::numeric_limits<u64>::max();
+	for (u64 i = begin; i < end; ++i) {
+		origin_ns = std::min(origin_ns, s_ring[i % RING_SIZE].begin_ns);
+	}
+
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+	for (u64 i = begin; i < end; ++i) {
+		const Event& event = s_ring[i % RING_SIZE];
+		// the names are literals from this codebase, so there's nothing to escape
+		file << (i == begin ? "\n" : ",\n") << "{\"name\": \"" << event.name << "\", \"cat\": \"cpu\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << event.thread
+			 << ", \"ts\": " << (event.begin_ns - origin_ns) / 1e3 << ", \"dur\": " << (event.end_ns - event.begin_ns) / 1e3 << "}";
+	}
+	file << "\n]}\n";
+
+	if (!file) {
+		spdlog::error("cpu trace: failed to write {}", path);
+		return false;
+	}
+	spdlog::info("cpu trace: wrote {} zones to {}", end - begin, path);
+	return true;
+#else
+	spdlog::warn("cpu trace: not compiled in (configure with VUKPBR_CPU_TRACE=ON)");
+	return false;
+#endif
+}
+
+} // namespace cpu_trace
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Types.hpp"
+
+#include <string>
+
+/*
+	CPU trace zones: TRACE_ZONE("name") times everything from there to the end of the enclosing scope, on whichever thread it runs, and
+	stores it in a ring of the last RING_SIZE zones; write_chrome_json() dumps the ring in the Chrome trace event format (chrome://tracing or
+	ui.perfetto.dev), with nested zones stacked under each other.
+
+	A zone costs two steady_clock reads and an atomic increment; only the name's pointer is stored, so it has to be a string literal.
+	Nothing is recorded unless VUKPBR_CPU_TRACE is defined (the CMake option of the same name): without it the macros expand to nothing,
+	or to just the statement for TRACE_CALL.
+
+	The ring is written without locks, so dump it from the render thread between frames; zones that are still open on another thread then
+	are simply not in it yet.
+*/
+
+namespace cpu_trace {
+
+inline constexpr u32 RING_SIZE = 1 << 16;
+
+// steady_clock, in nanoseconds
+u64 now();
+void record(const char* name, u64 begin_ns, u64 end_ns);
+
+// every zone in the ring, oldest first; false (and logged) if the file can't be written or tracing is compiled out
+bool write_chrome_json(const std::string& path);
+
+class Zone {
+  public:
+	explicit Zone(const char* name) : m_name{name}, m_begin_ns{now()} {
+	}
+
+	~Zone() {
+		record(m_name, m_begin_ns, now());
+	}
+
+	Zone(const Zone&) = delete;
+	Zone& operator=(const Zone&) = delete;
+
+  private:
+	const char* m_name;
+	u64 m_begin_ns;
+};
+
+} // namespace cpu_trace
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+#ifdef VUKPBR_CPU_TRACE
+#define TRACE_ZONE(name) const cpu_trace::Zone TRACE_CONCAT(trace_zone_, __LINE__)(name)
+#else
+#define TRACE_ZONE(name)
+#endif
+
+// a zone around a single statement, e.g. TRACE_CALL("wait_all_transfers", ptc.wait_all_transfers());
+#define TRACE_CALL(name, ...) \
+	do { \
+		TRACE_ZONE(name); \
+		__VA_ARGS__; \
+	} while (false)
@@ -0,0 +1,96 @@
+#include "DynamicResolution.hpp"
+
+#include "Context.hpp"
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cmath>
+
+DynamicResolution::DynamicResolution(f32 budget_ms)
+	: budget_ms{budget_ms}, m_enabled{true}, m_scale{MAX_SCALE}, m_frames_over{0}, m_frames_under{0}, m_cooldown{0} {
+}
+
+void DynamicResolution::init(Context& ctxt) {
+	m_timer.init(ctxt);
+}
+
+void DynamicResolution::update() {
+	if (const auto ms = m_timer.next_frame()) {
+		add_measurement(*ms);
+	}
+}
+
+void DynamicResolution::add_measurement(f64 ms) {
+	if (!m_enabled) {
+		return;
+	}
+
+	if (m_cooldown > 0) {
+		--m_cooldown;
+		return;
+	}
+
+	m_smoothed_ms = m_smoothed_ms ? std::lerp(*m_smoothed_ms, ms, static_cast<f64>(SMOOTHING)) : ms;
+
+	if (*m_smoothed_ms > budget_ms) {
+		++m_frames_over;
+		m_frames_under = 0;
+	} else if (*m_smoothed_ms < budget_ms * LOWER_THRESHOLD) {
+		++m_frames_under;
+		m_frames_over = 0;
+	} else {
+		m_frames_over = 0;
+		m_frames_under = 0;
+	}
+
+	const bool decrease = m_frames_over >= FRAMES_TO_DECREASE && m_scale > MIN_SCALE;
+	const bool increase = m_frames_under >= FRAMES_TO_INCREASE && m_scale < MAX_SCALE;
+	if (!decrease && !increase) {
+		return;
+	}
+
+	// aim for the middle of the band, so the next change isn't right around the corner
+	const f64 target_ms = budget_ms * (1.f + LOWER_THRESHOLD) * 0.5f;
+	f32 scale = m_scale * static_cast<f32>(std::sqrt(target_ms / std::max(*m_smoothed_ms, 1e-3)));
+	scale = std::clamp(scale, m_scale - MAX_STEP, m_scale + MAX_STEP);
+	// snapped away from the current scale, so it always moves at least one step
+	scale = decrease ? std::floor(scale / STEP) * STEP : std::ceil(scale / STEP) * STEP;
+	scale = std::clamp(scale, MIN_SCALE, MAX_SCALE);
+
+	spdlog::debug("dynamic resolution: {:.2f} ms against a budget of {:.2f} ms, scale {:.2f} -> {:.2f}", *m_smoothed_ms, budget_ms, m_scale, scale);
+
+	m_scale = scale;
+	m_smoothed_ms.reset();
+	m_frames_over = 0;
+	m_frames_under = 0;
+	// the frames in flight were still rendered at the old scale
+	m_cooldown = vuk::Context::FC;
+}
+
+vuk::Extent2D DynamicResolution::render_extent(vuk::Extent2D output) const {
+	return vuk::Extent2D{std::max(static_cast<u32>(std::lround(output.width * m_scale)), 1u),
+		std::max(static_cast<u32>(std::lround(output.height * m_scale)), 1u)};
+}
+
+f32 DynamicResolution::scale() const {
+	return m_scale;
+}
+
+bool DynamicResolution::enabled() const {
+	return m_enabled;
+}
+
+void DynamicResolution::set_enabled(bool enabled) {
+	m_enabled = enabled;
+	if (!enabled) {
+		m_scale = MAX_SCALE;
+	}
+	m_smoothed_ms.reset();
+	m_frames_over = 0;
+	m_frames_under = 0;
+	m_cooldown = vuk::Context::FC;
+}
+
+GpuTimer& DynamicResolution::timer() {
+	return m_timer;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Types.hpp"
+#include "GpuQueries.hpp"
+
+#include <vuk/Image.hpp>
+#include <optional>
+
+/*
+	Scales the internal render resolution to hold a GPU time budget for the passes whose cost depends on it (from the depth prepass to the
+	composite, which upsamples to the swapchain's resolution). Those are timed with a GpuTimer, so every measurement is vuk::Context::FC
+	frames old.
+
+	The cost is taken as proportional to the pixel count, so a new scale is the old one times sqrt(budget / time). To keep it from
+	oscillating, the measurements are smoothed, the scale only drops once the time has been over budget for a couple of frames and only grows
+	once it has been well below it (LOWER_THRESHOLD) for much longer, every change is limited to MAX_STEP and snapped to STEP, and the
+	measurements of the frames still in flight at the old scale are skipped afterwards.
+*/
+
+class DynamicResolution {
+  public:
+	static constexpr f32 MIN_SCALE = 0.5f;
+	static constexpr f32 MAX_SCALE = 1.f;
+	// the scale is always a multiple of this
+	static constexpr f32 STEP = 0.05f;
+	static constexpr f32 MAX_STEP = 0.15f;
+	// of the budget; between this and the budget the scale is left alone
+	static constexpr f32 LOWER_THRESHOLD = 0.8f;
+	// consecutive frames over (or under) the thresholds before the scale changes
+	static constexpr u32 FRAMES_TO_DECREASE = 3;
+	static constexpr u32 FRAMES_TO_INCREASE = 30;
+	// weight of each new measurement
+	static constexpr f32 SMOOTHING = 0.2f;
+
+	explicit DynamicResolution(f32 budget_ms);
+
+	void init(struct Context& ctxt);
+
+	// call once per frame, before render_extent(); reads back an earlier frame's time and adjusts the scale
+	void update();
+	// feeds one measurement to the controller; update() does this with the timer's
+	void add_measurement(f64 ms);
+
+	// output scaled down, at least 1 x 1
+	vuk::Extent2D render_extent(vuk::Extent2D output) const;
+
+	f32 scale() const;
+
+	bool enabled() const;
+	// disabling goes back to MAX_SCALE
+	void set_enabled(bool enabled);
+
+	// begun by GBufferPass and ended by the composite (see RenderInfo::resolution_timer)
+	GpuTimer& timer();
+
+	f32 budget_ms;
+
+  private:
+	GpuTimer m_timer;
+
+	bool m_enabled;
+	f32 m_scale;
+	std::optional<f64> m_smoothed_ms;
+	u32 m_frames_over;
+	u32 m_frames_under;
+	// measurements left to skip after a change
+	u32 m_cooldown;
+};
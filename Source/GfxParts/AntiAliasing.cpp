@@ -0,0 +1,172 @@
+#include "AntiAliasing.hpp"
+
+#include "../Context.hpp"
+#include "../Renderer.hpp"
+#include "../GpuProfiler.hpp"
+#include "../CpuTrace.hpp"
+
+#include <glm/mat4x4.hpp>
+#include <spdlog/spdlog.h>
+
+// radical inverse of index in the given base, in [0, 1)
+static f32 halton(u32 index, u32 base) {
+	f32 result = 0.f;
+	f32 fraction = 1.f;
+	while (index > 0) {
+		fraction /= static_cast<f32>(base);
+		result += fraction * static_cast<f32>(index % base);
+		index /= base;
+	}
+	return result;
+}
+
+const char* AntiAliasingPass::mode_name(Mode mode) {
+	switch (mode) {
+	case Mode::None:
+		return "none";
+	case Mode::MSAA:
+		return "msaa";
+	case Mode::FXAA:
+		return "fxaa";
+	case Mode::TAA:
+		return "taa";
+	}
+	return "";
+}
+
+glm::vec2 AntiAliasingPass::jitter(Mode mode, u64 frame, u32 width, u32 height) {
+	if (mode != Mode::TAA) {
+		return glm::vec2{0.f};
+	}
+
+	// starts at 1, since the sequence's first point is (0, 0)
+	const u32 index = static_cast<u32>(frame % TAA_SAMPLES) + 1;
+	// one pixel is 2 / size in NDC
+	return glm::vec2{(halton(index, 2) - 0.5f) * 2.f / width, (halton(index, 3) - 0.5f) * 2.f / height};
+}
+
+AntiAliasingPass::AntiAliasingPass() : m_mode{Mode::None}, m_width{0}, m_height{0}, m_jitter{0.f}, m_frame{0} {
+	m_timed_modes.fill(Mode::None);
+}
+
+void AntiAliasingPass::init(vuk::PerThreadContext& ptc, struct Context& ctxt, struct UniformStore& uniforms, PipelineStore& ps) {
+	// composite.vert is only used for its fullscreen triangle; both work in gl_FragCoord
+	ps.add("taa", "composite.vert", "taa.frag");
+	ps.add("fxaa", "composite.vert", "fxaa.frag");
+
+	m_timer.init(ctxt);
+}
+
+void AntiAliasingPass::prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) {
+	TRACE_ZONE("AntiAliasingPass::prep");
+
+	m_mode = info.anti_aliasing;
+	if (m_mode == Mode::MSAA && info.deferred) {
+		m_mode = Mode::None;
+	}
+	m_width = info.window_width;
+	m_height = info.window_height;
+	m_jitter = info.cam_proj.jitter;
+
+	if (m_mode == Mode::TAA) {
+		m_history.resize(ptc, ctxt, vuk::Extent2D{m_width, m_height}, vuk::Format::eR16G16B16A16Sfloat);
+	}
+
+	const u32 slot = ++m_frame % vuk::Context::FC;
+	if (const auto ms = m_timer.next_frame()) {
+		spdlog::debug("color pass to final image ({} anti-aliasing): {:.3f} ms", mode_name(m_timed_modes[slot]), *ms);
+	}
+	m_timed_modes[slot] = m_mode;
+}
+
+void AntiAliasingPass::render(
+	vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::RenderGraph& rg, const class SceneRenderer& renderer, struct RenderInfo& info) {
+	TRACE_ZONE("AntiAliasingPass::render");
+
+	if (m_mode != Mode::TAA) {
+		return;
+	}
+
+	const bool history_valid = m_history.attach(rg, "taa_history_prev", "taa_history", info.frame);
+
+	struct Params {
+		glm::mat4 inv_view_proj;
+		glm::mat4 prev_view_proj;
+		glm::vec2 jitter;
+		u32 history_valid;
+	} params{glm::inverse(info.cam_proj.matrix() * info.cam_view), info.prev_view_proj, m_jitter, history_valid ? 1u : 0u};
+
+	auto [bubo, stub] = ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eUniformBuffer, std::span{&params, 1});
+	auto ubo = bubo;
+
+	TRACE_CALL("wait_all_transfers", ptc.wait_all_transfers());
+
+	info.profiler->add_pass(rg, "taa", vuk::Pass{.resources = {"taa_history"_image(vuk::eColorWrite), "pbr_msaa"_image(vuk::eFragmentSampled),
+							  "taa_history_prev"_image(vuk::eFragmentSampled), "depth_prepass"_image(vuk::eFragmentSampled)},
+		.execute = [ubo](vuk::CommandBuffer& cbuf) {
+			// the history is reprojected, so it's the one that gets filtered
+			const auto sci = vuk::SamplerCreateInfo{
+				.magFilter = vuk::Filter::eLinear,
+				.minFilter = vuk::Filter::eLinear,
+				.addressModeU = vuk::SamplerAddressMode::eClampToEdge,
+				.addressModeV = vuk::SamplerAddressMode::eClampToEdge,
+				.addressModeW = vuk::SamplerAddressMode::eClampToEdge,
+			};
+
+			cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
+				.set_scissor(0, vuk::Rect2D::framebuffer())
+				.bind_graphics_pipeline("taa")
+				.bind_sampled_image(0, 0, "pbr_msaa", {})
+				.bind_sampled_image(0, 1, "taa_history_prev", sci)
+				.bind_sampled_image(0, 2, "depth_prepass", {})
+				.bind_uniform_buffer(0, 3, ubo)
+				.draw(3, 1, 0, 0);
+		}});
+}
+
+void AntiAliasingPass::render_post(vuk::RenderGraph& rg, GpuProfiler& profiler) {
+	TRACE_ZONE("AntiAliasingPass::render_post");
+
+	if (m_mode != Mode::FXAA) {
+		return;
+	}
+
+	profiler.add_pass(rg, "fxaa", vuk::Pass{.resources = {"pbr_final"_image(vuk::eColorWrite), "pbr_composite"_image(vuk::eFragmentSampled)},
+		.execute = [this](vuk::CommandBuffer& cbuf) {
+			const auto sci = vuk::SamplerCreateInfo{
+				.magFilter = vuk::Filter::eLinear,
+				.minFilter = vuk::Filter::eLinear,
+				.addressModeU = vuk::SamplerAddressMode::eClampToEdge,
+				.addressModeV = vuk::SamplerAddressMode::eClampToEdge,
+				.addressModeW = vuk::SamplerAddressMode::eClampToEdge,
+			};
+
+			cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
+				.set_scissor(0, vuk::Rect2D::framebuffer())
+				.bind_graphics_pipeline("fxaa")
+				.bind_sampled_image(0, 0, "pbr_composite", sci)
+				.draw(3, 1, 0, 0);
+
+			end_timing(cbuf);
+		}});
+}
+
+AntiAliasingPass::Mode AntiAliasingPass::mode() const {
+	return m_mode;
+}
+
+bool AntiAliasingPass::temporal() const {
+	return m_mode == Mode::TAA;
+}
+
+bool AntiAliasingPass::post() const {
+	return m_mode == Mode::FXAA;
+}
+
+void AntiAliasingPass::begin_timing(vuk::CommandBuffer& cbuf) {
+	m_timer.begin(cbuf);
+}
+
+void AntiAliasingPass::end_timing(vuk::CommandBuffer& cbuf) {
+	m_timer.end(cbuf);
+}
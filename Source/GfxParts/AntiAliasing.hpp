@@ -0,0 +1,70 @@
+#pragma once
+
+#include "GraphicsPass.hpp"
+#include "TemporalHistory.hpp"
+#include "../Types.hpp"
+#include "../GpuQueries.hpp"
+
+#include <vuk/Context.hpp>
+#include <vuk/RenderGraph.hpp>
+#include <vuk/CommandBuffer.hpp>
+#include <glm/vec2.hpp>
+#include <array>
+
+/*
+	The anti-aliasing of the final image, one of:
+
+	- MSAA: the forward color pass renders into a multisampled target (with its own multisampled depth, since depth_prepass is single
+	  sampled) that is resolved into pbr_msaa. Only geometry edges are smoothed, and the deferred path can't use it (it falls back to None).
+	- FXAA: a post-process over the tonemapped image, which blurs along the edges it finds in the luma.
+	- TAA: the projection is jittered by a sub-pixel offset every frame (Perspective::jitter), and the lit scene is blended with its
+	  reprojected history, before the composite. The history is clamped to the variance of the current neighbourhood.
+
+	Everything that's full screen (the composite, the post-processing, FXAA) renders single sampled; only MSAA's color pass pays for the extra samples.
+*/
+
+class AntiAliasingPass : public GraphicsPass {
+  public:
+	enum class Mode { None, MSAA, FXAA, TAA };
+
+	static const char* mode_name(Mode mode);
+
+	static constexpr vuk::Samples MSAA_SAMPLES = vuk::Samples::e4;
+	// of the jitter sequence
+	static constexpr u32 TAA_SAMPLES = 8;
+
+	// this frame's Perspective::jitter for a width x height target: the 2, 3 Halton sequence in TAA mode, nothing otherwise
+	static glm::vec2 jitter(Mode mode, u64 frame, u32 width, u32 height);
+
+	AntiAliasingPass();
+
+	void init(vuk::PerThreadContext& ptc, struct Context& ctxt, struct UniformStore& uniforms, class PipelineStore& ps) override;
+	void prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) override;
+	// the TAA resolve, after the color pass
+	void render(vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::RenderGraph& rg, const class SceneRenderer& renderer, struct RenderInfo& info) override;
+	// FXAA, from pbr_composite into pbr_final
+	void render_post(vuk::RenderGraph& rg, class GpuProfiler& profiler);
+
+	// what's in effect this frame (MSAA isn't in the deferred path)
+	Mode mode() const;
+	// the composite reads taa_history instead of pbr_msaa
+	bool temporal() const;
+	// the tonemap writes pbr_composite instead of pbr_final
+	bool post() const;
+
+	// brackets everything from the color pass to the final image, so the modes can be compared (logged in prep)
+	void begin_timing(vuk::CommandBuffer& cbuf);
+	void end_timing(vuk::CommandBuffer& cbuf);
+
+  private:
+	Mode m_mode;
+	u32 m_width, m_height;
+	glm::vec2 m_jitter;
+
+	TemporalHistory m_history;
+
+	GpuTimer m_timer;
+	// what each of the timer's frames in flight measured
+	std::array<Mode, vuk::Context::FC> m_timed_modes;
+	u32 m_frame;
+};
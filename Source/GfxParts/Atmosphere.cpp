@@ -5,79 +5,94 @@
 #include "../Mesh.hpp"
 #include "../Resource.hpp"
 #include "../PipelineStore.hpp"
+#include "../GpuProfiler.hpp"
+#include "../CpuTrace.hpp"
 
 #include <glm/gtx/euler_angles.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/mat4x4.hpp>
 #include <vuk/CommandBuffer.hpp>
 #include <vuk/RenderGraph.hpp>
+#include <glm/geometric.hpp>
+
+static constexpr u32 SKY_SIZE = 512;
+static constexpr u32 IRRADIANCE_SIZE = 32;
+static constexpr u32 PREFILTER_SIZE = 128;
+static constexpr u32 PREFILTER_MIPS = 5;
+
+// bake steps are ordered sky faces -> irradiance faces -> prefilter (mip, face)
+static constexpr u32 SKY_STEPS = 6;
+static constexpr u32 IRRADIANCE_STEPS = 6;
+static constexpr u32 PREFILTER_STEPS = 6 * PREFILTER_MIPS;
+static constexpr u32 BAKE_STEP_COUNT = SKY_STEPS + IRRADIANCE_STEPS + PREFILTER_STEPS;
+
+enum class BakePhase { Sky, Irradiance, Prefilter };
+
+static BakePhase bake_phase(u32 step) {
+	if (step < SKY_STEPS) {
+		return BakePhase::Sky;
+	} else if (step < SKY_STEPS + IRRADIANCE_STEPS) {
+		return BakePhase::Irradiance;
+	}
+	return BakePhase::Prefilter;
+}
+
+static const glm::mat4 capture_projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+static const glm::mat4 capture_views[] = {
+	glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+	glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+	glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
+	glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)),
+	glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+	glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+};
 
 glm::mat4 AtmosphericSkyCubemap::skybox_model_matrix(const Perspective& cam_proj, glm::vec3 cam_pos) {
 	return TransformComponent{}
 		.translate(cam_pos)
 		.scale({cam_proj.far / sqrt(3), cam_proj.far / sqrt(3), cam_proj.far / sqrt(3)})
 		.rotate(glm::eulerAngleXYZ(0.f, glm::radians(90.f), 0.f))
-		.matrix;
+		.matrix();
 }
 
-AtmosphericSkyCubemap::AtmosphericSkyCubemap(glm::vec3 light_direction) : m_light_direction{light_direction} {
+AtmosphericSkyCubemap::AtmosphericSkyCubemap(glm::vec3 light_direction, Mode mode)
+	: bake_steps_per_frame{1}, m_mode{mode}, m_light_direction{light_direction}, m_front{0}, m_pending_direction{light_direction},
+	  m_baking_direction{light_direction}, m_dirty{false}, m_swap_pending{false} {
 }
 
 void AtmosphericSkyCubemap::init(vuk::PerThreadContext& ptc, struct Context& ctxt, class PipelineStore& ps, const struct RenderMesh& cube) {
-	ps.add("sky", "sky.vert", "sky.frag");
-	ps.add("skybox", "skybox.vert", "skybox.frag");
+	ps.add("sky", "cubemap.vert", "sky.frag");
 
-	m_cubemap = gfx_util::alloc_cubemap(2048, 2048, ptc);
+	// drawn first, under everything else, into a pass whose depth is read-only (it's depth_prepass, which already has the sky in it)
+	vuk::PipelineBaseCreateInfo skybox_pipe;
+	skybox_pipe.depth_stencil_state.depthTestEnable = false;
+	skybox_pipe.depth_stencil_state.depthWriteEnable = false;
+	ps.add("skybox", "skybox.vert", "skybox.frag", skybox_pipe);
 
-	/*auto equirectangular = ctxt.vuk_context->allocate_texture({
-		.imageType = vuk::ImageType::e2D,
-		.format = vuk::Format::eR32G32B32A32Sfloat,
-		.extent = vuk::Extent3D{4096, 2048, 1},
-		.mipLevels = 1,
-		.arrayLayers = 1,
-		.samples = vuk::Samples::e1,
-		.tiling = vuk::ImageTiling::eOptimal,
-		.usage = vuk::ImageUsageFlagBits::eColorAttachment | vuk::ImageUsageFlagBits::eSampled,
-		.sharingMode = vuk::SharingMode::eExclusive,
-	});
-
-	{
-		vuk::RenderGraph rg;
+	if (m_mode == Mode::Procedural) {
+		for (u32 i = 0; i < BAKE_STEP_COUNT; ++i) {
+			m_step_names.push_back(std::string{"sky_bake_step_"}.append(std::to_string(i)));
+		}
 
-		rg.add_pass({.resources = {"equirectangular"_image(vuk::eColorWrite)}, .execute = [this](vuk::CommandBuffer& cbuf) {
-						 cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
-							 .set_scissor(0, vuk::Rect2D::framebuffer())
-							 .bind_graphics_pipeline("sky")
-							 .push_constants(vuk::ShaderStageFlagBits::eFragment, 0, m_light_direction)
-							 .draw(3, 1, 0, 0);
-					 }});
+		for (auto& target : m_targets) {
+			init_bake_target(ptc, target);
+		}
 
-		rg.attach_image("equirectangular",
-			vuk::ImageAttachment{
-				.image = *equirectangular.image,
-				.image_view = *equirectangular.view,
-				.extent = vuk::Extent2D{4096, 2048},
-				.format = vuk::Format::eR32G32B32A32Sfloat,
-				.sample_count = vuk::Samples::e1,
-				.clear_value = vuk::ClearColor{0.f, 0.f, 0.f, 1.f},
-			},
-			vuk::Access::eClear, vuk::eFragmentSampled);
+		// the very first bake is done up-front so there's always a complete sky to show
+		for (u32 i = 0; i < BAKE_STEP_COUNT; ++i) {
+			vuk::RenderGraph rg;
+			record_bake_step(rg, nullptr, m_targets[m_front], i, m_light_direction, cube);
+			auto erg = std::move(rg).link(ptc);
+			vuk::execute_submit_and_wait(ptc, std::move(erg));
+		}
+		m_targets[m_front].written = true;
 
-		auto erg = std::move(rg).link(ptc);
-		vuk::execute_submit_and_wait(ptc, std::move(erg));
-	}*/
+		return;
+	}
 
-	auto equirectangular = gfx_util::load_cubemap_texture("Resources/Textures/kloppenheim_2k.hdr", ptc, false);
+	m_cubemap = gfx_util::alloc_cubemap(2048, 2048, ptc);
 
-	const glm::mat4 capture_projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-	const glm::mat4 capture_views[] = {
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
-	};
+	auto equirectangular = gfx_util::load_cubemap_texture("Resources/Textures/kloppenheim_2k.hdr", ptc, false);
 
 	vuk::ImageViewCreateInfo ivci{
 		.image = *m_cubemap.image,
@@ -158,9 +173,212 @@ void AtmosphericSkyCubemap::draw(vuk::CommandBuffer& cbuf, const vuk::Buffer& ub
 		.bind_index_buffer(*cube.inds, vuk::IndexType::eUint32)
 		.bind_graphics_pipeline("skybox")
 		.bind_uniform_buffer(0, 0, ubo)
-		.bind_sampled_image(0, 2, *m_cubemap_view, {});
+		.bind_sampled_image(0, 2, m_mode == Mode::Procedural ? *m_targets[m_front].sky_view : *m_cubemap_view, {});
+
+	const glm::mat4 model = skybox_model_matrix(cam_proj, cam_pos);
+
+	auto* model_binding = cbuf.map_scratch_uniform_binding<glm::mat4>(0, 1);
+	*model_binding = model;
+
+	// the static HDR is stored upside-down, whereas the procedural sky is baked directly in world space
+	auto* sample_transform = cbuf.map_scratch_uniform_binding<glm::mat4>(0, 3);
+	*sample_transform = m_mode == Mode::Procedural ? glm::mat4{glm::mat3{glm::normalize(glm::vec3{model[0]}), glm::normalize(glm::vec3{model[1]}),
+															glm::normalize(glm::vec3{model[2]})}}
+													: glm::scale(glm::mat4{1.f}, glm::vec3{1.f, -1.f, 1.f});
 
-	auto* model = cbuf.map_scratch_uniform_binding<glm::mat4>(0, 1);
-	*model = skybox_model_matrix(cam_proj, cam_pos);
 	cbuf.draw_indexed(cube.mesh.second.size(), 1, 0, 0, 0);
 }
+
+void AtmosphericSkyCubemap::set_light_direction(glm::vec3 light_direction) {
+	if (glm::length(light_direction - m_pending_direction) < 1e-4f) {
+		return;
+	}
+
+	m_pending_direction = light_direction;
+	m_dirty = true;
+}
+
+void AtmosphericSkyCubemap::bake(vuk::RenderGraph& rg, GpuProfiler& profiler, const RenderMesh& cube) {
+	TRACE_ZONE("AtmosphericSkyCubemap::bake");
+
+	if (m_mode != Mode::Procedural) {
+		return;
+	}
+
+	// the last step was recorded last frame, so the back cubemaps are complete by now
+	if (m_swap_pending) {
+		m_front = 1 - m_front;
+		m_targets[m_front].written = true;
+		m_light_direction = m_baking_direction;
+		m_swap_pending = false;
+	}
+
+	// a bake that's already in progress always finishes; whatever direction is latest by then gets baked next
+	if (!m_bake_step.has_value() && m_dirty) {
+		m_bake_step = 0;
+		m_baking_direction = m_pending_direction;
+		m_dirty = false;
+	}
+
+	if (!m_bake_step.has_value()) {
+		return;
+	}
+
+	// the irradiance/prefilter steps sample the sky through a plain image view, which the render graph can't track,
+	// so never record steps from two different phases into the same frame
+	const BakePhase phase = bake_phase(*m_bake_step);
+	for (u32 i = 0; i < bake_steps_per_frame && m_bake_step.has_value() && bake_phase(*m_bake_step) == phase; ++i) {
+		record_bake_step(rg, &profiler, m_targets[1 - m_front], *m_bake_step, m_baking_direction, cube);
+
+		if (++*m_bake_step == BAKE_STEP_COUNT) {
+			m_bake_step.reset();
+			m_swap_pending = true;
+		}
+	}
+}
+
+bool AtmosphericSkyCubemap::procedural() const {
+	return m_mode == Mode::Procedural;
+}
+
+bool AtmosphericSkyCubemap::baking() const {
+	return m_bake_step.has_value() || m_swap_pending;
+}
+
+vuk::ImageView AtmosphericSkyCubemap::irradiance_view() const {
+	return *m_targets[m_front].irradiance_view;
+}
+
+vuk::ImageView AtmosphericSkyCubemap::prefilter_view() const {
+	return *m_targets[m_front].prefilter_view;
+}
+
+void AtmosphericSkyCubemap::init_bake_target(vuk::PerThreadContext& ptc, BakeTarget& target) {
+	target.sky = gfx_util::alloc_cubemap(SKY_SIZE, SKY_SIZE, ptc);
+	target.irradiance = gfx_util::alloc_cubemap(IRRADIANCE_SIZE, IRRADIANCE_SIZE, ptc);
+	target.prefilter = gfx_util::alloc_cubemap(PREFILTER_SIZE, PREFILTER_SIZE, ptc, PREFILTER_MIPS);
+	target.written = false;
+
+	auto cube_view = [&](const vuk::Texture& texture, u32 mips) {
+		return ptc.create_image_view(vuk::ImageViewCreateInfo{.image = *texture.image,
+			.viewType = vuk::ImageViewType::eCube,
+			.format = vuk::Format::eR32G32B32A32Sfloat,
+			.subresourceRange = vuk::ImageSubresourceRange{.aspectMask = vuk::ImageAspectFlagBits::eColor, .levelCount = mips, .layerCount = 6}});
+	};
+
+	auto face_view = [&](const vuk::Texture& texture, u32 mip, u32 face) {
+		return ptc.create_image_view(vuk::ImageViewCreateInfo{.image = *texture.image,
+			.viewType = vuk::ImageViewType::e2D,
+			.format = vuk::Format::eR32G32B32A32Sfloat,
+			.subresourceRange = vuk::ImageSubresourceRange{
+				.aspectMask = vuk::ImageAspectFlagBits::eColor, .baseMipLevel = mip, .levelCount = 1, .baseArrayLayer = face, .layerCount = 1}});
+	};
+
+	target.sky_view = cube_view(target.sky, 1);
+	target.irradiance_view = cube_view(target.irradiance, 1);
+	target.prefilter_view = cube_view(target.prefilter, PREFILTER_MIPS);
+
+	target.step_views.clear();
+	for (u32 step = 0; step < BAKE_STEP_COUNT; ++step) {
+		switch (bake_phase(step)) {
+		case BakePhase::Sky:
+			target.step_views.push_back(face_view(target.sky, 0, step));
+			break;
+		case BakePhase::Irradiance:
+			target.step_views.push_back(face_view(target.irradiance, 0, step - SKY_STEPS));
+			break;
+		case BakePhase::Prefilter: {
+			const u32 i = step - SKY_STEPS - IRRADIANCE_STEPS;
+			target.step_views.push_back(face_view(target.prefilter, i / 6, i % 6));
+			break;
+		}
+		}
+	}
+}
+
+void AtmosphericSkyCubemap::record_bake_step(
+	vuk::RenderGraph& rg, GpuProfiler* profiler, BakeTarget& target, u32 step, glm::vec3 light_direction, const RenderMesh& cube) {
+	const BakePhase phase = bake_phase(step);
+
+	vuk::Image image;
+	u32 face;
+	u32 size;
+	f32 roughness = 0.f;
+
+	switch (phase) {
+	case BakePhase::Sky:
+		image = *target.sky.image;
+		face = step;
+		size = SKY_SIZE;
+		break;
+	case BakePhase::Irradiance:
+		image = *target.irradiance.image;
+		face = step - SKY_STEPS;
+		size = IRRADIANCE_SIZE;
+		break;
+	case BakePhase::Prefilter: {
+		const u32 i = step - SKY_STEPS - IRRADIANCE_STEPS;
+		const u32 mip = i / 6;
+		image = *target.prefilter.image;
+		face = i % 6;
+		size = PREFILTER_SIZE >> mip;
+		roughness = static_cast<f32>(mip) / static_cast<f32>(PREFILTER_MIPS - 1);
+		break;
+	}
+	}
+
+	const vuk::ImageView sky_view = *target.sky_view;
+	const RenderMesh* cube_mesh = &cube;
+
+	vuk::Pass pass{
+		.resources = {vuk::Resource{m_step_names[step], vuk::Resource::Type::eImage, vuk::eColorWrite}},
+		.execute =
+			[=](vuk::CommandBuffer& cbuf) {
+				const auto sci = vuk::SamplerCreateInfo{
+					.magFilter = vuk::Filter::eLinear,
+					.minFilter = vuk::Filter::eLinear,
+					.addressModeU = vuk::SamplerAddressMode::eClampToEdge,
+					.addressModeV = vuk::SamplerAddressMode::eClampToEdge,
+					.addressModeW = vuk::SamplerAddressMode::eClampToEdge,
+				};
+
+				cbuf.set_viewport(0, vuk::Rect2D::absolute(0, 0, (f32)size, (f32)size))
+					.set_scissor(0, vuk::Rect2D::absolute(0, 0, size, size))
+					.bind_vertex_buffer(0, *cube_mesh->verts, 0,
+						vuk::Packed{vuk::Format::eR32G32B32Sfloat, vuk::Ignore{vuk::Format::eR32G32B32Sfloat}, vuk::Ignore{vuk::Format::eR32G32Sfloat}})
+					.bind_index_buffer(*cube_mesh->inds, vuk::IndexType::eUint32);
+
+				switch (phase) {
+				case BakePhase::Sky:
+					cbuf.bind_graphics_pipeline("sky").push_constants(vuk::ShaderStageFlagBits::eFragment, 0, light_direction);
+					break;
+				case BakePhase::Irradiance:
+					cbuf.bind_sampled_image(0, 2, sky_view, sci).bind_graphics_pipeline("irradiance");
+					break;
+				case BakePhase::Prefilter:
+					cbuf.bind_sampled_image(0, 2, sky_view, sci).bind_graphics_pipeline("prefilter");
+					*cbuf.map_scratch_uniform_binding<f32>(0, 3) = roughness;
+					break;
+				}
+
+				*cbuf.map_scratch_uniform_binding<glm::mat4>(0, 0) = capture_projection;
+				*cbuf.map_scratch_uniform_binding<glm::mat4>(0, 1) = capture_views[face];
+				cbuf.draw_indexed(cube_mesh->mesh.second.size(), 1, 0, 0, 0);
+			},
+	};
+
+	if (profiler) {
+		profiler->add_pass(rg, "sky bake", std::move(pass));
+	} else {
+		rg.add_pass(std::move(pass));
+	}
+
+	rg.attach_image(m_step_names[step],
+		vuk::ImageAttachment{
+			.image = image,
+			.image_view = *target.step_views[step],
+			.extent = vuk::Extent2D{size, size},
+			.format = vuk::Format::eR32G32B32A32Sfloat,
+		},
+		target.written ? vuk::Access::eFragmentSampled : vuk::Access::eNone, vuk::Access::eFragmentSampled);
+}
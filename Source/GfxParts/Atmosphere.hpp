@@ -5,6 +5,10 @@
 
 #include <vuk/Image.hpp>
 #include <glm/mat4x4.hpp>
+#include <array>
+#include <optional>
+#include <string>
+#include <vector>
 
 namespace vuk {
 class PerThreadContext;
@@ -13,20 +17,72 @@ class CommandBuffer;
 struct Buffer;
 } // namespace vuk
 
+/*
+	The sky cubemap can either be a static HDR (Mode::Static), or rendered procedurally from sky.frag (Mode::Procedural).
+
+	In procedural mode the sky also owns the irradiance/prefilter cubemaps derived from it, and re-bakes all three whenever the light direction changes.
+	A full bake is split into single face/mip steps that are recorded into the regular frame graph a few at a time (bake_steps_per_frame),
+	so moving the sun never causes a frame spike. The bake writes into a back set of cubemaps and swaps them in once it's complete.
+*/
+
 class AtmosphericSkyCubemap {
   public:
+	enum class Mode { Static, Procedural };
+
 	static glm::mat4 skybox_model_matrix(const Perspective& cam_proj, glm::vec3 cam_pos);
 
-	AtmosphericSkyCubemap(glm::vec3 light_direction);
+	AtmosphericSkyCubemap(glm::vec3 light_direction, Mode mode = Mode::Static);
 
 	void init(vuk::PerThreadContext& ptc, struct Context& ctxt, class PipelineStore& ps, const struct RenderMesh& cube);
 	void draw(vuk::CommandBuffer& cbuf, const vuk::Buffer& ubo, const struct RenderMesh& cube);
 
+	void set_light_direction(glm::vec3 light_direction);
+	// records the next steps of an in-progress re-bake (if any) into rg; no-op in static mode
+	void bake(vuk::RenderGraph& rg, class GpuProfiler& profiler, const struct RenderMesh& cube);
+
+	bool procedural() const;
+	bool baking() const;
+
+	// only valid in procedural mode
+	vuk::ImageView irradiance_view() const;
+	vuk::ImageView prefilter_view() const;
+
 	Perspective cam_proj;
 	glm::vec3 cam_pos;
 
+	u32 bake_steps_per_frame;
+
   private:
-	const glm::vec3 m_light_direction;
+	struct BakeTarget {
+		vuk::Texture sky;
+		vuk::Texture irradiance;
+		vuk::Texture prefilter;
+		vuk::Unique<vuk::ImageView> sky_view;
+		vuk::Unique<vuk::ImageView> irradiance_view;
+		vuk::Unique<vuk::ImageView> prefilter_view;
+		// one single face view per bake step
+		std::vector<vuk::Unique<vuk::ImageView>> step_views;
+		bool written;
+	};
+
+	void init_bake_target(vuk::PerThreadContext& ptc, BakeTarget& target);
+	// profiler is null for the up-front bake
+	void record_bake_step(
+		vuk::RenderGraph& rg, class GpuProfiler* profiler, BakeTarget& target, u32 step, glm::vec3 light_direction, const struct RenderMesh& cube);
+
+	const Mode m_mode;
+	glm::vec3 m_light_direction;
+
 	vuk::Texture m_cubemap;
 	vuk::Unique<vuk::ImageView> m_cubemap_view;
+
+	std::array<BakeTarget, 2> m_targets;
+	std::vector<std::string> m_step_names;
+	u8 m_front;
+
+	glm::vec3 m_pending_direction;
+	glm::vec3 m_baking_direction;
+	bool m_dirty;
+	bool m_swap_pending;
+	std::optional<u32> m_bake_step;
 };
@@ -5,19 +5,131 @@
 #include "../Context.hpp"
 #include "../Mesh.hpp"
 #include "../Renderer.hpp"
+#include "../CpuTrace.hpp"
 
 #include <vuk/CommandBuffer.hpp>
+#include <spdlog/spdlog.h>
+#include <glm/common.hpp>
+#include <glm/vec2.hpp>
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <limits>
+#include <vector>
 
-CascadedShadowRenderPass::CascadedShadowRenderPass() : cascade_split_lambda{0.95f} {
+static constexpr const char* STATIC_ATLAS_ATTACHMENT_NAME = "static_shadow_atlas";
+
+// accumulates the CPU time spent recording a pass
+struct RecordTimer {
+	explicit RecordTimer(f32& out_ms) : out_ms{out_ms}, start{std::chrono::steady_clock::now()} {
+	}
+
+	~RecordTimer() {
+		out_ms += std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	f32& out_ms;
+	std::chrono::steady_clock::time_point start;
+};
+
+// depth_only_tiled.vert
+struct CascadeUniforms {
+	std::array<glm::mat4, CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT> light_space_mats;
+	std::array<glm::vec4, CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT> tile_transforms;
+};
+
+// shadow_tile.vert; instance i covers target_rects[i]
+struct TileQuads {
+	std::array<glm::vec4, CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT> target_rects;
+	std::array<glm::ivec2, CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT> source_offsets;
+};
+
+// min/max corners of the tile in atlas clip space
+static glm::vec4 tile_clip_rect(const ShadowAtlas& atlas, u32 tile) {
+	const glm::vec4 uv = atlas.uv_rect(tile);
+	return glm::vec4{glm::vec2{uv.x, uv.y} * 2.f - 1.f, glm::vec2{uv.x + uv.z, uv.y + uv.w} * 2.f - 1.f};
+}
+
+static vuk::Rect2D whole_atlas(const ShadowAtlas& atlas) {
+	return vuk::Rect2D::absolute(0, 0, atlas.extent().width, atlas.extent().height);
+}
+
+static void bind_depth_only(vuk::CommandBuffer& cbuf, vuk::Buffer ubo, u8 cascade, vuk::Rect2D tile) {
+	cbuf.set_viewport(0, tile)
+		.set_scissor(0, tile)
+		.set_primitive_topology(vuk::PrimitiveTopology::eTriangleList)
+		.bind_graphics_pipeline("depth_only")
+		.bind_uniform_buffer(0, 0, ubo)
+		.push_constants(vuk::ShaderStageFlagBits::eVertex, 0, static_cast<u32>(cascade));
+}
+
+static std::function<vuk::Packed(const MeshComponent&, const vuk::Buffer&)> caster_binder(vuk::CommandBuffer& cbuf) {
+	return [&cbuf](const MeshComponent& mesh, const vuk::Buffer& transform) {
+		cbuf.bind_uniform_buffer(1, 0, transform);
+		return vuk::Packed{vuk::Format::eR32G32B32Sfloat, vuk::Format::eR32G32B32Sfloat, vuk::Ignore{vuk::Format::eR32G32Sfloat}};
+	};
+}
+
+// in the clip space of a cascade, i.e. light space
+struct ClipBounds {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+// the cascade's whole ortho box
+static const ClipBounds CASCADE_BOX{.min = {-1.f, -1.f, 0.f}, .max = {1.f, 1.f, 1.f}};
+
+// receivers sample a few texels around their own (PCF, normal offset), so casters just outside their bounds still matter
+static constexpr f32 RECEIVER_MARGIN_TEXELS = 8.f;
+
+static ClipBounds clip_bounds(const glm::mat4& view_proj, std::span<const glm::vec3> points) {
+	ClipBounds bounds{.min = glm::vec3{std::numeric_limits<f32>::max()}, .max = glm::vec3{std::numeric_limits<f32>::lowest()}};
+	for (const auto& point : points) {
+		// orthographic, so w = 1
+		const glm::vec3 clip = view_proj * glm::vec4{point, 1.f};
+		bounds.min = glm::min(bounds.min, clip);
+		bounds.max = glm::max(bounds.max, clip);
+	}
+	return bounds;
+}
+
+static ClipBounds clip_bounds(const glm::mat4& view_proj, const SceneRenderer::RenderObject& object) {
+	std::array<glm::vec3, 8> corners;
+	for (u8 i = 0; i < 8; ++i) {
+		corners[i] = {(i & 1) ? object.max.x : object.min.x, (i & 2) ? object.max.y : object.min.y, (i & 4) ? object.max.z : object.min.z};
+	}
+	return clip_bounds(view_proj, corners);
+}
+
+// conservative: a caster's shadow is its bounds swept away from the light, so it can reach the receivers if it overlaps them in xy and
+// doesn't start behind the furthest one. Anything between the cascade's near plane and the light still casts thanks to depth clamping
+static bool can_shadow(const ClipBounds& caster, const ClipBounds& receivers) {
+	return caster.max.x >= receivers.min.x && caster.min.x <= receivers.max.x && caster.max.y >= receivers.min.y && caster.min.y <= receivers.max.y &&
+		   caster.min.z <= receivers.max.z;
+}
+
+// the part of the cascade that's actually sampled this frame: its view frustum slice, which finer cascades don't cover
+static ClipBounds receiver_bounds(const CascadedShadowRenderPass::CascadeInfo& cascade, u32 resolution) {
+	ClipBounds bounds = clip_bounds(cascade.view_proj_mat, cascade.slice_corners);
+	const f32 margin = RECEIVER_MARGIN_TEXELS * 2.f / static_cast<f32>(resolution);
+	bounds.min = glm::max(bounds.min - glm::vec3{margin, margin, 0.f}, CASCADE_BOX.min);
+	bounds.max = glm::min(bounds.max + glm::vec3{margin, margin, 0.f}, CASCADE_BOX.max);
+	return bounds;
+}
+
+CascadedShadowRenderPass::CascadedShadowRenderPass()
+	: cascade_split_lambda{0.95f}, sample_distribution{true}, fit_to_receivers{false}, instanced_cascades{true}, cascade_resolutions{4096, 4096, 4096, 4096},
+	  depth_format{ShadowAtlas::DepthFormat::D32}, always_updated_cascades{2}, cached_cascade_interval{0}, cached_cascade_move_threshold{8.f},
+	  m_clip_distance{false}, m_initialized{false}, m_static_initialized{false}, m_cached{}, m_static_stale{}, m_layer_work{}, m_had_dynamic{false}, m_stats{} {
 }
 
 void CascadedShadowRenderPass::debug(vuk::CommandBuffer& cbuf, u8 cascade) {
 	cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
 		.set_scissor(0, vuk::Rect2D::framebuffer())
 		.set_primitive_topology(vuk::PrimitiveTopology::eTriangleList)
-		.bind_graphics_pipeline("debug")
-		.bind_sampled_image(0, 0, m_shadow_map, {})
+		.bind_graphics_pipeline("debug_shadow_map")
+		.bind_sampled_image(0, 0, m_atlas.view(), {})
+		.push_constants(vuk::ShaderStageFlagBits::eVertex, 0, m_atlas.uv_rect(cascade))
 		.draw(3, 1, 0, 0);
 }
 
@@ -27,193 +139,397 @@ void CascadedShadowRenderPass::init(vuk::PerThreadContext& ptc, struct Context&
 	depth_pipe.rasterization_state.depthClampEnable = VK_TRUE;
 	depth_pipe.rasterization_state.cullMode = vuk::CullModeFlagBits::eFront;
 	ps.add("depth_only", "depth_only.vert", "depth_only.frag", depth_pipe);
+	// clips each instance to its cascade's tile with gl_ClipDistance
+	m_clip_distance = ctxt.clip_distance;
+	if (m_clip_distance) {
+		ps.add("depth_only_tiled", "depth_only_tiled.vert", "depth_only.frag", depth_pipe);
+	} else if (instanced_cascades) {
+		spdlog::info("shadows: no shaderClipDistance, drawing the cascades one at a time");
+	}
 
 	ps.add("debug_shadow_map", "debug_shadow_map.vert", "debug_shadow_map.frag");
 
-	m_shadow_map = ctxt.vuk_context->allocate_texture(vuk::ImageCreateInfo{
-		.imageType = vuk::ImageType::e2D,
-		.format = vuk::Format::eD32Sfloat,
-		.extent = vuk::Extent3D{CascadedShadowRenderPass::DIMENSION, CascadedShadowRenderPass::DIMENSION, 1},
-		.mipLevels = 1,
-		.arrayLayers = CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT,
-		.samples = vuk::SampleCountFlagBits::e1,
-		.tiling = vuk::ImageTiling::eOptimal,
-		.usage = vuk::ImageUsageFlagBits::eSampled | vuk::ImageUsageFlagBits::eDepthStencilAttachment,
-		.sharingMode = vuk::SharingMode::eExclusive,
-	});
+	// clear whole tiles to the far plane, or copy static tiles into them
+	vuk::PipelineBaseCreateInfo tile_pipe;
+	tile_pipe.depth_stencil_state.depthCompareOp = vuk::CompareOp::eAlways;
+	tile_pipe.rasterization_state.cullMode = vuk::CullModeFlagBits::eNone;
+	ps.add("shadow_tile_clear", "shadow_tile.vert", "depth_only.frag", tile_pipe);
+	ps.add("shadow_tile_restore", "shadow_tile.vert", "shadow_tile_restore.frag", tile_pipe);
 
-	m_shadow_map_view = ptc.create_image_view(vuk::ImageViewCreateInfo{
-		.image = *m_shadow_map.image,
-		.viewType = vuk::ImageViewType::e2DArray,
-		.format = vuk::Format::eD32Sfloat,
-		.subresourceRange =
-			vuk::ImageSubresourceRange{
-				.aspectMask = vuk::ImageAspectFlagBits::eDepth,
-				.baseMipLevel = 0,
-				.levelCount = 1,
-				.baseArrayLayer = 0,
-				.layerCount = CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT,
-			},
-	});
+	always_updated_cascades = std::min(always_updated_cascades, SHADOW_MAP_CASCADE_COUNT);
+	allocate_atlases(ptc, ctxt);
+}
 
-	for (u8 i = 0; i < SHADOW_MAP_CASCADE_COUNT; ++i) {
-		std::string name = "depth_map_layer_";
-		name = name.append(std::to_string(i));
-		m_attachment_names.push_back(name);
-
-		m_image_views.push_back(ptc.create_image_view(vuk::ImageViewCreateInfo{
-			.image = *m_shadow_map.image,
-			.viewType = vuk::ImageViewType::e2DArray,
-			.format = vuk::Format::eD32Sfloat,
-			.subresourceRange =
-				vuk::ImageSubresourceRange{
-					.aspectMask = vuk::ImageAspectFlagBits::eDepth,
-					.baseMipLevel = 0,
-					.levelCount = 1,
-					.baseArrayLayer = static_cast<u32>(i),
-					.layerCount = 1,
-				},
-		}));
+void CascadedShadowRenderPass::allocate_atlases(vuk::PerThreadContext& ptc, Context& ctxt) {
+	if (!m_atlas.allocate(ptc, ctxt, cascade_resolutions, depth_format)) {
+		// keep using the current atlas (if there is one)
+		if (m_atlas.tile_count() == SHADOW_MAP_CASCADE_COUNT) {
+			for (u8 i = 0; i < SHADOW_MAP_CASCADE_COUNT; ++i) {
+				cascade_resolutions[i] = m_atlas.tile(i).size;
+			}
+			depth_format = m_atlas.format();
+		}
+		return;
+	}
+
+	// same sizes as the cascades' own tiles, so restoring one is a texel for texel copy
+	m_static_atlas.allocate(ptc, ctxt, std::span<const u32>{cascade_resolutions}.subspan(always_updated_cascades), depth_format);
+
+	m_initialized = false;
+	m_static_initialized = false;
+	for (auto& cached : m_cached) {
+		cached.valid = false;
 	}
 }
 
 void CascadedShadowRenderPass::prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) {
+	TRACE_ZONE("CascadedShadowRenderPass::prep");
+
+	// the previous frame has been executed by now
+	log_stats();
+	m_stats = {};
+
+	if (!m_atlas.matches(cascade_resolutions, depth_format)) {
+		allocate_atlases(ptc, ctxt);
+	}
+
+	if (m_atlas.tile_count() != SHADOW_MAP_CASCADE_COUNT) {
+		return;
+	}
+
+	const auto fitted = compute_cascades(info);
+
+	for (u8 i = 0; i < SHADOW_MAP_CASCADE_COUNT; ++i) {
+		if (!is_cached(i)) {
+			info.cascades[i] = fitted[i];
+			continue;
+		}
+
+		auto& cached = m_cached[i];
+
+		// the camera moved far enough that the margin the cascade was fitted with might not cover the view anymore
+		const f32 texel_size = 2.f * fitted[i].radius / static_cast<f32>(m_atlas.tile(i).size);
+		const f32 moved_texels = std::floor(glm::length(fitted[i].center - cached.info.center) / texel_size);
+
+		const bool stale = !cached.valid || info.static_geometry_dirty || cached.light_direction != info.light_direction ||
+						   cached.info.radius != fitted[i].radius || moved_texels > cached_cascade_move_threshold ||
+						   (cached_cascade_interval != 0 && cached.age >= cached_cascade_interval);
+
+		if (stale) {
+			cached = CachedCascade{.info = fitted[i], .light_direction = info.light_direction, .age = 0, .valid = true};
+		} else {
+			++cached.age;
+		}
+
+		m_static_stale[i] = stale;
+		info.cascades[i] = cached.info;
+		// the receivers are wherever the camera is now, not where it was when the cascade was fitted
+		info.cascades[i].slice_corners = fitted[i].slice_corners;
+	}
+
+	for (u8 i = 0; i < SHADOW_MAP_CASCADE_COUNT; ++i) {
+		m_stats.texel_density[i] = info.cascades[i].texel_density;
+		m_stats.utilization[i] = info.cascades[i].utilization;
+	}
+
+	m_stats.memory_bytes = m_atlas.memory_bytes() + m_static_atlas.memory_bytes();
 }
 
 void CascadedShadowRenderPass::render(
 	vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::RenderGraph& rg, const class SceneRenderer& renderer, struct RenderInfo& info) {
-	const auto cascades = compute_cascades(info);
-	std::vector<glm::mat4> cascade_mats;
-	cascade_mats.reserve(cascades.size());
-	for (auto m : cascades) {
-		cascade_mats.push_back(m.view_proj_mat);
+	TRACE_ZONE("CascadedShadowRenderPass::render");
+
+	if (m_atlas.tile_count() != SHADOW_MAP_CASCADE_COUNT) {
+		return;
+	}
+
+	CascadeUniforms uniforms;
+	for (u8 i = 0; i < SHADOW_MAP_CASCADE_COUNT; ++i) {
+		uniforms.light_space_mats[i] = info.cascades[i].view_proj_mat;
+
+		// the cascade's [-1, 1] clip space is scaled down to the tile and moved to its center
+		const glm::vec4 rect = m_atlas.uv_rect(i);
+		const glm::vec2 scale{rect.z, rect.w};
+		const glm::vec2 center = (glm::vec2{rect.x, rect.y} + scale * 0.5f) * 2.f - 1.f;
+		uniforms.tile_transforms[i] = glm::vec4{scale, center};
 	}
 
-	auto [bubo, stub] = ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eUniformBuffer, std::span{cascade_mats});
+	auto [bubo, stub] = ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eUniformBuffer, std::span{&uniforms, 1});
 	auto ubo = bubo;
 
-	ptc.wait_all_transfers();
+	TRACE_CALL("wait_all_transfers", ptc.wait_all_transfers());
+
+	// a cascade that lost its dynamic casters still needs one more restore to get rid of their shadows
+	const bool has_dynamic = renderer.has_dynamic_objects();
+	const bool restore_dynamic = has_dynamic || m_had_dynamic;
+	m_had_dynamic = has_dynamic;
 
 	for (u8 i = 0; i < SHADOW_MAP_CASCADE_COUNT; ++i) {
-		const vuk::Resource layer_resource{m_attachment_names[i], vuk::Resource::Type::eImage, vuk::eDepthStencilRW};
-
-		rg.add_pass(vuk::Pass{
-			.resources = {layer_resource},
-			.execute =
-				[=](vuk::CommandBuffer& cbuf) {
-					cbuf.set_viewport(0, vuk::Rect2D::absolute(0, 0, DIMENSION, DIMENSION))
-						.set_scissor(0, vuk::Rect2D::absolute(0, 0, DIMENSION, DIMENSION))
-						.set_primitive_topology(vuk::PrimitiveTopology::eTriangleList)
-						.bind_graphics_pipeline("depth_only")
-						.bind_uniform_buffer(0, 0, ubo)
-						.push_constants(vuk::ShaderStageFlagBits::eVertex, 0, static_cast<u32>(i));
-
-					renderer.render(cbuf, [&](const MeshComponent& mesh, const vuk::Buffer& transform) {
-						cbuf.bind_uniform_buffer(1, 0, transform);
-						return vuk::Packed{vuk::Format::eR32G32B32Sfloat, vuk::Format::eR32G32B32Sfloat, vuk::Ignore{vuk::Format::eR32G32Sfloat}};
-					});
-				},
-		});
+		if (!is_cached(i)) {
+			m_layer_work[i] = LayerWork::Redraw;
+		} else if (m_static_stale[i] || restore_dynamic) {
+			m_layer_work[i] = LayerWork::Restore;
+		} else {
+			// nothing changed in this cascade; its tile still holds last frame's contents
+			m_layer_work[i] = LayerWork::None;
+		}
+	}
 
-		rg.attach_image(m_attachment_names[i],
-			vuk::ImageAttachment{
-				.image = *m_shadow_map.image,
-				.image_view = *m_image_views[i],
-				.extent = vuk::Extent2D{DIMENSION, DIMENSION},
-				.format = vuk::Format::eD32Sfloat,
-				.sample_count = vuk::Samples::e1,
-				.clear_value = vuk::ClearDepthStencil{1.f, 0},
-			},
-			vuk::Access::eClear, vuk::Access::eFragmentSampled);
+	if (!m_clip_distance) {
+		instanced_cascades = false;
 	}
+	m_stats.instanced = instanced_cascades;
+
+	render_static_tiles(rg, renderer, info, ubo);
+	render_atlas(rg, renderer, info, ubo);
+
+	m_initialized = true;
 }
 
-vuk::ImageView CascadedShadowRenderPass::shadow_map_view() const {
-	return *m_shadow_map_view;
+void CascadedShadowRenderPass::render_static_tiles(vuk::RenderGraph& rg, const SceneRenderer& renderer, const RenderInfo& info, vuk::Buffer ubo) {
+	TileQuads clears{};
+	std::vector<u8> stale;
+
+	for (u8 i = 0; i < SHADOW_MAP_CASCADE_COUNT; ++i) {
+		if (!is_cached(i) || !m_static_stale[i]) {
+			continue;
+		}
+
+		const u32 size = m_static_atlas.tile(static_tile(i)).size;
+		clears.target_rects[stale.size()] = tile_clip_rect(m_static_atlas, static_tile(i));
+		stale.push_back(i);
+		m_stats.texels_written += static_cast<u64>(size) * size;
+	}
+
+	if (stale.empty()) {
+		return;
+	}
+
+	// the static tile is reused while the camera moves around inside the cascade, so it can only be culled against the whole cascade
+	const auto& objects = renderer.objects();
+	std::vector<u32> masks(objects.size(), 0);
+	for (const u8 i : stale) {
+		for (u64 j = 0; j < objects.size(); ++j) {
+			if (objects[j].is_static && can_shadow(clip_bounds(info.cascades[i].view_proj_mat, objects[j]), CASCADE_BOX)) {
+				masks[j] |= 1u << i;
+				++m_stats.static_casters[i];
+			}
+		}
+	}
+
+	info.profiler->add_pass(rg, "shadow cache", vuk::Pass{
+		.resources = {vuk::Resource{STATIC_ATLAS_ATTACHMENT_NAME, vuk::Resource::Type::eImage, vuk::eDepthStencilRW}},
+		.execute =
+			[=, this, &renderer, masks = std::move(masks)](vuk::CommandBuffer& cbuf) {
+				RecordTimer timer{m_stats.record_ms};
+
+				cbuf.set_viewport(0, whole_atlas(m_static_atlas))
+					.set_scissor(0, whole_atlas(m_static_atlas))
+					.set_primitive_topology(vuk::PrimitiveTopology::eTriangleList)
+					.bind_graphics_pipeline("shadow_tile_clear")
+					.push_constants(vuk::ShaderStageFlagBits::eVertex, 0, clears)
+					.draw(6, static_cast<u32>(stale.size()), 0, 0);
+
+				for (const u8 i : stale) {
+					bind_depth_only(cbuf, ubo, i, m_static_atlas.rect(static_tile(i)));
+					m_stats.draw_calls += renderer.render(cbuf, caster_binder(cbuf), [&masks, i](u64 index, const SceneRenderer::RenderObject&) {
+						return (masks[index] & (1u << i)) != 0;
+					});
+				}
+			},
+	});
+
+	rg.attach_image(STATIC_ATLAS_ATTACHMENT_NAME, m_static_atlas.attachment(),
+		// tiles that aren't stale have to keep their contents
+		m_static_initialized ? vuk::Access::eFragmentSampled : vuk::Access::eNone, vuk::Access::eFragmentSampled);
+	m_static_initialized = true;
+	m_stats.static_tiles_rendered = static_cast<u8>(stale.size());
 }
 
-// https://github.com/SaschaWillems/Vulkan/blob/master/examples/shadowmappingcascade/shadowmappingcascade.cpp
-std::array<CascadedShadowRenderPass::CascadeInfo, CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT> CascadedShadowRenderPass::compute_cascades(
-	const RenderInfo& info) {
-	std::array<CascadeInfo, SHADOW_MAP_CASCADE_COUNT> cascades;
-
-	f32 cascade_splits[SHADOW_MAP_CASCADE_COUNT];
-
-	f32 near_clip = info.cam_proj.near;
-	f32 far_clip = info.cam_proj.far;
-	f32 clip_range = far_clip - near_clip;
-
-	f32 min_z = near_clip;
-	f32 max_z = near_clip + clip_range;
-
-	f32 range = max_z - min_z;
-	f32 ratio = max_z / min_z;
-
-	// Calculate split depths based on view camera frustum
-	// Based on method presented in https://developer.nvidia.com/gpugems/GPUGems3/gpugems3_ch10.html
-	for (u8 i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
-		f32 p = (i + 1) / static_cast<f32>(SHADOW_MAP_CASCADE_COUNT);
-		f32 log = min_z * std::pow(ratio, p);
-		f32 uniform = min_z + range * p;
-		f32 d = cascade_split_lambda * (log - uniform) + uniform;
-		cascade_splits[i] = (d - near_clip) / clip_range;
-	}
-
-	// Calculate orthographic projection matrix for each cascade
-	f32 last_split_dist = 0.0;
-	for (u8 i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
-		f32 split_dist = cascade_splits[i];
-
-		glm::vec3 frustum_corners[8] = {
-			glm::vec3(-1.0f, 1.0f, -1.0f),
-			glm::vec3(1.0f, 1.0f, -1.0f),
-			glm::vec3(1.0f, -1.0f, -1.0f),
-			glm::vec3(-1.0f, -1.0f, -1.0f),
-			glm::vec3(-1.0f, 1.0f, 1.0f),
-			glm::vec3(1.0f, 1.0f, 1.0f),
-			glm::vec3(1.0f, -1.0f, 1.0f),
-			glm::vec3(-1.0f, -1.0f, 1.0f),
-		};
-
-		// Project frustum corners into world space
-		glm::mat4 inv_cam = glm::inverse(info.cam_proj.matrix() * info.cam_view);
-		for (u8 i = 0; i < 8; i++) {
-			glm::vec4 inv_corner = inv_cam * glm::vec4(frustum_corners[i], 1.0f);
-			frustum_corners[i] = inv_corner / inv_corner.w;
+void CascadedShadowRenderPass::render_atlas(vuk::RenderGraph& rg, const SceneRenderer& renderer, const RenderInfo& info, vuk::Buffer ubo) {
+	// redrawn cascades are cleared, restored cascades get their static tile copied in
+	TileQuads clears{};
+	TileQuads restores{};
+	u32 clear_count = 0;
+	u32 restore_count = 0;
+	bool reads_static = false;
+
+	for (u8 i = 0; i < SHADOW_MAP_CASCADE_COUNT; ++i) {
+		if (m_layer_work[i] == LayerWork::None) {
+			continue;
 		}
 
-		for (u8 i = 0; i < 4; i++) {
-			glm::vec3 dist = frustum_corners[i + 4] - frustum_corners[i];
-			frustum_corners[i + 4] = frustum_corners[i] + (dist * split_dist);
-			frustum_corners[i] = frustum_corners[i] + (dist * last_split_dist);
+		const auto& tile = m_atlas.tile(i);
+		m_stats.texels_written += static_cast<u64>(tile.size) * tile.size;
+
+		if (m_layer_work[i] == LayerWork::Redraw) {
+			clears.target_rects[clear_count++] = tile_clip_rect(m_atlas, i);
+		} else {
+			const auto& source = m_static_atlas.tile(static_tile(i));
+			restores.target_rects[restore_count] = tile_clip_rect(m_atlas, i);
+			restores.source_offsets[restore_count++] =
+				glm::ivec2{static_cast<i32>(source.x) - static_cast<i32>(tile.x), static_cast<i32>(source.y) - static_cast<i32>(tile.y)};
+			reads_static |= m_static_stale[i];
 		}
+	}
+
+	if (clear_count + restore_count == 0) {
+		return;
+	}
+
+	std::vector<vuk::Resource> resources{vuk::Resource{ATLAS_ATTACHMENT_NAME, vuk::Resource::Type::eImage, vuk::eDepthStencilRW}};
+	if (reads_static) {
+		// only tracked when it was written in this graph; otherwise it's already readable from an earlier frame
+		resources.push_back(vuk::Resource{STATIC_ATLAS_ATTACHMENT_NAME, vuk::Resource::Type::eImage, vuk::eFragmentSampled});
+	}
 
-		// Get frustum center
-		glm::vec3 frustum_center = glm::vec3(0.0f);
-		for (u8 i = 0; i < 8; i++) {
-			frustum_center += frustum_corners[i];
+	// which cascades each object goes into this frame; bit i = cascade i
+	const auto& objects = renderer.objects();
+	std::vector<u32> masks(objects.size(), 0);
+	for (u8 i = 0; i < SHADOW_MAP_CASCADE_COUNT; ++i) {
+		if (m_layer_work[i] == LayerWork::None) {
+			continue;
 		}
-		frustum_center /= 8.0f;
 
-		f32 radius = 0.0f;
-		for (u8 i = 0; i < 8; i++) {
-			f32 distance = glm::length(frustum_corners[i] - frustum_center);
-			radius = glm::max(radius, distance);
+		const bool dynamic_only = m_layer_work[i] == LayerWork::Restore;
+		const ClipBounds receivers = receiver_bounds(info.cascades[i], m_atlas.tile(i).size);
+		for (u64 j = 0; j < objects.size(); ++j) {
+			if (dynamic_only && objects[j].is_static) {
+				continue;
+			}
+
+			const ClipBounds caster = clip_bounds(info.cascades[i].view_proj_mat, objects[j]);
+			if (!can_shadow(caster, CASCADE_BOX)) {
+				continue;
+			}
+
+			// inside the cascade, but its shadow only lands on receivers that a finer cascade covers (or that aren't visible at all)
+			if (!can_shadow(caster, receivers)) {
+				++m_stats.receiver_culled[i];
+				continue;
+			}
+
+			masks[j] |= 1u << i;
+			++m_stats.casters[i];
 		}
-		radius = std::ceil(radius * 16.0f) / 16.0f;
+	}
 
-		glm::vec3 max_extents = glm::vec3(radius);
-		glm::vec3 min_extents = -max_extents;
+	const bool instanced = instanced_cascades;
+	const auto layer_work = m_layer_work;
+
+	info.profiler->add_pass(rg, "shadows", vuk::Pass{
+		.resources = std::move(resources),
+		.execute =
+			[=, this, &renderer, masks = std::move(masks)](vuk::CommandBuffer& cbuf) {
+				RecordTimer timer{m_stats.record_ms};
+
+				cbuf.set_viewport(0, whole_atlas(m_atlas))
+					.set_scissor(0, whole_atlas(m_atlas))
+					.set_primitive_topology(vuk::PrimitiveTopology::eTriangleList);
+
+				if (clear_count != 0) {
+					cbuf.bind_graphics_pipeline("shadow_tile_clear").push_constants(vuk::ShaderStageFlagBits::eVertex, 0, clears).draw(6, clear_count, 0, 0);
+				}
+
+				if (restore_count != 0) {
+					cbuf.bind_graphics_pipeline("shadow_tile_restore")
+						.bind_sampled_image(0, 0, m_static_atlas.view(), {})
+						.push_constants(vuk::ShaderStageFlagBits::eVertex, 0, restores)
+						.draw(6, restore_count, 0, 0);
+				}
+
+				if (instanced) {
+					cbuf.bind_graphics_pipeline("depth_only_tiled").bind_uniform_buffer(0, 0, ubo);
+					m_stats.draw_calls += renderer.render_masked(cbuf, caster_binder(cbuf), masks);
+					return;
+				}
+
+				for (u8 i = 0; i < SHADOW_MAP_CASCADE_COUNT; ++i) {
+					if (layer_work[i] == LayerWork::None) {
+						continue;
+					}
+
+					bind_depth_only(cbuf, ubo, i, m_atlas.rect(i));
+					m_stats.draw_calls += renderer.render(cbuf, caster_binder(cbuf), [&masks, i](u64 index, const SceneRenderer::RenderObject&) {
+						return (masks[index] & (1u << i)) != 0;
+					});
+				}
+			},
+	});
 
-		glm::mat4 light_view_matrix = glm::lookAt(frustum_center - info.light_direction * -min_extents.z, frustum_center, glm::vec3(0.0f, 1.0f, 0.0f));
-		glm::mat4 light_ortho_matrix = glm::ortho(min_extents.x, max_extents.x, min_extents.y, max_extents.y, 0.0f, max_extents.z - min_extents.z);
+	rg.attach_image(ATLAS_ATTACHMENT_NAME, m_atlas.attachment(),
+		// tiles that have nothing to do this frame have to keep their contents
+		m_initialized ? vuk::Access::eFragmentSampled : vuk::Access::eNone, vuk::Access::eFragmentSampled);
+	m_stats.cascades_rendered += clear_count + restore_count;
+}
+
+const CascadedShadowRenderPass::Stats& CascadedShadowRenderPass::stats() const {
+	return m_stats;
+}
 
-		// Store split distance and matrix in cascade
-		cascades[i].split_depth = (info.cam_proj.near + split_dist * clip_range) * -1.0f;
-		cascades[i].view_proj_mat = light_ortho_matrix * light_view_matrix;
+bool CascadedShadowRenderPass::is_cached(u8 cascade) const {
+	return cascade >= always_updated_cascades;
+}
 
-		last_split_dist = cascade_splits[i];
+u32 CascadedShadowRenderPass::static_tile(u8 cascade) const {
+	return cascade - always_updated_cascades;
+}
+
+void CascadedShadowRenderPass::log_stats() const {
+	std::string per_cascade;
+	std::string fit;
+	for (u8 i = 0; i < SHADOW_MAP_CASCADE_COUNT; ++i) {
+		per_cascade += fmt::format("{}{} (-{} receiver culled, {} static)", i == 0 ? "" : ", ", m_stats.casters[i], m_stats.receiver_culled[i],
+			m_stats.static_casters[i]);
+		fit += fmt::format("{}{:.1f} texels/m ({:.0f}% used)", i == 0 ? "" : ", ", m_stats.texel_density[i], m_stats.utilization[i] * 100.f);
 	}
 
+	spdlog::debug("shadows ({}): {} draw calls, {:.3f} ms recording, {}/{} cascades rendered, {} static tiles re-rendered",
+		m_stats.instanced ? "instanced" : "per cascade", m_stats.draw_calls, m_stats.record_ms, m_stats.cascades_rendered, SHADOW_MAP_CASCADE_COUNT,
+		m_stats.static_tiles_rendered);
+	spdlog::debug("shadow casters: {}", per_cascade);
+	spdlog::debug("shadow cascades: {}", fit);
+	spdlog::debug("shadow atlases: {:.1f} MB, {:.2f} Mtexels cleared or restored", m_stats.memory_bytes / (1024.f * 1024.f),
+		m_stats.texels_written / 1e6f);
+}
+
+std::array<CascadedShadowRenderPass::CascadeInfo, CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT> CascadedShadowRenderPass::compute_cascades(
+	const RenderInfo& info) {
+	// the atlas' actual tiles, which cascade_resolutions only matches once it's been applied
+	std::array<u32, SHADOW_MAP_CASCADE_COUNT> resolutions;
+	for (u8 i = 0; i < SHADOW_MAP_CASCADE_COUNT; ++i) {
+		resolutions[i] = m_atlas.tile(i).size;
+	}
+
+	std::vector<cascade_fit::Box> receivers;
+	if (fit_to_receivers) {
+		receivers.reserve(info.objects.size());
+		for (const auto& object : info.objects) {
+			receivers.push_back(cascade_fit::Box{.min = object.min, .max = object.max});
+		}
+	}
+
+	auto cascades = cascade_fit::fit(
+		cascade_fit::View{
+			.cam_proj = info.cam_proj,
+			.cam_view = info.cam_view,
+			.light_direction = info.light_direction,
+			.scene_min = info.scene_min,
+			.scene_max = info.scene_max,
+			.depth_bounds = info.depth_bounds,
+			.receivers = receivers,
+		},
+		cascade_fit::Settings{
+			.split_lambda = cascade_split_lambda,
+			.sample_distribution = sample_distribution,
+			.fit_to_receivers = fit_to_receivers,
+			.resolutions = resolutions,
+			.first_cached = always_updated_cascades,
+			.cached_move_threshold = cached_cascade_move_threshold,
+		});
+
+	for (u8 i = 0; i < SHADOW_MAP_CASCADE_COUNT; ++i) {
+		cascades[i].atlas_rect = m_atlas.uv_rect(i);
+	}
 	return cascades;
 }
@@ -2,7 +2,9 @@
 
 #include "../Types.hpp"
 #include "../Perspective.hpp"
+#include "../CascadeFit.hpp"
 #include "GraphicsPass.hpp"
+#include "ShadowAtlas.hpp"
 
 #include <vuk/RenderGraph.hpp>
 #include <glm/mat4x4.hpp>
@@ -12,16 +14,61 @@
 	Cascaded shadows are a simple spin on regular shadow mapping:
 	Split the shadow map into N z-slices. At each slice, render a closer shadow map (i.e. higher quality).
 	This reduces the aliasing that comes with regular shadow maps.
+
+	Every cascade is a tile of one ShadowAtlas, with its own resolution (cascade_resolutions), so the far cascades don't have to pay for the
+	near cascade's resolution. Both the resolutions and the depth format can be changed at runtime, which re-allocates the atlas.
+
+	The cascades are fitted by cascade_fit::fit (see CascadeFit.hpp): split within the visible depth range, fitted to the bounding sphere of
+	their slice, snapped to whole texels, with the depth range taken from the scene bounds.
+
+	Far cascades cover a lot of world for very little screen space, so re-rendering them every frame is mostly wasted work.
+	Cascades [0, always_updated_cascades) are rendered every frame as usual. The others keep their static casters in a tile of a second
+	(static) atlas, which is only re-rendered when it goes stale: a static caster moved, the light changed, the camera drifted further than
+	cached_cascade_move_threshold texels from where the cascade was fitted, or (optionally) every cached_cascade_interval frames.
+	Every frame the static tile is copied back into the cascade and the dynamic casters are drawn on top (skipped if there are none).
+	Cached cascades are fitted with a margin of cached_cascade_move_threshold texels so they still cover the view until they are re-fitted.
+
+	All the per-frame work is one render pass over the atlas. Tiles are cleared (or restored) by drawing quads over them, so tiles with nothing
+	to do keep their contents. With instanced_cascades, each object is culled against every cascade on the CPU and drawn once per run of
+	consecutive cascades it lands in, with one instance per cascade; the vertex shader moves each instance into its tile and clips it to the
+	tile's edges. Otherwise every cascade gets its own draws, with the viewport set to its tile.
+
+	Casters are culled per cascade, against the cascade's box swept towards the light (so casters between it and the light still count),
+	and against the receivers it actually serves this frame: the view frustum slice, which excludes everything the finer cascades cover.
+	A caster whose shadow only lands on a finer cascade's receivers is skipped. Static tiles outlive the slice, so they only use the box.
 */
 
 class CascadedShadowRenderPass : public GraphicsPass {
   public:
-	static constexpr u8 SHADOW_MAP_CASCADE_COUNT = 4;
-	static constexpr u32 DIMENSION = 4096;
+	static constexpr u8 SHADOW_MAP_CASCADE_COUNT = cascade_fit::CASCADE_COUNT;
+
+	using CascadeInfo = cascade_fit::Cascade;
 
-	struct CascadeInfo {
-		f32 split_depth;
-		glm::mat4 view_proj_mat;
+	// the atlas' render graph attachment. Passes that sample it declare it as a resource and bind it by this name, so the render graph
+	// orders them after this frame's shadow pass and transitions the atlas for the stage that reads it
+	static constexpr const char* ATLAS_ATTACHMENT_NAME = "shadow_atlas";
+
+	struct Stats {
+		// casters rendered into each cascade's tile this frame
+		std::array<u32, SHADOW_MAP_CASCADE_COUNT> casters;
+		// casters inside a cascade whose shadows can't reach its receivers
+		std::array<u32, SHADOW_MAP_CASCADE_COUNT> receiver_culled;
+		// casters rendered into each cascade's static tile (when it was stale)
+		std::array<u32, SHADOW_MAP_CASCADE_COUNT> static_casters;
+		// with instanced_cascades one draw covers several cascades
+		u32 draw_calls;
+		// CPU time spent recording the shadow passes
+		f32 record_ms;
+		// see CascadeInfo
+		std::array<f32, SHADOW_MAP_CASCADE_COUNT> texel_density;
+		std::array<f32, SHADOW_MAP_CASCADE_COUNT> utilization;
+		u8 cascades_rendered;
+		u8 static_tiles_rendered;
+		bool instanced;
+		// both atlases
+		u64 memory_bytes;
+		// texels of all the tiles that were cleared or restored, i.e. the minimum fill for the frame (casters come on top of that)
+		u64 texels_written;
 	};
 
 	CascadedShadowRenderPass();
@@ -32,15 +79,71 @@ class CascadedShadowRenderPass : public GraphicsPass {
 	void prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) override;
 	void render(vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::RenderGraph& rg, const class SceneRenderer& renderer, struct RenderInfo& info) override;
 
+	// cascade_fit::fit with this pass' settings and atlas tiles
 	std::array<CascadeInfo, SHADOW_MAP_CASCADE_COUNT> compute_cascades(const struct RenderInfo& info);
-	vuk::ImageView shadow_map_view() const;
+	// only complete once the frame that recorded them has been submitted
+	const Stats& stats() const;
 
 	f32 cascade_split_lambda;
+	// place the splits within the visible depth range (RenderInfo::depth_bounds) instead of the whole camera clip range
+	bool sample_distribution;
+	// shrink each cascade to the visible receivers inside it. Higher density, but the window changes size as things move in and out of view,
+	// which makes the edges shimmer a little
+	bool fit_to_receivers;
+	// draw each caster once for all the cascades it lands in (with per-cascade culling), rather than once per cascade. Needs shaderClipDistance;
+	// reverted on devices that don't have it
+	bool instanced_cascades;
+
+	// applied (i.e. the atlases re-allocated) in the next prep(); a set of resolutions that doesn't fit into one image is reverted.
+	// 4096² and D32 by default, which pbr_lighting.glsl's constant depth bias is tuned for: smaller tiles have larger texels, which need a
+	// larger bias on slopes. D16 and smaller tiles are opt-in
+	std::array<u32, SHADOW_MAP_CASCADE_COUNT> cascade_resolutions;
+	ShadowAtlas::DepthFormat depth_format;
+
+	// must be set before init(); the static tiles are only allocated for the other cascades
+	u8 always_updated_cascades;
+	// in frames; 0 means cached cascades are only re-rendered when they're invalidated
+	u32 cached_cascade_interval;
+	// in shadow map texels of the cascade
+	f32 cached_cascade_move_threshold;
 
   private:
-	std::vector<std::string> m_attachment_names;
-	std::vector<vuk::Unique<vuk::ImageView>> m_image_views;
+	struct CachedCascade {
+		CascadeInfo info;
+		glm::vec3 light_direction;
+		u32 age;
+		bool valid;
+	};
+
+	enum class LayerWork {
+		None,
+		// cleared and all casters drawn
+		Redraw,
+		// static tile copied in and dynamic casters drawn
+		Restore,
+	};
+
+	void allocate_atlases(vuk::PerThreadContext& ptc, struct Context& ctxt);
+
+	void render_static_tiles(vuk::RenderGraph& rg, const class SceneRenderer& renderer, const struct RenderInfo& info, vuk::Buffer ubo);
+	void render_atlas(vuk::RenderGraph& rg, const class SceneRenderer& renderer, const struct RenderInfo& info, vuk::Buffer ubo);
+
+	bool is_cached(u8 cascade) const;
+	u32 static_tile(u8 cascade) const;
+	void log_stats() const;
+
+	// Context::clip_distance
+	bool m_clip_distance;
+	ShadowAtlas m_atlas;
+	// one tile per cached cascade, i.e. tile (i - always_updated_cascades) belongs to cascade i
+	ShadowAtlas m_static_atlas;
+	// every tile has been written at least once since the atlases were allocated
+	bool m_initialized;
+	bool m_static_initialized;
 
-	vuk::Texture m_shadow_map;
-	vuk::Unique<vuk::ImageView> m_shadow_map_view;
+	std::array<CachedCascade, SHADOW_MAP_CASCADE_COUNT> m_cached;
+	std::array<bool, SHADOW_MAP_CASCADE_COUNT> m_static_stale;
+	std::array<LayerWork, SHADOW_MAP_CASCADE_COUNT> m_layer_work;
+	bool m_had_dynamic;
+	Stats m_stats;
 };
@@ -0,0 +1,93 @@
+#include "ClusteredLights.hpp"
+
+#include "../Context.hpp"
+#include "../Renderer.hpp"
+#include "../CpuTrace.hpp"
+
+#include <vuk/RenderGraph.hpp>
+#include <glm/vec4.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <vector>
+
+// keep in sync with pbr_lighting.glsl
+struct PackedLight {
+	// xyz = world space position, w = radius
+	glm::vec4 position_radius;
+	// rgb = color * intensity
+	glm::vec4 color;
+	// xyz = world space direction of a spot light
+	glm::vec4 direction;
+	// x = scale, y = offset of the spot cone falloff: clamp(dot(direction, -L) * scale + offset, 0, 1); a point light is (0, 1)
+	glm::vec4 spot;
+};
+
+struct GridUniforms {
+	// xy = clusters per pixel, z = slice scale, w = slice bias (see LightClusters::slice_scale)
+	glm::vec4 grid_scale;
+	glm::uvec4 grid_size;
+};
+
+void ClusteredLightPass::init(vuk::PerThreadContext& ptc, struct Context& ctxt, struct UniformStore& uniforms, PipelineStore& ps) {
+}
+
+void ClusteredLightPass::prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) {
+	TRACE_ZONE("ClusteredLightPass::prep");
+
+	m_clusters.build(info.cam_proj, info.cam_view, info.lights);
+
+	std::vector<PackedLight> lights;
+	lights.reserve(std::max<size_t>(info.lights.size(), 1));
+	for (const auto& light : info.lights) {
+		const f32 spot_scale = light.spot ? 1.f / std::max(light.cos_inner - light.cos_outer, 1e-4f) : 0.f;
+		const f32 spot_offset = light.spot ? -light.cos_outer * spot_scale : 1.f;
+
+		lights.push_back(PackedLight{
+			.position_radius = glm::vec4{light.position, light.radius},
+			.color = glm::vec4{light.color * light.intensity, 0.f},
+			.direction = glm::vec4{light.direction, 0.f},
+			.spot = glm::vec4{spot_scale, spot_offset, 0.f, 0.f},
+		});
+	}
+
+	// storage buffers can't be empty
+	if (lights.empty()) {
+		lights.push_back(PackedLight{});
+	}
+	std::vector<u32> indices{m_clusters.indices().begin(), m_clusters.indices().end()};
+	if (indices.empty()) {
+		indices.push_back(0);
+	}
+
+	const GridUniforms grid{
+		.grid_scale = glm::vec4{static_cast<f32>(LightClusters::GRID_X) / info.window_width, static_cast<f32>(LightClusters::GRID_Y) / info.window_height,
+			m_clusters.slice_scale(), m_clusters.slice_bias()},
+		.grid_size = glm::uvec4{LightClusters::GRID_X, LightClusters::GRID_Y, LightClusters::GRID_Z, 0},
+	};
+
+	auto [bgrid, gridstub] = ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eUniformBuffer, std::span{&grid, 1});
+	auto [blights, lightsstub] = ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eStorageBuffer, std::span{lights});
+	auto [branges, rangesstub] =
+		ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eStorageBuffer, m_clusters.ranges());
+	auto [bindices, indicesstub] = ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eStorageBuffer, std::span{indices});
+	m_grid_ubo = bgrid;
+	m_lights = blights;
+	m_ranges = branges;
+	m_indices = bindices;
+
+	TRACE_CALL("wait_all_transfers", ptc.wait_all_transfers());
+
+	spdlog::debug("clustered lights: {} lights, {} indices ({} clusters overflowed)", info.lights.size(), m_clusters.indices().size(),
+		m_clusters.overflowed_clusters());
+}
+
+void ClusteredLightPass::render(
+	vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::RenderGraph& rg, const class SceneRenderer& renderer, struct RenderInfo& info) {
+}
+
+void ClusteredLightPass::bind(vuk::CommandBuffer& cbuf) const {
+	cbuf.bind_uniform_buffer(0, 7, m_grid_ubo)
+		.bind_storage_buffer(0, 8, m_lights)
+		.bind_storage_buffer(0, 9, m_ranges)
+		.bind_storage_buffer(0, 10, m_indices);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "GraphicsPass.hpp"
+#include "../Types.hpp"
+#include "../LightClusters.hpp"
+
+#include <vuk/Buffer.hpp>
+#include <vuk/CommandBuffer.hpp>
+
+/*
+	Uploads the scene's point and spot lights along with their cluster assignment (see LightClusters), so the color pass only loops over the
+	lights that can reach each pixel.
+
+	The assignment is done in prep, on the CPU; there is nothing to render. The buffers are per-frame scratch buffers, bound to set 0 of
+	pbr_lighting.glsl by bind().
+*/
+
+class ClusteredLightPass : public GraphicsPass {
+  public:
+	void init(vuk::PerThreadContext& ptc, struct Context& ctxt, struct UniformStore& uniforms, class PipelineStore& ps) override;
+	void prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) override;
+	void render(vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::RenderGraph& rg, const class SceneRenderer& renderer, struct RenderInfo& info) override;
+
+	// set 0, bindings 7 to 10
+	void bind(vuk::CommandBuffer& cbuf) const;
+
+  private:
+	LightClusters m_clusters;
+
+	vuk::Buffer m_grid_ubo;
+	vuk::Buffer m_lights;
+	vuk::Buffer m_ranges;
+	vuk::Buffer m_indices;
+};
@@ -0,0 +1,105 @@
+#include "DepthReduction.hpp"
+
+#include "../Context.hpp"
+#include "../Renderer.hpp"
+#include "../CpuTrace.hpp"
+
+#include <vuk/RenderGraph.hpp>
+#include <vuk/CommandBuffer.hpp>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+static constexpr u32 GROUP_SIZE = 16;
+
+void DepthReductionPass::init(vuk::PerThreadContext& ptc, struct Context& ctxt, struct UniformStore& uniforms, PipelineStore& ps) {
+	ps.add_compute("depth_reduce", "depth_reduce.comp");
+
+	for (auto& readback : m_readbacks) {
+		readback.buffer =
+			ctxt.vuk_context->allocate_buffer(vuk::MemoryUsage::eGPUtoCPU, vuk::BufferUsageFlagBits::eStorageBuffer, 2 * sizeof(u32), alignof(u32));
+		readback.clip_range.reset();
+	}
+
+	m_frame = 0;
+}
+
+void DepthReductionPass::prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) {
+	TRACE_ZONE("DepthReductionPass::prep");
+
+	m_width = info.window_width;
+	m_height = info.window_height;
+
+	// vuk::Context::begin() already waited for the frame that last used this slot
+	const auto& readback = m_readbacks[m_frame % vuk::Context::FC];
+	if (readback.clip_range) {
+		const auto* result = reinterpret_cast<const u32*>(readback.buffer.mapped_ptr);
+		const auto [near, far] = *readback.clip_range;
+
+		// non-linear depth (GLM_FORCE_DEPTH_ZERO_TO_ONE) to view space distance
+		const auto distance = [near, far](u32 depth_bits) {
+			const f32 depth = std::bit_cast<f32>(depth_bits);
+			return near * far / (far - depth * (far - near));
+		};
+
+		if (result[0] <= result[1]) {
+			m_bounds = glm::vec2{distance(result[0]), distance(result[1])};
+		} else {
+			m_bounds.reset();
+		}
+	}
+
+	info.depth_bounds = m_bounds;
+}
+
+void DepthReductionPass::render(
+	vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::RenderGraph& rg, const class SceneRenderer& renderer, struct RenderInfo& info) {
+	TRACE_ZONE("DepthReductionPass::render");
+
+	struct Uniforms {
+		glm::mat4 inv_view_proj;
+		glm::vec3 cam_pos;
+		// see AtmosphericSkyCubemap::skybox_model_matrix
+		f32 sky_half_extent;
+	} uniforms{glm::inverse(info.cam_proj.matrix() * info.cam_view), info.cam_pos, info.cam_proj.far / std::sqrt(3.f)};
+
+	auto [bubo, stub] = ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eUniformBuffer, std::span{&uniforms, 1});
+	auto ubo = bubo;
+
+	TRACE_CALL("wait_all_transfers", ptc.wait_all_transfers());
+
+	auto& readback = m_readbacks[m_frame % vuk::Context::FC];
+	++m_frame;
+
+	// positive floats order the same way as their bits, which is what the shader's atomics rely on
+	auto* result = reinterpret_cast<u32*>(readback.buffer.mapped_ptr);
+	result[0] = std::numeric_limits<u32>::max();
+	result[1] = 0;
+	readback.clip_range = std::make_pair(info.cam_proj.near, info.cam_proj.far);
+
+	const vuk::Buffer out = readback.buffer;
+	const glm::uvec2 size{m_width, m_height};
+
+	info.profiler->add_pass(rg, "depth reduction", vuk::Pass{
+		.resources = {"depth_prepass"_image(vuk::eComputeSampled)},
+		.execute =
+			[ubo, out, size](vuk::CommandBuffer& cbuf) {
+				cbuf.bind_compute_pipeline("depth_reduce")
+					.bind_sampled_image(0, 0, "depth_prepass", {})
+					.bind_uniform_buffer(0, 1, ubo)
+					.bind_storage_buffer(0, 2, out)
+					.push_constants(vuk::ShaderStageFlagBits::eCompute, 0, size)
+					.dispatch((size.x + GROUP_SIZE - 1) / GROUP_SIZE, (size.y + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+
+				// the buffer isn't tracked by the render graph, so make the result visible to the host read in a later frame
+				VkMemoryBarrier barrier{
+					.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER, .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT, .dstAccessMask = VK_ACCESS_HOST_READ_BIT};
+				vkCmdPipelineBarrier(
+					cbuf.command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+			},
+	});
+}
+
+std::optional<glm::vec2> DepthReductionPass::bounds() const {
+	return m_bounds;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "GraphicsPass.hpp"
+#include "../Types.hpp"
+
+#include <vuk/Buffer.hpp>
+#include <vuk/Context.hpp>
+#include <glm/vec2.hpp>
+#include <array>
+#include <optional>
+#include <utility>
+
+/*
+	Reduces depth_prepass (from GBufferPass) to the min/max view distance of everything on screen, for sample distribution shadow maps.
+
+	The reduction is a single compute dispatch: every workgroup reduces its tile in shared memory, then does one atomic min/max into a small
+	host-visible buffer. Reading that buffer back in the same frame would stall, so there is one buffer per frame in flight, and each one is read
+	right before it gets reused. The bounds are therefore vuk::Context::FC frames old, not one: vuk::Context::begin() only waits for the frame
+	that last used the slot, and reading last frame's buffer would mean waiting for that frame too, i.e. no more CPU/GPU overlap. Consumers
+	pad the bounds for that (cascade_fit::fit widens them by 10% and rounds them out to quarter octaves). If the visible range grows further
+	than that within FC frames, whatever is past the stale far bound samples the clamped edge of the last cascade until the bounds catch up.
+
+	Only the depth range is reduced, not the light space bounds of the visible points: those would be in the cascades' light space, which
+	depends on the splits computed from this result, and they would be FC frames old as well. CascadedShadowRenderPass::fit_to_receivers
+	tightens the cascades' windows from the visible receivers' bounds on the CPU instead, without the lag.
+
+	The sky is drawn into depth_prepass too (as a camera centered cube), so those texels are recognized and skipped.
+*/
+
+class DepthReductionPass : public GraphicsPass {
+  public:
+	void init(vuk::PerThreadContext& ptc, struct Context& ctxt, struct UniformStore& uniforms, class PipelineStore& ps) override;
+	void prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) override;
+	void render(vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::RenderGraph& rg, const class SceneRenderer& renderer, struct RenderInfo& info) override;
+
+	// view space distance of the closest/furthest visible point (excluding the sky); empty until the first read back, or if only sky is visible
+	std::optional<glm::vec2> bounds() const;
+
+  private:
+	struct Readback {
+		vuk::Buffer buffer;
+		// camera clip range of the frame that last wrote it (if any); needed to turn the depths back into distances
+		std::optional<std::pair<f32, f32>> clip_range;
+	};
+
+	u32 m_width, m_height;
+
+	std::array<Readback, vuk::Context::FC> m_readbacks;
+	u32 m_frame;
+
+	std::optional<glm::vec2> m_bounds;
+};
@@ -0,0 +1,182 @@
+#include "FroxelFog.hpp"
+
+#include "../Context.hpp"
+#include "../Renderer.hpp"
+#include "../CpuTrace.hpp"
+
+#include <vuk/Context.hpp>
+#include <glm/mat4x4.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cmath>
+
+static constexpr u32 GROUP_SIZE = 8;
+
+static constexpr vuk::Format VOLUME_FORMAT = vuk::Format::eR16G16B16A16Sfloat;
+
+FroxelFogPass::FroxelFogPass() : m_used{false}, m_near{0.f}, m_far{0.f}, m_camera_far{0.f} {
+}
+
+void FroxelFogPass::init(vuk::PerThreadContext& ptc, struct Context& ctxt, struct UniformStore& uniforms, PipelineStore& ps) {
+	ps.add_compute("froxel_inject", "froxel_inject.comp");
+	ps.add_compute("froxel_integrate", "froxel_integrate.comp");
+	// composite.vert is only used for its fullscreen triangle
+	ps.add("composite_froxel", "composite.vert", "composite_froxel.frag");
+
+	for (u32 i = 0; i < 2; ++i) {
+		m_volumes[i] = ctxt.vuk_context->allocate_texture(vuk::ImageCreateInfo{
+			.imageType = vuk::ImageType::e3D,
+			.format = VOLUME_FORMAT,
+			.extent = vuk::Extent3D{GRID_X, GRID_Y, GRID_Z},
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = vuk::SampleCountFlagBits::e1,
+			.tiling = vuk::ImageTiling::eOptimal,
+			.usage = vuk::ImageUsageFlagBits::eStorage | vuk::ImageUsageFlagBits::eSampled,
+			.sharingMode = vuk::SharingMode::eExclusive,
+		});
+
+		m_volume_views[i] = ptc.create_image_view(vuk::ImageViewCreateInfo{
+			.image = *m_volumes[i].image,
+			.viewType = vuk::ImageViewType::e3D,
+			.format = VOLUME_FORMAT,
+			.subresourceRange =
+				vuk::ImageSubresourceRange{
+					.aspectMask = vuk::ImageAspectFlagBits::eColor,
+					.baseMipLevel = 0,
+					.levelCount = 1,
+					.baseArrayLayer = 0,
+					.layerCount = 1,
+				},
+		});
+	}
+
+	m_timer.init(ctxt);
+}
+
+void FroxelFogPass::prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) {
+	TRACE_ZONE("FroxelFogPass::prep");
+
+	m_near = info.cam_proj.near;
+	m_far = std::min(FOG_FAR, info.cam_proj.far);
+	m_camera_far = info.cam_proj.far;
+
+	if (const auto ms = m_timer.next_frame()) {
+		spdlog::debug("froxel fog: {:.3f} ms", *ms);
+	}
+}
+
+void FroxelFogPass::render(
+	vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::RenderGraph& rg, const class SceneRenderer& renderer, struct RenderInfo& info) {
+	TRACE_ZONE("FroxelFogPass::render");
+
+	static_assert(CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT == 4, "froxel_inject.comp packs the splits into a vec4");
+
+	const f32 tan_half_fovy = std::tan(info.cam_proj.fovy * 0.5f);
+
+	struct Params {
+		glm::mat4 inv_view;
+		f32 cascade_splits[CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT];
+		glm::mat4 cascade_view_proj_mats[CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT];
+		glm::vec4 cascade_atlas_rects[CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT];
+		glm::vec3 light_direction;
+		f32 near;
+		glm::vec3 cam_pos;
+		f32 far;
+		glm::vec2 tan_half_fov;
+	} params;
+
+	params.inv_view = glm::inverse(info.cam_view);
+	for (u8 i = 0; i < CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT; ++i) {
+		params.cascade_splits[i] = info.cascades[i].split_depth;
+		params.cascade_view_proj_mats[i] = info.cascades[i].view_proj_mat;
+		params.cascade_atlas_rects[i] = info.cascades[i].atlas_rect;
+	}
+	params.light_direction = info.light_direction;
+	params.near = m_near;
+	params.cam_pos = info.cam_pos;
+	params.far = m_far;
+	params.tan_half_fov = glm::vec2{tan_half_fovy * info.cam_proj.aspect_ratio, tan_half_fovy};
+
+	auto [bubo, stub] = ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eUniformBuffer, std::span{&params, 1});
+	auto ubo = bubo;
+
+	TRACE_CALL("wait_all_transfers", ptc.wait_all_transfers());
+
+	const glm::vec2 clip_range{m_near, m_far};
+	info.profiler->add_pass(rg, "froxel inject", vuk::Pass{
+		.resources = {"froxel_scattering"_image(vuk::eComputeWrite),
+			vuk::Resource{CascadedShadowRenderPass::ATLAS_ATTACHMENT_NAME, vuk::Resource::Type::eImage, vuk::eComputeSampled}},
+		.execute =
+			[this, ubo](vuk::CommandBuffer& cbuf) {
+				m_timer.begin(cbuf);
+
+				const auto sci = vuk::SamplerCreateInfo{
+					.addressModeU = vuk::SamplerAddressMode::eClampToEdge,
+					.addressModeV = vuk::SamplerAddressMode::eClampToEdge,
+					.addressModeW = vuk::SamplerAddressMode::eClampToEdge,
+				};
+
+				cbuf.bind_compute_pipeline("froxel_inject")
+					.bind_sampled_image(0, 0, CascadedShadowRenderPass::ATLAS_ATTACHMENT_NAME, sci)
+					.bind_uniform_buffer(0, 1, ubo)
+					.bind_storage_image(0, 2, "froxel_scattering")
+					.dispatch((GRID_X + GROUP_SIZE - 1) / GROUP_SIZE, (GRID_Y + GROUP_SIZE - 1) / GROUP_SIZE, GRID_Z);
+			},
+	});
+
+	info.profiler->add_pass(rg, "froxel integrate", vuk::Pass{
+		.resources = {"froxel_integrated"_image(vuk::eComputeWrite), "froxel_scattering"_image(vuk::eComputeRead)},
+		.execute =
+			[this, clip_range](vuk::CommandBuffer& cbuf) {
+				cbuf.bind_compute_pipeline("froxel_integrate")
+					.bind_storage_image(0, 0, "froxel_scattering")
+					.bind_storage_image(0, 1, "froxel_integrated")
+					.push_constants(vuk::ShaderStageFlagBits::eCompute, 0, clip_range)
+					.dispatch((GRID_X + GROUP_SIZE - 1) / GROUP_SIZE, (GRID_Y + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+
+				m_timer.end(cbuf);
+			},
+	});
+
+	// persistent rather than managed, since the render graph only allocates 2D images
+	rg.attach_image("froxel_scattering", attachment(0), m_used ? vuk::Access::eComputeRead : vuk::Access::eNone, vuk::Access::eComputeRead);
+	rg.attach_image("froxel_integrated", attachment(1), m_used ? vuk::Access::eFragmentSampled : vuk::Access::eNone, vuk::Access::eFragmentSampled);
+	m_used = true;
+}
+
+void FroxelFogPass::composite(vuk::CommandBuffer& cbuf, vuk::Name base, const vuk::SamplerCreateInfo& base_sampler) const {
+	const auto volume_sci = vuk::SamplerCreateInfo{
+		.magFilter = vuk::Filter::eLinear,
+		.minFilter = vuk::Filter::eLinear,
+		.addressModeU = vuk::SamplerAddressMode::eClampToEdge,
+		.addressModeV = vuk::SamplerAddressMode::eClampToEdge,
+		.addressModeW = vuk::SamplerAddressMode::eClampToEdge,
+	};
+
+	struct PushConstants {
+		f32 near;
+		f32 far;
+		f32 camera_far;
+	} push_consts{m_near, m_far, m_camera_far};
+
+	cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
+		.set_scissor(0, vuk::Rect2D::framebuffer())
+		.bind_graphics_pipeline("composite_froxel")
+		.bind_sampled_image(0, 0, base, base_sampler)
+		.bind_sampled_image(0, 1, "froxel_integrated", volume_sci)
+		.bind_sampled_image(0, 2, "depth_prepass", {})
+		.push_constants(vuk::ShaderStageFlagBits::eFragment, 0, push_consts)
+		.draw(3, 1, 0, 0);
+}
+
+vuk::ImageAttachment FroxelFogPass::attachment(u32 index) const {
+	return vuk::ImageAttachment{
+		.image = *m_volumes[index].image,
+		.image_view = *m_volume_views[index],
+		.extent = vuk::Extent2D{GRID_X, GRID_Y},
+		.format = VOLUME_FORMAT,
+		.sample_count = vuk::Samples::e1,
+		.clear_value = vuk::ClearColor{0.f, 0.f, 0.f, 0.f},
+	};
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "GraphicsPass.hpp"
+#include "CascadedShadows.hpp"
+#include "../Types.hpp"
+#include "../GpuQueries.hpp"
+
+#include <vuk/Image.hpp>
+#include <vuk/RenderGraph.hpp>
+#include <vuk/CommandBuffer.hpp>
+#include <array>
+
+/*
+	Volumetric fog in a camera aligned 3D grid of froxels (frustum voxels) rather than raymarched per pixel like VolumetricLightPass.
+
+	The grid covers the screen in GRID_X x GRID_Y tiles and splits the view distance up to FOG_FAR into GRID_Z exponential slices. Two
+	compute passes fill it every frame: the first one injects, per froxel, the fog's density and the sunlight it scatters (one cascaded
+	shadow map lookup per froxel), and the second one walks each column of froxels front to back, accumulating the scattered light and the
+	transmittance up to every slice. The composite then needs a single trilinear fetch per pixel, at the pixel's depth.
+
+	Neither pass depends on the screen resolution, only on the grid's, which is what makes it cheaper than the raymarch at high resolutions.
+	Lighting changes within a froxel are lost, so shadow edges in the fog are soft.
+*/
+
+class FroxelFogPass : public GraphicsPass {
+  public:
+	static constexpr u32 GRID_X = 160;
+	static constexpr u32 GRID_Y = 90;
+	static constexpr u32 GRID_Z = 64;
+	// the fog ends here (or at the camera's far plane, if that's closer)
+	static constexpr f32 FOG_FAR = 64.f;
+
+	FroxelFogPass();
+
+	void init(vuk::PerThreadContext& ptc, struct Context& ctxt, struct UniformStore& uniforms, class PipelineStore& ps) override;
+	void prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) override;
+	void render(vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::RenderGraph& rg, const class SceneRenderer& renderer, struct RenderInfo& info) override;
+
+	// draws base (the lit scene) with the fog applied, with composite_froxel.frag; the pass must sample froxel_integrated and depth_prepass
+	void composite(vuk::CommandBuffer& cbuf, vuk::Name base, const vuk::SamplerCreateInfo& base_sampler) const;
+
+  private:
+	vuk::ImageAttachment attachment(u32 index) const;
+
+	// 0 = froxel_scattering, 1 = froxel_integrated
+	std::array<vuk::Texture, 2> m_volumes;
+	std::array<vuk::Unique<vuk::ImageView>, 2> m_volume_views;
+	// whether the volumes have been through a frame (and so have to be waited on before they're overwritten)
+	bool m_used;
+
+	f32 m_near;
+	f32 m_far;
+	f32 m_camera_far;
+
+	// both compute passes
+	GpuTimer m_timer;
+};
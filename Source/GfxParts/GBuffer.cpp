@@ -5,16 +5,17 @@
 #include "../Scene.hpp"
 #include "../Resource.hpp"
 #include "../Renderer.hpp"
+#include "../CpuTrace.hpp"
 
 #include <vuk/RenderGraph.hpp>
 #include <vuk/CommandBuffer.hpp>
 
-void GBufferPass::debug_position(vuk::CommandBuffer& cbuf) {
+void GBufferPass::debug_depth(vuk::CommandBuffer& cbuf) {
 	cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
 		.set_scissor(0, vuk::Rect2D::framebuffer())
 		.set_primitive_topology(vuk::PrimitiveTopology::eTriangleList)
 		.bind_graphics_pipeline("debug")
-		.bind_sampled_image(0, 0, "g_position", {})
+		.bind_sampled_image(0, 0, "depth_prepass", {})
 		.draw(3, 1, 0, 0);
 }
 
@@ -29,14 +30,20 @@ void GBufferPass::debug_normal(vuk::CommandBuffer& cbuf) {
 
 void GBufferPass::init(vuk::PerThreadContext& ptc, struct Context& ctxt, struct UniformStore& uniforms, PipelineStore& ps) {
 	ps.add("gbuffer", "gbuffer.vert", "gbuffer.frag");
+	ps.add("gbuffer_deferred", "gbuffer.vert", "gbuffer_deferred.frag");
 }
 
 void GBufferPass::prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) {
+	TRACE_ZONE("GBufferPass::prep");
+
 	m_width = info.window_width;
 	m_height = info.window_height;
+	m_deferred = info.deferred;
 }
 
 void GBufferPass::render(vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::RenderGraph& rg, const class SceneRenderer& renderer, struct RenderInfo& info) {
+	TRACE_ZONE("GBufferPass::render");
+
 	struct Uniforms {
 		glm::mat4 proj;
 		glm::mat4 view;
@@ -45,42 +52,95 @@ void GBufferPass::render(vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::
 	auto [bubo, stub] = ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eUniformBuffer, std::span{&uniforms, 1});
 	auto ubo = bubo;
 
-	ptc.wait_all_transfers();
+	TRACE_CALL("wait_all_transfers", ptc.wait_all_transfers());
 
 	const auto skybox_mat = AtmosphericSkyCubemap::skybox_model_matrix(info.cam_proj, info.cam_pos);
 	auto [bskybox_ubo, stbu] = ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eUniformBuffer, std::span{&skybox_mat, 1});
 	auto skybox_buffer = bskybox_ubo;
 
-	auto pass = vuk::Pass{.resources = {"g_position"_image(vuk::eColorWrite), "g_normal"_image(vuk::eColorWrite), "depth_prepass"_image(vuk::eDepthStencilRW)},
-		.execute = [skybox_buffer, &renderer, ubo](vuk::CommandBuffer& cbuf) {
+	// the material is sampled the same way as the forward pass does
+	const vuk::SamplerCreateInfo map_sampler{.magFilter = vuk::Filter::eLinear,
+		.minFilter = vuk::Filter::eLinear,
+		.addressModeU = vuk::SamplerAddressMode::eRepeat,
+		.addressModeV = vuk::SamplerAddressMode::eRepeat,
+		.addressModeW = vuk::SamplerAddressMode::eRepeat,
+		.anisotropyEnable = VK_TRUE,
+		.maxAnisotropy = 16.f,
+		.minLod = 0.f,
+		.maxLod = 16.f};
+
+	auto pass = vuk::Pass{.resources = {"g_normal"_image(vuk::eColorWrite), "depth_prepass"_image(vuk::eDepthStencilRW)},
+		.execute = [skybox_buffer, &renderer, ubo, map_sampler, deferred = m_deferred, timer = info.resolution_timer,
+					   statistics = info.gbuffer_statistics](vuk::CommandBuffer& cbuf) {
+			if (timer) {
+				timer->begin(cbuf);
+			}
+			if (statistics) {
+				statistics->begin(cbuf);
+			}
+
 			cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
 				.set_scissor(0, vuk::Rect2D::framebuffer())
 				.set_primitive_topology(vuk::PrimitiveTopology::eTriangleList)
-				.bind_graphics_pipeline("gbuffer")
+				.bind_graphics_pipeline(deferred ? "gbuffer_deferred" : "gbuffer")
 				.bind_uniform_buffer(0, 0, ubo);
 
 			{ // render skybox
 				const auto& cube = renderer.scene().meshes.get(MeshCache::view("Cube"));
+				const auto& flat_normal = renderer.scene().textures.get(TextureCache::view("Normal.Flat"));
 				cbuf.bind_vertex_buffer(
 						0, *cube.verts, 0, vuk::Packed{vuk::Format::eR32G32B32Sfloat, vuk::Format::eR32G32B32Sfloat, vuk::Format::eR32G32Sfloat})
 					.bind_index_buffer(*cube.inds, vuk::IndexType::eUint32)
 					.bind_uniform_buffer(1, 0, skybox_buffer)
-					.bind_sampled_image(1, 1, renderer.scene().textures.get(TextureCache::view("Normal.Flat")), {})
-					.draw_indexed(cube.mesh.second.size(), 1, 0, 0, 0);
+					.bind_sampled_image(1, 1, flat_normal, {});
+				if (deferred) {
+					// the lighting pass skips the sky, so its material doesn't matter
+					for (u32 binding = 2; binding <= 5; ++binding) {
+						cbuf.bind_sampled_image(1, binding, flat_normal, {});
+					}
+				}
+				cbuf.draw_indexed(cube.mesh.second.size(), 1, 0, 0, 0);
 			}
 
 			renderer.render(cbuf, [&](const MeshComponent& mesh, const vuk::Buffer& transform) {
-				cbuf.bind_sampled_image(1, 1, renderer.scene().textures.get(mesh.material.normal), {}).bind_uniform_buffer(1, 0, transform);
+				const auto& textures = renderer.scene().textures;
+				if (deferred) {
+					cbuf.bind_sampled_image(1, 1, textures.get(mesh.material.normal), map_sampler)
+						.bind_sampled_image(1, 2, textures.get(mesh.material.albedo), map_sampler)
+						.bind_sampled_image(1, 3, textures.get(mesh.material.metallic), map_sampler)
+						.bind_sampled_image(1, 4, textures.get(mesh.material.roughness), map_sampler)
+						.bind_sampled_image(1, 5, textures.get(mesh.material.ao), map_sampler);
+				} else {
+					cbuf.bind_sampled_image(1, 1, textures.get(mesh.material.normal), {});
+				}
+				cbuf.bind_uniform_buffer(1, 0, transform);
 				return vuk::Packed{vuk::Format::eR32G32B32Sfloat, vuk::Format::eR32G32B32Sfloat, vuk::Format::eR32G32Sfloat};
 			});
+
+			if (statistics) {
+				statistics->end(cbuf);
+			}
 		}};
 
-	rg.add_pass(pass);
+	if (m_deferred) {
+		pass.resources.push_back("g_albedo"_image(vuk::eColorWrite));
+		pass.resources.push_back("g_material"_image(vuk::eColorWrite));
+	}
 
+	info.profiler->add_pass(rg, "gbuffer", pass);
+
+	// octahedral encoded (see gbuffer.frag)
 	rg.attach_managed(
-		"g_position", vuk::Format::eR16G16B16A16Sfloat, vuk::Dimension2D::absolute(m_width, m_height), vuk::Samples::e1, vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
-	rg.attach_managed(
-		"g_normal", vuk::Format::eR16G16B16A16Sfloat, vuk::Dimension2D::absolute(m_width, m_height), vuk::Samples::e1, vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
+		"g_normal", vuk::Format::eR16G16Snorm, vuk::Dimension2D::absolute(m_width, m_height), vuk::Samples::e1, vuk::ClearColor{0.f, 0.f, 0.f, 0.f});
 	rg.attach_managed(
 		"depth_prepass", vuk::Format::eD32Sfloat, vuk::Dimension2D::absolute(m_width, m_height), vuk::Samples::e1, vuk::ClearDepthStencil{1.f, 0});
+
+	if (m_deferred) {
+		// written as linear and read back as linear; sRGB just spends the 8 bits where they're needed. ao goes in alpha
+		rg.attach_managed(
+			"g_albedo", vuk::Format::eR8G8B8A8Srgb, vuk::Dimension2D::absolute(m_width, m_height), vuk::Samples::e1, vuk::ClearColor{0.f, 0.f, 0.f, 0.f});
+		// metallic, roughness
+		rg.attach_managed(
+			"g_material", vuk::Format::eR8G8Unorm, vuk::Dimension2D::absolute(m_width, m_height), vuk::Samples::e1, vuk::ClearColor{0.f, 0.f, 0.f, 0.f});
+	}
 }
@@ -9,6 +9,13 @@
 
 /*
 	This is a forward renderer, but some thin g-buffers are still needed for effects like SSAO.
+
+	There's no position target: view/world positions are reconstructed from depth_prepass and the inverse projection wherever they're needed.
+	Normals are octahedral encoded into two 16 bit snorm channels (4 bytes per pixel instead of 8), which is well below a hundredth of a degree
+	of error.
+
+	In deferred mode (RenderInfo::deferred) the pass also samples the material, and writes everything the lighting pass needs:
+	the shading normal into g_normal, linear albedo + ao into g_albedo (RGBA8 sRGB) and metallic/roughness into g_material (RG8).
 */
 
 namespace vuk {
@@ -20,7 +27,7 @@ class CommandBuffer;
 
 class GBufferPass : public GraphicsPass {
   public:
-	void debug_position(vuk::CommandBuffer& cbuf);
+	void debug_depth(vuk::CommandBuffer& cbuf);
 	void debug_normal(vuk::CommandBuffer& cbuf);
 
 	void init(vuk::PerThreadContext& ptc, struct Context& ctxt, struct UniformStore& uniforms, class PipelineStore& ps) override;
@@ -29,4 +36,5 @@ class GBufferPass : public GraphicsPass {
 
   private:
 	u32 m_width, m_height;
+	bool m_deferred;
 };
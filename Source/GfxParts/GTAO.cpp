@@ -0,0 +1,108 @@
+#include "GTAO.hpp"
+
+#include "../Context.hpp"
+#include "../Renderer.hpp"
+#include "../CpuTrace.hpp"
+
+#include <vuk/CommandBuffer.hpp>
+#include <glm/mat4x4.hpp>
+#include <spdlog/spdlog.h>
+#include <cmath>
+
+static constexpr u32 GROUP_SIZE = 16;
+
+// world space, same as ssao.frag
+static constexpr f32 RADIUS = 0.5f;
+
+void GTAOPass::init(vuk::PerThreadContext& ptc, struct Context& ctxt, struct UniformStore& uniforms, PipelineStore& ps) {
+	ps.add_compute("gtao", "gtao.comp");
+	ps.add("gtao_blur", "ssao.vert", "ssao_blur.frag");
+
+	m_timer.init(ctxt);
+}
+
+void GTAOPass::prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) {
+	TRACE_ZONE("GTAOPass::prep");
+
+	m_width = info.window_width;
+	m_height = info.window_height;
+
+	if (const auto ms = m_timer.next_frame()) {
+		spdlog::debug("gtao: {:.3f} ms", *ms);
+	}
+}
+
+void GTAOPass::render(vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::RenderGraph& rg, const class SceneRenderer& renderer, struct RenderInfo& info) {
+	TRACE_ZONE("GTAOPass::render");
+
+	const f32 tan_half_fovy = std::tan(info.cam_proj.fovy * 0.5f);
+
+	struct Params {
+		glm::mat4 view;
+		glm::vec2 tan_half_fov;
+		f32 near;
+		f32 far;
+		f32 projection_scale;
+		f32 radius;
+		glm::uvec2 size;
+	} params{
+		.view = info.cam_view,
+		.tan_half_fov = glm::vec2{tan_half_fovy * info.cam_proj.aspect_ratio, tan_half_fovy},
+		.near = info.cam_proj.near,
+		.far = info.cam_proj.far,
+		.projection_scale = 0.5f * m_height / tan_half_fovy,
+		.radius = RADIUS,
+		.size = glm::uvec2{m_width, m_height},
+	};
+
+	auto [bubo, stub] = ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eUniformBuffer, std::span{&params, 1});
+	auto ubo = bubo;
+
+	TRACE_CALL("wait_all_transfers", ptc.wait_all_transfers());
+
+	const glm::uvec2 groups{(m_width + GROUP_SIZE - 1) / GROUP_SIZE, (m_height + GROUP_SIZE - 1) / GROUP_SIZE};
+
+	info.profiler->add_pass(rg, "gtao", vuk::Pass{
+		.resources = {"gtao"_image(vuk::eComputeWrite), "depth_prepass"_image(vuk::eComputeSampled), "g_normal"_image(vuk::eComputeSampled)},
+		.execute =
+			[this, ubo, groups](vuk::CommandBuffer& cbuf) {
+				m_timer.begin(cbuf);
+
+				cbuf.bind_compute_pipeline("gtao")
+					.bind_sampled_image(0, 0, "depth_prepass", {})
+					.bind_sampled_image(0, 1, "g_normal", {})
+					.bind_uniform_buffer(0, 2, ubo)
+					.bind_storage_image(0, 3, "gtao")
+					.dispatch(groups.x, groups.y, 1);
+			},
+	});
+
+	// see ssao_blur.frag; it only texelFetches, so the samplers don't matter
+	const auto blur = [](vuk::CommandBuffer& cbuf, vuk::Name source, glm::ivec2 direction) {
+		cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
+			.set_scissor(0, vuk::Rect2D::framebuffer())
+			.bind_graphics_pipeline("gtao_blur")
+			.bind_sampled_image(0, 0, source, {})
+			.push_constants(vuk::ShaderStageFlagBits::eFragment, 0, direction)
+			.draw(3, 1, 0, 0);
+	};
+
+	info.profiler->add_pass(rg, "gtao blur", vuk::Pass{.resources = {"gtao_blur_x"_image(vuk::eColorWrite), "gtao"_image(vuk::eFragmentSampled)},
+		.execute = [blur](vuk::CommandBuffer& cbuf) {
+			blur(cbuf, "gtao", glm::ivec2{1, 0});
+		}});
+
+	info.profiler->add_pass(rg, "gtao blur", vuk::Pass{.resources = {"ssao_blurred"_image(vuk::eColorWrite), "gtao_blur_x"_image(vuk::eFragmentSampled)},
+		.execute = [this, blur](vuk::CommandBuffer& cbuf) {
+			blur(cbuf, "gtao_blur_x", glm::ivec2{0, 1});
+			m_timer.end(cbuf);
+		}});
+
+	// r = occlusion, g = view distance; rgba16f rather than rg16f, since storage images of the latter need an optional feature
+	rg.attach_managed("gtao", vuk::Format::eR16G16B16A16Sfloat, vuk::Dimension2D::absolute(m_width, m_height), vuk::Samples::e1,
+		vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
+	rg.attach_managed(
+		"gtao_blur_x", vuk::Format::eR16G16Sfloat, vuk::Dimension2D::absolute(m_width, m_height), vuk::Samples::e1, vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
+	rg.attach_managed("ssao_blurred", vuk::Format::eR16G16Sfloat, vuk::Dimension2D::absolute(m_width, m_height), vuk::Samples::e1,
+		vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
+}
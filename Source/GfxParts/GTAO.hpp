@@ -0,0 +1,31 @@
+#pragma once
+
+#include "GraphicsPass.hpp"
+#include "../Types.hpp"
+#include "../GpuQueries.hpp"
+
+#include <vuk/RenderGraph.hpp>
+
+/*
+	Horizon based ambient occlusion (GTAO), an alternative to SSAOPass that writes the same ssao_blurred.
+
+	Instead of testing points of a random hemisphere kernel, every pixel walks a couple of screen space slices in both directions to find the
+	horizon on either side, and integrates the visible part of the slice analytically. That converges with far fewer samples (2 slices of
+	2 x 8 steps here, against SSAOPass' 64) and has no kernel or noise texture to tune.
+
+	It runs as a compute shader at full resolution. Each workgroup first loads the view distances of its tile, plus an apron, into shared
+	memory; the steps are spread quadratically, so most of them read from there. The result goes through SSAOPass' bilateral blur.
+*/
+
+class GTAOPass : public GraphicsPass {
+  public:
+	void init(vuk::PerThreadContext& ptc, struct Context& ctxt, struct UniformStore& uniforms, class PipelineStore& ps) override;
+	void prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) override;
+	void render(vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::RenderGraph& rg, const class SceneRenderer& renderer, struct RenderInfo& info) override;
+
+  private:
+	u32 m_width, m_height;
+
+	// the compute pass and the blur, up to ssao_blurred
+	GpuTimer m_timer;
+};
@@ -0,0 +1,244 @@
+#include "PostProcess.hpp"
+
+#include "../Context.hpp"
+#include "../Renderer.hpp"
+#include "../CpuTrace.hpp"
+
+#include <vuk/Context.hpp>
+#include <glm/vec2.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+
+static constexpr u32 GROUP_SIZE = 16;
+static_assert(GROUP_SIZE * GROUP_SIZE == PostProcessPass::HISTOGRAM_BINS, "every histogram invocation flushes one bin");
+
+static constexpr u32 BLOOM_GROUP_SIZE = 8;
+
+// starts out at what the tonemap's exposure bias used to be
+static constexpr f32 INITIAL_EXPOSURE = 2.f;
+
+static void allocate_image(vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::Format format, vuk::Extent2D extent, vuk::ImageUsageFlags usage,
+	vuk::Texture& out_texture, vuk::Unique<vuk::ImageView>& out_view) {
+	out_texture = ctxt.vuk_context->allocate_texture(vuk::ImageCreateInfo{
+		.format = format,
+		.extent = vuk::Extent3D{extent.width, extent.height, 1},
+		.mipLevels = 1,
+		.arrayLayers = 1,
+		.samples = vuk::SampleCountFlagBits::e1,
+		.tiling = vuk::ImageTiling::eOptimal,
+		.usage = usage,
+		.sharingMode = vuk::SharingMode::eExclusive,
+	});
+
+	out_view = ptc.create_image_view(vuk::ImageViewCreateInfo{
+		.image = *out_texture.image,
+		.viewType = vuk::ImageViewType::e2D,
+		.format = format,
+		.subresourceRange =
+			vuk::ImageSubresourceRange{
+				.aspectMask = vuk::ImageAspectFlagBits::eColor,
+				.baseMipLevel = 0,
+				.levelCount = 1,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+	});
+}
+
+PostProcessPass::PostProcessPass() : m_used{false}, m_width{0}, m_height{0} {
+}
+
+void PostProcessPass::init(vuk::PerThreadContext& ptc, struct Context& ctxt, struct UniformStore& uniforms, PipelineStore& ps) {
+	ps.define("HISTOGRAM_BINS", std::to_string(HISTOGRAM_BINS));
+	ps.add_compute("luminance_histogram", "luminance_histogram.comp");
+	ps.add_compute("exposure", "exposure.comp");
+	ps.add_compute("bloom_downsample", "bloom_downsample.comp");
+	ps.add_compute("bloom_upsample", "bloom_upsample.comp");
+	// composite.vert is only used for its fullscreen triangle
+	ps.add("tonemap", "composite.vert", "tonemap.frag");
+
+	allocate_image(ptc, ctxt, vuk::Format::eR32Uint, vuk::Extent2D{HISTOGRAM_BINS, 1}, vuk::ImageUsageFlagBits::eStorage, m_histogram, m_histogram_view);
+	allocate_image(ptc, ctxt, vuk::Format::eR32Sfloat, vuk::Extent2D{1, 1}, vuk::ImageUsageFlagBits::eStorage | vuk::ImageUsageFlagBits::eSampled,
+		m_exposure, m_exposure_view);
+
+	for (u32 i = 0; i < BLOOM_MIPS; ++i) {
+		m_bloom_down_names.push_back(std::string{"bloom_down_"}.append(std::to_string(i)));
+		m_bloom_up_names.push_back(std::string{"bloom_up_"}.append(std::to_string(i)));
+	}
+
+	m_timer.init(ctxt);
+}
+
+void PostProcessPass::prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) {
+	TRACE_ZONE("PostProcessPass::prep");
+
+	m_width = info.output_width;
+	m_height = info.output_height;
+
+	if (const auto ms = m_timer.next_frame()) {
+		spdlog::debug("post processing: {:.3f} ms", *ms);
+	}
+}
+
+void PostProcessPass::render(
+	vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::RenderGraph& rg, const class SceneRenderer& renderer, struct RenderInfo& info) {
+	TRACE_ZONE("PostProcessPass::render");
+
+	// exposure
+
+	struct HistogramParams {
+		glm::uvec2 size;
+		f32 min_log_luminance;
+		f32 inv_log_luminance_range;
+	} histogram_params{glm::uvec2{m_width, m_height}, MIN_LOG_LUMINANCE, 1.f / (MAX_LOG_LUMINANCE - MIN_LOG_LUMINANCE)};
+
+	info.profiler->add_pass(rg, "exposure histogram", vuk::Pass{
+		// the bins are accumulated with atomics, so they're read too
+		.resources = {"exposure_histogram"_image(vuk::eComputeRW), "pbr_hdr"_image(vuk::eComputeSampled)},
+		.execute =
+			[this, histogram_params](vuk::CommandBuffer& cbuf) {
+				m_timer.begin(cbuf);
+
+				cbuf.bind_compute_pipeline("luminance_histogram")
+					.bind_sampled_image(0, 0, "pbr_hdr", {})
+					.bind_storage_image(0, 1, "exposure_histogram")
+					.push_constants(vuk::ShaderStageFlagBits::eCompute, 0, histogram_params)
+					.dispatch((m_width + GROUP_SIZE - 1) / GROUP_SIZE, (m_height + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+			},
+	});
+
+	struct ExposureParams {
+		f32 min_log_luminance;
+		f32 log_luminance_range;
+		f32 adaptation;
+		f32 initial_exposure;
+		u32 pixel_count;
+		// the histogram is garbage on the first frame, so the exposure is just initialized
+		u32 reset;
+	} exposure_params{MIN_LOG_LUMINANCE, MAX_LOG_LUMINANCE - MIN_LOG_LUMINANCE, ADAPTATION, INITIAL_EXPOSURE, m_width * m_height, m_used ? 0u : 1u};
+
+	info.profiler->add_pass(rg, "exposure", vuk::Pass{
+		// reads the histogram and then clears it, and adapts last frame's exposure
+		.resources = {"exposure"_image(vuk::eComputeRW), "exposure_histogram"_image(vuk::eComputeRW)},
+		.execute =
+			[exposure_params](vuk::CommandBuffer& cbuf) {
+				cbuf.bind_compute_pipeline("exposure")
+					.bind_storage_image(0, 0, "exposure_histogram")
+					.bind_storage_image(0, 1, "exposure")
+					.push_constants(vuk::ShaderStageFlagBits::eCompute, 0, exposure_params)
+					.dispatch(1, 1, 1);
+			},
+	});
+
+	// bloom
+
+	const auto bloom_sci = vuk::SamplerCreateInfo{
+		.magFilter = vuk::Filter::eLinear,
+		.minFilter = vuk::Filter::eLinear,
+		.addressModeU = vuk::SamplerAddressMode::eClampToEdge,
+		.addressModeV = vuk::SamplerAddressMode::eClampToEdge,
+		.addressModeW = vuk::SamplerAddressMode::eClampToEdge,
+	};
+
+	for (u32 i = 0; i < BLOOM_MIPS; ++i) {
+		const vuk::Name source = i == 0 ? vuk::Name{"pbr_hdr"} : vuk::Name{m_bloom_down_names[i - 1]};
+		const vuk::Name target = m_bloom_down_names[i];
+		const vuk::Extent2D extent = bloom_extent(i);
+		const u32 karis_average = i == 0 ? 1 : 0;
+
+		info.profiler->add_pass(rg, "bloom downsample", vuk::Pass{
+			.resources = {vuk::Resource{target, vuk::Resource::Type::eImage, vuk::eComputeWrite},
+				vuk::Resource{source, vuk::Resource::Type::eImage, vuk::eComputeSampled}},
+			.execute =
+				[source, target, extent, karis_average, bloom_sci](vuk::CommandBuffer& cbuf) {
+					cbuf.bind_compute_pipeline("bloom_downsample")
+						.bind_sampled_image(0, 0, source, bloom_sci)
+						.bind_storage_image(0, 1, target)
+						.push_constants(vuk::ShaderStageFlagBits::eCompute, 0, karis_average)
+						.dispatch((extent.width + BLOOM_GROUP_SIZE - 1) / BLOOM_GROUP_SIZE, (extent.height + BLOOM_GROUP_SIZE - 1) / BLOOM_GROUP_SIZE, 1);
+				},
+		});
+
+		rg.attach_managed(target, HDR_FORMAT, vuk::Dimension2D::absolute(extent.width, extent.height), vuk::Samples::e1, vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
+	}
+
+	// the smallest level has nothing below it, so its downsample stands in for its upsample
+	for (u32 i = BLOOM_MIPS - 1; i-- > 0;) {
+		const vuk::Name lower = i == BLOOM_MIPS - 2 ? vuk::Name{m_bloom_down_names[i + 1]} : vuk::Name{m_bloom_up_names[i + 1]};
+		const vuk::Name base = m_bloom_down_names[i];
+		const vuk::Name target = m_bloom_up_names[i];
+		const vuk::Extent2D extent = bloom_extent(i);
+
+		info.profiler->add_pass(rg, "bloom upsample", vuk::Pass{
+			.resources = {vuk::Resource{target, vuk::Resource::Type::eImage, vuk::eComputeWrite},
+				vuk::Resource{lower, vuk::Resource::Type::eImage, vuk::eComputeSampled},
+				vuk::Resource{base, vuk::Resource::Type::eImage, vuk::eComputeSampled}},
+			.execute =
+				[lower, base, target, extent, bloom_sci](vuk::CommandBuffer& cbuf) {
+					cbuf.bind_compute_pipeline("bloom_upsample")
+						.bind_sampled_image(0, 0, lower, bloom_sci)
+						.bind_sampled_image(0, 1, base, {})
+						.bind_storage_image(0, 2, target)
+						.dispatch((extent.width + BLOOM_GROUP_SIZE - 1) / BLOOM_GROUP_SIZE, (extent.height + BLOOM_GROUP_SIZE - 1) / BLOOM_GROUP_SIZE, 1);
+				},
+		});
+
+		rg.attach_managed(target, HDR_FORMAT, vuk::Dimension2D::absolute(extent.width, extent.height), vuk::Samples::e1, vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
+	}
+
+	// persistent, since the exposure adapts over frames (and the histogram is cleared by the exposure pass, for the next frame). Both are
+	// read-modify-write, so they end the frame in (and the next one starts from) compute read/write access; a write-only access would only
+	// order the writes, not make them visible to the next read
+	rg.attach_image("exposure_histogram",
+		vuk::ImageAttachment{
+			.image = *m_histogram.image,
+			.image_view = *m_histogram_view,
+			.extent = vuk::Extent2D{HISTOGRAM_BINS, 1},
+			.format = vuk::Format::eR32Uint,
+			.sample_count = vuk::Samples::e1,
+			.clear_value = vuk::ClearColor{0.f, 0.f, 0.f, 0.f},
+		},
+		m_used ? vuk::Access::eComputeRW : vuk::Access::eNone, vuk::Access::eComputeRW);
+	rg.attach_image("exposure",
+		vuk::ImageAttachment{
+			.image = *m_exposure.image,
+			.image_view = *m_exposure_view,
+			.extent = vuk::Extent2D{1, 1},
+			.format = vuk::Format::eR32Sfloat,
+			.sample_count = vuk::Samples::e1,
+			.clear_value = vuk::ClearColor{0.f, 0.f, 0.f, 0.f},
+		},
+		m_used ? vuk::Access::eComputeRW : vuk::Access::eNone, vuk::Access::eComputeRW);
+	m_used = true;
+}
+
+void PostProcessPass::tonemap(vuk::CommandBuffer& cbuf) {
+	const auto bloom_sci = vuk::SamplerCreateInfo{
+		.magFilter = vuk::Filter::eLinear,
+		.minFilter = vuk::Filter::eLinear,
+		.addressModeU = vuk::SamplerAddressMode::eClampToEdge,
+		.addressModeV = vuk::SamplerAddressMode::eClampToEdge,
+		.addressModeW = vuk::SamplerAddressMode::eClampToEdge,
+	};
+
+	struct PushConstants {
+		f32 bloom_strength;
+		// bloom_up_0 is the sum of every level
+		f32 bloom_scale;
+	} push_consts{BLOOM_STRENGTH, 1.f / BLOOM_MIPS};
+
+	cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
+		.set_scissor(0, vuk::Rect2D::framebuffer())
+		.bind_graphics_pipeline("tonemap")
+		.bind_sampled_image(0, 0, "pbr_hdr", {})
+		.bind_sampled_image(0, 1, m_bloom_up_names[0], bloom_sci)
+		.bind_sampled_image(0, 2, "exposure", {})
+		.push_constants(vuk::ShaderStageFlagBits::eFragment, 0, push_consts)
+		.draw(3, 1, 0, 0);
+
+	m_timer.end(cbuf);
+}
+
+vuk::Extent2D PostProcessPass::bloom_extent(u32 mip) const {
+	return vuk::Extent2D{std::max(m_width >> (mip + 1), 1u), std::max(m_height >> (mip + 1), 1u)};
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "GraphicsPass.hpp"
+#include "../Types.hpp"
+#include "../GpuQueries.hpp"
+
+#include <vuk/Image.hpp>
+#include <vuk/RenderGraph.hpp>
+#include <vuk/CommandBuffer.hpp>
+#include <string>
+#include <vector>
+
+/*
+	The post-processing chain between the HDR composite (pbr_hdr, at the swapchain's resolution) and the final image.
+
+	Auto exposure: a compute pass bins the log2 luminance of every pixel into a HISTOGRAM_BINS histogram (per workgroup in shared memory, then
+	atomically into a tiny persistent image), and a single workgroup reduces it to the average luminance, turns that into a target exposure,
+	moves the current one towards it by ADAPTATION and clears the histogram for the next frame. The exposure never leaves the GPU.
+
+	Bloom: the dual filter (Bjørge 2015) over a chain of BLOOM_MIPS half resolution images. Each downsample takes 5 bilinear taps (13 texels)
+	of the previous level, the first one weighted by inverse luminance (Karis 2013) so single bright pixels don't flicker; each upsample takes
+	8 bilinear taps of the level below and adds the downsampled image of its own size, so bloom_up_0 ends up with every level summed.
+
+	The tonemap pass is a fragment pass rather than compute, since the sRGB swapchain images can't be storage images. It applies the
+	exposure and the bloom, tonemaps and gamma corrects; every shader before it writes linear HDR.
+*/
+
+class PostProcessPass : public GraphicsPass {
+  public:
+	// what the scene is lit into, up to pbr_hdr
+	static constexpr vuk::Format HDR_FORMAT = vuk::Format::eR16G16B16A16Sfloat;
+
+	// one per invocation of the histogram's 16x16 workgroups
+	static constexpr u32 HISTOGRAM_BINS = 256;
+	// the range the histogram covers; bin 0 is everything darker (which doesn't count towards the average)
+	static constexpr f32 MIN_LOG_LUMINANCE = -10.f;
+	static constexpr f32 MAX_LOG_LUMINANCE = 6.f;
+	// of the distance to the target exposure, in log2 terms, covered every frame
+	static constexpr f32 ADAPTATION = 0.05f;
+
+	// the first one is at half the resolution of pbr_hdr
+	static constexpr u32 BLOOM_MIPS = 6;
+	static_assert(BLOOM_MIPS >= 2, "the upsample chain needs at least two levels");
+	// how much of the image is replaced by the bloom
+	static constexpr f32 BLOOM_STRENGTH = 0.04f;
+
+	PostProcessPass();
+
+	void init(vuk::PerThreadContext& ptc, struct Context& ctxt, struct UniformStore& uniforms, class PipelineStore& ps) override;
+	void prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) override;
+	// the exposure and bloom passes; reads pbr_hdr
+	void render(vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::RenderGraph& rg, const class SceneRenderer& renderer, struct RenderInfo& info) override;
+
+	// draws the tonemapped image, with tonemap.frag; the pass must sample pbr_hdr, bloom_up_0 and exposure
+	void tonemap(vuk::CommandBuffer& cbuf);
+
+  private:
+	vuk::Extent2D bloom_extent(u32 mip) const;
+
+	// HISTOGRAM_BINS x 1, r32ui
+	vuk::Texture m_histogram;
+	vuk::Unique<vuk::ImageView> m_histogram_view;
+	// 1 x 1, r32f
+	vuk::Texture m_exposure;
+	vuk::Unique<vuk::ImageView> m_exposure_view;
+	// whether the images above have been through a frame; before that, their contents are undefined
+	bool m_used;
+
+	std::vector<std::string> m_bloom_down_names;
+	std::vector<std::string> m_bloom_up_names;
+
+	u32 m_width;
+	u32 m_height;
+
+	// from the histogram to the tonemap
+	GpuTimer m_timer;
+};
@@ -6,13 +6,36 @@
 #include "../Scene.hpp"
 #include "../GfxUtil.hpp"
 #include "../Renderer.hpp"
+#include "../CpuTrace.hpp"
 
 #include <vuk/CommandBuffer.hpp>
+#include <spdlog/spdlog.h>
+#include <glm/common.hpp>
+#include <cmath>
 #include <random>
 
+const char* SSAOPass::resolution_name(Resolution resolution) {
+	switch (resolution) {
+	case Resolution::Full:
+		return "full";
+	case Resolution::Half:
+		return "half";
+	case Resolution::Quarter:
+		return "quarter";
+	}
+	return "";
+}
+
 void SSAOPass::init(vuk::PerThreadContext& ptc, struct Context& ctxt, struct UniformStore& uniforms, PipelineStore& ps) {
 	ps.add("ssao", "ssao.vert", "ssao.frag");
 	ps.add("ssao_blur", "ssao.vert", "ssao_blur.frag");
+	ps.add("ssao_upsample", "ssao.vert", "ssao_upsample.frag");
+	ps.add("ssao_temporal", "ssao.vert", "ssao_temporal.frag");
+
+	m_resolution = Resolution::Full;
+	m_timer.init(ctxt);
+	m_timed_resolutions.fill(Resolution::Full);
+	m_frame = 0;
 
 	m_random_normal = gfx_util::load_texture("Resources/Textures/random_normal.jpg", ptc, false);
 
@@ -35,14 +58,34 @@ void SSAOPass::init(vuk::PerThreadContext& ptc, struct Context& ctxt, struct Uni
 }
 
 void SSAOPass::prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) {
+	TRACE_ZONE("SSAOPass::prep");
+
 	m_width = info.window_width;
 	m_height = info.window_height;
+	m_resolution = info.ssao_resolution;
+	m_scale = m_resolution == Resolution::Full ? 1 : m_resolution == Resolution::Half ? 2 : 4;
+	m_ssao_width = (m_width + m_scale - 1) / m_scale;
+	m_ssao_height = (m_height + m_scale - 1) / m_scale;
+
+	m_temporal = info.temporal;
+	if (m_temporal) {
+		m_history.resize(ptc, ctxt, vuk::Extent2D{m_ssao_width, m_ssao_height}, vuk::Format::eR16G16Sfloat);
+	}
+
+	const u32 slot = ++m_frame % vuk::Context::FC;
+	if (const auto ms = m_timer.next_frame()) {
+		spdlog::debug("ssao ({} resolution): {:.3f} ms", resolution_name(m_timed_resolutions[slot]), *ms);
+	}
+	m_timed_resolutions[slot] = m_resolution;
 }
 
 void SSAOPass::render(vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::RenderGraph& rg, const class SceneRenderer& renderer, struct RenderInfo& info) {
+	TRACE_ZONE("SSAOPass::render");
+
 	struct Uniforms {
 		std::array<glm::vec4, KERNEL_SIZE> samples;
 		glm::mat4 projection;
+		glm::mat4 inv_projection;
 	} uniforms;
 
 	for (u16 i = 0; i < KERNEL_SIZE; ++i) {
@@ -50,24 +93,43 @@ void SSAOPass::render(vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::Ren
 	}
 
 	uniforms.projection = info.cam_proj.matrix();
+	uniforms.inv_projection = glm::inverse(uniforms.projection);
 
 	auto [bubo, stub] = ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eUniformBuffer, std::span{&uniforms, 1});
 	auto ubo = bubo;
 
-	ptc.wait_all_transfers();
+	TRACE_CALL("wait_all_transfers", ptc.wait_all_transfers());
+
+	const u32 scale = m_scale;
+	const u32 width = m_ssao_width;
+	const u32 height = m_ssao_height;
+
+	struct PushConstants {
+		glm::vec2 screen_size;
+		glm::vec2 noise_offset;
+		u32 scale;
+		u32 sample_count;
+		u32 sample_offset;
+	} push_consts{glm::vec2{m_width, m_height}, glm::vec2{0.f}, scale, KERNEL_SIZE, 0};
+
+	if (m_temporal) {
+		constexpr u32 stride = KERNEL_SIZE / TEMPORAL_SAMPLES;
+		push_consts.sample_count = TEMPORAL_SAMPLES;
+		push_consts.sample_offset = info.frame % stride;
+		// R2 sequence
+		push_consts.noise_offset = glm::fract(static_cast<f32>(info.frame % 1024) * glm::vec2{0.7548776662f, 0.5698402910f});
+	}
 
 	auto ssao_pass =
-		vuk::Pass{.resources = {"ssao"_image(vuk::eColorWrite), "g_position"_image(vuk::eFragmentSampled), "g_normal"_image(vuk::eFragmentSampled)},
-			.execute = [this, ubo](vuk::CommandBuffer& cbuf) {
-				const auto sci = vuk::SamplerCreateInfo{
-					.addressModeU = vuk::SamplerAddressMode::eClampToEdge,
-					.addressModeV = vuk::SamplerAddressMode::eClampToEdge,
-					.addressModeW = vuk::SamplerAddressMode::eClampToEdge,
-				};
-
-				cbuf.bind_graphics_pipeline("ssao")
-					.bind_sampled_image(0, 0, "g_position", sci)
-					.bind_sampled_image(0, 1, "g_normal", sci)
+		vuk::Pass{.resources = {"ssao"_image(vuk::eColorWrite), "depth_prepass"_image(vuk::eFragmentSampled), "g_normal"_image(vuk::eFragmentSampled)},
+			.execute = [this, ubo, push_consts](vuk::CommandBuffer& cbuf) {
+				m_timer.begin(cbuf);
+
+				cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
+					.set_scissor(0, vuk::Rect2D::framebuffer())
+					.bind_graphics_pipeline("ssao")
+					.bind_sampled_image(0, 0, "depth_prepass", {})
+					.bind_sampled_image(0, 1, "g_normal", {})
 					.bind_sampled_image(0, 2, m_random_normal,
 						{
 							.addressModeU = vuk::SamplerAddressMode::eRepeat,
@@ -75,25 +137,101 @@ void SSAOPass::render(vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::Ren
 							.addressModeW = vuk::SamplerAddressMode::eRepeat,
 						})
 					.bind_uniform_buffer(0, 3, ubo)
-					.push_constants(vuk::ShaderStageFlagBits::eFragment, 0, glm::vec2{m_width, m_height})
+					.push_constants(vuk::ShaderStageFlagBits::eFragment, 0, push_consts)
 					.draw(3, 1, 0, 0);
 			}};
 
-	auto blur_pass = vuk::Pass{
-		.resources = {"ssao_blurred"_image(vuk::eColorWrite), "ssao"_image(vuk::eFragmentSampled)}, .execute = [](vuk::CommandBuffer& cbuf) {
-			const auto sci = vuk::SamplerCreateInfo{
-				.addressModeU = vuk::SamplerAddressMode::eClampToEdge,
-				.addressModeV = vuk::SamplerAddressMode::eClampToEdge,
-				.addressModeW = vuk::SamplerAddressMode::eClampToEdge,
-			};
+	// the blur and upsample only texelFetch, so the samplers don't matter
+	const auto blur = [](vuk::CommandBuffer& cbuf, vuk::Name source, glm::ivec2 direction) {
+		cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
+			.set_scissor(0, vuk::Rect2D::framebuffer())
+			.bind_graphics_pipeline("ssao_blur")
+			.bind_sampled_image(0, 0, source, {})
+			.push_constants(vuk::ShaderStageFlagBits::eFragment, 0, direction)
+			.draw(3, 1, 0, 0);
+	};
+
+	info.profiler->add_pass(rg, "ssao", ssao_pass);
+
+	if (m_temporal) {
+		const bool history_valid = m_history.attach(rg, "ssao_history_prev", "ssao_history", info.frame);
+		const f32 tan_half_fovy = std::tan(info.cam_proj.fovy * 0.5f);
+
+		struct TemporalParams {
+			glm::mat4 inv_view;
+			glm::mat4 prev_view_proj;
+			glm::vec2 tan_half_fov;
+			glm::vec2 screen_size;
+			u32 scale;
+			u32 history_valid;
+		} temporal_params{glm::inverse(info.cam_view), info.prev_view_proj, glm::vec2{tan_half_fovy * info.cam_proj.aspect_ratio, tan_half_fovy},
+			glm::vec2{m_width, m_height}, scale, history_valid ? 1u : 0u};
+
+		auto [btemporal, temporalstub] =
+			ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eUniformBuffer, std::span{&temporal_params, 1});
+		auto temporal_ubo = btemporal;
+		TRACE_CALL("wait_all_transfers", ptc.wait_all_transfers());
+
+		info.profiler->add_pass(rg, "ssao temporal", vuk::Pass{.resources = {"ssao_history"_image(vuk::eColorWrite), "ssao"_image(vuk::eFragmentSampled),
+								  "ssao_history_prev"_image(vuk::eFragmentSampled)},
+			.execute = [temporal_ubo](vuk::CommandBuffer& cbuf) {
+				cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
+					.set_scissor(0, vuk::Rect2D::framebuffer())
+					.bind_graphics_pipeline("ssao_temporal")
+					.bind_sampled_image(0, 0, "ssao", {})
+					.bind_sampled_image(0, 1, "ssao_history_prev", {})
+					.bind_uniform_buffer(0, 2, temporal_ubo)
+					.draw(3, 1, 0, 0);
+			}});
+	}
 
-			cbuf.set_viewport(0, vuk::Rect2D::framebuffer()).bind_graphics_pipeline("ssao_blur").bind_sampled_image(0, 0, "ssao", sci).draw(3, 1, 0, 0);
-		}};
+	// the accumulated occlusion still gets blurred, but it's far less noisy by then
+	const vuk::Name blur_source = m_temporal ? "ssao_history" : "ssao";
+	info.profiler->add_pass(rg, "ssao blur", vuk::Pass{.resources = {"ssao_blur_x"_image(vuk::eColorWrite),
+							  m_temporal ? "ssao_history"_image(vuk::eFragmentSampled) : "ssao"_image(vuk::eFragmentSampled)},
+		.execute = [blur, blur_source](vuk::CommandBuffer& cbuf) {
+			blur(cbuf, blur_source, glm::ivec2{1, 0});
+		}});
+
+	if (m_resolution == Resolution::Full) {
+		info.profiler->add_pass(rg, "ssao blur", vuk::Pass{.resources = {"ssao_blurred"_image(vuk::eColorWrite), "ssao_blur_x"_image(vuk::eFragmentSampled)},
+			.execute = [this, blur](vuk::CommandBuffer& cbuf) {
+				blur(cbuf, "ssao_blur_x", glm::ivec2{0, 1});
+				m_timer.end(cbuf);
+			}});
+	} else {
+		struct UpsamplePushConstants {
+			f32 near;
+			f32 far;
+			u32 scale;
+		} upsample_push_consts{info.cam_proj.near, info.cam_proj.far, scale};
+
+		info.profiler->add_pass(rg, "ssao blur", vuk::Pass{.resources = {"ssao_blur_y"_image(vuk::eColorWrite), "ssao_blur_x"_image(vuk::eFragmentSampled)},
+			.execute = [blur](vuk::CommandBuffer& cbuf) {
+				blur(cbuf, "ssao_blur_x", glm::ivec2{0, 1});
+			}});
+
+		info.profiler->add_pass(rg, "ssao upsample", vuk::Pass{
+			.resources = {"ssao_blurred"_image(vuk::eColorWrite), "depth_prepass"_image(vuk::eFragmentSampled), "ssao_blur_y"_image(vuk::eFragmentSampled)},
+			.execute = [this, upsample_push_consts](vuk::CommandBuffer& cbuf) {
+				cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
+					.set_scissor(0, vuk::Rect2D::framebuffer())
+					.bind_graphics_pipeline("ssao_upsample")
+					.bind_sampled_image(0, 0, "depth_prepass", {})
+					.bind_sampled_image(0, 1, "ssao_blur_y", {})
+					.push_constants(vuk::ShaderStageFlagBits::eFragment, 0, upsample_push_consts)
+					.draw(3, 1, 0, 0);
+				m_timer.end(cbuf);
+			}});
 
-	rg.add_pass(ssao_pass);
-	rg.add_pass(blur_pass);
+		rg.attach_managed(
+			"ssao_blur_y", vuk::Format::eR16G16Sfloat, vuk::Dimension2D::absolute(width, height), vuk::Samples::e1, vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
+	}
 
-	rg.attach_managed("ssao", vuk::Format::eR16Sfloat, vuk::Dimension2D::absolute(m_width, m_height), vuk::Samples::e1, vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
+	// r = occlusion, g = view distance
+	rg.attach_managed("ssao", vuk::Format::eR16G16Sfloat, vuk::Dimension2D::absolute(width, height), vuk::Samples::e1, vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
 	rg.attach_managed(
-		"ssao_blurred", vuk::Format::eR16Sfloat, vuk::Dimension2D::absolute(m_width, m_height), vuk::Samples::e1, vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
+		"ssao_blur_x", vuk::Format::eR16G16Sfloat, vuk::Dimension2D::absolute(width, height), vuk::Samples::e1, vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
+	rg.attach_managed("ssao_blurred", vuk::Format::eR16G16Sfloat, vuk::Dimension2D::absolute(m_width, m_height), vuk::Samples::e1,
+		vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
 }
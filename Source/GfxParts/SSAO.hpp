@@ -3,6 +3,8 @@
 #include "GraphicsPass.hpp"
 #include "../Types.hpp"
 #include "../Perspective.hpp"
+#include "../GpuQueries.hpp"
+#include "TemporalHistory.hpp"
 
 #include <vuk/RenderGraph.hpp>
 #include <glm/mat4x4.hpp>
@@ -12,7 +14,15 @@
 	Screen-space ambient occlusion emulates parts of a scene where not much light can get to.
 	For example, the concave corners and edges of an object will be darker.
 
-	There are a few way to approach SSAO, but my Vuk implementation uses the two thin g-buffers rendered in GBufferPass (position + normal).
+	There are a few way to approach SSAO, but my Vuk implementation uses the two thin g-buffers rendered in GBufferPass (depth + normal).
+
+	The occlusion can be computed at full, half or quarter resolution. Every ssao pixel stores the view distance of the texel it was computed
+	for next to the occlusion, which drives a separable bilateral blur (so it doesn't bleed across depth edges) and, at the reduced
+	resolutions, a joint bilateral upsample against the full resolution depth. Either way the result ends up in ssao_blurred.
+
+	With temporal accumulation, every frame only uses a quarter of the kernel (a different one each frame, with shifted noise), and the raw
+	occlusion is blended with the reprojected history before the blur. History texels whose depth doesn't match are dropped, and the rest are
+	clamped to the range of their current neighbourhood.
 */
 
 namespace vuk {
@@ -22,6 +32,12 @@ class PerThreadContext;
 class SSAOPass : public GraphicsPass {
   public:
 	static constexpr u16 KERNEL_SIZE = 64;
+	// per frame, with temporal accumulation
+	static constexpr u16 TEMPORAL_SAMPLES = KERNEL_SIZE / 4;
+
+	enum class Resolution { Full, Half, Quarter };
+
+	static const char* resolution_name(Resolution resolution);
 
 	void init(vuk::PerThreadContext& ptc, struct Context& ctxt, struct UniformStore& uniforms, class PipelineStore& ps) override;
 	void prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) override;
@@ -29,6 +45,20 @@ class SSAOPass : public GraphicsPass {
 
   private:
 	u32 m_width, m_height;
+	Resolution m_resolution;
+	// full resolution pixels per ssao pixel
+	u32 m_scale;
+	u32 m_ssao_width, m_ssao_height;
+
+	bool m_temporal;
+	TemporalHistory m_history;
+
+	// the whole pass, from the ssao pixels to ssao_blurred
+	GpuTimer m_timer;
+	// what each of the timer's frames in flight measured
+	std::array<Resolution, vuk::Context::FC> m_timed_resolutions;
+	u32 m_frame;
+
 	vuk::Texture m_random_normal;
 	std::array<glm::vec3, KERNEL_SIZE> m_kernel;
 };
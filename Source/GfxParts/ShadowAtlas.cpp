@@ -0,0 +1,217 @@
+#include "ShadowAtlas.hpp"
+
+#include "../Context.hpp"
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <numeric>
+
+struct Shelf {
+	u32 y;
+	u32 height;
+	// where the next tile goes
+	u32 x;
+};
+
+// packs the tiles (in order) into shelves of the given width; empty if they end up taller than max_height
+static std::optional<std::vector<ShadowAtlas::Tile>> pack_shelves(
+	std::span<const u32> tile_sizes, std::span<const u32> order, u32 width, u32 max_height, u32& out_height) {
+	std::vector<ShadowAtlas::Tile> tiles(tile_sizes.size());
+	std::vector<Shelf> shelves;
+	u32 height = 0;
+
+	for (const u32 index : order) {
+		const u32 size = tile_sizes[index];
+
+		auto shelf = std::find_if(shelves.begin(), shelves.end(), [=](const Shelf& s) {
+			return s.height >= size && s.x + size <= width;
+		});
+
+		if (shelf == shelves.end()) {
+			if (height + size > max_height) {
+				return {};
+			}
+			shelves.push_back(Shelf{.y = height, .height = size, .x = 0});
+			height += size;
+			shelf = shelves.end() - 1;
+		}
+
+		tiles[index] = ShadowAtlas::Tile{.x = shelf->x, .y = shelf->y, .size = size};
+		shelf->x += size;
+	}
+
+	out_height = height;
+	return tiles;
+}
+
+vuk::Format ShadowAtlas::to_format(DepthFormat format) {
+	return format == DepthFormat::D16 ? vuk::Format::eD16Unorm : vuk::Format::eD32Sfloat;
+}
+
+u32 ShadowAtlas::texel_bytes(DepthFormat format) {
+	return format == DepthFormat::D16 ? 2 : 4;
+}
+
+std::optional<std::vector<ShadowAtlas::Tile>> ShadowAtlas::pack(std::span<const u32> tile_sizes, u32 max_dimension, vuk::Extent2D& out_extent) {
+	if (tile_sizes.empty()) {
+		out_extent = vuk::Extent2D{0, 0};
+		return std::vector<Tile>{};
+	}
+
+	std::vector<u32> order(tile_sizes.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](u32 a, u32 b) {
+		return tile_sizes[a] > tile_sizes[b];
+	});
+
+	const u32 largest = tile_sizes[order.front()];
+	const u32 smallest = tile_sizes[order.back()];
+	const u32 widest = std::min(max_dimension, std::accumulate(tile_sizes.begin(), tile_sizes.end(), 0u));
+
+	if (smallest == 0 || largest > max_dimension) {
+		return {};
+	}
+
+	// there's only a handful of tiles, so just try every width (in steps of the smallest tile) and keep the one that wastes the least
+	std::optional<std::vector<Tile>> best;
+	u64 best_area = 0;
+	for (u32 width = largest; width <= widest; width += smallest) {
+		u32 height = 0;
+		auto tiles = pack_shelves(tile_sizes, order, width, max_dimension, height);
+		if (!tiles) {
+			continue;
+		}
+
+		// the actual width might be less than what was available
+		u32 used_width = 0;
+		for (const auto& tile : *tiles) {
+			used_width = std::max(used_width, tile.x + tile.size);
+		}
+
+		const u64 area = static_cast<u64>(used_width) * height;
+		// prefer squarer atlases when the area is the same
+		if (!best || area < best_area || (area == best_area && std::max(used_width, height) < std::max(out_extent.width, out_extent.height))) {
+			best = std::move(tiles);
+			best_area = area;
+			out_extent = vuk::Extent2D{used_width, height};
+		}
+	}
+
+	return best;
+}
+
+ShadowAtlas::ShadowAtlas() : m_extent{0, 0}, m_format{DepthFormat::D32} {
+}
+
+bool ShadowAtlas::allocate(vuk::PerThreadContext& ptc, Context& ctxt, std::span<const u32> tile_sizes, DepthFormat format) {
+	vuk::Extent2D extent;
+	auto tiles = pack(tile_sizes, ctxt.vkb_physical_device.properties.limits.maxImageDimension2D, extent);
+	if (!tiles) {
+		spdlog::error("failed to pack {} shadow map tiles into an atlas", tile_sizes.size());
+		return false;
+	}
+
+	m_requested.assign(tile_sizes.begin(), tile_sizes.end());
+	m_tiles = std::move(*tiles);
+	m_extent = extent;
+	m_format = format;
+
+	if (m_tiles.empty()) {
+		m_view = {};
+		m_texture = {};
+		return true;
+	}
+
+	m_texture = ctxt.vuk_context->allocate_texture(vuk::ImageCreateInfo{
+		.imageType = vuk::ImageType::e2D,
+		.format = to_format(format),
+		.extent = vuk::Extent3D{extent.width, extent.height, 1},
+		.mipLevels = 1,
+		.arrayLayers = 1,
+		.samples = vuk::SampleCountFlagBits::e1,
+		.tiling = vuk::ImageTiling::eOptimal,
+		.usage = vuk::ImageUsageFlagBits::eSampled | vuk::ImageUsageFlagBits::eDepthStencilAttachment,
+		.sharingMode = vuk::SharingMode::eExclusive,
+	});
+
+	m_view = ptc.create_image_view(vuk::ImageViewCreateInfo{
+		.image = *m_texture.image,
+		.viewType = vuk::ImageViewType::e2D,
+		.format = to_format(format),
+		.subresourceRange =
+			vuk::ImageSubresourceRange{
+				.aspectMask = vuk::ImageAspectFlagBits::eDepth,
+				.baseMipLevel = 0,
+				.levelCount = 1,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+	});
+
+	spdlog::info("shadow atlas: {} tiles in {}x{} ({:.1f} MB, {:.0f}% used)", m_tiles.size(), extent.width, extent.height,
+		memory_bytes() / (1024.f * 1024.f), 100.f * used_texels() / (static_cast<f32>(extent.width) * extent.height));
+	return true;
+}
+
+bool ShadowAtlas::matches(std::span<const u32> tile_sizes, DepthFormat format) const {
+	return m_format == format && std::equal(tile_sizes.begin(), tile_sizes.end(), m_requested.begin(), m_requested.end());
+}
+
+const ShadowAtlas::Tile& ShadowAtlas::tile(u32 index) const {
+	return m_tiles[index];
+}
+
+u32 ShadowAtlas::tile_count() const {
+	return static_cast<u32>(m_tiles.size());
+}
+
+glm::vec4 ShadowAtlas::uv_rect(u32 index) const {
+	const Tile& t = m_tiles[index];
+	const f32 width = static_cast<f32>(m_extent.width);
+	const f32 height = static_cast<f32>(m_extent.height);
+	return glm::vec4{t.x / width, t.y / height, t.size / width, t.size / height};
+}
+
+vuk::Rect2D ShadowAtlas::rect(u32 index) const {
+	const Tile& t = m_tiles[index];
+	return vuk::Rect2D::absolute(static_cast<i32>(t.x), static_cast<i32>(t.y), t.size, t.size);
+}
+
+vuk::Image ShadowAtlas::image() const {
+	return *m_texture.image;
+}
+
+vuk::ImageView ShadowAtlas::view() const {
+	return *m_view;
+}
+
+vuk::Extent2D ShadowAtlas::extent() const {
+	return m_extent;
+}
+
+ShadowAtlas::DepthFormat ShadowAtlas::format() const {
+	return m_format;
+}
+
+vuk::ImageAttachment ShadowAtlas::attachment() const {
+	return vuk::ImageAttachment{
+		.image = *m_texture.image,
+		.image_view = *m_view,
+		.extent = m_extent,
+		.format = to_format(m_format),
+		.sample_count = vuk::Samples::e1,
+		.clear_value = vuk::ClearDepthStencil{1.f, 0},
+	};
+}
+
+u64 ShadowAtlas::memory_bytes() const {
+	return static_cast<u64>(m_extent.width) * m_extent.height * texel_bytes(m_format);
+}
+
+u64 ShadowAtlas::used_texels() const {
+	u64 texels = 0;
+	for (const auto& tile : m_tiles) {
+		texels += static_cast<u64>(tile.size) * tile.size;
+	}
+	return texels;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "../Types.hpp"
+
+#include <vuk/Image.hpp>
+#include <vuk/RenderGraph.hpp>
+#include <glm/vec4.hpp>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace vuk {
+class PerThreadContext;
+}
+
+/*
+	One 2D depth texture that any number of square shadow maps are packed into as tiles, so every shadow map can have its own resolution
+	without being padded out to the largest one (as an array texture would).
+
+	Tiles are placed with a shelf packer: largest first, each into the first shelf that still has room, or a new shelf below the others.
+	The width is picked to waste as little as possible, and the atlas is exactly as tall as its shelves.
+	Asking for a different set of tiles (or another format) re-allocates the texture, so that's not something to do every frame.
+*/
+
+class ShadowAtlas {
+  public:
+	enum class DepthFormat { D16, D32 };
+
+	struct Tile {
+		u32 x;
+		u32 y;
+		u32 size;
+	};
+
+	static vuk::Format to_format(DepthFormat format);
+	static u32 texel_bytes(DepthFormat format);
+
+	// packs tile_sizes into shelves; empty if they don't fit into max_dimension x max_dimension
+	static std::optional<std::vector<Tile>> pack(std::span<const u32> tile_sizes, u32 max_dimension, vuk::Extent2D& out_extent);
+
+	ShadowAtlas();
+
+	// keeps the current atlas (and returns false) if the tiles can't be packed into one image
+	bool allocate(vuk::PerThreadContext& ptc, struct Context& ctxt, std::span<const u32> tile_sizes, DepthFormat format);
+	// whether allocate() with these parameters would produce the current atlas
+	bool matches(std::span<const u32> tile_sizes, DepthFormat format) const;
+
+	const Tile& tile(u32 index) const;
+	u32 tile_count() const;
+	// xy = offset, zw = scale of the tile in atlas uv space
+	glm::vec4 uv_rect(u32 index) const;
+	vuk::Rect2D rect(u32 index) const;
+
+	vuk::Image image() const;
+	vuk::ImageView view() const;
+	vuk::Extent2D extent() const;
+	DepthFormat format() const;
+	// cleared to the far plane
+	vuk::ImageAttachment attachment() const;
+
+	u64 memory_bytes() const;
+	// texels that actually belong to a tile
+	u64 used_texels() const;
+
+  private:
+	vuk::Texture m_texture;
+	vuk::Unique<vuk::ImageView> m_view;
+
+	std::vector<u32> m_requested;
+	std::vector<Tile> m_tiles;
+	vuk::Extent2D m_extent;
+	DepthFormat m_format;
+};
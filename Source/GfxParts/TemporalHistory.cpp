@@ -0,0 +1,77 @@
+#include "TemporalHistory.hpp"
+
+#include "../Context.hpp"
+
+#include <vuk/Context.hpp>
+
+TemporalHistory::TemporalHistory() : m_used{}, m_extent{0, 0}, m_format{vuk::Format::eUndefined}, m_current{0} {
+}
+
+void TemporalHistory::resize(vuk::PerThreadContext& ptc, Context& ctxt, vuk::Extent2D extent, vuk::Format format) {
+	if (extent.width == m_extent.width && extent.height == m_extent.height && format == m_format) {
+		return;
+	}
+
+	m_extent = extent;
+	m_format = format;
+
+	for (u32 i = 0; i < 2; ++i) {
+		m_textures[i] = ctxt.vuk_context->allocate_texture(vuk::ImageCreateInfo{
+			.imageType = vuk::ImageType::e2D,
+			.format = format,
+			.extent = vuk::Extent3D{extent.width, extent.height, 1},
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = vuk::SampleCountFlagBits::e1,
+			.tiling = vuk::ImageTiling::eOptimal,
+			.usage = vuk::ImageUsageFlagBits::eSampled | vuk::ImageUsageFlagBits::eColorAttachment,
+			.sharingMode = vuk::SharingMode::eExclusive,
+		});
+
+		m_views[i] = ptc.create_image_view(vuk::ImageViewCreateInfo{
+			.image = *m_textures[i].image,
+			.viewType = vuk::ImageViewType::e2D,
+			.format = format,
+			.subresourceRange =
+				vuk::ImageSubresourceRange{
+					.aspectMask = vuk::ImageAspectFlagBits::eColor,
+					.baseMipLevel = 0,
+					.levelCount = 1,
+					.baseArrayLayer = 0,
+					.layerCount = 1,
+				},
+		});
+	}
+
+	m_used = {};
+	m_last_frame.reset();
+}
+
+bool TemporalHistory::attach(vuk::RenderGraph& rg, vuk::Name read_name, vuk::Name write_name, u64 frame) {
+	const bool valid = m_last_frame && *m_last_frame + 1 == frame;
+	m_last_frame = frame;
+
+	m_current = 1 - m_current;
+	const u32 previous = 1 - m_current;
+
+	// both end up sampled: the write target by this frame's consumers and the next frame's reads, the read by the frame that overwrites it
+	rg.attach_image(write_name, attachment(m_current), m_used[m_current] ? vuk::Access::eFragmentSampled : vuk::Access::eNone,
+		vuk::Access::eFragmentSampled);
+	rg.attach_image(read_name, attachment(previous), m_used[previous] ? vuk::Access::eFragmentSampled : vuk::Access::eNone,
+		vuk::Access::eFragmentSampled);
+
+	m_used[m_current] = true;
+	m_used[previous] = true;
+	return valid;
+}
+
+vuk::ImageAttachment TemporalHistory::attachment(u32 index) const {
+	return vuk::ImageAttachment{
+		.image = *m_textures[index].image,
+		.image_view = *m_views[index],
+		.extent = m_extent,
+		.format = m_format,
+		.sample_count = vuk::Samples::e1,
+		.clear_value = vuk::ClearColor{0.f, 0.f, 0.f, 0.f},
+	};
+}
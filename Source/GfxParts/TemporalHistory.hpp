@@ -0,0 +1,47 @@
+#pragma once
+
+#include "../Types.hpp"
+
+#include <vuk/Image.hpp>
+#include <vuk/RenderGraph.hpp>
+#include <array>
+#include <optional>
+
+namespace vuk {
+class PerThreadContext;
+}
+
+/*
+	A pair of persistent images for effects that accumulate over frames: every frame one of them is written, while the other (last frame's
+	result) is read back, reprojected with RenderInfo::prev_view_proj. They swap every frame.
+
+	The shaders' side of it (reprojection, the blend weight) is in temporal.glsl; clamping the history to the current frame's neighbourhood
+	is up to each effect, since it depends on what's stored.
+*/
+
+class TemporalHistory {
+  public:
+	TemporalHistory();
+
+	// re-allocates both images if the extent or format changed, which throws the history away
+	void resize(vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::Extent2D extent, vuk::Format format);
+
+	// attaches last frame's result as read_name and this frame's target as write_name; returns whether read_name really holds the result of
+	// frame - 1 (it doesn't on the first frame, after a resize, or if a frame was skipped), if not the shaders should ignore it
+	bool attach(vuk::RenderGraph& rg, vuk::Name read_name, vuk::Name write_name, u64 frame);
+
+  private:
+	vuk::ImageAttachment attachment(u32 index) const;
+
+	std::array<vuk::Texture, 2> m_textures;
+	std::array<vuk::Unique<vuk::ImageView>, 2> m_views;
+	// whether the image has been through a frame (and so has to be waited on before it's overwritten)
+	std::array<bool, 2> m_used;
+
+	vuk::Extent2D m_extent;
+	vuk::Format m_format;
+
+	// the one written this frame
+	u32 m_current;
+	std::optional<u64> m_last_frame;
+};
@@ -3,9 +3,13 @@
 #include "../Context.hpp"
 #include "../Resource.hpp"
 #include "../Renderer.hpp"
+#include "../CpuTrace.hpp"
 
 #include <vuk/RenderGraph.hpp>
 #include <vuk/CommandBuffer.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cmath>
 
 void VolumetricLightPass::debug(vuk::CommandBuffer& cbuf) {
 	cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
@@ -19,6 +23,13 @@ void VolumetricLightPass::debug(vuk::CommandBuffer& cbuf) {
 void VolumetricLightPass::init(vuk::PerThreadContext& ptc, struct Context& ctxt, struct UniformStore& uniforms, PipelineStore& ps) {
 	ps.add("volumetric_light", "volumetric_light.vert", "volumetric_light.frag");
 	ps.add("volumetric_light_blur", "volumetric_light_blur.vert", "volumetric_light_blur.frag");
+	ps.add("volumetric_light_temporal", "volumetric_light_blur.vert", "volumetric_light_temporal.frag");
+	ps.add("volumetric_march_depth", "volumetric_light_blur.vert", "volumetric_march_depth.frag");
+
+	m_scale = 1;
+	m_timer.init(ctxt);
+	m_timed_scales.fill(1);
+	m_frame = 0;
 
 	m_verts = ctxt.vuk_context->allocate_buffer(
 		vuk::MemoryUsage::eGPUonly, vuk::BufferUsageFlagBits::eVertexBuffer | vuk::BufferUsageFlagBits::eTransferDst, 4, sizeof(Vertex));
@@ -34,15 +45,36 @@ void VolumetricLightPass::init(vuk::PerThreadContext& ptc, struct Context& ctxt,
 }
 
 void VolumetricLightPass::prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) {
+	TRACE_ZONE("VolumetricLightPass::prep");
+
 	m_width = info.window_width;
 	m_height = info.window_height;
+	m_scale = std::max(info.volumetric_downscale, 1u);
+	m_march_width = (m_width + m_scale - 1) / m_scale;
+	m_march_height = (m_height + m_scale - 1) / m_scale;
+	m_near = info.cam_proj.near;
+	m_far = info.cam_proj.far;
+
+	m_temporal = info.temporal;
+	if (m_temporal) {
+		m_history.resize(ptc, ctxt, vuk::Extent2D{m_march_width, m_march_height}, vuk::Format::eR16G16B16A16Sfloat);
+	}
+
+	const u32 slot = ++m_frame % vuk::Context::FC;
+	if (const auto ms = m_timer.next_frame()) {
+		spdlog::debug("volumetric light (1/{} resolution): {:.3f} ms", m_timed_scales[slot], *ms);
+	}
+	m_timed_scales[slot] = m_scale;
 }
 
 void VolumetricLightPass::render(
 	vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::RenderGraph& rg, const class SceneRenderer& renderer, struct RenderInfo& info) {
+	TRACE_ZONE("VolumetricLightPass::render");
+
 	struct Uniforms {
 		f32 cascade_splits[CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT];
 		glm::mat4 cascade_view_proj_mats[CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT];
+		glm::vec4 cascade_atlas_rects[CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT];
 		glm::mat4 inv_view;
 		glm::vec3 light_direction;
 		f32 _pad;
@@ -60,6 +92,7 @@ void VolumetricLightPass::render(
 	for (u8 i = 0; i < CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT; ++i) {
 		uniforms.cascade_splits[i] = info.cascades[i].split_depth;
 		uniforms.cascade_view_proj_mats[i] = info.cascades[i].view_proj_mat;
+		uniforms.cascade_atlas_rects[i] = info.cascades[i].atlas_rect;
 	}
 
 	uniforms.inv_view = glm::inverse(info.cam_view);
@@ -74,54 +107,137 @@ void VolumetricLightPass::render(
 	auto [bcam, stub2] = ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eUniformBuffer, std::span{&camera, 1});
 	auto cam = bcam;
 
-	ptc.wait_all_transfers();
+	TRACE_CALL("wait_all_transfers", ptc.wait_all_transfers());
+
+	struct PushConstants {
+		glm::vec2 screen_size;
+		u32 scale;
+		i32 num_steps;
+		f32 dither_offset;
+	} push_consts{glm::vec2{m_width, m_height}, m_scale, STEPS, 0.f};
+
+	if (m_temporal) {
+		push_consts.num_steps = TEMPORAL_STEPS;
+		// golden ratio sequence, so consecutive frames fill in between each other's steps
+		push_consts.dither_offset = std::fmod(static_cast<f32>(info.frame % 1024) * 0.6180339887f, 1.f);
+	}
+
+	info.profiler->add_pass(rg, "volumetric depth",
+		vuk::Pass{.resources = {"volumetric_march_depth"_image(vuk::eColorWrite), "depth_prepass"_image(vuk::eFragmentSampled)},
+		.execute = [this](vuk::CommandBuffer& cbuf) {
+			m_timer.begin(cbuf);
+
+			cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
+				.set_scissor(0, vuk::Rect2D::framebuffer())
+				.bind_graphics_pipeline("volumetric_march_depth")
+				.bind_sampled_image(0, 0, "depth_prepass", {})
+				.push_constants(vuk::ShaderStageFlagBits::eFragment, 0, m_scale)
+				.draw(3, 1, 0, 0);
+		}});
 
-	rg.add_pass(vuk::Pass{.resources =
+	info.profiler->add_pass(rg, "volumetric raymarch", vuk::Pass{.resources =
 							  {
 								  "volumetric_light"_image(vuk::eColorWrite),
 								  "volumetric_depth"_image(vuk::eDepthStencilRW),
-								  "g_position"_image(vuk::eFragmentSampled),
-								  "depth_prepass"_image(vuk::eFragmentSampled),
+								  "volumetric_march_depth"_image(vuk::eFragmentSampled),
+								  vuk::Resource{CascadedShadowRenderPass::ATLAS_ATTACHMENT_NAME, vuk::Resource::Type::eImage, vuk::eFragmentSampled},
 							  },
-		.execute = [this, info, ubo, cam](vuk::CommandBuffer& cbuf) {
+		.execute = [this, info, ubo, cam, push_consts](vuk::CommandBuffer& cbuf) {
 			const auto sci = vuk::SamplerCreateInfo{
 				.addressModeU = vuk::SamplerAddressMode::eClampToEdge,
 				.addressModeV = vuk::SamplerAddressMode::eClampToEdge,
 				.addressModeW = vuk::SamplerAddressMode::eClampToEdge,
 			};
 
-			cbuf.set_viewport(0, vuk::Rect2D::absolute(0, 0, m_width, m_height))
-				.set_scissor(0, vuk::Rect2D::absolute(0, 0, m_width, m_height))
+			cbuf.set_viewport(0, vuk::Rect2D::absolute(0, 0, m_march_width, m_march_height))
+				.set_scissor(0, vuk::Rect2D::absolute(0, 0, m_march_width, m_march_height))
 				.bind_vertex_buffer(
 					0, m_verts, 0, vuk::Packed{vuk::Format::eR32G32B32Sfloat, vuk::Ignore{vuk::Format::eR32G32B32Sfloat}, vuk::Format::eR32G32Sfloat})
 				.bind_index_buffer(m_inds, vuk::IndexType::eUint32)
 				.bind_graphics_pipeline("volumetric_light")
 				.bind_uniform_buffer(0, 0, cam)
-				.bind_sampled_image(0, 1, "g_position", sci)
-				.bind_sampled_image(0, 2, info.shadow_map, sci)
-				.bind_sampled_image(0, 3, "depth_prepass", sci)
+				.bind_sampled_image(0, 2, CascadedShadowRenderPass::ATLAS_ATTACHMENT_NAME, sci)
+				.bind_sampled_image(0, 3, "volumetric_march_depth", sci)
 				.bind_uniform_buffer(0, 4, ubo)
+				.push_constants(vuk::ShaderStageFlagBits::eFragment, 0, push_consts)
 				.draw_indexed(6, 1, 0, 0, 0);
 		}});
 
-	rg.add_pass(vuk::Pass{.resources = {"volumetric_light_blurred"_image(vuk::eColorWrite), "volumetric_light"_image(vuk::eFragmentSampled)},
-		.execute = [this](vuk::CommandBuffer& cbuf) {
+	const auto sci = vuk::SamplerCreateInfo{
+		.magFilter = vuk::Filter::eLinear,
+		.minFilter = vuk::Filter::eLinear,
+		.addressModeU = vuk::SamplerAddressMode::eClampToEdge,
+		.addressModeV = vuk::SamplerAddressMode::eClampToEdge,
+		.addressModeW = vuk::SamplerAddressMode::eClampToEdge,
+	};
+
+	if (m_temporal) {
+		const bool history_valid = m_history.attach(rg, "volumetric_light_history_prev", "volumetric_light_history", info.frame);
+
+		struct TemporalParams {
+			glm::mat4 inv_view_proj;
+			glm::mat4 prev_view_proj;
+			glm::vec2 screen_size;
+			u32 scale;
+			u32 history_valid;
+		} temporal_params{camera.inv_view_proj, info.prev_view_proj, glm::vec2{m_width, m_height}, m_scale, history_valid ? 1u : 0u};
+
+		auto [btemporal, temporalstub] =
+			ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eUniformBuffer, std::span{&temporal_params, 1});
+		auto temporal_ubo = btemporal;
+		TRACE_CALL("wait_all_transfers", ptc.wait_all_transfers());
+
+		info.profiler->add_pass(rg, "volumetric temporal",
+			vuk::Pass{.resources = {"volumetric_light_history"_image(vuk::eColorWrite), "volumetric_light"_image(vuk::eFragmentSampled),
+						  "volumetric_light_history_prev"_image(vuk::eFragmentSampled), "volumetric_march_depth"_image(vuk::eFragmentSampled)},
+			.execute = [temporal_ubo, sci](vuk::CommandBuffer& cbuf) {
+				cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
+					.set_scissor(0, vuk::Rect2D::framebuffer())
+					.bind_graphics_pipeline("volumetric_light_temporal")
+					.bind_sampled_image(0, 0, "volumetric_light", sci)
+					// reprojected, so it's the one that gets filtered
+					.bind_sampled_image(0, 1, "volumetric_light_history_prev", sci)
+					.bind_sampled_image(0, 2, "volumetric_march_depth", {})
+					.bind_uniform_buffer(0, 3, temporal_ubo)
+					.draw(3, 1, 0, 0);
+			}});
+	}
+
+	const vuk::Name blur_source = m_temporal ? "volumetric_light_history" : "volumetric_light";
+	info.profiler->add_pass(rg, "volumetric blur", vuk::Pass{.resources = {"volumetric_light_blurred"_image(vuk::eColorWrite),
+							  m_temporal ? "volumetric_light_history"_image(vuk::eFragmentSampled) : "volumetric_light"_image(vuk::eFragmentSampled)},
+		.execute = [this, blur_source, sci](vuk::CommandBuffer& cbuf) {
 			cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
-				.set_scissor(0, vuk::Rect2D::absolute(0, 0, m_width, m_height))
+				.set_scissor(0, vuk::Rect2D::framebuffer())
 				.bind_graphics_pipeline("volumetric_light_blur")
-				.bind_sampled_image(0, 0, "volumetric_light",
-					vuk::SamplerCreateInfo{
-						.addressModeU = vuk::SamplerAddressMode::eClampToEdge,
-						.addressModeV = vuk::SamplerAddressMode::eClampToEdge,
-						.addressModeW = vuk::SamplerAddressMode::eClampToEdge,
-					})
+				.bind_sampled_image(0, 0, blur_source, sci)
 				.draw(3, 1, 0, 0);
+
+			m_timer.end(cbuf);
 		}});
 
-	rg.attach_managed("volumetric_light", vuk::Format::eR16G16B16A16Sfloat, vuk::Dimension2D::absolute(m_width, m_height), vuk::Samples::e1,
-		vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
-	rg.attach_managed("volumetric_light_blurred", vuk::Format::eR16G16B16A16Sfloat, vuk::Dimension2D::absolute(m_width, m_height), vuk::Samples::e1,
-		vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
-	rg.attach_managed(
-		"volumetric_depth", vuk::Format::eD32Sfloat, vuk::Dimension2D::absolute(m_width, m_height), vuk::Samples::e1, vuk::ClearDepthStencil{1.f, 0});
+	const auto march_size = vuk::Dimension2D::absolute(m_march_width, m_march_height);
+	rg.attach_managed("volumetric_march_depth", vuk::Format::eR32Sfloat, march_size, vuk::Samples::e1, vuk::ClearColor{1.f, 1.f, 1.f, 1.f});
+	rg.attach_managed("volumetric_light", vuk::Format::eR16G16B16A16Sfloat, march_size, vuk::Samples::e1, vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
+	rg.attach_managed("volumetric_light_blurred", vuk::Format::eR16G16B16A16Sfloat, march_size, vuk::Samples::e1, vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
+	rg.attach_managed("volumetric_depth", vuk::Format::eD32Sfloat, march_size, vuk::Samples::e1, vuk::ClearDepthStencil{1.f, 0});
+}
+
+void VolumetricLightPass::composite(vuk::CommandBuffer& cbuf, vuk::Name base, const vuk::SamplerCreateInfo& base_sampler) const {
+	// the upsample only texelFetches
+	struct PushConstants {
+		f32 near;
+		f32 far;
+		u32 scale;
+	} push_consts{m_near, m_far, m_scale};
+
+	cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
+		.set_scissor(0, vuk::Rect2D::framebuffer())
+		.bind_graphics_pipeline("composite")
+		.bind_sampled_image(0, 0, base, base_sampler)
+		.bind_sampled_image(0, 1, "volumetric_light_blurred", {})
+		.bind_sampled_image(0, 2, "volumetric_march_depth", {})
+		.bind_sampled_image(0, 3, "depth_prepass", {})
+		.push_constants(vuk::ShaderStageFlagBits::eFragment, 0, push_consts)
+		.draw(3, 1, 0, 0);
 }
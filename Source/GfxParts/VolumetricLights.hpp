@@ -5,14 +5,25 @@
 
 	The basic idea is to start at each pixel position (sampled from the g-buffer) and raymarch towards the camera.
 	At each step in the raymarch, check if the position is visible to the light. The shadow map can be leveraged for this.
+
+	With temporal accumulation the raymarch takes fewer steps, and the dither that offsets them moves every frame; the result is blended with
+	the reprojected history (clamped to the current neighbourhood) before the blur.
+
+	The raymarch (and everything after it) can run at a fraction of the window's resolution (RenderInfo::volumetric_downscale). Each pixel
+	then marches to either the closest or the furthest depth of the block it covers, alternating in a checkerboard, and composite() upsamples
+	the result against the full resolution depth, picking the texels that marched to the pixel's own side of any depth edge.
 */
 
 #include "GraphicsPass.hpp"
 #include "CascadedShadows.hpp"
 #include "../Mesh.hpp"
 #include "../Perspective.hpp"
+#include "TemporalHistory.hpp"
+#include "../GpuQueries.hpp"
 
 #include <vuk/Image.hpp>
+#include <vuk/Context.hpp>
+#include <array>
 
 namespace vuk {
 struct RenderGraph;
@@ -27,8 +38,29 @@ class VolumetricLightPass : public GraphicsPass {
 	void prep(vuk::PerThreadContext& ptc, struct Context& ctxt, struct RenderInfo& info) override;
 	void render(vuk::PerThreadContext& ptc, struct Context& ctxt, vuk::RenderGraph& rg, const class SceneRenderer& renderer, struct RenderInfo& info) override;
 
+	// draws base (the lit scene) with the volumetric light added, with composite.frag; the pass must sample volumetric_light_blurred,
+	// volumetric_march_depth and depth_prepass
+	void composite(vuk::CommandBuffer& cbuf, vuk::Name base, const vuk::SamplerCreateInfo& base_sampler) const;
+
   private:
+	static constexpr i32 STEPS = 10;
+	static constexpr i32 TEMPORAL_STEPS = 4;
+
 	u32 m_width, m_height;
+	// full resolution pixels per raymarched pixel
+	u32 m_scale;
+	u32 m_march_width, m_march_height;
+	f32 m_near, m_far;
+
+	// from the depth downsample to volumetric_light_blurred
+	GpuTimer m_timer;
+	// what each of the timer's frames in flight measured
+	std::array<u32, vuk::Context::FC> m_timed_scales;
+	u32 m_frame;
+
+	bool m_temporal;
+	TemporalHistory m_history;
+
 	vuk::Buffer m_verts;
 	vuk::Buffer m_inds;
 };
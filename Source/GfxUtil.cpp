@@ -111,6 +111,25 @@ vuk::Texture alloc_lut(u32 width, u32 height, vuk::PerThreadContext& ptc) {
 	return texture;
 }
 
+std::optional<vuk::Texture> load_lut(std::string_view path, u32 width, u32 height, vuk::PerThreadContext& ptc) {
+	auto resource = get_resource(path);
+
+	// raw R16G16 texels, as written by brdf_lut_generator
+	const u64 expected_size = static_cast<u64>(width) * height * 2 * sizeof(u16);
+	if (resource.size != expected_size) {
+		spdlog::error("LUT {} is {} bytes, expected {}", path, resource.size, expected_size);
+		return {};
+	}
+
+	auto tex = alloc_lut(width, height, ptc);
+
+	ptc.upload(*tex.image, vuk::Format::eR16G16Sfloat, vuk::Extent3D{width, height, 1u}, 0,
+		std::span(resource.data, resource.size), false);
+	ptc.wait_all_transfers();
+
+	return tex;
+}
+
 u64 uniform_buffer_offset_alignment(Context& ctxt, u64 min) {
 	return std::max(ctxt.vkb_physical_device.properties.limits.minUniformBufferOffsetAlignment, min);
 }
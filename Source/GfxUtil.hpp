@@ -2,6 +2,7 @@
 
 #include "Types.hpp"
 
+#include <optional>
 #include <string_view>
 #include <vuk/Context.hpp>
 
@@ -14,6 +15,8 @@ vuk::Texture load_mipmapped_texture(std::string_view path, vuk::PerThreadContext
 vuk::Texture load_cubemap_texture(std::string_view path, vuk::PerThreadContext& ptc, bool flip = true);
 vuk::Texture alloc_cubemap(u32 width, u32 height, vuk::PerThreadContext& ptc, u32 mips = 1);
 vuk::Texture alloc_lut(u32 width, u32 height, vuk::PerThreadContext& ptc);
+// raw R16G16 half floats; empty (and logged) unless the resource is exactly width * height texels
+std::optional<vuk::Texture> load_lut(std::string_view path, u32 width, u32 height, vuk::PerThreadContext& ptc);
 
 u64 uniform_buffer_offset_alignment(struct Context& ctxt, u64 min);
 
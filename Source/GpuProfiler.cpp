@@ -0,0 +1,162 @@
+#include "GpuProfiler.hpp"
+
+#include "Context.hpp"
+
+#include <vuk/CommandBuffer.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+// a begin/end pair per pass, MAX_PASSES pairs per slice
+static constexpr u32 QUERIES_PER_SLICE = 2 * GpuProfiler::MAX_PASSES;
+
+GpuProfiler::GpuProfiler() : m_device{VK_NULL_HANDLE}, m_pool{VK_NULL_HANDLE}, m_period{0.0}, m_frame{0}, m_warned_full{false} {
+}
+
+GpuProfiler::~GpuProfiler() {
+	if (m_pool != VK_NULL_HANDLE) {
+		vkDeviceWaitIdle(m_device);
+		vkDestroyQueryPool(m_device, m_pool, nullptr);
+	}
+}
+
+void GpuProfiler::init(Context& ctxt) {
+	if (!ctxt.timestamps) {
+		return;
+	}
+
+	m_device = ctxt.device;
+	m_period = ctxt.vkb_physical_device.properties.limits.timestampPeriod;
+
+	const VkQueryPoolCreateInfo pool_info{
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = QUERIES_PER_SLICE * vuk::Context::FC,
+	};
+	vkCreateQueryPool(m_device, &pool_info, nullptr, &m_pool);
+	vkResetQueryPool(m_device, m_pool, 0, QUERIES_PER_SLICE * vuk::Context::FC);
+
+	for (auto& recorded : m_recorded) {
+		recorded.reserve(MAX_PASSES);
+	}
+}
+
+void GpuProfiler::next_frame() {
+	if (m_pool == VK_NULL_HANDLE) {
+		return;
+	}
+
+	const u32 slice = ++m_frame % vuk::Context::FC;
+	auto& recorded = m_recorded[slice];
+	m_frame_ms.reset();
+	if (recorded.empty()) {
+		return;
+	}
+
+	// vuk::Context::begin() already waited for the frame that last used this slice
+	std::vector<f64> frame_ms(m_scopes.size(), 0.0);
+	std::vector<bool> seen(m_scopes.size(), false);
+	const u32 first_query = slice * QUERIES_PER_SLICE;
+	u64 frame_begin = std::numeric_limits<u64>::max();
+	u64 frame_end = 0;
+
+	for (u32 i = 0; i < recorded.size(); ++i) {
+		if (!recorded[i].written) {
+			continue;
+		}
+
+		std::array<u64, 2> ticks;
+		const VkResult result = vkGetQueryPoolResults(
+			m_device, m_pool, first_query + 2 * i, 2, sizeof(ticks), ticks.data(), sizeof(u64), VK_QUERY_RESULT_64_BIT);
+		if (result == VK_SUCCESS) {
+			frame_ms[recorded[i].scope] += static_cast<f64>(ticks[1] - ticks[0]) * m_period / 1e6;
+			seen[recorded[i].scope] = true;
+			frame_begin = std::min(frame_begin, ticks[0]);
+			frame_end = std::max(frame_end, ticks[1]);
+		}
+	}
+	if (frame_begin <= frame_end) {
+		m_frame_ms = static_cast<f64>(frame_end - frame_begin) * m_period / 1e6;
+	}
+
+	vkResetQueryPool(m_device, m_pool, first_query, 2 * static_cast<u32>(recorded.size()));
+	recorded.clear();
+
+	for (u32 s = 0; s < m_scopes.size(); ++s) {
+		if (!seen[s]) {
+			continue;
+		}
+
+		auto& history = m_history[s];
+		history.ms[history.next] = frame_ms[s];
+		history.next = (history.next + 1) % AVERAGE_FRAMES;
+		history.count = std::min(history.count + 1, AVERAGE_FRAMES);
+
+		// summed from scratch, so nothing drifts
+		m_scopes[s].last_ms = frame_ms[s];
+		m_scopes[s].average_ms = std::accumulate(history.ms.begin(), history.ms.begin() + history.count, 0.0) / history.count;
+	}
+}
+
+void GpuProfiler::add_pass(vuk::RenderGraph& rg, std::string_view name, vuk::Pass pass) {
+	const u32 slice = m_frame % vuk::Context::FC;
+	auto& recorded = m_recorded[slice];
+
+	if (m_pool == VK_NULL_HANDLE || recorded.size() == MAX_PASSES) {
+		if (m_pool != VK_NULL_HANDLE && !m_warned_full) {
+			spdlog::warn("gpu profiler: more than {} passes in a frame, the rest aren't timed", MAX_PASSES);
+			m_warned_full = true;
+		}
+		rg.add_pass(std::move(pass));
+		return;
+	}
+
+	const u32 index = static_cast<u32>(recorded.size());
+	const u32 query = slice * QUERIES_PER_SLICE + 2 * index;
+	recorded.push_back(Recorded{.scope = scope_index(name), .written = false});
+
+	// runs when the graph is executed, before next_frame() comes back to this slice
+	pass.execute = [this, slice, index, query, execute = std::move(pass.execute)](vuk::CommandBuffer& cbuf) {
+		vkCmdWriteTimestamp(cbuf.command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_pool, query);
+		if (execute) {
+			execute(cbuf);
+		}
+		vkCmdWriteTimestamp(cbuf.command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_pool, query + 1);
+		m_recorded[slice][index].written = true;
+	};
+	rg.add_pass(std::move(pass));
+}
+
+std::span<const GpuProfiler::Scope> GpuProfiler::scopes() const {
+	return m_scopes;
+}
+
+std::optional<f64> GpuProfiler::frame_ms() const {
+	return m_frame_ms;
+}
+
+void GpuProfiler::log() const {
+	if (m_scopes.empty()) {
+		spdlog::info("gpu profiler: nothing timed{}", m_pool == VK_NULL_HANDLE ? " (no timestamp support)" : "");
+		return;
+	}
+
+	f64 total_ms = 0.0;
+	for (const auto& scope : m_scopes) {
+		spdlog::info("{:>24}: {:7.3f} ms", scope.name, scope.average_ms);
+		total_ms += scope.average_ms;
+	}
+	spdlog::info("{:>24}: {:7.3f} ms (averages of the last {} frames)", "total", total_ms, AVERAGE_FRAMES);
+}
+
+u32 GpuProfiler::scope_index(std::string_view name) {
+	const auto it = std::find_if(m_scopes.begin(), m_scopes.end(), [name](const Scope& scope) { return scope.name == name; });
+	if (it != m_scopes.end()) {
+		return static_cast<u32>(it - m_scopes.begin());
+	}
+
+	m_scopes.push_back(Scope{.name = std::string{name}, .last_ms = 0.0, .average_ms = 0.0});
+	m_history.push_back(History{.ms = {}, .count = 0, .next = 0});
+	return static_cast<u32>(m_scopes.size() - 1);
+}
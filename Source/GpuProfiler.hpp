@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Types.hpp"
+
+#include <vulkan/vulkan.h>
+#include <vuk/Context.hpp>
+#include <vuk/RenderGraph.hpp>
+#include <array>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+	GPU time per render graph pass: every pass added through add_pass() gets a timestamp written before and after its commands, and passes
+	added under the same name are added up (so the cascades, the bloom chain or the blurs show up as one scope each).
+
+	The queries are a ring of vuk::Context::FC slices of one pool, read back and reset from the host like GpuTimer, so the results are
+	vuk::Context::FC frames old. Each scope keeps its last AVERAGE_FRAMES measurements for a rolling average.
+
+	A pass doesn't have to be in the same render pass (or even run) as any other, but timestamps inside a render pass only say when the
+	commands got through the pipeline, so overlapping work ends up in both neighbours. Without Context::timestamps add_pass just adds the pass.
+
+	The whole frame's time is taken from the same timestamps, from the earliest begin to the latest end of all its passes, so it doesn't
+	depend on which pass the render graph happens to schedule first or last.
+*/
+
+class GpuProfiler {
+  public:
+	// per frame; passes past that aren't timed
+	static constexpr u32 MAX_PASSES = 128;
+	static constexpr u32 AVERAGE_FRAMES = 64;
+
+	struct Scope {
+		std::string name;
+		// of the last frame the scope was recorded in
+		f64 last_ms;
+		// over its last AVERAGE_FRAMES frames (or fewer, to begin with)
+		f64 average_ms;
+	};
+
+	GpuProfiler();
+	~GpuProfiler();
+
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	void init(struct Context& ctxt);
+
+	// call once per frame after vuk::Context::begin(), before the first add_pass(); reads back the frame that used the slice last
+	void next_frame();
+
+	// rg.add_pass(pass), timed under name
+	void add_pass(vuk::RenderGraph& rg, std::string_view name, vuk::Pass pass);
+
+	// in the order they were first added
+	std::span<const Scope> scopes() const;
+	// from the first timed pass' start to the last one's end, of the frame next_frame() read back last; empty without one
+	std::optional<f64> frame_ms() const;
+	// every scope's average, at info level
+	void log() const;
+
+  private:
+	struct Recorded {
+		u32 scope;
+		// the pass actually got executed
+		bool written;
+	};
+
+	struct History {
+		std::array<f64, AVERAGE_FRAMES> ms;
+		u32 count;
+		u32 next;
+	};
+
+	u32 scope_index(std::string_view name);
+
+	VkDevice m_device;
+	VkQueryPool m_pool;
+	// nanoseconds per tick
+	f64 m_period;
+
+	// per slice: the passes added in the frame that used it last, in query order
+	std::array<std::vector<Recorded>, vuk::Context::FC> m_recorded;
+	u32 m_frame;
+	bool m_warned_full;
+
+	std::vector<Scope> m_scopes;
+	std::vector<History> m_history;
+	std::optional<f64> m_frame_ms;
+};
@@ -0,0 +1,138 @@
+#include "GpuQueries.hpp"
+
+#include "Context.hpp"
+
+#include <vuk/CommandBuffer.hpp>
+
+// the results come back in the order of the bits
+static constexpr VkQueryPipelineStatisticFlags STATISTICS =
+	VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+PipelineStatisticsQuery::PipelineStatisticsQuery() : m_device{VK_NULL_HANDLE}, m_pool{VK_NULL_HANDLE}, m_written{}, m_frame{0} {
+}
+
+PipelineStatisticsQuery::~PipelineStatisticsQuery() {
+	if (m_pool != VK_NULL_HANDLE) {
+		// unlike vuk's resources, nothing defers this until the last frame that used it is done
+		vkDeviceWaitIdle(m_device);
+		vkDestroyQueryPool(m_device, m_pool, nullptr);
+	}
+}
+
+void PipelineStatisticsQuery::init(Context& ctxt) {
+	if (!ctxt.pipeline_statistics) {
+		return;
+	}
+
+	m_device = ctxt.device;
+
+	const VkQueryPoolCreateInfo pool_info{
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+		.queryCount = vuk::Context::FC,
+		.pipelineStatistics = STATISTICS,
+	};
+	vkCreateQueryPool(m_device, &pool_info, nullptr, &m_pool);
+	vkResetQueryPool(m_device, m_pool, 0, vuk::Context::FC);
+}
+
+std::optional<PipelineStatisticsQuery::Result> PipelineStatisticsQuery::next_frame() {
+	if (m_pool == VK_NULL_HANDLE) {
+		return {};
+	}
+
+	const u32 query = ++m_frame % vuk::Context::FC;
+	if (!m_written[query]) {
+		return {};
+	}
+	m_written[query] = false;
+
+	// vuk::Context::begin() already waited for the frame that last used this query, so it's available
+	std::array<u64, 2> data;
+	const VkResult result =
+		vkGetQueryPoolResults(m_device, m_pool, query, 1, sizeof(data), data.data(), sizeof(u64), VK_QUERY_RESULT_64_BIT);
+	vkResetQueryPool(m_device, m_pool, query, 1);
+
+	if (result != VK_SUCCESS) {
+		return {};
+	}
+	return Result{.vertex_invocations = data[0], .fragment_invocations = data[1]};
+}
+
+void PipelineStatisticsQuery::begin(vuk::CommandBuffer& cbuf) {
+	if (m_pool != VK_NULL_HANDLE) {
+		vkCmdBeginQuery(cbuf.command_buffer, m_pool, m_frame % vuk::Context::FC, 0);
+	}
+}
+
+void PipelineStatisticsQuery::end(vuk::CommandBuffer& cbuf) {
+	if (m_pool != VK_NULL_HANDLE) {
+		const u32 query = m_frame % vuk::Context::FC;
+		vkCmdEndQuery(cbuf.command_buffer, m_pool, query);
+		m_written[query] = true;
+	}
+}
+
+GpuTimer::GpuTimer() : m_device{VK_NULL_HANDLE}, m_pool{VK_NULL_HANDLE}, m_period{0.0}, m_written{}, m_frame{0} {
+}
+
+GpuTimer::~GpuTimer() {
+	if (m_pool != VK_NULL_HANDLE) {
+		vkDeviceWaitIdle(m_device);
+		vkDestroyQueryPool(m_device, m_pool, nullptr);
+	}
+}
+
+void GpuTimer::init(Context& ctxt) {
+	if (!ctxt.timestamps) {
+		return;
+	}
+
+	m_device = ctxt.device;
+	m_period = ctxt.vkb_physical_device.properties.limits.timestampPeriod;
+
+	// a begin/end pair per frame in flight
+	const VkQueryPoolCreateInfo pool_info{
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = 2 * vuk::Context::FC,
+	};
+	vkCreateQueryPool(m_device, &pool_info, nullptr, &m_pool);
+	vkResetQueryPool(m_device, m_pool, 0, 2 * vuk::Context::FC);
+}
+
+std::optional<f64> GpuTimer::next_frame() {
+	if (m_pool == VK_NULL_HANDLE) {
+		return {};
+	}
+
+	const u32 slot = ++m_frame % vuk::Context::FC;
+	if (!m_written[slot]) {
+		return {};
+	}
+	m_written[slot] = false;
+
+	std::array<u64, 2> ticks;
+	const VkResult result =
+		vkGetQueryPoolResults(m_device, m_pool, 2 * slot, 2, sizeof(ticks), ticks.data(), sizeof(u64), VK_QUERY_RESULT_64_BIT);
+	vkResetQueryPool(m_device, m_pool, 2 * slot, 2);
+
+	if (result != VK_SUCCESS) {
+		return {};
+	}
+	return static_cast<f64>(ticks[1] - ticks[0]) * m_period / 1e6;
+}
+
+void GpuTimer::begin(vuk::CommandBuffer& cbuf) {
+	if (m_pool != VK_NULL_HANDLE) {
+		vkCmdWriteTimestamp(cbuf.command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_pool, 2 * (m_frame % vuk::Context::FC));
+	}
+}
+
+void GpuTimer::end(vuk::CommandBuffer& cbuf) {
+	if (m_pool != VK_NULL_HANDLE) {
+		const u32 slot = m_frame % vuk::Context::FC;
+		vkCmdWriteTimestamp(cbuf.command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_pool, 2 * slot + 1);
+		m_written[slot] = true;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Types.hpp"
+
+#include <vulkan/vulkan.h>
+#include <vuk/Context.hpp>
+#include <array>
+#include <optional>
+
+namespace vuk {
+class CommandBuffer;
+}
+
+/*
+	Pipeline statistics (vertex/fragment shader invocations) for whatever gets recorded between begin() and end(), once per frame.
+
+	Like DepthReductionPass, there's one query per frame in flight and each is read right before it gets reused, so the results are
+	vuk::Context::FC frames old but reading them never stalls. The queries are reset from the host (hostQueryReset), since vuk doesn't give
+	passes a point outside of their render pass to record a vkCmdResetQueryPool.
+
+	Needs the pipelineStatisticsQuery feature; without it (Context::pipeline_statistics) everything here is a no-op.
+*/
+
+class PipelineStatisticsQuery {
+  public:
+	struct Result {
+		u64 vertex_invocations;
+		u64 fragment_invocations;
+	};
+
+	PipelineStatisticsQuery();
+	~PipelineStatisticsQuery();
+
+	PipelineStatisticsQuery(const PipelineStatisticsQuery&) = delete;
+	PipelineStatisticsQuery& operator=(const PipelineStatisticsQuery&) = delete;
+
+	void init(struct Context& ctxt);
+
+	// call once per frame after vuk::Context::begin(), before anything is recorded; returns the last results of the query that gets reused
+	std::optional<Result> next_frame();
+
+	// both have to be inside the same pass
+	void begin(vuk::CommandBuffer& cbuf);
+	void end(vuk::CommandBuffer& cbuf);
+
+  private:
+	VkDevice m_device;
+	VkQueryPool m_pool;
+
+	std::array<bool, vuk::Context::FC> m_written;
+	u32 m_frame;
+};
+
+/*
+	GPU time between begin() and end(), once per frame, read back the same way as PipelineStatisticsQuery (and just as old).
+
+	The two timestamps can be written from different passes, as long as they end up in the same command buffer; anything the render graph
+	schedules in between is timed too. Needs timestamp support on the graphics queue and hostQueryReset (Context::timestamps).
+*/
+
+class GpuTimer {
+  public:
+	GpuTimer();
+	~GpuTimer();
+
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+
+	void init(struct Context& ctxt);
+
+	// same as PipelineStatisticsQuery::next_frame; in milliseconds
+	std::optional<f64> next_frame();
+
+	void begin(vuk::CommandBuffer& cbuf);
+	void end(vuk::CommandBuffer& cbuf);
+
+  private:
+	VkDevice m_device;
+	VkQueryPool m_pool;
+	// nanoseconds per tick
+	f64 m_period;
+
+	std::array<bool, vuk::Context::FC> m_written;
+	u32 m_frame;
+};
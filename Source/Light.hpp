@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Types.hpp"
+
+#include <glm/vec3.hpp>
+
+// the position comes from the entity's TransformComponent; attenuation reaches zero at radius
+struct PointLightComponent {
+	glm::vec3 color;
+	f32 intensity;
+	f32 radius;
+};
+
+// like PointLightComponent, shining down the transform's local -z axis
+struct SpotLightComponent {
+	glm::vec3 color;
+	f32 intensity;
+	f32 radius;
+	// half angles (radians): full intensity inside inner_angle, nothing outside outer_angle
+	f32 inner_angle;
+	f32 outer_angle;
+};
@@ -0,0 +1,256 @@
+#include "LightClusters.hpp"
+
+#include <glm/geometric.hpp>
+#include <glm/trigonometric.hpp>
+#include <emmintrin.h>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+// fills up the last group of four with spheres that can't touch anything
+static void pad(LightClusters::SliceLights& lights) {
+	while (lights.x.size() % 4 != 0) {
+		lights.x.push_back(0.f);
+		lights.y.push_back(0.f);
+		lights.z.push_back(0.f);
+		lights.radius_sq.push_back(-1.f);
+		lights.index.push_back(0);
+	}
+}
+
+u32 LightClusters::cluster_index(u32 x, u32 y, u32 z) {
+	return (z * GRID_Y + y) * GRID_X + x;
+}
+
+void LightClusters::bounding_sphere(const Light& light, glm::vec3& out_center, f32& out_radius) {
+	if (!light.spot) {
+		out_center = light.position;
+		out_radius = light.radius;
+	} else if (light.cos_outer < std::sqrt(0.5f)) {
+		// wider than 90 degrees: the sphere around the rim of the cap also holds the apex
+		out_center = light.position + light.direction * (light.radius * light.cos_outer);
+		out_radius = light.radius * std::sqrt(1.f - light.cos_outer * light.cos_outer);
+	} else {
+		// narrow: the sphere through the apex and the rim
+		out_radius = light.radius / (2.f * light.cos_outer);
+		out_center = light.position + light.direction * out_radius;
+	}
+}
+
+LightClusters::LightClusters() : m_bounds_valid{false}, m_slice_scale{0.f}, m_slice_bias{0.f}, m_overflowed{0} {
+}
+
+void LightClusters::compute_bounds(const Perspective& cam_proj) {
+	m_min_x.resize(CLUSTER_COUNT);
+	m_min_y.resize(CLUSTER_COUNT);
+	m_min_z.resize(CLUSTER_COUNT);
+	m_max_x.resize(CLUSTER_COUNT);
+	m_max_y.resize(CLUSTER_COUNT);
+	m_max_z.resize(CLUSTER_COUNT);
+
+	const f32 log_depth_range = std::log2(cam_proj.far / cam_proj.near);
+	m_slice_scale = GRID_Z / log_depth_range;
+	m_slice_bias = -static_cast<f32>(GRID_Z) * std::log2(cam_proj.near) / log_depth_range;
+
+	// glm::perspective: ndc.x = x / (-z * aspect * tan(fovy / 2)), ndc.y = y / (-z * tan(fovy / 2))
+	const f32 tan_half_fovy = std::tan(cam_proj.fovy * 0.5f);
+	const f32 scale_x = cam_proj.aspect_ratio * tan_half_fovy;
+	const f32 scale_y = tan_half_fovy;
+
+	// the view space extent of [ndc0, ndc1] somewhere between the two distances (it's linear in the distance, so one of them is the extreme)
+	const auto extent = [](f32 ndc0, f32 ndc1, f32 near, f32 far, f32 scale, f32& out_min, f32& out_max) {
+		out_min = ndc0 * (ndc0 < 0.f ? far : near) * scale;
+		out_max = ndc1 * (ndc1 > 0.f ? far : near) * scale;
+	};
+
+	for (u32 z = 0; z < GRID_Z; ++z) {
+		const f32 near = cam_proj.near * std::pow(cam_proj.far / cam_proj.near, static_cast<f32>(z) / GRID_Z);
+		const f32 far = cam_proj.near * std::pow(cam_proj.far / cam_proj.near, static_cast<f32>(z + 1) / GRID_Z);
+
+		for (u32 y = 0; y < GRID_Y; ++y) {
+			const f32 ndc_y0 = 2.f * y / GRID_Y - 1.f;
+			const f32 ndc_y1 = 2.f * (y + 1) / GRID_Y - 1.f;
+
+			for (u32 x = 0; x < GRID_X; ++x) {
+				const f32 ndc_x0 = 2.f * x / GRID_X - 1.f;
+				const f32 ndc_x1 = 2.f * (x + 1) / GRID_X - 1.f;
+
+				const u32 i = cluster_index(x, y, z);
+				extent(ndc_x0, ndc_x1, near, far, scale_x, m_min_x[i], m_max_x[i]);
+				extent(ndc_y0, ndc_y1, near, far, scale_y, m_min_y[i], m_max_y[i]);
+				m_min_z[i] = -far;
+				m_max_z[i] = -near;
+			}
+		}
+	}
+
+	m_bounds_proj = cam_proj;
+	m_bounds_valid = true;
+}
+
+u32 LightClusters::slice(f32 distance) const {
+	const f32 s = std::floor(std::log2(std::max(distance, 1e-6f)) * m_slice_scale + m_slice_bias);
+	return static_cast<u32>(std::clamp(s, 0.f, static_cast<f32>(GRID_Z - 1)));
+}
+
+void LightClusters::build(const Perspective& cam_proj, const glm::mat4& cam_view, std::span<const Light> lights) {
+	if (!m_bounds_valid || m_bounds_proj.fovy != cam_proj.fovy || m_bounds_proj.aspect_ratio != cam_proj.aspect_ratio ||
+		m_bounds_proj.near != cam_proj.near || m_bounds_proj.far != cam_proj.far) {
+		compute_bounds(cam_proj);
+	}
+
+	m_slice_lights.resize(GRID_Z);
+	for (auto& slice_lights : m_slice_lights) {
+		slice_lights.x.clear();
+		slice_lights.y.clear();
+		slice_lights.z.clear();
+		slice_lights.radius_sq.clear();
+		slice_lights.index.clear();
+	}
+
+	// bucket the bounding spheres into the slices they span
+	for (u32 i = 0; i < lights.size(); ++i) {
+		const Light& light = lights[i];
+
+		glm::vec3 center;
+		f32 radius;
+		bounding_sphere(light, center, radius);
+
+		const glm::vec3 view_center = cam_view * glm::vec4{center, 1.f};
+		const f32 distance = -view_center.z;
+		if (distance + radius < cam_proj.near || distance - radius > cam_proj.far) {
+			continue;
+		}
+
+		const u32 first = slice(distance - radius);
+		const u32 last = slice(distance + radius);
+		for (u32 z = first; z <= last; ++z) {
+			auto& slice_lights = m_slice_lights[z];
+			slice_lights.x.push_back(view_center.x);
+			slice_lights.y.push_back(view_center.y);
+			slice_lights.z.push_back(view_center.z);
+			slice_lights.radius_sq.push_back(radius * radius);
+			slice_lights.index.push_back(i);
+		}
+	}
+
+	for (auto& slice_lights : m_slice_lights) {
+		pad(slice_lights);
+	}
+
+	m_ranges.resize(CLUSTER_COUNT);
+	m_indices.clear();
+	m_overflowed = 0;
+
+	const __m128 zero = _mm_setzero_ps();
+
+	for (u32 z = 0; z < GRID_Z; ++z) {
+		const auto& slice_lights = m_slice_lights[z];
+		const u32 slice_count = static_cast<u32>(slice_lights.x.size());
+
+		for (u32 y = 0; y < GRID_Y; ++y) {
+			// narrow the slice's lights down to the ones touching this row first
+			const u32 first = cluster_index(0, y, z);
+			const u32 last = cluster_index(GRID_X - 1, y, z);
+			// (the clusters of a row only differ in x)
+			const __m128 row_min_x = _mm_set1_ps(m_min_x[first]);
+			const __m128 row_min_y = _mm_set1_ps(m_min_y[first]);
+			const __m128 row_min_z = _mm_set1_ps(m_min_z[first]);
+			const __m128 row_max_x = _mm_set1_ps(m_max_x[last]);
+			const __m128 row_max_y = _mm_set1_ps(m_max_y[first]);
+			const __m128 row_max_z = _mm_set1_ps(m_max_z[first]);
+
+			auto& row_lights = m_row_lights;
+			row_lights.x.clear();
+			row_lights.y.clear();
+			row_lights.z.clear();
+			row_lights.radius_sq.clear();
+			row_lights.index.clear();
+
+			for (u32 i = 0; i < slice_count; i += 4) {
+				const __m128 cx = _mm_loadu_ps(&slice_lights.x[i]);
+				const __m128 cy = _mm_loadu_ps(&slice_lights.y[i]);
+				const __m128 cz = _mm_loadu_ps(&slice_lights.z[i]);
+
+				// squared distance from the sphere's center to the box
+				const __m128 dx = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(row_min_x, cx), _mm_sub_ps(cx, row_max_x)));
+				const __m128 dy = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(row_min_y, cy), _mm_sub_ps(cy, row_max_y)));
+				const __m128 dz = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(row_min_z, cz), _mm_sub_ps(cz, row_max_z)));
+				const __m128 dist_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+				u32 hits = static_cast<u32>(_mm_movemask_ps(_mm_cmple_ps(dist_sq, _mm_loadu_ps(&slice_lights.radius_sq[i]))));
+				for (; hits != 0; hits &= hits - 1) {
+					const u32 j = i + std::countr_zero(hits);
+					row_lights.x.push_back(slice_lights.x[j]);
+					row_lights.y.push_back(slice_lights.y[j]);
+					row_lights.z.push_back(slice_lights.z[j]);
+					row_lights.radius_sq.push_back(slice_lights.radius_sq[j]);
+					row_lights.index.push_back(slice_lights.index[j]);
+				}
+			}
+
+			// then test each of those against all the clusters of the row, four clusters at a time, and sort it into their lists
+			for (auto& list : m_cluster_lists) {
+				list.clear();
+			}
+
+			for (u32 j = 0; j < row_lights.x.size(); ++j) {
+				const __m128 cx = _mm_set1_ps(row_lights.x[j]);
+				const __m128 cy = _mm_set1_ps(row_lights.y[j]);
+				const __m128 cz = _mm_set1_ps(row_lights.z[j]);
+				const __m128 radius_sq = _mm_set1_ps(row_lights.radius_sq[j]);
+
+				u32 hits = 0;
+				for (u32 x = 0; x < GRID_X; x += 4) {
+					const u32 c = first + x;
+					const __m128 dx = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_min_x[c]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&m_max_x[c]))));
+					const __m128 dy = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_min_y[c]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&m_max_y[c]))));
+					const __m128 dz = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_min_z[c]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&m_max_z[c]))));
+					const __m128 dist_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+					hits |= static_cast<u32>(_mm_movemask_ps(_mm_cmple_ps(dist_sq, radius_sq))) << x;
+				}
+
+				for (; hits != 0; hits &= hits - 1) {
+					m_cluster_lists[std::countr_zero(hits)].push_back(row_lights.index[j]);
+				}
+			}
+
+			for (u32 x = 0; x < GRID_X; ++x) {
+				const auto& list = m_cluster_lists[x];
+				Range& range = m_ranges[first + x];
+				range.offset = static_cast<u32>(m_indices.size());
+				range.count = std::min(static_cast<u32>(list.size()), MAX_LIGHTS_PER_CLUSTER);
+				m_indices.insert(m_indices.end(), list.begin(), list.begin() + range.count);
+
+				if (list.size() > MAX_LIGHTS_PER_CLUSTER) {
+					++m_overflowed;
+				}
+			}
+		}
+	}
+}
+
+std::span<const LightClusters::Range> LightClusters::ranges() const {
+	return m_ranges;
+}
+
+std::span<const u32> LightClusters::indices() const {
+	return m_indices;
+}
+
+f32 LightClusters::slice_scale() const {
+	return m_slice_scale;
+}
+
+f32 LightClusters::slice_bias() const {
+	return m_slice_bias;
+}
+
+void LightClusters::cluster_bounds(u32 cluster, glm::vec3& out_min, glm::vec3& out_max) const {
+	out_min = glm::vec3{m_min_x[cluster], m_min_y[cluster], m_min_z[cluster]};
+	out_max = glm::vec3{m_max_x[cluster], m_max_y[cluster], m_max_z[cluster]};
+}
+
+u32 LightClusters::overflowed_clusters() const {
+	return m_overflowed;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Types.hpp"
+#include "Perspective.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <array>
+#include <span>
+#include <vector>
+
+/*
+	Clustered light assignment: the view frustum is split into a grid of clusters (screen tiles x exponential depth slices), and every cluster
+	gets the list of lights whose sphere of influence touches it, so shading only has to loop over the lights that can reach the pixel.
+
+	This runs on the CPU. Lights are first bucketed into the depth slices their sphere spans. Per row of clusters, the slice's lights are
+	narrowed down to the ones touching the row (four lights at a time with SSE), and each of those is then tested against the row's clusters'
+	view space AABBs (four clusters at a time). Spot lights are tested with the bounding sphere of their cone.
+	The cluster bounds only depend on the projection, so they're only recomputed when it changes.
+*/
+
+class LightClusters {
+  public:
+	static constexpr u32 GRID_X = 16;
+	static constexpr u32 GRID_Y = 9;
+	static constexpr u32 GRID_Z = 24;
+	static constexpr u32 CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+	static_assert(GRID_X % 4 == 0, "a row of clusters is tested four at a time");
+	// anything past this in a single cluster is dropped
+	static constexpr u32 MAX_LIGHTS_PER_CLUSTER = 256;
+
+	// world space
+	struct Light {
+		glm::vec3 position;
+		f32 radius;
+		glm::vec3 color;
+		f32 intensity;
+		// only for spot lights
+		glm::vec3 direction;
+		f32 cos_inner;
+		f32 cos_outer;
+		bool spot;
+	};
+
+	// view space bounding spheres, structure-of-arrays and padded to a multiple of 4 with spheres that can't touch anything
+	struct SliceLights {
+		std::vector<f32> x, y, z, radius_sq;
+		// into the lights passed to build()
+		std::vector<u32> index;
+	};
+
+	// a cluster's lights are indices()[offset, offset + count)
+	struct Range {
+		u32 offset;
+		u32 count;
+	};
+
+	static u32 cluster_index(u32 x, u32 y, u32 z);
+	// what a light is culled with: its own sphere, or for spot lights the smallest sphere around the cone
+	static void bounding_sphere(const Light& light, glm::vec3& out_center, f32& out_radius);
+
+	LightClusters();
+
+	void build(const Perspective& cam_proj, const glm::mat4& cam_view, std::span<const Light> lights);
+
+	std::span<const Range> ranges() const;
+	std::span<const u32> indices() const;
+
+	// the depth slice of view distance d is floor(log2(d) * slice_scale() + slice_bias())
+	f32 slice_scale() const;
+	f32 slice_bias() const;
+
+	// view space AABB, as of the last build
+	void cluster_bounds(u32 cluster, glm::vec3& out_min, glm::vec3& out_max) const;
+
+	// clusters that had to drop lights during the last build
+	u32 overflowed_clusters() const;
+
+  private:
+	void compute_bounds(const Perspective& cam_proj);
+	u32 slice(f32 distance) const;
+
+	Perspective m_bounds_proj;
+	bool m_bounds_valid;
+
+	// view space AABBs of the clusters, structure-of-arrays in cluster_index order
+	std::vector<f32> m_min_x, m_min_y, m_min_z;
+	std::vector<f32> m_max_x, m_max_y, m_max_z;
+
+	f32 m_slice_scale;
+	f32 m_slice_bias;
+
+	std::vector<SliceLights> m_slice_lights;
+	// the lights of the slice being assigned that touch the current row
+	SliceLights m_row_lights;
+	// and the lights of each cluster in that row
+	std::array<std::vector<u32>, GRID_X> m_cluster_lists;
+
+	std::vector<Range> m_ranges;
+	std::vector<u32> m_indices;
+	u32 m_overflowed;
+};
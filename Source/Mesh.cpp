@@ -140,26 +140,43 @@ void RenderMesh::compute_bounds() {
 	}
 }
 
-TransformComponent::TransformComponent() : matrix{1} {
+TransformComponent::TransformComponent() : m_matrix{1}, m_dirty{true} {
 }
 
 TransformComponent& TransformComponent::translate(const glm::vec3& offset) {
-	matrix = glm::translate(matrix, offset);
+	m_matrix = glm::translate(m_matrix, offset);
+	m_dirty = true;
 	return *this;
 }
 
 TransformComponent& TransformComponent::scale(const glm::vec3& scale) {
-	matrix = glm::scale(matrix, scale);
+	m_matrix = glm::scale(m_matrix, scale);
+	m_dirty = true;
 	return *this;
 }
 
 TransformComponent& TransformComponent::rotate(const glm::quat& rot) {
-	matrix *= glm::mat4_cast(rot);
+	m_matrix *= glm::mat4_cast(rot);
+	m_dirty = true;
+	return *this;
+}
+
+TransformComponent& TransformComponent::set_matrix(const glm::mat4& matrix) {
+	m_matrix = matrix;
+	m_dirty = true;
 	return *this;
 }
 
 DecomposedTransform TransformComponent::decompose() const {
 	DecomposedTransform dt = {};
-	glm::decompose(matrix, dt.scale, dt.rotation, dt.translation, dt.skew, dt.perspective);
+	glm::decompose(m_matrix, dt.scale, dt.rotation, dt.translation, dt.skew, dt.perspective);
 	return dt;
 }
+
+const glm::mat4& TransformComponent::matrix() const {
+	return m_matrix;
+}
+
+bool TransformComponent::dirty() const {
+	return m_dirty;
+}
@@ -63,14 +63,28 @@ struct DecomposedTransform {
 	glm::vec4 perspective;
 };
 
-struct TransformComponent {
+// the matrix is only changed through the member functions, so dirty() can't miss a change
+class TransformComponent {
+  public:
 	TransformComponent();
 
 	TransformComponent& translate(const glm::vec3& offset);
 	TransformComponent& scale(const glm::vec3& scale);
 	TransformComponent& rotate(const glm::quat& rot);
+	TransformComponent& set_matrix(const glm::mat4& matrix);
 
 	DecomposedTransform decompose() const;
 
-	glm::mat4 matrix;
+	const glm::mat4& matrix() const;
+	// set whenever the matrix changes; cleared by SceneRenderer::update
+	bool dirty() const;
+
+  private:
+	friend class SceneRenderer;
+
+	glm::mat4 m_matrix;
+	bool m_dirty;
 };
+
+// tag for entities that never move, which lets passes cache anything derived from them (e.g. far shadow cascades)
+struct StaticComponent {};
@@ -3,6 +3,14 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 glm::mat4 Perspective::matrix(bool flip) const {
+	auto m = unjittered_matrix(flip);
+	// clip.w is -z in view space, so this moves every point by exactly jitter after the perspective divide
+	m[2][0] -= jitter.x;
+	m[2][1] -= jitter.y;
+	return m;
+}
+
+glm::mat4 Perspective::unjittered_matrix(bool flip) const {
 	auto m = glm::perspective(fovy, aspect_ratio, near, far);
 	m[1][1] *= flip ? -1.f : 1;
 	return m;
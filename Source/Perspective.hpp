@@ -2,6 +2,7 @@
 
 #include "Types.hpp"
 
+#include <glm/vec2.hpp>
 #include <glm/mat4x4.hpp>
 
 struct Perspective {
@@ -9,7 +10,11 @@ struct Perspective {
 	f32 aspect_ratio;
 	f32 near;
 	f32 far;
+	// sub-pixel offset of the whole image in NDC, for temporal anti-aliasing; matrix() includes it
+	glm::vec2 jitter{0.f};
 
 	glm::mat4 matrix(bool flip = false) const;
+	// for what shouldn't follow the jitter around, e.g. the shadow cascades or last frame's matrix for reprojection
+	glm::mat4 unjittered_matrix(bool flip = false) const;
 	f32 fovx() const;
 };
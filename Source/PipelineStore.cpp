@@ -1,10 +1,13 @@
 #include "PipelineStore.hpp"
 
 #include "Resource.hpp"
+#include "CpuTrace.hpp"
 
 #include <vuk/Context.hpp>
+#include <algorithm>
 #include <fstream>
 #include <streambuf>
+#include <string>
 
 PipelineStore::PipelineStore() : m_counter{0}, m_ctxt{nullptr} {
 }
@@ -17,7 +20,18 @@ void PipelineStore::add(std::string_view name, std::string_view vert, std::strin
 	load(name);
 }
 
+void PipelineStore::add_compute(std::string_view name, std::string_view comp) {
+	m_compute_pipes[std::string{name}] = ComputePipe{std::string{comp}};
+	load_compute(name);
+}
+
+void PipelineStore::define(std::string_view name, std::string_view value) {
+	m_defines += "#define " + std::string{name} + " " + std::string{value} + "\n";
+}
+
 void PipelineStore::update() {
+	TRACE_ZONE("PipelineStore::update");
+
 #ifndef NDEBUG
 	m_counter++;
 
@@ -27,6 +41,10 @@ void PipelineStore::update() {
 		for (const auto& [k, _] : m_pipes) {
 			load(k);
 		}
+
+		for (const auto& [k, _] : m_compute_pipes) {
+			load_compute(k);
+		}
 	}
 #endif
 }
@@ -34,20 +52,69 @@ void PipelineStore::update() {
 void PipelineStore::load(std::string_view name) {
 	const Pipe& p = m_pipes.at(std::string{name});
 	vuk::PipelineBaseCreateInfo pipe = p.pipe;
-#ifndef NDEBUG
-	std::ifstream vertf{std::string{PROJECT_ABSOLUTE_PATH} + std::string{"/Resources/Shaders/"} + p.vert};
-	std::string vert{(std::istreambuf_iterator<char>(vertf)), std::istreambuf_iterator<char>()};
-	vertf.close();
+	pipe.add_shader(load_shader(p.vert), p.vert);
+	pipe.add_shader(load_shader(p.frag), p.frag);
+	m_ctxt->create_named_pipeline(name.data(), pipe);
+}
 
-	std::ifstream fragf{std::string{PROJECT_ABSOLUTE_PATH} + std::string{"/Resources/Shaders/"} + p.frag};
-	std::string frag{(std::istreambuf_iterator<char>(fragf)), std::istreambuf_iterator<char>()};
-	fragf.close();
+void PipelineStore::load_compute(std::string_view name) {
+	const ComputePipe& p = m_compute_pipes.at(std::string{name});
+	vuk::ComputePipelineCreateInfo pipe;
+	pipe.add_shader(load_shader(p.comp), p.comp);
+	m_ctxt->create_named_pipeline(name.data(), pipe);
+}
 
-	pipe.add_shader(vert, p.vert);
-	pipe.add_shader(frag, p.frag);
+std::string PipelineStore::read_shader(std::string_view file) const {
+#ifndef NDEBUG
+	std::ifstream f{std::string{PROJECT_ABSOLUTE_PATH} + std::string{"/Resources/Shaders/"} + std::string{file}};
+	std::string source{(std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>()};
+	f.close();
 #else
-	pipe.add_shader(get_resource_string(std::string{"Resources/Shaders/"} + p.vert), p.vert);
-	pipe.add_shader(get_resource_string(std::string{"Resources/Shaders/"} + p.frag), p.frag);
+	std::string source = get_resource_string(std::string{"Resources/Shaders/"} + std::string{file});
 #endif
-	m_ctxt->create_named_pipeline(name.data(), pipe);
+
+	// paste in every #include "file" (relative to Resources/Shaders); the #lines keep error messages pointing at the right line of each file
+	static constexpr std::string_view INCLUDE = "#include \"";
+	u64 line_start = 0;
+	u64 line = 1;
+	while (line_start < source.size()) {
+		const u64 line_end = std::min(source.find('\n', line_start), source.size());
+
+		if (source.compare(line_start, INCLUDE.size(), INCLUDE) == 0) {
+			const u64 name_start = line_start + INCLUDE.size();
+			const u64 name_end = source.find('"', name_start);
+			if (name_end != std::string::npos && name_end < line_end) {
+				const std::string included = "#line 1\n" + read_shader(std::string_view{source}.substr(name_start, name_end - name_start)) + "\n#line " +
+											 std::to_string(line + 1);
+				source.replace(line_start, line_end - line_start, included);
+				line_start += included.size() + 1;
+				++line;
+				continue;
+			}
+		}
+
+		line_start = line_end + 1;
+		++line;
+	}
+
+	return source;
+}
+
+std::string PipelineStore::load_shader(std::string_view file) const {
+	std::string source = read_shader(file);
+
+	if (m_defines.empty()) {
+		return source;
+	}
+
+	// #version has to stay first; the #line keeps the compiler's line numbers matching the file
+	const u64 version = source.find("#version");
+	const u64 line_end = version == std::string::npos ? std::string::npos : source.find('\n', version);
+	if (line_end == std::string::npos) {
+		return source;
+	}
+
+	const u64 next_line = static_cast<u64>(std::count(source.begin(), source.begin() + line_end, '\n')) + 2;
+	source.insert(line_end + 1, m_defines + "#line " + std::to_string(next_line) + "\n");
+	return source;
 }
@@ -12,6 +12,10 @@ class Context;
 
 /*
 	Loads shaders as normal from embedded resources when built in release mode, but reloads shaders on the fly from disk when built in debug mode.
+
+	Constants that have to match the C++ side (e.g. the shadow cascade count) are registered with define() and injected into every shader
+	right after its #version line, instead of being duplicated in each shader.
+	Code shared between shaders goes into .glsl files, which are pasted in by a line of the form #include "file.glsl".
 */
 
 class PipelineStore {
@@ -20,6 +24,10 @@ class PipelineStore {
 	PipelineStore(vuk::Context& ctxt);
 
 	void add(std::string_view name, std::string_view vert, std::string_view frag, vuk::PipelineBaseCreateInfo base = {});
+	void add_compute(std::string_view name, std::string_view comp);
+
+	// only affects pipelines added (or reloaded) afterwards
+	void define(std::string_view name, std::string_view value);
 
 	void update();
 
@@ -32,7 +40,19 @@ class PipelineStore {
 		vuk::PipelineBaseCreateInfo pipe;
 	};
 
+	struct ComputePipe {
+		std::string comp;
+	};
+
+	void load_compute(std::string_view name);
+	// the file with its #includes expanded
+	std::string read_shader(std::string_view file) const;
+	std::string load_shader(std::string_view file) const;
+
 	u32 m_counter;
+	// #define lines, in the order they were registered
+	std::string m_defines;
 	std::unordered_map<std::string, Pipe> m_pipes;
+	std::unordered_map<std::string, ComputePipe> m_compute_pipes;
 	vuk::Context* m_ctxt;
 };
@@ -4,6 +4,7 @@
 #include "Resource.hpp"
 #include "GfxUtil.hpp"
 #include "Frustum.hpp"
+#include "CpuTrace.hpp"
 
 #include <vuk/RenderGraph.hpp>
 #include <vuk/Pipeline.hpp>
@@ -15,13 +16,62 @@
 #include <glm/common.hpp>
 #include <GLFW/glfw3.h>
 #include <spdlog/spdlog.h>
+#include <chrono>
 
-static const glm::vec3 LIGHT_DIRECTION = glm::normalize(glm::vec3(0, -2, 1));
+// the sun moves along the y-z plane; the elevation is measured up from the -z horizon
+static glm::vec3 sun_light_direction(f32 elevation) {
+	return glm::vec3{0.f, -std::sin(elevation), std::cos(elevation)};
+}
+
+// i.e. a light direction of (0, -2, 1)
+static const f32 INITIAL_SUN_ELEVATION = std::atan2(2.f, 1.f);
+
+// yaw and pitch in degrees; yaw is measured from +x towards +z
+static glm::vec3 camera_front(f32 yaw, f32 pitch) {
+	glm::vec3 dir;
+	dir.x = std::cos(glm::radians(yaw)) * std::cos(glm::radians(pitch));
+	dir.y = std::sin(glm::radians(pitch));
+	dir.z = std::sin(glm::radians(yaw)) * std::cos(glm::radians(pitch));
+	return glm::normalize(dir);
+}
+
+// compiling the render graph into passes, barriers and render passes
+static vuk::ExecutableRenderGraph link(vuk::RenderGraph&& rg, vuk::PerThreadContext& ptc) {
+	TRACE_ZONE("RenderGraph::link");
+	return std::move(rg).link(ptc);
+}
 
-Renderer::Renderer() : m_atmosphere{LIGHT_DIRECTION} {
+static constexpr u32 POINT_LIGHT_COUNT = 128;
+static constexpr u32 SPOT_LIGHT_COUNT = 4;
+
+// GPU time of everything that scales with the render resolution (see DynamicResolution)
+static constexpr f32 RESOLUTION_BUDGET_MS = 10.f;
+
+// for both the static environment's and the procedural sky's cubemaps
+static const vuk::SamplerCreateInfo IRRADIANCE_SAMPLER{.magFilter = vuk::Filter::eLinear,
+	.minFilter = vuk::Filter::eLinear,
+	.addressModeU = vuk::SamplerAddressMode::eClampToEdge,
+	.addressModeV = vuk::SamplerAddressMode::eClampToEdge,
+	.addressModeW = vuk::SamplerAddressMode::eClampToEdge};
+static const vuk::SamplerCreateInfo PREFILTER_SAMPLER{.magFilter = vuk::Filter::eLinear,
+	.minFilter = vuk::Filter::eLinear,
+	.mipmapMode = vuk::SamplerMipmapMode::eLinear,
+	.addressModeU = vuk::SamplerAddressMode::eClampToEdge,
+	.addressModeV = vuk::SamplerAddressMode::eClampToEdge,
+	.addressModeW = vuk::SamplerAddressMode::eClampToEdge,
+	.minLod = 0.f,
+	.maxLod = 4.f};
+
+Renderer::Renderer()
+	: m_atmosphere{sun_light_direction(INITIAL_SUN_ELEVATION), AtmosphericSkyCubemap::Mode::Procedural}, m_deferred{false},
+	  m_ssao_resolution{SSAOPass::Resolution::Full}, m_horizon_ao{false}, m_froxel{true}, m_volumetric_downscale{2},
+	  m_temporal{true}, m_anti_aliasing_mode{AntiAliasingPass::Mode::TAA},
+	  m_dynamic_resolution{RESOLUTION_BUDGET_MS}, m_frame{0}, m_prev_view_proj{1.f}, m_sun_elevation{INITIAL_SUN_ELEVATION}, m_time{0.f},
+	  m_light_direction{sun_light_direction(INITIAL_SUN_ELEVATION)}, m_offscreen_used{false}, m_readback{false},
+	  m_cpu_frame_ms{0.0} {
 }
 
-void Renderer::init(Context& ctxt) {
+bool Renderer::init(Context& ctxt) {
 	// initialize simple members
 
 	m_ctxt = &ctxt;
@@ -29,7 +79,8 @@ void Renderer::init(Context& ctxt) {
 	m_last_x = -1.f;
 	m_last_y = -1.f;
 	m_pitch = 0.f;
-	m_yaw = 0.f;
+	// looking down -z, like m_cam_front (so a recorded CameraPath starts out the same way)
+	m_yaw = -90.f;
 
 	m_cam_pos = glm::vec3(0, 0, 3);
 	m_cam_front = glm::vec3(0, 0, -3);
@@ -42,38 +93,67 @@ void Renderer::init(Context& ctxt) {
 	// create the pipelines that are going to be used later
 
 	m_pipe_store = PipelineStore{*ctxt.vuk_context};
-
-	m_pipe_store.add("pbr", "pbr.vert", "pbr.frag");
+	m_pipe_store.define("SHADOW_MAP_CASCADE_COUNT", std::to_string(CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT));
+
+	// depth_prepass already has the final depth of every pixel, so only the visible surface passes and gets shaded (see pbr.vert)
+	vuk::PipelineBaseCreateInfo pbr_pipe;
+	pbr_pipe.depth_stencil_state.depthCompareOp = vuk::CompareOp::eEqual;
+	pbr_pipe.depth_stencil_state.depthWriteEnable = false;
+	m_pipe_store.add("pbr", "pbr.vert", "pbr.frag", pbr_pipe);
+	// with MSAA, the color pass has its own multisampled depth, so it needs a regular depth test
+	vuk::PipelineBaseCreateInfo pbr_multisampled_pipe;
+	pbr_multisampled_pipe.depth_stencil_state.depthCompareOp = vuk::CompareOp::eLessOrEqual;
+	m_pipe_store.add("pbr_multisampled", "pbr.vert", "pbr.frag", pbr_multisampled_pipe);
 	m_pipe_store.add("equirectangular_to_cubemap", "cubemap.vert", "equirectangular_to_cubemap.frag");
 	m_pipe_store.add("irradiance", "cubemap.vert", "irradiance_convolution.frag");
 	m_pipe_store.add("prefilter", "cubemap.vert", "prefilter.frag");
-	m_pipe_store.add("brdf", "brdf.vert", "brdf.frag");
 	m_pipe_store.add("debug", "debug.vert", "debug.frag");
 	m_pipe_store.add("composite", "composite.vert", "composite.frag");
+	// composite.vert is only used for its fullscreen triangle; the lighting pass works in gl_FragCoord
+	m_pipe_store.add("deferred_lighting", "composite.vert", "deferred_lighting.frag");
 
 	auto ifc = ctxt.vuk_context->begin();
 	auto ptc = ifc.begin();
 
 	RenderMesh sphere_rm;
 	sphere_rm.mesh = m_sphere;
+	sphere_rm.compute_bounds();
 	sphere_rm.upload(ptc);
 	m_scene.meshes.insert("Sphere", std::move(sphere_rm));
 
 	RenderMesh cube_rm;
 	cube_rm.mesh = m_cube;
+	cube_rm.compute_bounds();
 	cube_rm.upload(ptc);
 	m_scene.meshes.insert("Cube", std::move(cube_rm));
 
 	RenderMesh quad_rm;
 	quad_rm.mesh = m_quad;
+	quad_rm.compute_bounds();
 	quad_rm.upload(ptc);
 	m_scene.meshes.insert("Quad", std::move(quad_rm));
 
 	m_cascaded_shadows.init(ptc, ctxt, m_uniforms, m_pipe_store);
 	m_ssao.init(ptc, ctxt, m_uniforms, m_pipe_store);
+	m_gtao.init(ptc, ctxt, m_uniforms, m_pipe_store);
 	m_gbuffer.init(ptc, ctxt, m_uniforms, m_pipe_store);
 	m_volumetric_light.init(ptc, ctxt, m_uniforms, m_pipe_store);
+	m_froxel_fog.init(ptc, ctxt, m_uniforms, m_pipe_store);
+	m_depth_reduction.init(ptc, ctxt, m_uniforms, m_pipe_store);
+	m_clustered_lights.init(ptc, ctxt, m_uniforms, m_pipe_store);
+	m_anti_aliasing.init(ptc, ctxt, m_uniforms, m_pipe_store);
+	m_post_process.init(ptc, ctxt, m_uniforms, m_pipe_store);
 	m_atmosphere.init(ptc, ctxt, m_pipe_store, m_scene.meshes.get(MeshCache::view("Cube")));
+	m_color_pass_statistics.init(ctxt);
+	m_gbuffer_statistics.init(ctxt);
+	m_dynamic_resolution.init(ctxt);
+	m_profiler.init(ctxt);
+
+	if (ctxt.headless) {
+		init_offscreen_target(ptc);
+		// headless frames are for benchmarks and image comparisons, which a resolution that depends on timing would make irreproducible
+		m_dynamic_resolution.set_enabled(false);
+	}
 
 	// allocate a large buffer to dump all the model matrices in; this will be used a dynamic UBO for drawing by offsetting into it
 
@@ -93,6 +173,77 @@ void Renderer::init(Context& ctxt) {
 
 	m_scene_renderer = SceneRenderer::create(ctxt, m_scene);
 
+	// the procedural sky bakes (and re-bakes) its own irradiance and prefilter cubemaps, so forest_slope is only needed without it
+	if (!m_atmosphere.procedural()) {
+		bake_static_environment(ptc);
+	}
+
+	// the BRDF LUT is integrated at build time (see brdf_lut_generator); just upload it
+
+	auto brdf_lut = gfx_util::load_lut("Resources/Textures/brdf_lut.bin", BRDF_LUT_SIZE, BRDF_LUT_SIZE, ptc);
+	if (!brdf_lut) {
+		return false;
+	}
+	m_brdf_lut = std::make_pair(std::move(*brdf_lut), vuk::SamplerCreateInfo{
+														  .magFilter = vuk::Filter::eLinear,
+														  .minFilter = vuk::Filter::eLinear,
+														  .addressModeU = vuk::SamplerAddressMode::eClampToEdge,
+														  .addressModeV = vuk::SamplerAddressMode::eClampToEdge,
+														  .addressModeW = vuk::SamplerAddressMode::eClampToEdge,
+													  });
+
+	auto entity = m_scene.registry.create();
+	m_scene.registry.emplace<MeshComponent>(entity, MeshCache::view("Sphere"),
+		Material{.albedo = TextureCache::view("Iron.Albedo"),
+			.metallic = TextureCache::view("Iron.Metallic"),
+			.roughness = TextureCache::view("Iron.Roughness"),
+			.normal = TextureCache::view("Iron.Normal"),
+			.ao = TextureCache::view("Iron.AO")});
+	m_scene.registry.emplace<TransformComponent>(entity, TransformComponent{});
+	m_scene.registry.emplace<StaticComponent>(entity);
+
+	auto entity2 = m_scene.registry.create();
+	m_scene.registry.emplace<MeshComponent>(entity2, MeshCache::view("Quad"),
+		Material{.albedo = TextureCache::view("Iron.Albedo"),
+			.metallic = TextureCache::view("Iron.Metallic"),
+			.roughness = TextureCache::view("Iron.Roughness"),
+			.normal = TextureCache::view("Iron.Normal"),
+			.ao = TextureCache::view("Iron.AO")});
+	m_scene.registry.emplace<TransformComponent>(
+		entity2, TransformComponent{}.translate({0, -1, 0}).rotate(glm::eulerAngleXYZ(glm::radians(-90.f), 0.f, 0.f)).scale({3, 3, 3}));
+	m_scene.registry.emplace<StaticComponent>(entity2);
+
+	// a ring of point lights around the pillars (they orbit in update()), and a few spot lights pointing down at the floor
+	for (u32 i = 0; i < POINT_LIGHT_COUNT; ++i) {
+		const glm::vec3 color = glm::vec3{0.5f} + 0.5f * glm::cos(glm::vec3{0.f, 2.f, 4.f} + 6.2831853f * i / POINT_LIGHT_COUNT);
+
+		auto light = m_scene.registry.create();
+		m_scene.registry.emplace<PointLightComponent>(light, PointLightComponent{.color = color, .intensity = 2.f, .radius = 0.75f});
+		m_scene.registry.emplace<TransformComponent>(light, TransformComponent{});
+	}
+
+	for (u32 i = 0; i < SPOT_LIGHT_COUNT; ++i) {
+		const f32 angle = 6.2831853f * i / SPOT_LIGHT_COUNT;
+
+		auto light = m_scene.registry.create();
+		m_scene.registry.emplace<SpotLightComponent>(light, SpotLightComponent{
+			.color = glm::vec3{1.f, 0.9f, 0.7f},
+			.intensity = 20.f,
+			.radius = 4.f,
+			.inner_angle = glm::radians(15.f),
+			.outer_angle = glm::radians(25.f),
+		});
+		m_scene.registry.emplace<TransformComponent>(light, TransformComponent{}
+																.translate({2.f * std::cos(angle), 1.5f, 2.f * std::sin(angle)})
+																.rotate(glm::eulerAngleXYZ(glm::radians(-90.f), 0.f, 0.f)));
+	}
+
+	return true;
+}
+
+void Renderer::bake_static_environment(vuk::PerThreadContext& ptc) {
+	TRACE_ZONE("Renderer::bake_static_environment");
+
 	m_hdr_texture = gfx_util::load_cubemap_texture("Resources/Textures/forest_slope_1k.hdr", ptc);
 
 	// m_hdr_texture is a 2:1 equirectangular; it needs to be converted to a cubemap
@@ -183,11 +334,7 @@ void Renderer::init(Context& ctxt) {
 	// filter this new cubemap to make an irradiance cubemap (for light emission)
 
 	{
-		m_irradiance_cubemap = std::make_pair(gfx_util::alloc_cubemap(32, 32, ptc), vuk::SamplerCreateInfo{.magFilter = vuk::Filter::eLinear,
-																						.minFilter = vuk::Filter::eLinear,
-																						.addressModeU = vuk::SamplerAddressMode::eClampToEdge,
-																						.addressModeV = vuk::SamplerAddressMode::eClampToEdge,
-																						.addressModeW = vuk::SamplerAddressMode::eClampToEdge});
+		m_irradiance_cubemap = std::make_pair(gfx_util::alloc_cubemap(32, 32, ptc), IRRADIANCE_SAMPLER);
 
 		vuk::ImageViewCreateInfo ivci{.image = *m_irradiance_cubemap.first.image,
 			.viewType = vuk::ImageViewType::e2D,
@@ -246,17 +393,7 @@ void Renderer::init(Context& ctxt) {
 	// filter it again to create a prefiltered cubemap (for specular reflections at varying roughness levels)
 
 	{
-		vuk::SamplerCreateInfo sci;
-		sci.magFilter = vuk::Filter::eLinear;
-		sci.minFilter = vuk::Filter::eLinear;
-		sci.mipmapMode = vuk::SamplerMipmapMode::eLinear;
-		sci.addressModeU = vuk::SamplerAddressMode::eClampToEdge;
-		sci.addressModeV = vuk::SamplerAddressMode::eClampToEdge;
-		sci.addressModeW = vuk::SamplerAddressMode::eClampToEdge;
-		sci.minLod = 0.f;
-		sci.maxLod = 4.f;
-
-		m_prefilter_cubemap = std::make_pair(gfx_util::alloc_cubemap(128, 128, ptc, 5), sci);
+		m_prefilter_cubemap = std::make_pair(gfx_util::alloc_cubemap(128, 128, ptc, 5), PREFILTER_SAMPLER);
 
 		vuk::ImageViewCreateInfo ivci{.image = *m_prefilter_cubemap.first.image,
 			.viewType = vuk::ImageViewType::e2D,
@@ -320,111 +457,242 @@ void Renderer::init(Context& ctxt) {
 			.format = vuk::Format::eR32G32B32A32Sfloat,
 			.subresourceRange = vuk::ImageSubresourceRange{.aspectMask = vuk::ImageAspectFlagBits::eColor, .levelCount = 4, .layerCount = 6}});
 	}
+}
 
-	// integrate BRDF into a LUT
+void Renderer::init_offscreen_target(vuk::PerThreadContext& ptc) {
+	const vuk::Extent2D extent = m_ctxt->output_extent;
+
+	m_offscreen_target = m_ctxt->vuk_context->allocate_texture(vuk::ImageCreateInfo{
+		.format = m_ctxt->output_format,
+		.extent = vuk::Extent3D{extent.width, extent.height, 1},
+		.mipLevels = 1,
+		.arrayLayers = 1,
+		.samples = vuk::SampleCountFlagBits::e1,
+		.tiling = vuk::ImageTiling::eOptimal,
+		// copied from by the read back
+		.usage = vuk::ImageUsageFlagBits::eColorAttachment | vuk::ImageUsageFlagBits::eSampled | vuk::ImageUsageFlagBits::eTransferSrc,
+		.sharingMode = vuk::SharingMode::eExclusive,
+	});
 
-	{
-		m_brdf_lut = std::make_pair(gfx_util::alloc_lut(512, 512, ptc), vuk::SamplerCreateInfo{
-																			.magFilter = vuk::Filter::eLinear,
-																			.minFilter = vuk::Filter::eLinear,
-																			.addressModeU = vuk::SamplerAddressMode::eClampToEdge,
-																			.addressModeV = vuk::SamplerAddressMode::eClampToEdge,
-																			.addressModeW = vuk::SamplerAddressMode::eClampToEdge,
-																		});
-
-		vuk::ImageViewCreateInfo ivci{.image = *m_brdf_lut.first.image,
-			.viewType = vuk::ImageViewType::e2D,
-			.format = vuk::Format::eR16G16Sfloat,
-			.subresourceRange = vuk::ImageSubresourceRange{.aspectMask = vuk::ImageAspectFlagBits::eColor}};
+	m_offscreen_view = ptc.create_image_view(vuk::ImageViewCreateInfo{
+		.image = *m_offscreen_target.image,
+		.viewType = vuk::ImageViewType::e2D,
+		.format = m_ctxt->output_format,
+		.subresourceRange =
+			vuk::ImageSubresourceRange{
+				.aspectMask = vuk::ImageAspectFlagBits::eColor,
+				.baseMipLevel = 0,
+				.levelCount = 1,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+	});
 
-		// upload the quad mesh
+	m_readback_buffer = m_ctxt->vuk_context->allocate_buffer(
+		vuk::MemoryUsage::eGPUtoCPU, vuk::BufferUsageFlagBits::eTransferDst, static_cast<size_t>(extent.width) * extent.height * 4, alignof(u32));
+}
 
-		auto [bqverts, _s1] = ptc.create_scratch_buffer(vuk::MemoryUsage::eGPUonly, vuk::BufferUsageFlagBits::eVertexBuffer, std::span{m_quad.first});
-		auto qverts = std::move(bqverts);
-		auto [qbinds, _s2] = ptc.create_scratch_buffer(vuk::MemoryUsage::eGPUonly, vuk::BufferUsageFlagBits::eIndexBuffer, std::span{m_quad.second});
-		auto qinds = std::move(qbinds);
+void Renderer::update() {
+	TRACE_ZONE("Renderer::update");
 
-		ptc.wait_all_transfers();
+	// per second
+	constexpr static f32 cam_speed = 0.6f;
+	constexpr static f32 sun_speed = 0.12f;
+	constexpr static f32 light_speed = 0.3f;
 
-		{
-			vuk::RenderGraph rg;
-			rg.add_pass({
-				.resources = {"brdf_out"_image(vuk::eColorWrite)},
-				.execute =
-					[&](vuk::CommandBuffer& cbuf) {
-						cbuf.set_viewport(0, vuk::Rect2D::absolute(0, 0, 512, 512))
-							.set_scissor(0, vuk::Rect2D::absolute(0, 0, 512, 512))
-							.bind_vertex_buffer(0, qverts, 0,
-								vuk::Packed{vuk::Format::eR32G32B32Sfloat, vuk::Ignore{vuk::Format::eR32G32B32Sfloat}, vuk::Format::eR32G32Sfloat})
-							.bind_index_buffer(qinds, vuk::IndexType::eUint32)
-							.bind_graphics_pipeline("brdf");
-						cbuf.draw_indexed(m_quad.second.size(), 1, 0, 0, 0);
-					},
-			});
+	const auto cpu_start = std::chrono::steady_clock::now();
 
-			auto iv = ptc.create_image_view(ivci);
+	// headless frames advance by a fixed 60 Hz step, so every run animates the same frames. The step is capped so that a hitch (or
+	// sitting in a breakpoint) doesn't teleport the camera
+	f32 dt = 1.f / 60.f;
+	if (m_ctxt->window && m_last_update) {
+		dt = std::min(std::chrono::duration<f32>(cpu_start - *m_last_update).count(), 0.1f);
+	}
+	m_last_update = cpu_start;
+
+	// no input in headless mode
+	if (m_ctxt->window) {
+		const f32 dz = (glfwGetKey(m_ctxt->window, GLFW_KEY_W) | glfwGetKey(m_ctxt->window, GLFW_KEY_UP) - glfwGetKey(m_ctxt->window, GLFW_KEY_S) |
+						   glfwGetKey(m_ctxt->window, GLFW_KEY_DOWN)) *
+					   cam_speed * dt;
+		const f32 dx = (glfwGetKey(m_ctxt->window, GLFW_KEY_D) | glfwGetKey(m_ctxt->window, GLFW_KEY_RIGHT) - glfwGetKey(m_ctxt->window, GLFW_KEY_A) |
+						   glfwGetKey(m_ctxt->window, GLFW_KEY_LEFT)) *
+					   cam_speed * dt;
+
+		m_cam_pos += m_cam_front * dz;
+		m_cam_pos += glm::normalize(glm::cross(m_cam_front, m_cam_up)) * dx;
+
+		// time of day
+		const f32 dsun = (glfwGetKey(m_ctxt->window, GLFW_KEY_E) - glfwGetKey(m_ctxt->window, GLFW_KEY_Q)) * sun_speed * dt;
+		if (dsun != 0.f) {
+			m_sun_elevation = std::clamp(m_sun_elevation + dsun, glm::radians(5.f), glm::radians(175.f));
+			m_light_direction = sun_light_direction(m_sun_elevation);
+		}
+	}
 
-			rg.attach_image("brdf_out",
-				vuk::ImageAttachment{
-					.image = *m_brdf_lut.first.image,
-					.image_view = *iv,
-					.extent = vuk::Extent2D{512, 512},
-					.format = vuk::Format::eR16G16Sfloat,
+	m_atmosphere.set_light_direction(m_light_direction);
+
+	m_time += light_speed * dt;
+	u32 i = 0;
+	m_scene.registry.view<PointLightComponent, TransformComponent>().each([&](PointLightComponent&, TransformComponent& transform) {
+		// three interleaved rings at different heights, radii and speeds
+		const u32 ring = i % 3;
+		const f32 angle = 6.2831853f * i / POINT_LIGHT_COUNT + m_time * (1.f + ring * 0.5f) * (ring == 1 ? -1.f : 1.f);
+		const f32 radius = 1.25f + ring * 0.5f;
+		transform = TransformComponent{}.translate({radius * std::cos(angle), -0.8f + ring * 0.3f, radius * std::sin(angle)});
+		++i;
+	});
+
+	m_pipe_store.update();
+
+	m_cpu_frame_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - cpu_start).count();
+}
+
+void Renderer::render() {
+	TRACE_ZONE("Renderer::render");
+
+	const auto cpu_start = std::chrono::steady_clock::now();
+
+	auto ifc = m_ctxt->vuk_context->begin();
+	auto ptc = ifc.begin();
+
+	auto rg = render_graph(ptc);
+
+	const glm::uvec2 size{m_ctxt->output_extent.width, m_ctxt->output_extent.height};
+
+	// only ever set in headless mode
+	if (m_readback) {
+		const vuk::Buffer out = m_readback_buffer;
+		const VkImage image = *m_offscreen_target.image;
+
+		// a plain copy, so the bytes are exactly what the last pass stored in the (sRGB) image, on any driver
+		m_profiler.add_pass(rg, "readback", vuk::Pass{
+			.resources = {"pbr_final"_image(vuk::eTransferSrc)},
+			.execute =
+				[out, image, size](vuk::CommandBuffer& cbuf) {
+					// rows are tightly packed, top row first
+					const VkBufferImageCopy region{
+						.bufferOffset = out.offset,
+						.bufferRowLength = 0,
+						.bufferImageHeight = 0,
+						.imageSubresource =
+							VkImageSubresourceLayers{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+						.imageOffset = VkOffset3D{0, 0, 0},
+						.imageExtent = VkExtent3D{size.x, size.y, 1},
+					};
+					vkCmdCopyImageToBuffer(cbuf.command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, out.buffer, 1, &region);
+
+					// the buffer isn't tracked by the render graph, so make the result visible to the host read below
+					VkMemoryBarrier barrier{
+						.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER, .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT, .dstAccessMask = VK_ACCESS_HOST_READ_BIT};
+					vkCmdPipelineBarrier(
+						cbuf.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
 				},
-				vuk::Access::eNone, vuk::Access::eFragmentSampled);
+		});
+	}
 
-			auto erg = std::move(rg).link(ptc);
-			vuk::execute_submit_and_wait(ptc, std::move(erg));
-		}
+	if (!m_ctxt->headless) {
+		rg.attach_swapchain("pbr_final", m_ctxt->vuk_swapchain, vuk::ClearColor{0.01f, 0.01f, 0.01f, 1.f});
+		auto erg = link(std::move(rg), ptc);
+		m_cpu_frame_ms += std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - cpu_start).count();
+		// records the command buffers, then submits and presents
+		TRACE_CALL("execute_submit_and_present", vuk::execute_submit_and_present_to_one(ptc, std::move(erg), m_ctxt->vuk_swapchain));
+		return;
 	}
 
-	auto entity = m_scene.registry.create();
-	m_scene.registry.emplace<MeshComponent>(entity, MeshCache::view("Sphere"),
-		Material{.albedo = TextureCache::view("Iron.Albedo"),
-			.metallic = TextureCache::view("Iron.Metallic"),
-			.roughness = TextureCache::view("Iron.Roughness"),
-			.normal = TextureCache::view("Iron.Normal"),
-			.ao = TextureCache::view("Iron.AO")});
-	m_scene.registry.emplace<TransformComponent>(entity, TransformComponent{});
+	rg.attach_image("pbr_final",
+		vuk::ImageAttachment{
+			.image = *m_offscreen_target.image,
+			.image_view = *m_offscreen_view,
+			.extent = m_ctxt->output_extent,
+			.format = m_ctxt->output_format,
+			.sample_count = vuk::Samples::e1,
+			.clear_value = vuk::ClearColor{0.01f, 0.01f, 0.01f, 1.f},
+		},
+		m_offscreen_used ? vuk::Access::eFragmentSampled : vuk::Access::eNone, vuk::Access::eFragmentSampled);
+	m_offscreen_used = true;
+
+	// there is nothing to present to, so the frame is waited for; that also makes the read back safe right away
+	auto erg = link(std::move(rg), ptc);
+	m_cpu_frame_ms += std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - cpu_start).count();
+	TRACE_CALL("execute_submit_and_wait", vuk::execute_submit_and_wait(ptc, std::move(erg)));
+
+	if (m_readback) {
+		const auto* pixels = reinterpret_cast<const u8*>(m_readback_buffer.mapped_ptr);
+		m_frame_pixels.assign(pixels, pixels + size.x * size.y * 4);
+	}
+}
 
-	auto entity2 = m_scene.registry.create();
-	m_scene.registry.emplace<MeshComponent>(entity2, MeshCache::view("Quad"),
-		Material{.albedo = TextureCache::view("Iron.Albedo"),
-			.metallic = TextureCache::view("Iron.Metallic"),
-			.roughness = TextureCache::view("Iron.Roughness"),
-			.normal = TextureCache::view("Iron.Normal"),
-			.ao = TextureCache::view("Iron.AO")});
-	m_scene.registry.emplace<TransformComponent>(
-		entity2, TransformComponent{}.translate({0, -1, 0}).rotate(glm::eulerAngleXYZ(glm::radians(-90.f), 0.f, 0.f)).scale({3, 3, 3}));
+void Renderer::set_readback(bool enabled) {
+	m_readback = enabled && m_ctxt->headless;
 }
 
-void Renderer::update() {
-	constexpr static f32 cam_speed = 0.01f;
+std::span<const u8> Renderer::frame() const {
+	return m_frame_pixels;
+}
 
-	const f32 dz = (glfwGetKey(m_ctxt->window, GLFW_KEY_W) | glfwGetKey(m_ctxt->window, GLFW_KEY_UP) - glfwGetKey(m_ctxt->window, GLFW_KEY_S) |
-					   glfwGetKey(m_ctxt->window, GLFW_KEY_DOWN)) *
-				   cam_speed;
-	const f32 dx = (glfwGetKey(m_ctxt->window, GLFW_KEY_D) | glfwGetKey(m_ctxt->window, GLFW_KEY_RIGHT) - glfwGetKey(m_ctxt->window, GLFW_KEY_A) |
-					   glfwGetKey(m_ctxt->window, GLFW_KEY_LEFT)) *
-				   cam_speed;
+void Renderer::set_camera(const glm::vec3& position, f32 yaw, f32 pitch) {
+	m_cam_pos = position;
+	m_yaw = yaw;
+	m_pitch = std::clamp(pitch, -89.f, 89.f);
+	m_cam_front = camera_front(m_yaw, m_pitch);
+}
 
-	m_cam_pos += m_cam_front * dz;
-	m_cam_pos += glm::normalize(glm::cross(m_cam_front, m_cam_up)) * dx;
+glm::vec3 Renderer::camera_position() const {
+	return m_cam_pos;
+}
 
-	m_pipe_store.update();
+f32 Renderer::camera_yaw() const {
+	return m_yaw;
 }
 
-void Renderer::render() {
-	auto ifc = m_ctxt->vuk_context->begin();
-	auto ptc = ifc.begin();
+f32 Renderer::camera_pitch() const {
+	return m_pitch;
+}
 
-	auto rg = render_graph(ptc);
-	rg.attach_swapchain("pbr_final", m_ctxt->vuk_swapchain, vuk::ClearColor{0.01f, 0.01f, 0.01f, 1.f});
-	auto erg = std::move(rg).link(ptc);
-	vuk::execute_submit_and_present_to_one(ptc, std::move(erg), m_ctxt->vuk_swapchain);
+void Renderer::set_horizon_ao(bool enabled) {
+	m_horizon_ao = enabled;
+}
+
+void Renderer::set_froxel_fog(bool enabled) {
+	m_froxel = enabled;
+}
+
+void Renderer::set_volumetric_downscale(u32 downscale) {
+	m_volumetric_downscale = downscale;
+}
+
+void Renderer::set_anti_aliasing(AntiAliasingPass::Mode mode) {
+	m_anti_aliasing_mode = mode;
+}
+
+f64 Renderer::cpu_frame_ms() const {
+	return m_cpu_frame_ms;
+}
+
+std::optional<f64> Renderer::gpu_frame_ms() const {
+	return m_gpu_frame_ms;
+}
+
+const GpuProfiler& Renderer::profiler() const {
+	return m_profiler;
+}
+
+std::optional<PipelineStatisticsQuery::Result> Renderer::color_pass_statistics() const {
+	return m_color_pass_result;
+}
+
+std::optional<PipelineStatisticsQuery::Result> Renderer::gbuffer_statistics() const {
+	return m_gbuffer_result;
+}
+
+CascadedShadowRenderPass& Renderer::cascaded_shadows() {
+	return m_cascaded_shadows;
 }
 
 vuk::RenderGraph Renderer::render_graph(vuk::PerThreadContext& ptc) {
+	TRACE_ZONE("Renderer::render_graph");
+
 	struct Uniforms {
 		glm::mat4 projection;
 		glm::mat4 view;
@@ -434,6 +702,7 @@ vuk::RenderGraph Renderer::render_graph(vuk::PerThreadContext& ptc) {
 	struct Cascades {
 		float cascade_splits[CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT];
 		glm::mat4 cascade_view_proj_mats[CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT];
+		glm::vec4 cascade_atlas_rects[CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT];
 		glm::vec3 light_direction;
 	};
 
@@ -441,10 +710,18 @@ vuk::RenderGraph Renderer::render_graph(vuk::PerThreadContext& ptc) {
 
 	Perspective cam_perspective;
 	cam_perspective.fovy = glm::radians(60.f);
-	cam_perspective.aspect_ratio = static_cast<f32>(m_ctxt->vkb_swapchain.extent.width) / static_cast<f32>(m_ctxt->vkb_swapchain.extent.height);
+	cam_perspective.aspect_ratio = static_cast<f32>(m_ctxt->output_extent.width) / static_cast<f32>(m_ctxt->output_extent.height);
 	cam_perspective.near = 0.1f;
 	cam_perspective.far = 100.f;
 
+	// from vuk::Context::FC frames ago
+	m_dynamic_resolution.update();
+	const vuk::Extent2D output_extent = m_ctxt->output_extent;
+	const vuk::Extent2D render_extent = m_dynamic_resolution.render_extent(output_extent);
+	const auto render_size = vuk::Dimension2D::absolute(render_extent.width, render_extent.height);
+
+	cam_perspective.jitter = AntiAliasingPass::jitter(m_anti_aliasing_mode, m_frame, render_extent.width, render_extent.height);
+
 	const glm::mat4 cam_view = glm::lookAt(m_cam_pos, m_cam_pos + m_cam_front, m_cam_up);
 
 	RenderInfo render_info;
@@ -455,12 +732,24 @@ vuk::RenderGraph Renderer::render_graph(vuk::PerThreadContext& ptc) {
 	render_info.cam_pos = m_cam_pos;
 	render_info.cam_forward = m_cam_front;
 	render_info.cam_up = m_cam_up;
-
-	render_info.window_width = m_ctxt->vkb_swapchain.extent.width;
-	render_info.window_height = m_ctxt->vkb_swapchain.extent.height;
-
-	render_info.light_direction = LIGHT_DIRECTION;
-	render_info.shadow_map = m_cascaded_shadows.shadow_map_view();
+	// the first frame has nothing to reproject from; it'll get thrown away anyway (see TemporalHistory::attach)
+	render_info.prev_view_proj = m_frame == 0 ? cam_perspective.unjittered_matrix() * cam_view : m_prev_view_proj;
+	render_info.frame = m_frame;
+
+	render_info.window_width = render_extent.width;
+	render_info.window_height = render_extent.height;
+	render_info.output_width = output_extent.width;
+	render_info.output_height = output_extent.height;
+	render_info.resolution_timer = &m_dynamic_resolution.timer();
+	render_info.gbuffer_statistics = &m_gbuffer_statistics;
+	render_info.profiler = &m_profiler;
+	render_info.deferred = m_deferred;
+	render_info.ssao_resolution = m_ssao_resolution;
+	render_info.volumetric_downscale = m_volumetric_downscale;
+	render_info.temporal = m_temporal;
+	render_info.anti_aliasing = m_anti_aliasing_mode;
+
+	render_info.light_direction = m_light_direction;
 
 	Uniforms uniforms;
 
@@ -470,56 +759,97 @@ vuk::RenderGraph Renderer::render_graph(vuk::PerThreadContext& ptc) {
 	auto [bubo, stub3] = ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eUniformBuffer, std::span(&uniforms, 1));
 	auto ubo = bubo;
 
-	Cascades cascades;
+	// from vuk::Context::FC frames ago
+	m_profiler.next_frame();
+	m_gpu_frame_ms = m_profiler.frame_ms();
+	m_color_pass_result = m_color_pass_statistics.next_frame();
+	m_gbuffer_result = m_gbuffer_statistics.next_frame();
+	if (m_color_pass_result && m_gbuffer_result) {
+		const f64 pixels = static_cast<f64>(render_info.window_width) * render_info.window_height;
+		spdlog::debug("color pass: {} vertex, {} fragment shader invocations ({:.2f} per pixel); gbuffer: {} fragment ({:.2f} per pixel)",
+			m_color_pass_result->vertex_invocations, m_color_pass_result->fragment_invocations, m_color_pass_result->fragment_invocations / pixels,
+			m_gbuffer_result->fragment_invocations, m_gbuffer_result->fragment_invocations / pixels);
+	}
+
+	m_atmosphere.cam_proj = cam_perspective;
+	m_atmosphere.cam_pos = m_cam_pos;
+
+	{
+		TRACE_ZONE("transform uploads");
+
+		u32 offset = 0;
+		meshes_view.each([&](MeshComponent& mesh, TransformComponent& transform) {
+			ptc.upload(m_transform_buffer.subrange(offset, sizeof(glm::mat4)), std::span{&transform.matrix(), 1});
+			offset += m_transform_buffer_alignment;
+		});
+	}
+
+	m_scene_renderer.update(ptc, m_scene);
+	render_info.static_geometry_dirty = m_scene_renderer.static_dirty();
+	render_info.objects = m_scene_renderer.objects();
+	render_info.scene_min = m_scene_renderer.bounds_min();
+	render_info.scene_max = m_scene_renderer.bounds_max();
+	render_info.lights = m_scene_renderer.lights();
+
+	// the shadow pass picks the cascades (some of which may be cached) in prep, based on the depth bounds of an earlier frame
+	m_depth_reduction.prep(ptc, *m_ctxt, render_info);
+	m_cascaded_shadows.prep(ptc, *m_ctxt, render_info);
+	// prep may have re-allocated the atlas
+	// either one writes ssao_blurred
+	if (m_horizon_ao) {
+		m_gtao.prep(ptc, *m_ctxt, render_info);
+	} else {
+		m_ssao.prep(ptc, *m_ctxt, render_info);
+	}
+	m_gbuffer.prep(ptc, *m_ctxt, render_info);
+	if (m_froxel) {
+		m_froxel_fog.prep(ptc, *m_ctxt, render_info);
+	} else {
+		m_volumetric_light.prep(ptc, *m_ctxt, render_info);
+	}
+	m_clustered_lights.prep(ptc, *m_ctxt, render_info);
+	m_anti_aliasing.prep(ptc, *m_ctxt, render_info);
+	m_post_process.prep(ptc, *m_ctxt, render_info);
 
-	cascades.light_direction = LIGHT_DIRECTION;
+	Cascades cascades;
 
-	render_info.cascades = m_cascaded_shadows.compute_cascades(render_info);
+	cascades.light_direction = m_light_direction;
 
 	for (u32 i = 0; i < render_info.cascades.size(); ++i) {
 		cascades.cascade_splits[i] = render_info.cascades[i].split_depth;
 		cascades.cascade_view_proj_mats[i] = render_info.cascades[i].view_proj_mat;
+		cascades.cascade_atlas_rects[i] = render_info.cascades[i].atlas_rect;
 	}
 
 	auto [bcascade_ubo, cascadestub] =
 		ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eUniformBuffer, std::span{&cascades, 1});
 	auto cascade_ubo = bcascade_ubo;
 
-	m_atmosphere.cam_proj = cam_perspective;
-	m_atmosphere.cam_pos = m_cam_pos;
-
-	u32 offset = 0;
-	meshes_view.each([&](MeshComponent& mesh, TransformComponent& transform) {
-		ptc.upload(m_transform_buffer.subrange(offset, sizeof(glm::mat4)), std::span{&transform.matrix, 1});
-		offset += m_transform_buffer_alignment;
-	});
-
-	m_cascaded_shadows.prep(ptc, *m_ctxt, render_info);
-	m_ssao.prep(ptc, *m_ctxt, render_info);
-	m_gbuffer.prep(ptc, *m_ctxt, render_info);
-	m_volumetric_light.prep(ptc, *m_ctxt, render_info);
-
-	ptc.wait_all_transfers();
-
-	m_scene_renderer.update(ptc, m_scene);
+	TRACE_CALL("wait_all_transfers", ptc.wait_all_transfers());
 
 	vuk::RenderGraph rg;
 
+	// amortized re-bake of the sky (and its IBL maps) if the sun moved
+	m_atmosphere.bake(rg, m_profiler, m_scene.meshes.get(MeshCache::view("Cube")));
+
 	// cool fancy effects
 
 	m_cascaded_shadows.render(ptc, *m_ctxt, rg, m_scene_renderer, render_info);
-	m_ssao.render(ptc, *m_ctxt, rg, m_scene_renderer, render_info);
+	if (m_horizon_ao) {
+		m_gtao.render(ptc, *m_ctxt, rg, m_scene_renderer, render_info);
+	} else {
+		m_ssao.render(ptc, *m_ctxt, rg, m_scene_renderer, render_info);
+	}
 	m_gbuffer.render(ptc, *m_ctxt, rg, m_scene_renderer, render_info);
-	m_volumetric_light.render(ptc, *m_ctxt, rg, m_scene_renderer, render_info);
+	m_depth_reduction.render(ptc, *m_ctxt, rg, m_scene_renderer, render_info);
+	if (m_froxel) {
+		m_froxel_fog.render(ptc, *m_ctxt, rg, m_scene_renderer, render_info);
+	} else {
+		m_volumetric_light.render(ptc, *m_ctxt, rg, m_scene_renderer, render_info);
+	}
 
 	// color pass
 
-	struct PushConstants {
-		glm::vec3 cam_pos;
-		f32 _pad;
-		glm::vec2 screen_size;
-	} push_consts{m_cam_pos, 0.f, glm::vec2{m_ctxt->vkb_swapchain.extent.width, m_ctxt->vkb_swapchain.extent.height}};
-
 	const vuk::SamplerCreateInfo map_sampler{.magFilter = vuk::Filter::eLinear,
 		.minFilter = vuk::Filter::eLinear,
 		.addressModeU = vuk::SamplerAddressMode::eRepeat,
@@ -530,90 +860,294 @@ vuk::RenderGraph Renderer::render_graph(vuk::PerThreadContext& ptc) {
 		.minLod = 0.f,
 		.maxLod = 16.f};
 
-	rg.add_pass({
-		.resources =
-			{
-				"pbr_msaa"_image(vuk::eColorWrite),
-				"pbr_depth"_image(vuk::eDepthStencilRW),
-				"ssao_blurred"_image(vuk::eFragmentSampled),
-			},
-		.execute =
-			[this, meshes_view, map_sampler, ubo, cascade_ubo, push_consts](vuk::CommandBuffer& cbuf) {
-				const auto sci = vuk::SamplerCreateInfo{.addressModeU = vuk::SamplerAddressMode::eClampToBorder,
-					.addressModeV = vuk::SamplerAddressMode::eClampToBorder,
-					.addressModeW = vuk::SamplerAddressMode::eClampToBorder};
-
-				// draw skybox
-				m_atmosphere.draw(cbuf, ubo, m_scene.meshes.get(MeshCache::view("Cube")));
-
-				cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
-					.set_scissor(0, vuk::Rect2D::framebuffer())
-					.set_primitive_topology(vuk::PrimitiveTopology::eTriangleList)
-					.bind_uniform_buffer(0, 0, ubo)
-					.push_constants(vuk::ShaderStageFlagBits::eFragment, 0, push_consts)
-					.bind_sampled_image(0, 1, *m_irradiance_cubemap_iv, m_irradiance_cubemap.second)
-					.bind_sampled_image(0, 2, *m_prefilter_cubemap_iv, m_prefilter_cubemap.second)
-					.bind_sampled_image(0, 3, m_brdf_lut.first, m_brdf_lut.second)
-					.bind_sampled_image(0, 4, m_cascaded_shadows.shadow_map_view(), sci)
-					.bind_sampled_image(0, 5, "ssao_blurred", sci)
-					.bind_uniform_buffer(0, 6, cascade_ubo)
-					.bind_graphics_pipeline("pbr");
-
-				u64 offset = 0;
-				meshes_view.each([&](MeshComponent& mesh_comp, TransformComponent& transform_comp) {
-					cbuf.bind_vertex_buffer(0, *m_scene.meshes.get(mesh_comp.mesh).verts, 0,
-							vuk::Packed{vuk::Format::eR32G32B32Sfloat, vuk::Format::eR32G32B32Sfloat, vuk::Format::eR32G32Sfloat})
-						.bind_index_buffer(*m_scene.meshes.get(mesh_comp.mesh).inds, vuk::IndexType::eUint32)
-						.bind_sampled_image(2, 0, m_scene.textures.get(mesh_comp.material.albedo), map_sampler)
-						.bind_sampled_image(2, 1, m_scene.textures.get(mesh_comp.material.normal), map_sampler)
-						.bind_sampled_image(2, 2, m_scene.textures.get(mesh_comp.material.metallic), map_sampler)
-						.bind_sampled_image(2, 3, m_scene.textures.get(mesh_comp.material.roughness), map_sampler)
-						.bind_sampled_image(2, 4, m_scene.textures.get(mesh_comp.material.ao), map_sampler)
-						.bind_uniform_buffer(1, 0, m_transform_buffer.subrange(offset, m_transform_buffer_alignment));
-					cbuf.draw_indexed(m_scene.meshes.get(mesh_comp.mesh).mesh.second.size(), 1, 0, 0, 0);
-					offset += m_transform_buffer_alignment;
-				});
-			},
-	});
+	// set 0 of pbr_lighting.glsl, shared by both paths
+	const auto bind_lighting = [this, cascade_ubo](vuk::CommandBuffer& cbuf) {
+		const auto sci = vuk::SamplerCreateInfo{.addressModeU = vuk::SamplerAddressMode::eClampToBorder,
+			.addressModeV = vuk::SamplerAddressMode::eClampToBorder,
+			.addressModeW = vuk::SamplerAddressMode::eClampToBorder};
+
+		cbuf.bind_sampled_image(0, 1, m_atmosphere.procedural() ? m_atmosphere.irradiance_view() : *m_irradiance_cubemap_iv, IRRADIANCE_SAMPLER)
+			.bind_sampled_image(0, 2, m_atmosphere.procedural() ? m_atmosphere.prefilter_view() : *m_prefilter_cubemap_iv, PREFILTER_SAMPLER)
+			.bind_sampled_image(0, 3, m_brdf_lut.first, m_brdf_lut.second)
+			.bind_sampled_image(0, 4, CascadedShadowRenderPass::ATLAS_ATTACHMENT_NAME, sci)
+			.bind_sampled_image(0, 5, "ssao_blurred", sci)
+			.bind_uniform_buffer(0, 6, cascade_ubo);
+		m_clustered_lights.bind(cbuf);
+	};
+
+	if (m_deferred) {
+		struct Camera {
+			glm::mat4 inv_view_proj;
+			glm::mat4 view;
+			glm::vec3 cam_pos;
+			// see AtmosphericSkyCubemap::skybox_model_matrix
+			f32 sky_half_extent;
+		} camera{glm::inverse(cam_perspective.matrix() * cam_view), cam_view, m_cam_pos, cam_perspective.far / std::sqrt(3.f)};
+
+		auto [bcamera_ubo, camerastub] =
+			ptc.create_scratch_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eUniformBuffer, std::span{&camera, 1});
+		auto camera_ubo = bcamera_ubo;
+		TRACE_CALL("wait_all_transfers", ptc.wait_all_transfers());
+		const glm::vec2 screen_size{render_extent.width, render_extent.height};
+
+		// one fullscreen pass that shades every pixel of the g-buffer exactly once
+		m_profiler.add_pass(rg, "deferred lighting", {
+			.resources =
+				{
+					"pbr_msaa"_image(vuk::eColorWrite),
+					"depth_prepass"_image(vuk::eFragmentSampled),
+					"g_normal"_image(vuk::eFragmentSampled),
+					"g_albedo"_image(vuk::eFragmentSampled),
+					"g_material"_image(vuk::eFragmentSampled),
+					"ssao_blurred"_image(vuk::eFragmentSampled),
+					vuk::Resource{CascadedShadowRenderPass::ATLAS_ATTACHMENT_NAME, vuk::Resource::Type::eImage, vuk::eFragmentSampled},
+				},
+			.execute =
+				[this, bind_lighting, ubo, camera_ubo, screen_size](vuk::CommandBuffer& cbuf) {
+					m_anti_aliasing.begin_timing(cbuf);
+					m_color_pass_statistics.begin(cbuf);
+
+					// draw skybox; the lighting pass discards the pixels that show it
+					m_atmosphere.draw(cbuf, ubo, m_scene.meshes.get(MeshCache::view("Cube")));
+
+					cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
+						.set_scissor(0, vuk::Rect2D::framebuffer())
+						.set_primitive_topology(vuk::PrimitiveTopology::eTriangleList)
+						.bind_graphics_pipeline("deferred_lighting")
+						.bind_uniform_buffer(0, 0, camera_ubo)
+						.bind_sampled_image(1, 0, "depth_prepass", {})
+						.bind_sampled_image(1, 1, "g_normal", {})
+						.bind_sampled_image(1, 2, "g_albedo", {})
+						.bind_sampled_image(1, 3, "g_material", {})
+						.push_constants(vuk::ShaderStageFlagBits::eFragment, 0, screen_size);
+					bind_lighting(cbuf);
+					cbuf.draw(3, 1, 0, 0);
+
+					m_color_pass_statistics.end(cbuf);
+				},
+		});
+	} else {
+		struct PushConstants {
+			glm::vec3 cam_pos;
+			f32 _pad;
+			glm::vec2 screen_size;
+		} push_consts{m_cam_pos, 0.f, glm::vec2{render_extent.width, render_extent.height}};
+
+		// with MSAA, into a multisampled target that gets resolved into pbr_msaa
+		const bool multisampled = m_anti_aliasing.mode() == AntiAliasingPass::Mode::MSAA;
+		const vuk::Name pipeline = multisampled ? "pbr_multisampled" : "pbr";
+
+		auto pass = vuk::Pass{
+			.resources =
+				{
+					multisampled ? "pbr_multisampled"_image(vuk::eColorWrite) : "pbr_msaa"_image(vuk::eColorWrite),
+					multisampled ? "depth_multisampled"_image(vuk::eDepthStencilRW) : "depth_prepass"_image(vuk::eDepthStencilRead),
+					"ssao_blurred"_image(vuk::eFragmentSampled),
+					vuk::Resource{CascadedShadowRenderPass::ATLAS_ATTACHMENT_NAME, vuk::Resource::Type::eImage, vuk::eFragmentSampled},
+				},
+			.execute =
+				[this, meshes_view, map_sampler, bind_lighting, ubo, push_consts, pipeline](vuk::CommandBuffer& cbuf) {
+					m_anti_aliasing.begin_timing(cbuf);
+					m_color_pass_statistics.begin(cbuf);
+
+					// draw skybox; it doesn't depth test, so everything else is drawn over it
+					m_atmosphere.draw(cbuf, ubo, m_scene.meshes.get(MeshCache::view("Cube")));
+
+					cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
+						.set_scissor(0, vuk::Rect2D::framebuffer())
+						.set_primitive_topology(vuk::PrimitiveTopology::eTriangleList)
+						.bind_uniform_buffer(0, 0, ubo)
+						.push_constants(vuk::ShaderStageFlagBits::eFragment, 0, push_consts)
+						.bind_graphics_pipeline(pipeline);
+					bind_lighting(cbuf);
+
+					u64 offset = 0;
+					meshes_view.each([&](MeshComponent& mesh_comp, TransformComponent& transform_comp) {
+						cbuf.bind_vertex_buffer(0, *m_scene.meshes.get(mesh_comp.mesh).verts, 0,
+								vuk::Packed{vuk::Format::eR32G32B32Sfloat, vuk::Format::eR32G32B32Sfloat, vuk::Format::eR32G32Sfloat})
+							.bind_index_buffer(*m_scene.meshes.get(mesh_comp.mesh).inds, vuk::IndexType::eUint32)
+							.bind_sampled_image(2, 0, m_scene.textures.get(mesh_comp.material.albedo), map_sampler)
+							.bind_sampled_image(2, 1, m_scene.textures.get(mesh_comp.material.normal), map_sampler)
+							.bind_sampled_image(2, 2, m_scene.textures.get(mesh_comp.material.metallic), map_sampler)
+							.bind_sampled_image(2, 3, m_scene.textures.get(mesh_comp.material.roughness), map_sampler)
+							.bind_sampled_image(2, 4, m_scene.textures.get(mesh_comp.material.ao), map_sampler)
+							.bind_uniform_buffer(1, 0, m_transform_buffer.subrange(offset, m_transform_buffer_alignment));
+						cbuf.draw_indexed(m_scene.meshes.get(mesh_comp.mesh).mesh.second.size(), 1, 0, 0, 0);
+						offset += m_transform_buffer_alignment;
+					});
+
+					m_color_pass_statistics.end(cbuf);
+				},
+		};
+		m_profiler.add_pass(rg, "forward lighting", pass);
+
+		if (multisampled) {
+			rg.attach_managed(
+				"pbr_multisampled", PostProcessPass::HDR_FORMAT, render_size, AntiAliasingPass::MSAA_SAMPLES, vuk::ClearColor{0.01f, 0.01f, 0.01f, 1.f});
+			rg.attach_managed("depth_multisampled", vuk::Format::eD32Sfloat, render_size, AntiAliasingPass::MSAA_SAMPLES, vuk::ClearDepthStencil{1.f, 0});
+			rg.resolve_resource_into("pbr_msaa", "pbr_multisampled");
+		}
+	}
+
+	m_anti_aliasing.render(ptc, *m_ctxt, rg, m_scene_renderer, render_info);
 
 	// composite pass
 
-	rg.add_pass({
+	// into pbr_hdr, for PostProcessPass; the scene is taa_history in TAA mode. It's also where the render resolution is upsampled to the
+	// swapchain's
+	const bool post_aa = m_anti_aliasing.post();
+	const vuk::Name scene_color = m_anti_aliasing.temporal() ? "taa_history" : "pbr_msaa";
+
+	auto composite = vuk::Pass{
 		.resources =
 			{
-				"pbr_composite"_image(vuk::eColorWrite),
-				"pbr_msaa"_image(vuk::eFragmentSampled),
-				"volumetric_light_blurred"_image(vuk::eFragmentSampled),
+				"pbr_hdr"_image(vuk::eColorWrite),
+				m_anti_aliasing.temporal() ? "taa_history"_image(vuk::eFragmentSampled) : "pbr_msaa"_image(vuk::eFragmentSampled),
+				"depth_prepass"_image(vuk::eFragmentSampled),
 			},
 		.execute =
-			[](vuk::CommandBuffer& cbuf) {
+			[this, scene_color, froxel = m_froxel](vuk::CommandBuffer& cbuf) {
+				// bilinear for the upsample; at full resolution every pixel still lands on a texel center
 				const auto sci = vuk::SamplerCreateInfo{
+					.magFilter = vuk::Filter::eLinear,
+					.minFilter = vuk::Filter::eLinear,
 					.addressModeU = vuk::SamplerAddressMode::eClampToBorder,
 					.addressModeV = vuk::SamplerAddressMode::eClampToBorder,
 					.addressModeW = vuk::SamplerAddressMode::eClampToBorder,
 				};
 
-				cbuf.set_viewport(0, vuk::Rect2D::framebuffer())
-					.set_scissor(0, vuk::Rect2D::framebuffer())
-					.bind_graphics_pipeline("composite")
-					.bind_sampled_image(0, 0, "pbr_msaa", sci)
-					.bind_sampled_image(0, 1, "volumetric_light_blurred", sci)
-					.draw(3, 1, 0, 0);
+				if (froxel) {
+					m_froxel_fog.composite(cbuf, scene_color, sci);
+				} else {
+					m_volumetric_light.composite(cbuf, scene_color, sci);
+				}
+
+				m_dynamic_resolution.timer().end(cbuf);
+			},
+	};
+
+	if (m_froxel) {
+		composite.resources.push_back("froxel_integrated"_image(vuk::eFragmentSampled));
+	} else {
+		composite.resources.push_back("volumetric_light_blurred"_image(vuk::eFragmentSampled));
+		composite.resources.push_back("volumetric_march_depth"_image(vuk::eFragmentSampled));
+	}
+
+	m_profiler.add_pass(rg, "composite", composite);
+
+	// post-processing
+
+	m_post_process.render(ptc, *m_ctxt, rg, m_scene_renderer, render_info);
+
+	// straight into the swapchain image, unless FXAA still has to run over it
+	m_profiler.add_pass(rg, "tonemap", vuk::Pass{
+		.resources =
+			{
+				post_aa ? "pbr_composite"_image(vuk::eColorWrite) : "pbr_final"_image(vuk::eColorWrite),
+				"pbr_hdr"_image(vuk::eFragmentSampled),
+				"bloom_up_0"_image(vuk::eFragmentSampled),
+				"exposure"_image(vuk::eFragmentSampled),
+			},
+		.execute =
+			[this, post_aa](vuk::CommandBuffer& cbuf) {
+				m_post_process.tonemap(cbuf);
+
+				if (!post_aa) {
+					m_anti_aliasing.end_timing(cbuf);
+				}
 			},
 	});
 
-	rg.attach_managed("pbr_msaa", static_cast<vuk::Format>(m_ctxt->vkb_swapchain.image_format),
-		vuk::Dimension2D::absolute(m_ctxt->vkb_swapchain.extent.width, m_ctxt->vkb_swapchain.extent.height), vuk::Samples::e1,
-		vuk::ClearColor{0.01f, 0.01f, 0.01f, 1.f});
-	rg.attach_managed("pbr_composite", static_cast<vuk::Format>(m_ctxt->vkb_swapchain.image_format),
-		vuk::Dimension2D::absolute(m_ctxt->vkb_swapchain.extent.width, m_ctxt->vkb_swapchain.extent.height), vuk::Samples::e8,
+	m_anti_aliasing.render_post(rg, m_profiler);
+
+	rg.attach_managed("pbr_msaa", PostProcessPass::HDR_FORMAT, render_size, vuk::Samples::e1, vuk::ClearColor{0.01f, 0.01f, 0.01f, 1.f});
+	rg.attach_managed("pbr_hdr", PostProcessPass::HDR_FORMAT, vuk::Dimension2D::absolute(output_extent.width, output_extent.height), vuk::Samples::e1,
 		vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
-	rg.attach_managed("pbr_depth", vuk::Format::eD32Sfloat, vuk::Dimension2D::framebuffer(), vuk::Samples::Framebuffer{}, vuk::ClearDepthStencil{1.f, 0});
-	rg.resolve_resource_into("pbr_final", "pbr_composite");
+	if (post_aa) {
+		rg.attach_managed("pbr_composite", m_ctxt->output_format, vuk::Dimension2D::absolute(output_extent.width, output_extent.height), vuk::Samples::e1,
+			vuk::ClearColor{0.f, 0.f, 0.f, 1.f});
+	}
+
+	m_prev_view_proj = cam_perspective.unjittered_matrix() * cam_view;
+	++m_frame;
 
 	return rg;
 }
 
+void Renderer::key_event(i32 key, i32 action) {
+	if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+		m_deferred = !m_deferred;
+		spdlog::info("shading: {}", m_deferred ? "deferred" : "forward");
+	}
+
+	if (key == GLFW_KEY_O && action == GLFW_PRESS) {
+		switch (m_ssao_resolution) {
+		case SSAOPass::Resolution::Full:
+			m_ssao_resolution = SSAOPass::Resolution::Half;
+			break;
+		case SSAOPass::Resolution::Half:
+			m_ssao_resolution = SSAOPass::Resolution::Quarter;
+			break;
+		case SSAOPass::Resolution::Quarter:
+			m_ssao_resolution = SSAOPass::Resolution::Full;
+			break;
+		}
+		spdlog::info("ssao: {} resolution", SSAOPass::resolution_name(m_ssao_resolution));
+	}
+
+	if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+		m_horizon_ao = !m_horizon_ao;
+		spdlog::info("ambient occlusion: {}", m_horizon_ao ? "gtao" : "ssao");
+	}
+
+	if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+		m_froxel = !m_froxel;
+		spdlog::info("volumetric fog: {}", m_froxel ? "froxels" : "raymarched");
+	}
+
+	if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+		switch (m_anti_aliasing_mode) {
+		case AntiAliasingPass::Mode::None:
+			m_anti_aliasing_mode = AntiAliasingPass::Mode::MSAA;
+			break;
+		case AntiAliasingPass::Mode::MSAA:
+			m_anti_aliasing_mode = AntiAliasingPass::Mode::FXAA;
+			break;
+		case AntiAliasingPass::Mode::FXAA:
+			m_anti_aliasing_mode = AntiAliasingPass::Mode::TAA;
+			break;
+		case AntiAliasingPass::Mode::TAA:
+			m_anti_aliasing_mode = AntiAliasingPass::Mode::None;
+			break;
+		}
+		spdlog::info("anti-aliasing: {}{}", AntiAliasingPass::mode_name(m_anti_aliasing_mode),
+			m_anti_aliasing_mode == AntiAliasingPass::Mode::MSAA && m_deferred ? " (forward shading only)" : "");
+	}
+
+	if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+		m_dynamic_resolution.set_enabled(!m_dynamic_resolution.enabled());
+		spdlog::info("dynamic resolution: {}", m_dynamic_resolution.enabled() ? "on" : "off");
+	}
+
+	if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+		m_profiler.log();
+	}
+
+	if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+		cpu_trace::write_chrome_json("cpu_trace.json");
+	}
+
+	if (key == GLFW_KEY_H && action == GLFW_PRESS) {
+		m_volumetric_downscale = m_volumetric_downscale == 4 ? 1 : m_volumetric_downscale * 2;
+		spdlog::info("volumetric light: 1/{} resolution", m_volumetric_downscale);
+	}
+
+	if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+		m_temporal = !m_temporal;
+		spdlog::info("temporal accumulation: {}", m_temporal ? "on" : "off");
+	}
+}
+
 void Renderer::mouse_event(f64 x_pos, f64 y_pos) {
 	static constexpr f32 sensitivity = 0.05f;
 
@@ -633,9 +1167,5 @@ void Renderer::mouse_event(f64 x_pos, f64 y_pos) {
 
 	m_pitch = std::min(std::max(m_pitch, -89.f), 89.f);
 
-	glm::vec3 dir;
-	dir.x = std::cos(glm::radians(m_yaw)) * std::cos(glm::radians(m_pitch));
-	dir.y = std::sin(glm::radians(m_pitch));
-	dir.z = std::sin(glm::radians(m_yaw)) * std::cos(glm::radians(m_pitch));
-	m_cam_front = glm::normalize(dir);
+	m_cam_front = camera_front(m_yaw, m_pitch);
 }
@@ -6,30 +6,79 @@
 #include "Material.hpp"
 #include "Uniforms.hpp"
 #include "PipelineStore.hpp"
+#include "GpuQueries.hpp"
+#include "GpuProfiler.hpp"
+#include "DynamicResolution.hpp"
 #include "GfxParts/CascadedShadows.hpp"
 #include "GfxParts/SSAO.hpp"
+#include "GfxParts/GTAO.hpp"
 #include "GfxParts/GBuffer.hpp"
 #include "GfxParts/VolumetricLights.hpp"
+#include "GfxParts/FroxelFog.hpp"
 #include "GfxParts/Atmosphere.hpp"
+#include "GfxParts/DepthReduction.hpp"
+#include "GfxParts/ClusteredLights.hpp"
+#include "GfxParts/AntiAliasing.hpp"
+#include "GfxParts/PostProcess.hpp"
 
 #include <glm/vec3.hpp>
 #include <vuk/Image.hpp>
 #include <vuk/RenderGraph.hpp>
+#include <chrono>
 #include <optional>
+#include <span>
+#include <vector>
 
 class Renderer {
   public:
 	Renderer();
 
-	void init(struct Context& ctxt);
+	// false (and logged) if a resource the renderer can't do without failed to load
+	bool init(struct Context& ctxt);
 
 	void update();
 	void render();
 
 	void mouse_event(f64 x_pos, f64 y_pos);
+	void key_event(i32 key, i32 action);
+
+	// headless mode only (see Context::create): render() also copies the final image back to the CPU, where frame() returns it
+	void set_readback(bool enabled);
+	// the final image of the last render() with read back enabled: width * height RGBA8 texels (sRGB encoded), top row first
+	std::span<const u8> frame() const;
+
+	// for scripted cameras (see CameraPath); yaw and pitch are in degrees, like mouse_event turns them
+	void set_camera(const glm::vec3& position, f32 yaw, f32 pitch);
+	glm::vec3 camera_position() const;
+	f32 camera_yaw() const;
+	f32 camera_pitch() const;
+
+	// for scripted runs, the settings G, V, H and M toggle (see key_event); the downscale is 1, 2 or 4
+	void set_horizon_ao(bool enabled);
+	void set_froxel_fog(bool enabled);
+	void set_volumetric_downscale(u32 downscale);
+	void set_anti_aliasing(AntiAliasingPass::Mode mode);
+
+	// CPU time of the last update() and render(), up to handing the frame to vuk (which records it, and waits for it in headless mode)
+	f64 cpu_frame_ms() const;
+	// GPU time of the whole frame vuk::Context::FC frames before the last render() (see GpuProfiler::frame_ms); empty before that, or without
+	// Context::timestamps
+	std::optional<f64> gpu_frame_ms() const;
+	// per pass GPU times; also logged with P
+	const GpuProfiler& profiler() const;
+	// shader invocations of the color pass, and of the G-buffer pass: the same geometry with its own depth test, i.e. what the color pass
+	// shaded before it tested against depth_prepass. Like gpu_frame_ms, vuk::Context::FC frames old, and empty without Context::pipeline_statistics
+	std::optional<PipelineStatisticsQuery::Result> color_pass_statistics() const;
+	std::optional<PipelineStatisticsQuery::Result> gbuffer_statistics() const;
+	// its settings, and the stats of the last render() (complete once it returns in headless mode, which waits for the frame)
+	CascadedShadowRenderPass& cascaded_shadows();
 
   private:
 	vuk::RenderGraph render_graph(vuk::PerThreadContext& ptc);
+	// headless mode: the final image goes into m_offscreen_target instead of a swapchain image
+	void init_offscreen_target(vuk::PerThreadContext& ptc);
+	// converts forest_slope_1k.hdr into the environment, irradiance and prefilter cubemaps lighting uses when the sky isn't procedural
+	void bake_static_environment(vuk::PerThreadContext& ptc);
 
 	struct Context* m_ctxt;
 
@@ -41,9 +90,51 @@ class Renderer {
 
 	CascadedShadowRenderPass m_cascaded_shadows;
 	SSAOPass m_ssao;
+	GTAOPass m_gtao;
 	GBufferPass m_gbuffer;
 	VolumetricLightPass m_volumetric_light;
+	FroxelFogPass m_froxel_fog;
 	AtmosphericSkyCubemap m_atmosphere;
+	DepthReductionPass m_depth_reduction;
+	ClusteredLightPass m_clustered_lights;
+	AntiAliasingPass m_anti_aliasing;
+	PostProcessPass m_post_process;
+
+	PipelineStatisticsQuery m_color_pass_statistics;
+	PipelineStatisticsQuery m_gbuffer_statistics;
+	std::optional<PipelineStatisticsQuery::Result> m_color_pass_result;
+	std::optional<PipelineStatisticsQuery::Result> m_gbuffer_result;
+	// toggled with B
+	DynamicResolution m_dynamic_resolution;
+	// times every pass of the frame
+	GpuProfiler m_profiler;
+	std::optional<f64> m_gpu_frame_ms;
+	f64 m_cpu_frame_ms;
+
+	// shade in a fullscreen pass over the g-buffer instead of in a second geometry pass
+	bool m_deferred;
+	// cycled with O
+	SSAOPass::Resolution m_ssao_resolution;
+	// GTAOPass instead of SSAOPass, toggled with G
+	bool m_horizon_ao;
+	// FroxelFogPass instead of VolumetricLightPass, toggled with V
+	bool m_froxel;
+	// VolumetricLightPass raymarches at 1/m_volumetric_downscale of the window's resolution (1, 2 or 4), cycled with H
+	u32 m_volumetric_downscale;
+	// accumulate SSAO and the volumetric light over frames (with fewer samples per frame), toggled with T
+	bool m_temporal;
+	// cycled with M
+	AntiAliasingPass::Mode m_anti_aliasing_mode;
+
+	u64 m_frame;
+	glm::mat4 m_prev_view_proj;
+
+	f32 m_sun_elevation;
+	// drives the local lights' orbits
+	f32 m_time;
+	// of the last update(), which the animation and movement speeds are scaled by the time since
+	std::optional<std::chrono::steady_clock::time_point> m_last_update;
+	glm::vec3 m_light_direction;
 
 	f64 m_last_x;
 	f64 m_last_y;
@@ -69,6 +160,15 @@ class Renderer {
 	vuk::Unique<vuk::ImageView> m_env_cubemap_iv;
 	vuk::Unique<vuk::ImageView> m_irradiance_cubemap_iv;
 	vuk::Unique<vuk::ImageView> m_prefilter_cubemap_iv;
+
+	vuk::Texture m_offscreen_target;
+	vuk::Unique<vuk::ImageView> m_offscreen_view;
+	// whether the target has been through a frame (and so has to be waited on before it's overwritten)
+	bool m_offscreen_used;
+	// host visible, output_extent RGBA8 texels
+	vuk::Buffer m_readback_buffer;
+	bool m_readback;
+	std::vector<u8> m_frame_pixels;
 };
 
 struct RenderInfo {
@@ -79,11 +179,46 @@ struct RenderInfo {
 	glm::vec3 cam_pos;
 	glm::vec3 cam_forward;
 	glm::vec3 cam_up;
+	// the camera's view-projection of the previous frame, for reprojecting into a TemporalHistory
+	glm::mat4 prev_view_proj;
+
+	// increases by one every frame
+	u64 frame;
 
+	// the internal render resolution, which every pass renders at; the composite upsamples it to the swapchain's (see DynamicResolution)
 	u32 window_width;
 	u32 window_height;
+	// the swapchain's, which the post-processing runs at
+	u32 output_width;
+	u32 output_height;
+	// brackets the passes whose cost depends on the render resolution: begun by GBufferPass, ended by the composite
+	GpuTimer* resolution_timer;
+	// begun and ended by GBufferPass
+	PipelineStatisticsQuery* gbuffer_statistics;
+	// every pass of the frame is added through this
+	GpuProfiler* profiler;
+
+	// see Renderer::m_deferred
+	bool deferred;
+	SSAOPass::Resolution ssao_resolution;
+	// see Renderer::m_volumetric_downscale
+	u32 volumetric_downscale;
+	// see Renderer::m_temporal
+	bool temporal;
+	// see Renderer::m_anti_aliasing_mode; cam_proj is jittered in TAA mode
+	AntiAliasingPass::Mode anti_aliasing;
+
+	// a static object was added, removed or moved this frame
+	bool static_geometry_dirty;
+	// everything SceneRenderer draws this frame, and its world space bounds
+	std::span<const SceneRenderer::RenderObject> objects;
+	glm::vec3 scene_min;
+	glm::vec3 scene_max;
+	// point and spot lights, world space
+	std::span<const LightClusters::Light> lights;
+	// closest/furthest visible view distance, a few frames old (see DepthReductionPass)
+	std::optional<glm::vec2> depth_bounds;
 
 	glm::vec3 light_direction;
-	vuk::ImageView shadow_map;
 	std::array<CascadedShadowRenderPass::CascadeInfo, CascadedShadowRenderPass::SHADOW_MAP_CASCADE_COUNT> cascades;
 };
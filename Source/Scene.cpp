@@ -2,9 +2,15 @@
 
 #include "Context.hpp"
 #include "GfxUtil.hpp"
+#include "CpuTrace.hpp"
 
 #include <vuk/Context.hpp>
 #include <vuk/CommandBuffer.hpp>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <bit>
+#include <limits>
+#include <cmath>
 
 SceneRenderer SceneRenderer::create(Context& ctxt, Scene& scene) {
 	static constexpr u32 MAX_SCENE_OBJECTS = 1000;
@@ -13,6 +19,11 @@ SceneRenderer SceneRenderer::create(Context& ctxt, Scene& scene) {
 
 	sr.m_ctxt = &ctxt;
 	sr.m_scene = &scene;
+	sr.m_bounds_min = glm::vec3{std::numeric_limits<f32>::max()};
+	sr.m_bounds_max = glm::vec3{std::numeric_limits<f32>::lowest()};
+	sr.m_static_count = 0;
+	sr.m_static_dirty = true;
+	sr.m_has_dynamic = false;
 	sr.m_transform_buffer =
 		ctxt.vuk_context->allocate_buffer(vuk::MemoryUsage::eCPUtoGPU, vuk::BufferUsageFlagBits::eUniformBuffer | vuk::BufferUsageFlagBits::eTransferDst,
 			MAX_SCENE_OBJECTS * gfx_util::uniform_buffer_offset_alignment<glm::mat4>(ctxt), gfx_util::uniform_buffer_offset_alignment<glm::mat4>(ctxt));
@@ -21,32 +32,153 @@ SceneRenderer SceneRenderer::create(Context& ctxt, Scene& scene) {
 }
 
 void SceneRenderer::update(vuk::PerThreadContext& ptc, Scene& scene) {
+	TRACE_ZONE("SceneRenderer::update");
+
 	auto scene_view = scene.registry.view<MeshComponent, TransformComponent>();
 
 	m_scene = &scene;
 
-	m_cached_meshes.clear();
-	m_cached_meshes.reserve(scene_view.size_hint());
+	m_objects.clear();
+	m_objects.reserve(scene_view.size_hint());
+
+	m_bounds_min = glm::vec3{std::numeric_limits<f32>::max()};
+	m_bounds_max = glm::vec3{std::numeric_limits<f32>::lowest()};
+
+	u64 static_count = 0;
+	m_static_dirty = false;
+	m_has_dynamic = false;
 
 	u64 offset = 0;
-	scene_view.each([&](const MeshComponent& mesh, const TransformComponent& transform) {
-		m_cached_meshes.push_back(mesh);
-		ptc.upload(m_transform_buffer.subrange(offset, sizeof(glm::mat4)), std::span{&transform.matrix, 1});
+	scene_view.each([&](entt::entity entity, const MeshComponent& mesh, TransformComponent& transform) {
+		const bool is_static = scene.registry.all_of<StaticComponent>(entity);
+		const auto& render_mesh = scene.meshes.get(mesh.mesh);
+
+		RenderObject object{
+			.mesh = mesh,
+			.is_static = is_static,
+			.min = glm::vec3{std::numeric_limits<f32>::max()},
+			.max = glm::vec3{std::numeric_limits<f32>::lowest()},
+		};
+		for (u8 i = 0; i < 8; ++i) {
+			const glm::vec3 corner{(i & 1) ? render_mesh.max.x : render_mesh.min.x, (i & 2) ? render_mesh.max.y : render_mesh.min.y,
+				(i & 4) ? render_mesh.max.z : render_mesh.min.z};
+			const glm::vec3 world = transform.matrix() * glm::vec4{corner, 1.f};
+			object.min = glm::min(object.min, world);
+			object.max = glm::max(object.max, world);
+		}
+		m_objects.push_back(object);
+		m_bounds_min = glm::min(m_bounds_min, object.min);
+		m_bounds_max = glm::max(m_bounds_max, object.max);
+
+		if (is_static) {
+			++static_count;
+			m_static_dirty |= transform.dirty();
+		} else {
+			m_has_dynamic = true;
+		}
+		transform.m_dirty = false;
+
+		ptc.upload(m_transform_buffer.subrange(offset, sizeof(glm::mat4)), std::span{&transform.matrix(), 1});
 		offset += gfx_util::uniform_buffer_offset_alignment<glm::mat4>(*m_ctxt);
 	});
 
-	ptc.wait_all_transfers();
+	m_static_dirty |= static_count != m_static_count;
+	m_static_count = static_count;
+
+	m_lights.clear();
+	scene.registry.view<PointLightComponent, TransformComponent>().each([&](const PointLightComponent& light, const TransformComponent& transform) {
+		m_lights.push_back(LightClusters::Light{
+			.position = glm::vec3{transform.matrix()[3]},
+			.radius = light.radius,
+			.color = light.color,
+			.intensity = light.intensity,
+			.direction = glm::vec3{0.f},
+			.cos_inner = 1.f,
+			.cos_outer = 1.f,
+			.spot = false,
+		});
+	});
+	scene.registry.view<SpotLightComponent, TransformComponent>().each([&](const SpotLightComponent& light, const TransformComponent& transform) {
+		m_lights.push_back(LightClusters::Light{
+			.position = glm::vec3{transform.matrix()[3]},
+			.radius = light.radius,
+			.color = light.color,
+			.intensity = light.intensity,
+			.direction = glm::normalize(glm::vec3{transform.matrix() * glm::vec4{0.f, 0.f, -1.f, 0.f}}),
+			.cos_inner = std::cos(light.inner_angle),
+			.cos_outer = std::cos(light.outer_angle),
+			.spot = true,
+		});
+	});
+
+	TRACE_CALL("wait_all_transfers", ptc.wait_all_transfers());
+}
+
+u32 SceneRenderer::render(vuk::CommandBuffer& out_cbuf, std::function<vuk::Packed(const MeshComponent&, const vuk::Buffer&)> binder, Filter filter) const {
+	u32 draws = 0;
+	u64 offset = 0;
+	for (u64 i = 0; i < m_objects.size(); ++i) {
+		const auto& object = m_objects[i];
+		if (!filter || filter(i, object)) {
+			const auto& mesh = object.mesh;
+			auto packed = binder(mesh, vuk::Buffer{m_transform_buffer}.subrange(offset, sizeof(glm::mat4)));
+			out_cbuf.bind_vertex_buffer(0, *m_scene->meshes.get(mesh.mesh).verts, 0, packed)
+				.bind_index_buffer(*m_scene->meshes.get(mesh.mesh).inds, vuk::IndexType::eUint32);
+			out_cbuf.draw_indexed(m_scene->meshes.get(mesh.mesh).mesh.second.size(), 1, 0, 0, 0);
+			++draws;
+		}
+		offset += gfx_util::uniform_buffer_offset_alignment<glm::mat4>(*m_ctxt);
+	}
+	return draws;
 }
 
-void SceneRenderer::render(vuk::CommandBuffer& out_cbuf, std::function<vuk::Packed(const MeshComponent&, const vuk::Buffer&)> binder) const {
+u32 SceneRenderer::render_masked(
+	vuk::CommandBuffer& out_cbuf, std::function<vuk::Packed(const MeshComponent&, const vuk::Buffer&)> binder, std::span<const u32> masks) const {
+	u32 draws = 0;
 	u64 offset = 0;
-	for (const auto& mesh : m_cached_meshes) {
-		auto packed = binder(mesh, vuk::Buffer{m_transform_buffer}.subrange(offset, sizeof(glm::mat4)));
-		out_cbuf.bind_vertex_buffer(0, *m_scene->meshes.get(mesh.mesh).verts, 0, packed)
-			.bind_index_buffer(*m_scene->meshes.get(mesh.mesh).inds, vuk::IndexType::eUint32);
-		out_cbuf.draw_indexed(m_scene->meshes.get(mesh.mesh).mesh.second.size(), 1, 0, 0, 0);
+	for (u64 i = 0; i < m_objects.size(); ++i) {
+		u32 mask = i < masks.size() ? masks[i] : 0;
+		if (mask != 0) {
+			const auto& mesh = m_objects[i].mesh;
+			const auto& render_mesh = m_scene->meshes.get(mesh.mesh);
+			auto packed = binder(mesh, vuk::Buffer{m_transform_buffer}.subrange(offset, sizeof(glm::mat4)));
+			out_cbuf.bind_vertex_buffer(0, *render_mesh.verts, 0, packed).bind_index_buffer(*render_mesh.inds, vuk::IndexType::eUint32);
+
+			while (mask != 0) {
+				const u32 first = std::countr_zero(mask);
+				const u32 count = std::countr_one(mask >> first);
+				out_cbuf.draw_indexed(render_mesh.mesh.second.size(), count, 0, 0, first);
+				mask &= ~(((1u << count) - 1u) << first);
+				++draws;
+			}
+		}
 		offset += gfx_util::uniform_buffer_offset_alignment<glm::mat4>(*m_ctxt);
 	}
+	return draws;
+}
+
+const std::vector<SceneRenderer::RenderObject>& SceneRenderer::objects() const {
+	return m_objects;
+}
+
+const std::vector<LightClusters::Light>& SceneRenderer::lights() const {
+	return m_lights;
+}
+
+glm::vec3 SceneRenderer::bounds_min() const {
+	return m_bounds_min;
+}
+
+glm::vec3 SceneRenderer::bounds_max() const {
+	return m_bounds_max;
+}
+
+bool SceneRenderer::static_dirty() const {
+	return m_static_dirty;
+}
+
+bool SceneRenderer::has_dynamic_objects() const {
+	return m_has_dynamic;
 }
 
 Scene& SceneRenderer::scene() {
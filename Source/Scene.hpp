@@ -1,9 +1,12 @@
 #pragma once
 
 #include "Mesh.hpp"
+#include "Light.hpp"
+#include "LightClusters.hpp"
 
 #include <entt/entt.hpp>
 #include <functional>
+#include <span>
 
 namespace vuk {
 class CommandBuffer;
@@ -23,10 +26,36 @@ class Scene {
 
 class SceneRenderer {
   public:
+	struct RenderObject {
+		MeshComponent mesh;
+		bool is_static;
+		// world space AABB
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	using Filter = std::function<bool(u64 index, const RenderObject&)>;
+
 	static SceneRenderer create(struct Context& ctxt, Scene& scene);
 
 	void update(vuk::PerThreadContext& ptc, Scene& scene);
-	void render(vuk::CommandBuffer& out_cbuf, std::function<vuk::Packed(const MeshComponent&, const vuk::Buffer&)> binder) const;
+	// returns the number of draws recorded; objects rejected by filter (if any) are skipped
+	u32 render(vuk::CommandBuffer& out_cbuf, std::function<vuk::Packed(const MeshComponent&, const vuk::Buffer&)> binder, Filter filter = {}) const;
+
+	// draws object i once per run of consecutive set bits in masks[i], with the run as the instance range (first instance = lowest bit of the run);
+	// returns the number of draws recorded
+	u32 render_masked(
+		vuk::CommandBuffer& out_cbuf, std::function<vuk::Packed(const MeshComponent&, const vuk::Buffer&)> binder, std::span<const u32> masks) const;
+
+	const std::vector<RenderObject>& objects() const;
+	// every point and spot light in the scene, in world space
+	const std::vector<LightClusters::Light>& lights() const;
+	// world space AABB of every object; min > max if there are none
+	glm::vec3 bounds_min() const;
+	glm::vec3 bounds_max() const;
+	// true if the last update() saw a static object being added, removed or moved
+	bool static_dirty() const;
+	bool has_dynamic_objects() const;
 
 	Scene& scene();
 	const Scene& scene() const;
@@ -35,8 +64,16 @@ class SceneRenderer {
 	struct Context* m_ctxt;
 	Scene* m_scene;
 
-	std::vector<MeshComponent> m_cached_meshes;
+	std::vector<RenderObject> m_objects;
+	std::vector<LightClusters::Light> m_lights;
 	vuk::Buffer m_transform_buffer;
+
+	glm::vec3 m_bounds_min;
+	glm::vec3 m_bounds_max;
+
+	u64 m_static_count;
+	bool m_static_dirty;
+	bool m_has_dynamic;
 };
 
 void pbr_binder(vuk::CommandBuffer&, const MeshComponent&, Scene&);
@@ -0,0 +1,208 @@
+#include "../Types.hpp"
+
+#include <emmintrin.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+/*
+	Build-time generator for the split-sum BRDF LUT.
+
+	This is a CPU port of the old brdf.frag (which used to be rendered at startup), except that cos/sin theta are computed so that nothing
+	cancels at low roughness, where the shader's single precision result was off (see integrate_brdf).
+	The LUT depends on nothing but (n_dot_v, roughness), so it's integrated once here, written as raw R16G16 half floats, and embedded as a resource.
+
+	Since N is fixed at +Z and the Hammersley sequence doesn't depend on the texel, the per-sample trig is tabulated once
+	and the integration loop becomes plain arithmetic that runs 4 samples at a time with SSE.
+*/
+
+static constexpr f32 PI = 3.14159265359f;
+static constexpr u32 SAMPLE_COUNT = 1024;
+
+static_assert(SAMPLE_COUNT % 4 == 0);
+
+struct SampleTable {
+	alignas(16) f32 sin_phi[SAMPLE_COUNT];
+	alignas(16) f32 xi_y[SAMPLE_COUNT];
+};
+
+// http://holger.dammertz.org/stuff/notes_HammersleyOnHemisphere.html
+static f32 radical_inverse_vdc(u32 bits) {
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return static_cast<f32>(bits) * 2.3283064365386963e-10f; // / 0x100000000
+}
+
+static SampleTable make_sample_table() {
+	SampleTable table;
+	for (u32 i = 0; i < SAMPLE_COUNT; ++i) {
+		const f32 phi = 2.f * PI * (static_cast<f32>(i) / static_cast<f32>(SAMPLE_COUNT));
+		table.sin_phi[i] = std::sin(phi);
+		table.xi_y[i] = radical_inverse_vdc(i);
+	}
+	return table;
+}
+
+// same as brdf.frag, with importance_sample_ggx expanded for N = (0, 0, 1):
+// tangent = (0, -1, 0), bitangent = (1, 0, 0), so H = (sin(phi) * sin(theta), -cos(phi) * sin(theta), cos(theta))
+static void integrate_brdf(const SampleTable& table, f32 n_dot_v, f32 roughness, f32& out_a, f32& out_b) {
+	const f32 a = roughness * roughness;
+	const f32 k = (roughness * roughness) / 2.f;
+
+	const __m128 v_x = _mm_set1_ps(std::sqrt(1.f - n_dot_v * n_dot_v));
+	const __m128 v_z = _mm_set1_ps(n_dot_v);
+	const __m128 a2 = _mm_set1_ps(a * a);
+	const __m128 one_minus_k = _mm_set1_ps(1.f - k);
+	const __m128 k4 = _mm_set1_ps(k);
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 two = _mm_set1_ps(2.f);
+	const __m128 zero = _mm_setzero_ps();
+
+	// G1(n_dot_v) is constant across samples
+	const f32 ggx_v = n_dot_v / (n_dot_v * (1.f - k) + k);
+	const __m128 ggx_v_over_n_dot_v = _mm_set1_ps(ggx_v / n_dot_v);
+
+	__m128 sum_a = zero;
+	__m128 sum_b = zero;
+
+	for (u32 i = 0; i < SAMPLE_COUNT; i += 4) {
+		const __m128 xi_y = _mm_load_ps(&table.xi_y[i]);
+		// brdf.frag's 1 + (a^2 - 1) * xi_y and 1 - cos_theta^2 rearranged so nothing cancels: at low roughness a^2 - 1 rounds to -1 in single
+		// precision, which collapses every half vector onto N and is visibly off at grazing angles
+		const __m128 one_minus_xi_y = _mm_sub_ps(one, xi_y);
+		const __m128 denom = _mm_add_ps(one_minus_xi_y, _mm_mul_ps(a2, xi_y));
+		const __m128 cos_theta = _mm_sqrt_ps(_mm_div_ps(one_minus_xi_y, denom));
+		const __m128 sin_theta = _mm_sqrt_ps(_mm_div_ps(_mm_mul_ps(a2, xi_y), denom));
+
+		// only H.x contributes to dot(V, H) since V.y = 0
+		const __m128 h_x = _mm_mul_ps(_mm_load_ps(&table.sin_phi[i]), sin_theta);
+		const __m128 h_z = cos_theta;
+
+		const __m128 v_dot_h_raw = _mm_add_ps(_mm_mul_ps(v_x, h_x), _mm_mul_ps(v_z, h_z));
+		const __m128 l_z = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(two, v_dot_h_raw), h_z), v_z);
+
+		const __m128 n_dot_l = _mm_max_ps(l_z, zero);
+		const __m128 n_dot_h = _mm_max_ps(h_z, zero);
+		const __m128 v_dot_h = _mm_max_ps(v_dot_h_raw, zero);
+
+		const __m128 mask = _mm_cmpgt_ps(n_dot_l, zero);
+
+		// G_Vis = G1(n_dot_l) * G1(n_dot_v) * v_dot_h / (n_dot_h * n_dot_v)
+		const __m128 ggx_l = _mm_div_ps(n_dot_l, _mm_add_ps(_mm_mul_ps(n_dot_l, one_minus_k), k4));
+		const __m128 g_vis = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(ggx_l, ggx_v_over_n_dot_v), v_dot_h), _mm_max_ps(n_dot_h, _mm_set1_ps(1e-8f)));
+
+		// Fc = (1 - v_dot_h) ^ 5
+		const __m128 f1 = _mm_sub_ps(one, v_dot_h);
+		const __m128 f2 = _mm_mul_ps(f1, f1);
+		const __m128 fc = _mm_mul_ps(_mm_mul_ps(f2, f2), f1);
+
+		sum_a = _mm_add_ps(sum_a, _mm_and_ps(mask, _mm_mul_ps(_mm_sub_ps(one, fc), g_vis)));
+		sum_b = _mm_add_ps(sum_b, _mm_and_ps(mask, _mm_mul_ps(fc, g_vis)));
+	}
+
+	alignas(16) f32 lanes_a[4];
+	alignas(16) f32 lanes_b[4];
+	_mm_store_ps(lanes_a, sum_a);
+	_mm_store_ps(lanes_b, sum_b);
+
+	out_a = (lanes_a[0] + lanes_a[1] + lanes_a[2] + lanes_a[3]) / static_cast<f32>(SAMPLE_COUNT);
+	out_b = (lanes_b[0] + lanes_b[1] + lanes_b[2] + lanes_b[3]) / static_cast<f32>(SAMPLE_COUNT);
+}
+
+// round-to-nearest-even f32 -> f16; the LUT is always in [0, 1] but handle the full range anyway
+static u16 to_half(f32 value) {
+	u32 bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	const u32 sign = (bits >> 16) & 0x8000u;
+	const i32 exponent = static_cast<i32>((bits >> 23) & 0xFFu) - 127 + 15;
+	u32 mantissa = bits & 0x7FFFFFu;
+
+	if (exponent <= 0) {
+		if (exponent < -10) {
+			return static_cast<u16>(sign);
+		}
+		mantissa |= 0x800000u;
+		const u32 shift = static_cast<u32>(14 - exponent);
+		u32 half_mantissa = mantissa >> shift;
+		const u32 rest = mantissa & ((1u << shift) - 1u);
+		const u32 halfway = 1u << (shift - 1u);
+		if (rest > halfway || (rest == halfway && (half_mantissa & 1u))) {
+			++half_mantissa;
+		}
+		return static_cast<u16>(sign | half_mantissa);
+	}
+
+	if (exponent >= 31) {
+		return static_cast<u16>(sign | 0x7C00u);
+	}
+
+	u32 half = sign | (static_cast<u32>(exponent) << 10) | (mantissa >> 13);
+	const u32 rest = mantissa & 0x1FFFu;
+	if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) {
+		++half; // may carry into the exponent, which is the correct rounding
+	}
+	return static_cast<u16>(half);
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::fprintf(stderr, "usage: %s <output> [size]\n", argv[0]);
+		return 1;
+	}
+
+	const u32 size = argc > 2 ? static_cast<u32>(std::strtoul(argv[2], nullptr, 10)) : BRDF_LUT_SIZE;
+	if (size == 0) {
+		std::fprintf(stderr, "invalid LUT size\n");
+		return 1;
+	}
+
+	const SampleTable table = make_sample_table();
+
+	// R16G16, row-major; row = roughness, column = n_dot_v (matches the texture(brdf_lut, vec2(n_dot_v, roughness)) lookup)
+	std::vector<u16> texels(static_cast<u64>(size) * size * 2);
+
+	std::atomic<u32> next_row{0};
+	auto worker = [&] {
+		for (u32 y = next_row++; y < size; y = next_row++) {
+			// sample at texel centers, exactly like the interpolated UVs of the old fullscreen quad
+			const f32 roughness = (static_cast<f32>(y) + 0.5f) / static_cast<f32>(size);
+			for (u32 x = 0; x < size; ++x) {
+				const f32 n_dot_v = (static_cast<f32>(x) + 0.5f) / static_cast<f32>(size);
+				f32 a, b;
+				integrate_brdf(table, n_dot_v, roughness, a, b);
+				const u64 i = (static_cast<u64>(y) * size + x) * 2;
+				texels[i] = to_half(a);
+				texels[i + 1] = to_half(b);
+			}
+		}
+	};
+
+	const u32 thread_count = std::max(1u, std::min(std::thread::hardware_concurrency(), size));
+	std::vector<std::thread> threads;
+	threads.reserve(thread_count);
+	for (u32 i = 0; i < thread_count; ++i) {
+		threads.emplace_back(worker);
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+
+	std::ofstream out{argv[1], std::ios::binary};
+	if (!out) {
+		std::fprintf(stderr, "failed to open %s for writing\n", argv[1]);
+		return 1;
+	}
+	out.write(reinterpret_cast<const char*>(texels.data()), static_cast<std::streamsize>(texels.size() * sizeof(u16)));
+
+	return out ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+#include "../Types.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+/*
+	Checks a LUT written by brdf_lut_generator against a reference integration in double precision: the split-sum integral the old brdf.frag
+	computed (the same Hammersley sequence, importance_sample_ggx with its tangent frame, and geometry_smith), written out straightforwardly
+	without any of the generator's shortcuts (tabulated trig, the N = +Z expansion, SSE).
+
+	This is not a comparison with the shader's output. brdf.frag is gone and nothing here runs on the GPU, so a misreading of the shader that
+	this port and the generator share would go unnoticed. The shader's own single precision error isn't reproduced either: at roughness below
+	about 0.02 its a^2 - 1 rounds to -1 and the half vectors collapse onto N, which the generator deliberately avoids, so at grazing angles
+	there the LUT matches this reference and not what brdf.frag rendered.
+
+	Every texel has to be within TOLERANCE of the reference, which covers the half float storage (at most 2^-11 relative, for values in
+	[0, 1]) with room for the generator's single precision sums. Returns nonzero and prints the worst texel otherwise.
+*/
+
+static constexpr f64 PI = 3.14159265358979323846;
+// the shader's
+static constexpr u32 SAMPLE_COUNT = 1024;
+static constexpr f64 TOLERANCE = 1e-3;
+
+struct Vec3 {
+	f64 x, y, z;
+};
+
+static Vec3 operator+(Vec3 a, Vec3 b) {
+	return Vec3{a.x + b.x, a.y + b.y, a.z + b.z};
+}
+
+static Vec3 operator*(Vec3 a, f64 s) {
+	return Vec3{a.x * s, a.y * s, a.z * s};
+}
+
+static f64 dot(Vec3 a, Vec3 b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static Vec3 cross(Vec3 a, Vec3 b) {
+	return Vec3{a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+static Vec3 normalize(Vec3 v) {
+	return v * (1.0 / std::sqrt(dot(v, v)));
+}
+
+static f64 radical_inverse_vdc(u32 bits) {
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return static_cast<f64>(bits) * 2.3283064365386963e-10; // / 0x100000000
+}
+
+static Vec3 importance_sample_ggx(f64 xi_x, f64 xi_y, Vec3 n, f64 roughness) {
+	const f64 a = roughness * roughness;
+
+	const f64 phi = 2.0 * PI * xi_x;
+	const f64 cos_theta = std::sqrt((1.0 - xi_y) / (1.0 + (a * a - 1.0) * xi_y));
+	const f64 sin_theta = std::sqrt(1.0 - cos_theta * cos_theta);
+
+	const Vec3 h{std::cos(phi) * sin_theta, std::sin(phi) * sin_theta, cos_theta};
+
+	const Vec3 up = std::abs(n.z) < 0.999 ? Vec3{0.0, 0.0, 1.0} : Vec3{1.0, 0.0, 0.0};
+	const Vec3 tangent = normalize(cross(up, n));
+	const Vec3 bitangent = cross(n, tangent);
+
+	return normalize(tangent * h.x + bitangent * h.y + n * h.z);
+}
+
+static f64 geometry_schlick_ggx(f64 n_dot_v, f64 roughness) {
+	const f64 k = (roughness * roughness) / 2.0;
+	return n_dot_v / (n_dot_v * (1.0 - k) + k);
+}
+
+static void integrate_brdf(f64 n_dot_v, f64 roughness, f64& out_a, f64& out_b) {
+	const Vec3 v{std::sqrt(1.0 - n_dot_v * n_dot_v), 0.0, n_dot_v};
+	const Vec3 n{0.0, 0.0, 1.0};
+
+	f64 a = 0.0;
+	f64 b = 0.0;
+
+	for (u32 i = 0; i < SAMPLE_COUNT; ++i) {
+		const Vec3 h = importance_sample_ggx(static_cast<f64>(i) / SAMPLE_COUNT, radical_inverse_vdc(i), n, roughness);
+		const Vec3 l = normalize(h * (2.0 * dot(v, h)) + v * -1.0);
+
+		const f64 n_dot_l = std::max(l.z, 0.0);
+		const f64 n_dot_h = std::max(h.z, 0.0);
+		const f64 v_dot_h = std::max(dot(v, h), 0.0);
+
+		if (n_dot_l > 0.0) {
+			const f64 g = geometry_schlick_ggx(std::max(dot(n, v), 0.0), roughness) * geometry_schlick_ggx(n_dot_l, roughness);
+			const f64 g_vis = (g * v_dot_h) / (n_dot_h * n_dot_v);
+			const f64 fc = std::pow(1.0 - v_dot_h, 5.0);
+
+			a += (1.0 - fc) * g_vis;
+			b += fc * g_vis;
+		}
+	}
+
+	out_a = a / SAMPLE_COUNT;
+	out_b = b / SAMPLE_COUNT;
+}
+
+static f64 from_half(u16 half) {
+	const f64 sign = (half & 0x8000u) ? -1.0 : 1.0;
+	const i32 exponent = (half >> 10) & 0x1F;
+	const u32 mantissa = half & 0x3FFu;
+
+	if (exponent == 0) {
+		return sign * std::ldexp(static_cast<f64>(mantissa), -24);
+	}
+	if (exponent == 31) {
+		return mantissa == 0 ? sign * HUGE_VAL : NAN;
+	}
+	return sign * std::ldexp(static_cast<f64>(mantissa | 0x400u), exponent - 25);
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::fprintf(stderr, "usage: %s <lut> [size]\n", argv[0]);
+		return 1;
+	}
+
+	const u32 size = argc > 2 ? static_cast<u32>(std::strtoul(argv[2], nullptr, 10)) : BRDF_LUT_SIZE;
+	if (size == 0) {
+		std::fprintf(stderr, "invalid LUT size\n");
+		return 1;
+	}
+
+	std::ifstream in{argv[1], std::ios::binary};
+	if (!in) {
+		std::fprintf(stderr, "failed to open %s\n", argv[1]);
+		return 1;
+	}
+	const std::vector<char> bytes{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+
+	const u64 expected_size = static_cast<u64>(size) * size * 2 * sizeof(u16);
+	if (bytes.size() != expected_size) {
+		std::fprintf(stderr, "%s is %zu bytes, expected %llu for a %ux%u LUT\n", argv[1], bytes.size(), static_cast<unsigned long long>(expected_size), size,
+			size);
+		return 1;
+	}
+
+	std::vector<u16> texels(static_cast<u64>(size) * size * 2);
+	std::copy(bytes.begin(), bytes.end(), reinterpret_cast<char*>(texels.data()));
+
+	// per row, so the threads never share a slot
+	std::vector<f64> row_error(size, 0.0);
+	std::vector<u32> row_worst(size, 0);
+
+	std::atomic<u32> next_row{0};
+	auto worker = [&] {
+		for (u32 y = next_row++; y < size; y = next_row++) {
+			// texel centers, like the generator (and the old fullscreen quad)
+			const f64 roughness = (y + 0.5) / size;
+			for (u32 x = 0; x < size; ++x) {
+				f64 a, b;
+				integrate_brdf((x + 0.5) / size, roughness, a, b);
+
+				const u64 i = (static_cast<u64>(y) * size + x) * 2;
+				const f64 error = std::max(std::abs(from_half(texels[i]) - a), std::abs(from_half(texels[i + 1]) - b));
+				// also catches NaNs
+				if (!(error <= row_error[y])) {
+					row_error[y] = std::isnan(error) ? HUGE_VAL : error;
+					row_worst[y] = x;
+				}
+			}
+		}
+	};
+
+	const u32 thread_count = std::max(1u, std::min(std::thread::hardware_concurrency(), size));
+	std::vector<std::thread> threads;
+	threads.reserve(thread_count);
+	for (u32 i = 0; i < thread_count; ++i) {
+		threads.emplace_back(worker);
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+
+	const u32 worst_y = static_cast<u32>(std::max_element(row_error.begin(), row_error.end()) - row_error.begin());
+	const u32 worst_x = row_worst[worst_y];
+	const f64 max_error = row_error[worst_y];
+
+	std::printf("max error %.3g at n_dot_v %.4f, roughness %.4f (tolerance %.3g)\n", max_error, (worst_x + 0.5) / size, (worst_y + 0.5) / size, TOLERANCE);
+	if (max_error > TOLERANCE) {
+		std::fprintf(stderr, "%s doesn't match the double precision reference integration\n", argv[1]);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,228 @@
+#include "../CascadeFit.hpp"
+#include "../CameraPath.hpp"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+#include <glm/trigonometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+/*
+	Measures the shadow texel density (texels per world unit) of every cascade along the benchmark's camera path, for a few sun elevations,
+	against the fitting all cascades had on their 4096² maps before: splits over the whole clip range and one bounding sphere per slice.
+
+	With the same splits the cascades compare one to one, and the check fails if a fitting it asserts on leaves any cascade coarser than
+	that. With the sample distribution the splits move, so there the comparison is per visible point instead, with the cascade each fitting
+	picks for the point's depth; the share of points that are shadowed coarser than before is printed, not checked.
+
+	The scene is Renderer's (the pillars and the floor), as boxes. The visible points are where a grid of rays hits them; boxes are larger
+	than the meshes, so the visible depth range (what the GPU depth reduction would return) is, if anything, too wide.
+*/
+
+static constexpr u32 POSES = 64;
+// of the visible points
+static constexpr u32 RAYS_X = 64;
+static constexpr u32 RAYS_Y = 36;
+// sun elevations, in degrees up from the -z horizon (see Renderer's sun_light_direction); 90 is straight down
+static constexpr f32 SUN_ELEVATIONS[] = {20.f, 63.43f, 90.f, 135.f};
+
+// the renderer's scene: Pillars.obj as loaded, and the floor quad (scaled by 3 and moved down to y = -1)
+static const cascade_fit::Box SCENE_BOXES[] = {
+	{.min = {-2.837823f, -0.987054f, -0.167455f}, .max = {2.837824f, 3.435138f, 3.163375f}},
+	{.min = {-3.f, -1.f, -3.f}, .max = {3.f, -1.f, 3.f}},
+};
+
+struct Config {
+	const char* name;
+	cascade_fit::Settings settings;
+	// fail if any cascade ends up coarser than the baseline's
+	bool checked;
+};
+
+static cascade_fit::Settings settings(bool sample_distribution, bool fit_to_receivers, u8 first_cached,
+	std::array<u32, cascade_fit::CASCADE_COUNT> resolutions) {
+	return cascade_fit::Settings{
+		.split_lambda = 0.95f,
+		.sample_distribution = sample_distribution,
+		.fit_to_receivers = fit_to_receivers,
+		.resolutions = resolutions,
+		.first_cached = first_cached,
+		.cached_move_threshold = 8.f,
+	};
+}
+
+// nothing cached, so the margin doesn't matter
+static const cascade_fit::Settings BASELINE = settings(false, false, cascade_fit::CASCADE_COUNT, {4096, 4096, 4096, 4096});
+
+// slab test; the distance along the ray to where it enters the box (0 if it starts inside)
+static std::optional<f32> intersect(const glm::vec3& origin, const glm::vec3& dir, const cascade_fit::Box& box) {
+	f32 t_min = 0.f;
+	f32 t_max = std::numeric_limits<f32>::max();
+	for (u32 axis = 0; axis < 3; ++axis) {
+		if (std::abs(dir[axis]) < 1e-8f) {
+			if (origin[axis] < box.min[axis] || origin[axis] > box.max[axis]) {
+				return {};
+			}
+			continue;
+		}
+		const f32 t0 = (box.min[axis] - origin[axis]) / dir[axis];
+		const f32 t1 = (box.max[axis] - origin[axis]) / dir[axis];
+		t_min = std::max(t_min, std::min(t0, t1));
+		t_max = std::min(t_max, std::max(t0, t1));
+	}
+	if (t_min > t_max) {
+		return {};
+	}
+	return t_min;
+}
+
+// view distances where a grid of rays through the pixel centers hits the scene, like the depth buffer DepthReductionPass reduces
+static std::vector<f32> visible_depths(const Perspective& cam_proj, const glm::mat4& cam_view, const glm::vec3& cam_pos) {
+	const glm::mat4 inv_view = glm::inverse(cam_view);
+	const f32 tan_half_fovy = std::tan(cam_proj.fovy * 0.5f);
+
+	std::vector<f32> depths;
+	for (u32 y = 0; y < RAYS_Y; ++y) {
+		for (u32 x = 0; x < RAYS_X; ++x) {
+			const glm::vec2 ndc{(x + 0.5f) / RAYS_X * 2.f - 1.f, (y + 0.5f) / RAYS_Y * 2.f - 1.f};
+			// view space, at a distance of 1 along -z
+			const glm::vec3 view_dir{ndc.x * tan_half_fovy * cam_proj.aspect_ratio, ndc.y * tan_half_fovy, -1.f};
+			const glm::vec3 dir = glm::vec3(inv_view * glm::vec4(view_dir, 0.f));
+
+			f32 closest = std::numeric_limits<f32>::max();
+			for (const auto& box : SCENE_BOXES) {
+				if (const auto t = intersect(cam_pos, dir, box)) {
+					closest = std::min(closest, *t);
+				}
+			}
+			// dir is 1 long along the view axis, so t is the view distance
+			if (closest <= cam_proj.far) {
+				depths.push_back(std::max(closest, cam_proj.near));
+			}
+		}
+	}
+	return depths;
+}
+
+// of the cascade a point at this view distance is shadowed with, picked like pbr_lighting.glsl does
+static f32 density_at(const std::array<cascade_fit::Cascade, cascade_fit::CASCADE_COUNT>& cascades, f32 depth) {
+	for (u8 i = 0; i < cascade_fit::CASCADE_COUNT - 1; ++i) {
+		if (-depth >= cascades[i].split_depth) {
+			return cascades[i].texel_density;
+		}
+	}
+	return cascades[cascade_fit::CASCADE_COUNT - 1].texel_density;
+}
+
+int main() {
+	constexpr u8 NONE_CACHED = cascade_fit::CASCADE_COUNT;
+	const Config configs[] = {
+		// the near slices are mostly filled by the pillars and the floor, so the receivers leave too little to cut off for 2048²
+		{"receivers, 4096/4096/2048/2048", settings(false, true, NONE_CACHED, {4096, 4096, 2048, 2048}), true},
+		{"receivers, 2048/2048/2048/2048", settings(false, true, NONE_CACHED, {2048, 2048, 2048, 2048}), false},
+		// CascadedShadowRenderPass' defaults
+		{"sdsm, 2 cached, 4096/4096/4096/4096", settings(true, false, 2, {4096, 4096, 4096, 4096}), false},
+	};
+	constexpr u32 CONFIG_COUNT = std::size(configs);
+
+	Perspective cam_proj;
+	cam_proj.fovy = glm::radians(60.f);
+	cam_proj.aspect_ratio = 16.f / 9.f;
+	cam_proj.near = 0.1f;
+	cam_proj.far = 100.f;
+
+	glm::vec3 scene_min{std::numeric_limits<f32>::max()};
+	glm::vec3 scene_max{std::numeric_limits<f32>::lowest()};
+	for (const auto& box : SCENE_BOXES) {
+		scene_min = glm::min(scene_min, box.min);
+		scene_max = glm::max(scene_max, box.max);
+	}
+
+	const CameraPath path = CameraPath::orbit();
+
+	std::array<f32, cascade_fit::CASCADE_COUNT> baseline_sum{};
+	std::array<std::array<f32, cascade_fit::CASCADE_COUNT>, CONFIG_COUNT> config_sum{};
+	// per cascade, the smallest ratio of a config's density to the baseline's
+	std::array<std::array<f32, cascade_fit::CASCADE_COUNT>, CONFIG_COUNT> worst_ratio;
+	for (auto& ratios : worst_ratio) {
+		ratios.fill(std::numeric_limits<f32>::max());
+	}
+	std::array<u64, CONFIG_COUNT> coarser_points{};
+	u64 points = 0;
+	u32 samples = 0;
+
+	for (u32 pose = 0; pose < POSES; ++pose) {
+		const auto keyframe = path.sample(path.duration() * pose / POSES);
+		const glm::vec3 front{std::cos(glm::radians(keyframe.yaw)) * std::cos(glm::radians(keyframe.pitch)), std::sin(glm::radians(keyframe.pitch)),
+			std::sin(glm::radians(keyframe.yaw)) * std::cos(glm::radians(keyframe.pitch))};
+		const glm::mat4 cam_view = glm::lookAt(keyframe.position, keyframe.position + glm::normalize(front), glm::vec3{0.f, 1.f, 0.f});
+
+		const std::vector<f32> depths = visible_depths(cam_proj, cam_view, keyframe.position);
+		std::optional<glm::vec2> depth_bounds;
+		if (!depths.empty()) {
+			const auto [closest, furthest] = std::minmax_element(depths.begin(), depths.end());
+			depth_bounds = glm::vec2{*closest, *furthest};
+		}
+
+		for (const f32 elevation : SUN_ELEVATIONS) {
+			const cascade_fit::View view{
+				.cam_proj = cam_proj,
+				.cam_view = cam_view,
+				.light_direction = glm::vec3{0.f, -std::sin(glm::radians(elevation)), std::cos(glm::radians(elevation))},
+				.scene_min = scene_min,
+				.scene_max = scene_max,
+				.depth_bounds = depth_bounds,
+				.receivers = SCENE_BOXES,
+			};
+
+			const auto baseline = cascade_fit::fit(view, BASELINE);
+			for (u8 i = 0; i < cascade_fit::CASCADE_COUNT; ++i) {
+				baseline_sum[i] += baseline[i].texel_density;
+			}
+
+			for (u32 c = 0; c < CONFIG_COUNT; ++c) {
+				const auto cascades = cascade_fit::fit(view, configs[c].settings);
+				for (u8 i = 0; i < cascade_fit::CASCADE_COUNT; ++i) {
+					config_sum[c][i] += cascades[i].texel_density;
+					worst_ratio[c][i] = std::min(worst_ratio[c][i], cascades[i].texel_density / baseline[i].texel_density);
+				}
+				for (const f32 depth : depths) {
+					coarser_points[c] += density_at(cascades, depth) < density_at(baseline, depth);
+				}
+			}
+			points += depths.size();
+			++samples;
+		}
+	}
+
+	std::printf("texels per world unit of cascades 0-3: mean (worst ratio to the baseline's), and the share of visible points shadowed coarser\n");
+	std::printf("%u camera poses x %zu sun elevations\n", POSES, std::size(SUN_ELEVATIONS));
+	std::printf("%-38s", "baseline: clip range, spheres, 4096");
+	for (u8 i = 0; i < cascade_fit::CASCADE_COUNT; ++i) {
+		std::printf("%8.1f         ", baseline_sum[i] / samples);
+	}
+	std::printf("\n");
+
+	bool passed = true;
+	for (u32 c = 0; c < CONFIG_COUNT; ++c) {
+		std::printf("%-38s", configs[c].name);
+		for (u8 i = 0; i < cascade_fit::CASCADE_COUNT; ++i) {
+			std::printf("%8.1f (%5.2fx)", config_sum[c][i] / samples, worst_ratio[c][i]);
+			if (configs[c].checked && worst_ratio[c][i] < 1.f) {
+				passed = false;
+			}
+		}
+		std::printf("%7.1f%%%s\n", 100.0 * coarser_points[c] / points, configs[c].checked ? " (checked)" : "");
+	}
+
+	if (!passed) {
+		std::fprintf(stderr, "a checked fitting left a cascade coarser than the baseline's\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,225 @@
+#include "../Renderer.hpp"
+#include "../Context.hpp"
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+	Renders a fixed frame headless and compares it against a reference image, so a change that should leave the output alone (like
+	reconstructing positions from depth instead of storing them) can be checked on a software device such as lavapipe.
+
+	The frame is the renderer's defaults from a fixed camera pose, after FRAMES frames at the headless fixed timestep, so the temporal passes
+	(TAA, the SSAO and volumetric accumulation, auto exposure) have settled the same way on every run. Headless mode also turns dynamic
+	resolution off. The same device and driver reproduce the frame exactly; the tolerance is for other lavapipe/LLVM versions, whose
+	transcendentals and fused multiply-adds round a little differently: a pixel counts as different once any channel is more than
+	PIXEL_TOLERANCE off, and the check fails once more than MAX_DIFFERENT_SHARE of them are. A moved shadow, a missing AO term or a broken
+	reconstruction changes far more of the image than that.
+
+	With --update the frame is written to the reference path instead, at --size (the comparison renders at the reference's size). Review a
+	new reference by eye before committing it. --output also writes the rendered frame when comparing, to look at a failure.
+*/
+
+// image_regression <reference.ppm> [--update [--size <width>x<height>]] [--output <file.ppm>]
+struct Options {
+	std::string reference;
+	bool update = false;
+	vuk::Extent2D extent{640, 360};
+	std::string output;
+};
+
+static constexpr u32 FRAMES = 60;
+static const glm::vec3 CAMERA_POSITION{0.f, 0.5f, 4.f};
+static constexpr f32 CAMERA_YAW = -90.f;
+static constexpr f32 CAMERA_PITCH = -10.f;
+
+// of 255, in the stored (sRGB) values
+static constexpr u32 PIXEL_TOLERANCE = 12;
+static constexpr f64 MAX_DIFFERENT_SHARE = 0.002;
+
+struct Image {
+	vuk::Extent2D extent;
+	// RGB, top row first
+	std::vector<u8> pixels;
+};
+
+static std::optional<Options> parse_options(i32 argc, char** argv) {
+	Options options;
+
+	for (i32 i = 1; i < argc; ++i) {
+		const std::string_view arg{argv[i]};
+		const bool has_value = i + 1 < argc;
+
+		if (arg == "--update") {
+			options.update = true;
+		} else if (arg == "--size" && has_value) {
+			u32 width, height;
+			if (std::sscanf(argv[++i], "%ux%u", &width, &height) != 2 || width == 0 || height == 0) {
+				spdlog::error("--size expects <width>x<height>, got {}", argv[i]);
+				return {};
+			}
+			options.extent = vuk::Extent2D{width, height};
+		} else if (arg == "--output" && has_value) {
+			options.output = argv[++i];
+		} else if (!arg.starts_with("--") && options.reference.empty()) {
+			options.reference = arg;
+		} else {
+			spdlog::error("unknown argument {}", arg);
+			return {};
+		}
+	}
+
+	if (options.reference.empty()) {
+		spdlog::error("usage: image_regression <reference.ppm> [--update [--size <width>x<height>]] [--output <file.ppm>]");
+		return {};
+	}
+	return options;
+}
+
+// binary PPM with a maxval of 255, as vukpbr --output writes them
+static std::optional<Image> read_ppm(const std::string& path) {
+	std::ifstream file{path, std::ios::binary};
+	if (!file) {
+		return {};
+	}
+
+	// the header's tokens, skipping # comments
+	const auto next_token = [&file]() {
+		std::string token;
+		while (file >> token && token.starts_with("#")) {
+			std::string comment;
+			std::getline(file, comment);
+		}
+		return token;
+	};
+
+	if (next_token() != "P6") {
+		return {};
+	}
+	const u32 width = static_cast<u32>(std::strtoul(next_token().c_str(), nullptr, 10));
+	const u32 height = static_cast<u32>(std::strtoul(next_token().c_str(), nullptr, 10));
+	if (width == 0 || height == 0 || next_token() != "255") {
+		return {};
+	}
+	// exactly one whitespace character between the header and the pixels
+	file.get();
+
+	Image image{.extent = vuk::Extent2D{width, height}, .pixels = std::vector<u8>(static_cast<size_t>(width) * height * 3)};
+	if (!file.read(reinterpret_cast<char*>(image.pixels.data()), static_cast<std::streamsize>(image.pixels.size()))) {
+		return {};
+	}
+	return image;
+}
+
+static bool write_ppm(const std::string& path, const Image& image) {
+	std::ofstream file{path, std::ios::binary};
+	if (!file) {
+		return false;
+	}
+
+	file << "P6\n" << image.extent.width << " " << image.extent.height << "\n255\n";
+	file.write(reinterpret_cast<const char*>(image.pixels.data()), static_cast<std::streamsize>(image.pixels.size()));
+	return static_cast<bool>(file);
+}
+
+static std::optional<Image> render_frame(vuk::Extent2D extent) {
+	auto ctxt = Context::create(extent);
+	if (!ctxt) {
+		return {};
+	}
+
+	auto renderer = std::make_optional<Renderer>();
+	if (!renderer->init(*ctxt)) {
+		renderer.reset();
+		Context::cleanup(ctxt);
+		return {};
+	}
+
+	for (u32 i = 0; i < FRAMES; ++i) {
+		renderer->set_camera(CAMERA_POSITION, CAMERA_YAW, CAMERA_PITCH);
+		renderer->set_readback(i + 1 == FRAMES);
+		renderer->update();
+		renderer->render();
+	}
+
+	// the alpha channel is dropped
+	Image image{.extent = ctxt->output_extent};
+	const auto rgba = renderer->frame();
+	image.pixels.reserve(rgba.size() / 4 * 3);
+	for (size_t i = 0; i + 3 < rgba.size(); i += 4) {
+		image.pixels.insert(image.pixels.end(), rgba.begin() + i, rgba.begin() + i + 3);
+	}
+
+	renderer.reset();
+	Context::cleanup(ctxt);
+	return image;
+}
+
+int main(int argc, char** argv) {
+	const auto options = parse_options(argc, argv);
+	if (!options) {
+		return 1;
+	}
+
+	if (options->update) {
+		const auto frame = render_frame(options->extent);
+		if (!frame) {
+			return 1;
+		}
+		if (!write_ppm(options->reference, *frame)) {
+			spdlog::error("failed to write {}", options->reference);
+			return 1;
+		}
+		spdlog::info("wrote {}x{} reference to {}", frame->extent.width, frame->extent.height, options->reference);
+		return 0;
+	}
+
+	const auto reference = read_ppm(options->reference);
+	if (!reference) {
+		spdlog::error("failed to read {} (a binary PPM with a maxval of 255; write one with --update)", options->reference);
+		return 1;
+	}
+
+	const auto frame = render_frame(reference->extent);
+	if (!frame) {
+		return 1;
+	}
+	if (!options->output.empty() && !write_ppm(options->output, *frame)) {
+		spdlog::error("failed to write {}", options->output);
+		return 1;
+	}
+	if (frame->pixels.size() != reference->pixels.size()) {
+		spdlog::error("read back {} bytes, expected {}", frame->pixels.size(), reference->pixels.size());
+		return 1;
+	}
+
+	u64 different = 0;
+	u32 max_error = 0;
+	u64 sum_error = 0;
+	for (size_t i = 0; i < frame->pixels.size(); i += 3) {
+		u32 pixel_error = 0;
+		for (size_t c = 0; c < 3; ++c) {
+			const u32 error = static_cast<u32>(std::abs(frame->pixels[i + c] - reference->pixels[i + c]));
+			pixel_error = std::max(pixel_error, error);
+			sum_error += error;
+		}
+		max_error = std::max(max_error, pixel_error);
+		different += pixel_error > PIXEL_TOLERANCE;
+	}
+
+	const u64 pixel_count = frame->pixels.size() / 3;
+	const f64 different_share = static_cast<f64>(different) / pixel_count;
+	spdlog::info("{} of {} pixels differ by more than {} ({:.3f}%, limit {:.3f}%), max {}, mean {:.3f}", different, pixel_count, PIXEL_TOLERANCE,
+		100.0 * different_share, 100.0 * MAX_DIFFERENT_SHARE, max_error, static_cast<f64>(sum_error) / frame->pixels.size());
+
+	if (different_share > MAX_DIFFERENT_SHARE) {
+		spdlog::error("the frame doesn't match {}", options->reference);
+		return 1;
+	}
+	return 0;
+}
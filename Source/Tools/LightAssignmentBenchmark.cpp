@@ -0,0 +1,122 @@
+#include "../LightClusters.hpp"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/trigonometric.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+/*
+	Times LightClusters::build for a few light counts, with the renderer's camera and lights scattered through the view frustum.
+
+	Every result is also checked against a brute force assignment (every light against every cluster, with the same bounds), so the slice
+	bucketing and SSE paths can't silently drop or invent lights.
+*/
+
+static constexpr u32 LIGHT_COUNTS[] = {256, 1024, 4096};
+static constexpr u32 ITERATIONS = 100;
+
+static std::vector<LightClusters::Light> scatter_lights(u32 count, const Perspective& cam_proj, std::mt19937& rng) {
+	std::uniform_real_distribution<f32> unit{0.f, 1.f};
+	const f32 tan_half_fovy = std::tan(cam_proj.fovy * 0.5f);
+
+	std::vector<LightClusters::Light> lights(count);
+	for (auto& light : lights) {
+		// uniform in the frustum's volume, out to a fifth of the far plane (where the scene is)
+		const f32 distance = cam_proj.near + std::cbrt(unit(rng)) * (cam_proj.far * 0.2f - cam_proj.near);
+		const f32 x = (unit(rng) * 2.f - 1.f) * distance * tan_half_fovy * cam_proj.aspect_ratio;
+		const f32 y = (unit(rng) * 2.f - 1.f) * distance * tan_half_fovy;
+
+		light.position = glm::vec3{x, y, -distance};
+		light.radius = 0.5f + unit(rng) * 2.5f;
+		light.color = glm::vec3{unit(rng), unit(rng), unit(rng)};
+		light.intensity = 10.f;
+		light.spot = unit(rng) < 0.25f;
+		light.direction = glm::normalize(glm::vec3{unit(rng) - 0.5f, -1.f, unit(rng) - 0.5f});
+		light.cos_outer = std::cos(glm::radians(20.f + unit(rng) * 50.f));
+		light.cos_inner = std::min(1.f, light.cos_outer + 0.05f);
+	}
+	return lights;
+}
+
+// every light against every cluster, scalar; returns true if each cluster got exactly the lights it should have
+static bool matches_brute_force(const LightClusters& clusters, std::span<const LightClusters::Light> lights) {
+	const auto ranges = clusters.ranges();
+	const auto indices = clusters.indices();
+
+	for (u32 c = 0; c < LightClusters::CLUSTER_COUNT; ++c) {
+		glm::vec3 min, max;
+		clusters.cluster_bounds(c, min, max);
+
+		const auto begin = indices.begin() + ranges[c].offset;
+		const auto end = begin + ranges[c].count;
+		u32 expected_count = 0;
+
+		for (u32 i = 0; i < lights.size(); ++i) {
+			glm::vec3 center;
+			f32 radius;
+			LightClusters::bounding_sphere(lights[i], center, radius);
+
+			const glm::vec3 d = glm::max(glm::vec3{0.f}, glm::max(min - center, center - max));
+			const bool expected = glm::dot(d, d) <= radius * radius;
+			expected_count += expected ? 1 : 0;
+
+			// a full cluster legitimately misses some
+			if (expected && std::find(begin, end, i) == end && ranges[c].count < LightClusters::MAX_LIGHTS_PER_CLUSTER) {
+				std::fprintf(stderr, "cluster %u is missing light %u\n", c, i);
+				return false;
+			}
+		}
+
+		if (ranges[c].count > expected_count) {
+			std::fprintf(stderr, "cluster %u has %u lights instead of %u\n", c, ranges[c].count, expected_count);
+			return false;
+		}
+	}
+	return true;
+}
+
+int main() {
+	Perspective cam_proj;
+	cam_proj.fovy = glm::radians(60.f);
+	cam_proj.aspect_ratio = 16.f / 9.f;
+	cam_proj.near = 0.1f;
+	cam_proj.far = 100.f;
+
+	std::mt19937 rng{1234};
+	bool ok = true;
+
+	for (const u32 count : LIGHT_COUNTS) {
+		const auto lights = scatter_lights(count, cam_proj, rng);
+
+		LightClusters clusters;
+		// first build computes the cluster bounds, which normally only happens when the projection changes
+		clusters.build(cam_proj, glm::mat4{1.f}, lights);
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (u32 i = 0; i < ITERATIONS; ++i) {
+			clusters.build(cam_proj, glm::mat4{1.f}, lights);
+		}
+		const auto end = std::chrono::high_resolution_clock::now();
+		const f64 ms = std::chrono::duration<f64, std::milli>(end - start).count() / ITERATIONS;
+
+		u32 max_count = 0;
+		for (const auto& range : clusters.ranges()) {
+			max_count = std::max(max_count, range.count);
+		}
+
+		const bool valid = matches_brute_force(clusters, lights);
+		ok = ok && valid;
+
+		std::printf("%5u lights: %7.3f ms per build, %7zu indices (%.1f per cluster, max %u, %u overflowed)%s\n", count, ms, clusters.indices().size(),
+			static_cast<f64>(clusters.indices().size()) / LightClusters::CLUSTER_COUNT, max_count, clusters.overflowed_clusters(),
+			valid ? "" : ", DOESN'T MATCH BRUTE FORCE");
+	}
+
+	return ok ? 0 : 1;
+}
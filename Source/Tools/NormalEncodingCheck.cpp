@@ -0,0 +1,129 @@
+#include "../Types.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+/*
+	Round trips unit vectors through normal_encoding.glsl the way g_normal stores them: encode_normal, quantization to R16G16_SNORM
+	(round to nearest, as Vulkan requires for snorm writes), then decode_normal, all in single precision like the shaders.
+
+	The vectors are the axes, the octahedron's fold lines (where the lower hemisphere is mirrored over the upper one), and uniformly random
+	directions. Returns nonzero if any of them comes back more than MAX_ERROR_DEGREES off.
+*/
+
+static constexpr u32 RANDOM_COUNT = 1 << 21;
+// the octahedral map's worst texel at 16 bits is a few thousandths of a degree; far below what lighting or SSAO can show
+static constexpr f64 MAX_ERROR_DEGREES = 0.01;
+
+struct Vec2 {
+	f32 x, y;
+};
+
+struct Vec3 {
+	f32 x, y, z;
+};
+
+static f32 sign_not_zero(f32 v) {
+	return v >= 0.f ? 1.f : -1.f;
+}
+
+static Vec3 normalize(Vec3 v) {
+	const f32 length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+	return Vec3{v.x / length, v.y / length, v.z / length};
+}
+
+// encode_normal from normal_encoding.glsl
+static Vec2 encode_normal(Vec3 n) {
+	const f32 l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	n = Vec3{n.x / l1, n.y / l1, n.z / l1};
+	if (n.z < 0.f) {
+		return Vec2{(1.f - std::abs(n.y)) * sign_not_zero(n.x), (1.f - std::abs(n.x)) * sign_not_zero(n.y)};
+	}
+	return Vec2{n.x, n.y};
+}
+
+// decode_normal from normal_encoding.glsl
+static Vec3 decode_normal(Vec2 e) {
+	Vec3 n{e.x, e.y, 1.f - std::abs(e.x) - std::abs(e.y)};
+	const f32 t = std::clamp(-n.z, 0.f, 1.f);
+	n.x += n.x >= 0.f ? -t : t;
+	n.y += n.y >= 0.f ? -t : t;
+	return normalize(n);
+}
+
+// a write to an R16_SNORM texel and the filtered read of it at a texel center
+static f32 snorm16(f32 v) {
+	const f32 stored = std::round(std::clamp(v, -1.f, 1.f) * 32767.f);
+	return std::max(stored / 32767.f, -1.f);
+}
+
+static f64 angle_degrees(Vec3 a, Vec3 b) {
+	const f64 cos_angle = static_cast<f64>(a.x) * b.x + static_cast<f64>(a.y) * b.y + static_cast<f64>(a.z) * b.z;
+	const f64 sin_angle = std::hypot(static_cast<f64>(a.y) * b.z - static_cast<f64>(a.z) * b.y, static_cast<f64>(a.z) * b.x - static_cast<f64>(a.x) * b.z,
+		static_cast<f64>(a.x) * b.y - static_cast<f64>(a.y) * b.x);
+	// atan2 stays accurate for tiny angles, where acos of the dot product would round to 0
+	return std::atan2(sin_angle, cos_angle) * 180.0 / 3.14159265358979323846;
+}
+
+int main() {
+	f64 max_error = 0.0;
+	f64 sum_error = 0.0;
+	u32 count = 0;
+	Vec3 worst{0.f, 0.f, 1.f};
+
+	const auto check = [&](Vec3 n) {
+		n = normalize(n);
+		const Vec2 e = encode_normal(n);
+		const Vec3 decoded = decode_normal(Vec2{snorm16(e.x), snorm16(e.y)});
+
+		const f64 error = angle_degrees(n, decoded);
+		// also catches NaNs
+		if (!(error <= max_error)) {
+			max_error = std::isnan(error) ? HUGE_VAL : error;
+			worst = n;
+		}
+		sum_error += error;
+		++count;
+	};
+
+	// the axes, and the fold lines of both hemispheres (including the equator, which either side may encode)
+	const f32 signs[] = {-1.f, 1.f};
+	for (const f32 s : signs) {
+		check(Vec3{s, 0.f, 0.f});
+		check(Vec3{0.f, s, 0.f});
+		check(Vec3{0.f, 0.f, s});
+	}
+	for (u32 i = 0; i <= 1024; ++i) {
+		const f32 t = i / 1024.f;
+		for (const f32 sx : signs) {
+			for (const f32 sy : signs) {
+				for (const f32 sz : signs) {
+					check(Vec3{sx * t, sy * (1.f - t), 0.f});
+					check(Vec3{sx * t, 0.f, sz * (1.f - t)});
+					check(Vec3{0.f, sy * t, sz * (1.f - t)});
+					check(Vec3{sx * t, sy * (1.f - t), sz * 1e-3f});
+				}
+			}
+		}
+	}
+
+	// uniform on the sphere
+	std::mt19937 rng{1234};
+	std::normal_distribution<f32> gaussian{0.f, 1.f};
+	for (u32 i = 0; i < RANDOM_COUNT; ++i) {
+		Vec3 n{gaussian(rng), gaussian(rng), gaussian(rng)};
+		if (n.x * n.x + n.y * n.y + n.z * n.z < 1e-12f) {
+			continue;
+		}
+		check(n);
+	}
+
+	std::printf("%u normals: max error %.5f degrees, mean %.5f (limit %.3f)\n", count, max_error, sum_error / count, MAX_ERROR_DEGREES);
+	if (max_error > MAX_ERROR_DEGREES) {
+		std::fprintf(stderr, "worst normal (%f, %f, %f)\n", worst.x, worst.y, worst.z);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,355 @@
+#include "../Renderer.hpp"
+#include "../Context.hpp"
+#include "../CameraPath.hpp"
+#include "../CpuTrace.hpp"
+
+#include <vuk/Context.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+	Renders the scene headless along a camera path at a fixed timestep, and writes per-frame timings of the measured frames (and their mean
+	and percentiles) to a JSON file, for tracking regressions between builds.
+
+	Everything that moves is driven by the frame count rather than the clock (the camera by the path, the lights by Renderer::update), so
+	every run renders the same frames. Dynamic resolution is off in headless mode.
+
+	Per frame:
+	- cpu_ms: update() and render() up to handing the frame to vuk (see Renderer::cpu_frame_ms)
+	- frame_ms: the wall time of update() and render(), which wait for the GPU in headless mode
+	- gpu_ms: the first to the last pass of the frame; read back vuk::Context::FC frames late, so that many extra frames are rendered at the
+	  end, and null without timestamp support
+	- color_fragments and gbuffer_fragments: fragment shader invocations of the color pass, and of the G-buffer pass, which rasterizes the
+	  same geometry with a full depth test the way the color pass did before it tested against depth_prepass (see
+	  Renderer::color_pass_statistics); read back like gpu_ms, and null without pipeline statistics support
+
+	plus each pass's GPU time (see GpuProfiler), averaged over the last GpuProfiler::AVERAGE_FRAMES measured frames, and the shadow pass'
+	draw calls and recording time (see CascadedShadowRenderPass::Stats), which --shadows compares between drawing each caster once for all
+	its cascades and once per cascade.
+
+	--ao, --volumetric and --volumetric-scale pick what the passes compared run with (the renderer's defaults otherwise); their cost is in
+	the per pass times ("ssao*" against "gtao*", and "volumetric*" or "froxel*"). The scale only matters with --volumetric raymarch, since
+	the froxel fog is the default. Likewise --aa, whose cost is in "forward lighting" (multisampled with msaa) and "fxaa" or "taa".
+*/
+
+// renderer_benchmark [--size <width>x<height>] [--warmup <count>] [--frames <count>] [--path <file>] [--output <file.json>]
+//                    [--trace <file.json>] [--shadows instanced|per-cascade] [--ao ssao|gtao] [--volumetric froxel|raymarch]
+//                    [--volumetric-scale 1|2|4] [--aa none|msaa|fxaa|taa]
+struct Options {
+	vuk::Extent2D extent{1280, 720};
+	u32 warmup = 60;
+	u32 frames = 600;
+	// a recorded path (vukpbr --record), or CameraPath::orbit()
+	std::string path;
+	std::string output = "benchmark.json";
+	// a Chrome trace of the last frames' CPU zones (see CpuTrace.hpp)
+	std::string trace;
+	// CascadedShadowRenderPass::instanced_cascades
+	bool instanced_shadows = true;
+	// see Renderer::set_horizon_ao, set_froxel_fog and set_volumetric_downscale
+	std::optional<bool> horizon_ao;
+	std::optional<bool> froxel_fog;
+	std::optional<u32> volumetric_downscale;
+	// see Renderer::set_anti_aliasing
+	std::optional<AntiAliasingPass::Mode> anti_aliasing;
+};
+
+// seconds along the camera path per frame
+static constexpr f32 TIMESTEP = 1.f / 60.f;
+
+struct Stats {
+	f64 mean;
+	f64 p50;
+	f64 p95;
+	f64 p99;
+	f64 max;
+};
+
+static std::optional<Options> parse_options(i32 argc, char** argv) {
+	Options options;
+
+	for (i32 i = 1; i < argc; ++i) {
+		const std::string_view arg{argv[i]};
+		const bool has_value = i + 1 < argc;
+
+		if (arg == "--size" && has_value) {
+			u32 width, height;
+			if (std::sscanf(argv[++i], "%ux%u", &width, &height) != 2 || width == 0 || height == 0) {
+				spdlog::error("--size expects <width>x<height>, got {}", argv[i]);
+				return {};
+			}
+			options.extent = vuk::Extent2D{width, height};
+		} else if (arg == "--warmup" && has_value) {
+			if (std::sscanf(argv[++i], "%u", &options.warmup) != 1) {
+				spdlog::error("--warmup expects a count, got {}", argv[i]);
+				return {};
+			}
+		} else if (arg == "--frames" && has_value) {
+			if (std::sscanf(argv[++i], "%u", &options.frames) != 1 || options.frames == 0) {
+				spdlog::error("--frames expects a positive count, got {}", argv[i]);
+				return {};
+			}
+		} else if (arg == "--path" && has_value) {
+			options.path = argv[++i];
+		} else if (arg == "--output" && has_value) {
+			options.output = argv[++i];
+		} else if (arg == "--trace" && has_value) {
+			options.trace = argv[++i];
+		} else if (arg == "--shadows" && has_value) {
+			const std::string_view mode{argv[++i]};
+			if (mode != "instanced" && mode != "per-cascade") {
+				spdlog::error("--shadows expects instanced or per-cascade, got {}", mode);
+				return {};
+			}
+			options.instanced_shadows = mode == "instanced";
+		} else if (arg == "--ao" && has_value) {
+			const std::string_view mode{argv[++i]};
+			if (mode != "ssao" && mode != "gtao") {
+				spdlog::error("--ao expects ssao or gtao, got {}", mode);
+				return {};
+			}
+			options.horizon_ao = mode == "gtao";
+		} else if (arg == "--volumetric" && has_value) {
+			const std::string_view mode{argv[++i]};
+			if (mode != "froxel" && mode != "raymarch") {
+				spdlog::error("--volumetric expects froxel or raymarch, got {}", mode);
+				return {};
+			}
+			options.froxel_fog = mode == "froxel";
+		} else if (arg == "--volumetric-scale" && has_value) {
+			u32 downscale;
+			if (std::sscanf(argv[++i], "%u", &downscale) != 1 || (downscale != 1 && downscale != 2 && downscale != 4)) {
+				spdlog::error("--volumetric-scale expects 1, 2 or 4, got {}", argv[i]);
+				return {};
+			}
+			options.volumetric_downscale = downscale;
+		} else if (arg == "--aa" && has_value) {
+			const std::string_view mode{argv[++i]};
+			using Mode = AntiAliasingPass::Mode;
+			for (const Mode candidate : {Mode::None, Mode::MSAA, Mode::FXAA, Mode::TAA}) {
+				if (mode == AntiAliasingPass::mode_name(candidate)) {
+					options.anti_aliasing = candidate;
+				}
+			}
+			if (!options.anti_aliasing) {
+				spdlog::error("--aa expects none, msaa, fxaa or taa, got {}", mode);
+				return {};
+			}
+		} else {
+			spdlog::error("unknown argument {}", arg);
+			return {};
+		}
+	}
+
+	return options;
+}
+
+// nearest rank percentiles
+static Stats stats(std::vector<f64> values) {
+	std::sort(values.begin(), values.end());
+	const auto percentile = [&](f64 p) {
+		const size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+		return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+	};
+
+	return Stats{
+		.mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size(),
+		.p50 = percentile(50.0),
+		.p95 = percentile(95.0),
+		.p99 = percentile(99.0),
+		.max = values.back(),
+	};
+}
+
+static std::string json_string(std::string_view text) {
+	std::string result = "\"";
+	for (const char c : text) {
+		if (c == '"' || c == '\\') {
+			result += '\\';
+		}
+		result += c;
+	}
+	return result + "\"";
+}
+
+static void write_series(std::ofstream& file, const char* name, const std::vector<f64>& values, const char* unit, bool last) {
+	file << "\t\"" << name << "\": ";
+	if (values.empty()) {
+		file << "null" << (last ? "\n" : ",\n");
+		return;
+	}
+
+	const Stats s = stats(values);
+	file << "{\n";
+	file << "\t\t\"mean\": " << s.mean << ", \"p50\": " << s.p50 << ", \"p95\": " << s.p95 << ", \"p99\": " << s.p99 << ", \"max\": " << s.max << ",\n";
+	file << "\t\t\"frames\": [";
+	for (size_t i = 0; i < values.size(); ++i) {
+		file << (i == 0 ? "" : ", ") << values[i];
+	}
+	file << "]\n\t}" << (last ? "\n" : ",\n");
+
+	spdlog::info("{:>16}: mean {:.3f} {}, p50 {:.3f}, p95 {:.3f}, p99 {:.3f}, max {:.3f}", name, s.mean, unit, s.p50, s.p95, s.p99, s.max);
+}
+
+int main(int argc, char** argv) {
+	const auto options = parse_options(argc, argv);
+	if (!options) {
+		return 1;
+	}
+
+	std::optional<CameraPath> path = options->path.empty() ? CameraPath::orbit() : CameraPath::load(options->path);
+	if (!path) {
+		return 1;
+	}
+
+	auto ctxt = Context::create(options->extent);
+	if (!ctxt) {
+		return 1;
+	}
+
+	auto renderer = std::make_optional<Renderer>();
+	if (!renderer->init(*ctxt)) {
+		renderer.reset();
+		Context::cleanup(ctxt);
+		return 1;
+	}
+	renderer->cascaded_shadows().instanced_cascades = options->instanced_shadows;
+	if (options->horizon_ao) {
+		renderer->set_horizon_ao(*options->horizon_ao);
+	}
+	if (options->froxel_fog) {
+		renderer->set_froxel_fog(*options->froxel_fog);
+	}
+	if (options->volumetric_downscale) {
+		renderer->set_volumetric_downscale(*options->volumetric_downscale);
+	}
+	if (options->anti_aliasing) {
+		renderer->set_anti_aliasing(*options->anti_aliasing);
+	}
+
+	std::vector<f64> cpu_ms;
+	std::vector<f64> frame_ms;
+	std::vector<f64> gpu_ms;
+	std::vector<f64> shadow_draw_calls;
+	std::vector<f64> shadow_record_ms;
+	std::vector<f64> color_fragments;
+	std::vector<f64> gbuffer_fragments;
+	bool gpu_complete = true;
+	bool statistics_complete = true;
+
+	const u32 measured_begin = options->warmup;
+	const u32 measured_end = options->warmup + options->frames;
+
+	// the last vuk::Context::FC frames are only there to read back the GPU times of the measured ones
+	for (u32 i = 0; i < measured_end + vuk::Context::FC; ++i) {
+		// paths shorter than the run loop
+		const f32 duration = path->duration();
+		const auto keyframe = path->sample(duration > 0.f ? std::fmod(i * TIMESTEP, duration) : 0.f);
+		renderer->set_camera(keyframe.position, keyframe.yaw, keyframe.pitch);
+
+		const auto start = std::chrono::steady_clock::now();
+		renderer->update();
+		renderer->render();
+		const f64 wall_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		if (i >= measured_begin && i < measured_end) {
+			cpu_ms.push_back(renderer->cpu_frame_ms());
+			frame_ms.push_back(wall_ms);
+			const auto& shadow_stats = renderer->cascaded_shadows().stats();
+			shadow_draw_calls.push_back(shadow_stats.draw_calls);
+			shadow_record_ms.push_back(shadow_stats.record_ms);
+		}
+
+		// of frame i - FC
+		if (i >= measured_begin + vuk::Context::FC) {
+			if (const auto ms = renderer->gpu_frame_ms()) {
+				gpu_ms.push_back(*ms);
+			} else {
+				gpu_complete = false;
+			}
+			const auto color_pass = renderer->color_pass_statistics();
+			const auto gbuffer = renderer->gbuffer_statistics();
+			if (color_pass && gbuffer) {
+				color_fragments.push_back(static_cast<f64>(color_pass->fragment_invocations));
+				gbuffer_fragments.push_back(static_cast<f64>(gbuffer->fragment_invocations));
+			} else {
+				statistics_complete = false;
+			}
+		}
+	}
+
+	if (!gpu_complete) {
+		spdlog::warn("no GPU times (timestamps aren't supported on this device)");
+		gpu_ms.clear();
+	}
+	if (!statistics_complete) {
+		spdlog::warn("no fragment shader invocations (pipeline statistics aren't supported on this device)");
+		color_fragments.clear();
+		gbuffer_fragments.clear();
+	}
+
+	if (!options->trace.empty()) {
+		cpu_trace::write_chrome_json(options->trace);
+	}
+
+	std::vector<std::pair<std::string, f64>> passes;
+	if (gpu_complete) {
+		for (const auto& scope : renderer->profiler().scopes()) {
+			passes.emplace_back(scope.name, scope.average_ms);
+		}
+	}
+
+	// render() falls back to per cascade draws without shaderClipDistance
+	const bool instanced_shadows = renderer->cascaded_shadows().stats().instanced;
+	if (options->instanced_shadows && !instanced_shadows) {
+		spdlog::warn("instanced shadows aren't supported on this device, measured per-cascade");
+	}
+
+	renderer.reset();
+	Context::cleanup(ctxt);
+
+	std::ofstream file{options->output};
+	if (!file) {
+		spdlog::error("failed to write {}", options->output);
+		return 1;
+	}
+
+	file << "{\n";
+	file << "\t\"width\": " << options->extent.width << ", \"height\": " << options->extent.height << ",\n";
+	file << "\t\"warmup_frames\": " << options->warmup << ", \"measured_frames\": " << options->frames << ", \"timestep\": " << TIMESTEP << ",\n";
+	file << "\t\"path\": " << json_string(options->path.empty() ? "orbit" : options->path) << ",\n";
+	file << "\t\"shadows\": " << json_string(instanced_shadows ? "instanced" : "per-cascade") << ",\n";
+	// null where the renderer's default was used
+	file << "\t\"ao\": " << (options->horizon_ao ? json_string(*options->horizon_ao ? "gtao" : "ssao") : "null")
+		 << ", \"volumetric\": " << (options->froxel_fog ? json_string(*options->froxel_fog ? "froxel" : "raymarch") : "null")
+		 << ", \"volumetric_scale\": " << (options->volumetric_downscale ? std::to_string(*options->volumetric_downscale) : "null")
+		 << ", \"aa\": " << (options->anti_aliasing ? json_string(AntiAliasingPass::mode_name(*options->anti_aliasing)) : "null") << ",\n";
+	write_series(file, "cpu_ms", cpu_ms, "ms", false);
+	write_series(file, "frame_ms", frame_ms, "ms", false);
+	write_series(file, "gpu_ms", gpu_ms, "ms", false);
+	write_series(file, "shadow_draw_calls", shadow_draw_calls, "draws", false);
+	write_series(file, "shadow_record_ms", shadow_record_ms, "ms", false);
+	write_series(file, "color_fragments", color_fragments, "invocations", false);
+	write_series(file, "gbuffer_fragments", gbuffer_fragments, "invocations", false);
+	file << "\t\"passes\": {";
+	for (size_t i = 0; i < passes.size(); ++i) {
+		file << (i == 0 ? "\n" : ",\n") << "\t\t" << json_string(passes[i].first) << ": " << passes[i].second;
+	}
+	file << (passes.empty() ? "}\n" : "\n\t}\n");
+	file << "}\n";
+
+	if (!file) {
+		spdlog::error("failed to write {}", options->output);
+		return 1;
+	}
+	spdlog::info("wrote {} measured frames to {}", options->frames, options->output);
+}
@@ -1,13 +1,115 @@
 #include "Renderer.hpp"
 #include "Context.hpp"
+#include "CameraPath.hpp"
 
 #include <GLFW/glfw3.h>
+#include <spdlog/spdlog.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <string_view>
 
-int main() {
-	auto ctxt = Context::create();
+// a keyframe of the recorded camera path this often, in seconds
+static constexpr f64 RECORD_INTERVAL = 0.1;
+
+// vukpbr [--headless <width>x<height> [--frames <count>] [--output <file.ppm>]] [--record <file>]
+struct Options {
+	std::optional<vuk::Extent2D> headless_extent;
+	// headless only: how many frames to render before exiting, and where to write the last one
+	u32 frames = 1;
+	std::string output;
+	// with a window only: where to write the camera's path on exit, for renderer_benchmark --path
+	std::string record;
+};
+
+static std::optional<Options> parse_options(i32 argc, char** argv) {
+	Options options;
+
+	for (i32 i = 1; i < argc; ++i) {
+		const std::string_view arg{argv[i]};
+		const bool has_value = i + 1 < argc;
+
+		if (arg == "--headless" && has_value) {
+			u32 width, height;
+			if (std::sscanf(argv[++i], "%ux%u", &width, &height) != 2 || width == 0 || height == 0) {
+				spdlog::error("--headless expects <width>x<height>, got {}", argv[i]);
+				return {};
+			}
+			options.headless_extent = vuk::Extent2D{width, height};
+		} else if (arg == "--frames" && has_value) {
+			if (std::sscanf(argv[++i], "%u", &options.frames) != 1 || options.frames == 0) {
+				spdlog::error("--frames expects a positive count, got {}", argv[i]);
+				return {};
+			}
+		} else if (arg == "--output" && has_value) {
+			options.output = argv[++i];
+		} else if (arg == "--record" && has_value) {
+			options.record = argv[++i];
+		} else {
+			spdlog::error("unknown argument {}", arg);
+			return {};
+		}
+	}
+
+	return options;
+}
+
+// binary PPM; the alpha channel is dropped
+static bool write_ppm(const std::string& path, std::span<const u8> rgba, vuk::Extent2D extent) {
+	std::ofstream file{path, std::ios::binary};
+	if (!file) {
+		return false;
+	}
+
+	file << "P6\n" << extent.width << " " << extent.height << "\n255\n";
+	for (size_t i = 0; i + 3 < rgba.size(); i += 4) {
+		file.write(reinterpret_cast<const char*>(&rgba[i]), 3);
+	}
+	return static_cast<bool>(file);
+}
+
+static i32 run_headless(Context& ctxt, Renderer& renderer, const Options& options) {
+	for (u32 i = 0; i < options.frames; ++i) {
+		renderer.set_readback(i + 1 == options.frames && !options.output.empty());
+		renderer.update();
+		renderer.render();
+	}
+
+	if (!options.output.empty()) {
+		if (!write_ppm(options.output, renderer.frame(), ctxt.output_extent)) {
+			spdlog::error("failed to write {}", options.output);
+			return 1;
+		}
+		spdlog::info("wrote frame {} to {}", options.frames, options.output);
+	}
+
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	const auto options = parse_options(argc, argv);
+	if (!options) {
+		return 1;
+	}
+
+	auto ctxt = Context::create(options->headless_extent);
+	if (!ctxt) {
+		return 1;
+	}
 
 	auto renderer = std::make_optional<Renderer>();
-	renderer->init(*ctxt);
+	if (!renderer->init(*ctxt)) {
+		renderer.reset();
+		Context::cleanup(ctxt);
+		return 1;
+	}
+
+	if (ctxt->headless) {
+		const i32 result = run_headless(*ctxt, *renderer, *options);
+		renderer.reset();
+		Context::cleanup(ctxt);
+		return result;
+	}
 
 	glfwSetWindowUserPointer(ctxt->window, &*renderer);
 	glfwSetInputMode(ctxt->window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -21,13 +123,39 @@ int main() {
 		if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
 			glfwSetWindowShouldClose(window, GLFW_TRUE);
 		}
+
+		Renderer* r = (Renderer*)glfwGetWindowUserPointer(window);
+		r->key_event(key, action);
 	});
 
+	CameraPath recorded;
+	const f64 record_start = glfwGetTime();
+	f64 next_keyframe = record_start;
+
 	while (!glfwWindowShouldClose(ctxt->window)) {
 		glfwPollEvents();
 
 		renderer->update();
 		renderer->render();
+
+		const f64 now = glfwGetTime();
+		if (!options->record.empty() && now >= next_keyframe) {
+			recorded.add(CameraPath::Keyframe{
+				.time = static_cast<f32>(now - record_start),
+				.position = renderer->camera_position(),
+				.yaw = renderer->camera_yaw(),
+				.pitch = renderer->camera_pitch(),
+			});
+			next_keyframe = now + RECORD_INTERVAL;
+		}
+	}
+
+	if (!options->record.empty()) {
+		if (recorded.save(options->record)) {
+			spdlog::info("wrote a {:.1f}s camera path to {}", recorded.duration(), options->record);
+		} else {
+			spdlog::error("failed to write {}", options->record);
+		}
 	}
 
 	renderer.reset();